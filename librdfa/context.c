@@ -89,8 +89,13 @@ void rdfa_init_context(rdfacontext* context)
 
 #ifdef LIBRDFA_IN_RAPTOR
 #else
-   /* the [list of URI mappings] is cleared; */
-   context->uri_mappings = rdfa_create_mapping(MAX_URI_MAPPINGS);
+   /* the [list of URI mappings] is cleared;
+    * NOTE: unless rdfa_create_new_element_context() has shared them */
+   if(context->uri_mappings == NULL)
+   {
+      context->uri_mappings = rdfa_create_mapping(MAX_URI_MAPPINGS);
+      context->uri_mappings_owned = 1;
+   }
 #endif
 
    /* the [list of incomplete triples] is cleared; */
@@ -104,14 +109,26 @@ void rdfa_init_context(rdfacontext* context)
 
    /* the list of term mappings is set to null
     * (or a list defined in the initial context of the Host Language). */
-   context->term_mappings = rdfa_create_mapping(MAX_TERM_MAPPINGS);
+   if(context->term_mappings == NULL)
+   {
+      context->term_mappings = rdfa_create_mapping(MAX_TERM_MAPPINGS);
+      context->term_mappings_owned = 1;
+   }
 
    /* the maximum number of list mappings */
-   context->list_mappings = rdfa_create_mapping(MAX_LIST_MAPPINGS);
+   if(context->list_mappings == NULL)
+   {
+      context->list_mappings = rdfa_create_mapping(MAX_LIST_MAPPINGS);
+      context->list_mappings_owned = 1;
+   }
 
    /* the maximum number of local list mappings */
-   context->local_list_mappings =
-      rdfa_create_mapping(MAX_LOCAL_LIST_MAPPINGS);
+   if(context->local_list_mappings == NULL)
+   {
+      context->local_list_mappings =
+         rdfa_create_mapping(MAX_LOCAL_LIST_MAPPINGS);
+      context->local_list_mappings_owned = 1;
+   }
 
    /* the default vocabulary is set to null
     * (or a IRI defined in the initial context of the Host Language). */
@@ -354,6 +371,44 @@ void rdfa_setup_initial_context(rdfacontext* context)
 #endif
 }
 
+#ifndef LIBRDFA_IN_RAPTOR
+/**
+ * Makes sure the URI mappings of a context can be changed by copying
+ * them if they are still shared with the parent context.
+ *
+ * @param context the context that is about to change its URI mappings.
+ */
+void rdfa_own_uri_mappings(rdfacontext* context)
+{
+   if(!context->uri_mappings_owned)
+   {
+      context->uri_mappings =
+         rdfa_copy_mapping((void**)context->uri_mappings,
+            (copy_mapping_value_fp)rdfa_replace_string);
+      context->uri_mappings_owned = 1;
+   }
+}
+#endif
+
+/**
+ * Makes sure the local list mappings of a context and the lists in
+ * them can be changed by copying them if they are still shared with
+ * the parent context.
+ *
+ * @param context the context that is about to change its local list
+ *                mappings.
+ */
+void rdfa_own_local_list_mappings(rdfacontext* context)
+{
+   if(!context->local_list_mappings_owned)
+   {
+      context->local_list_mappings =
+         rdfa_copy_mapping((void**)context->local_list_mappings,
+            (copy_mapping_value_fp)rdfa_replace_list);
+      context->local_list_mappings_owned = 1;
+   }
+}
+
 /**
  * Creates a new context for the current element by cloning certain
  * parts of the old context on the top of the given stack.
@@ -375,36 +430,23 @@ rdfacontext* rdfa_create_new_element_context(rdfalist* context_stack)
    /* * the [ base ] is set to the [ base ] value of the current
     *   [ evaluation context ]; */
    rval->base = rdfa_replace_string(rval->base, parent_context->base);
-   rdfa_init_context(rval);
-
-   /* Set the processing depth as parent + 1 */
-   rval->depth = parent_context->depth + 1;
 
-   /* copy the URI mappings */
+   /* share the mappings with the parent context; they are only copied
+    * when this element changes them, see rdfa_own_uri_mappings() and
+    * rdfa_own_local_list_mappings() */
 #ifdef LIBRDFA_IN_RAPTOR
    /* Raptor does this automatically for URIs */
 #else
-   rdfa_free_mapping(rval->uri_mappings, (free_mapping_value_fp)free);
+   rval->uri_mappings = parent_context->uri_mappings;
 #endif
-   rdfa_free_mapping(rval->term_mappings, (free_mapping_value_fp)free);
-   rdfa_free_mapping(rval->list_mappings, (free_mapping_value_fp)rdfa_free_list);
-   rdfa_free_mapping(rval->local_list_mappings, (free_mapping_value_fp)rdfa_free_list);
-#ifdef LIBRDFA_IN_RAPTOR
-   /* Raptor does this automatically for URIs */
-#else
-   rval->uri_mappings =
-      rdfa_copy_mapping((void**)parent_context->uri_mappings,
-         (copy_mapping_value_fp)rdfa_replace_string);
-#endif
-   rval->term_mappings =
-      rdfa_copy_mapping((void**)parent_context->term_mappings,
-         (copy_mapping_value_fp)rdfa_replace_string);
-   rval->list_mappings =
-      rdfa_copy_mapping((void**)parent_context->local_list_mappings,
-         (copy_mapping_value_fp)rdfa_replace_list);
-   rval->local_list_mappings =
-      rdfa_copy_mapping((void**)parent_context->local_list_mappings,
-         (copy_mapping_value_fp)rdfa_replace_list);
+   rval->term_mappings = parent_context->term_mappings;
+   rval->list_mappings = parent_context->local_list_mappings;
+   rval->local_list_mappings = parent_context->local_list_mappings;
+
+   rdfa_init_context(rval);
+
+   /* Set the processing depth as parent + 1 */
+   rval->depth = parent_context->depth + 1;
 
    /* inherit the parent context's host language and RDFa processor mode */
    rval->host_language = parent_context->host_language;
@@ -558,15 +600,19 @@ void rdfa_free_context(rdfacontext* context)
 
 #ifdef LIBRDFA_IN_RAPTOR
 #else
-   rdfa_free_mapping(context->uri_mappings, (free_mapping_value_fp)free);
+   if(context->uri_mappings_owned)
+      rdfa_free_mapping(context->uri_mappings, (free_mapping_value_fp)free);
 #endif
 
-   rdfa_free_mapping(context->term_mappings, (free_mapping_value_fp)free);
+   if(context->term_mappings_owned)
+      rdfa_free_mapping(context->term_mappings, (free_mapping_value_fp)free);
    rdfa_free_list(context->incomplete_triples);
-   rdfa_free_mapping(context->list_mappings,
-      (free_mapping_value_fp)rdfa_free_list);
-   rdfa_free_mapping(context->local_list_mappings,
-      (free_mapping_value_fp)rdfa_free_list);
+   if(context->list_mappings_owned)
+      rdfa_free_mapping(context->list_mappings,
+         (free_mapping_value_fp)rdfa_free_list);
+   if(context->local_list_mappings_owned)
+      rdfa_free_mapping(context->local_list_mappings,
+         (free_mapping_value_fp)rdfa_free_list);
    free(context->language);
    free(context->underscore_colon_bnode_name);
    free(context->new_subject);
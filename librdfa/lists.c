@@ -42,6 +42,7 @@ void rdfa_establish_new_inlist_triples(rdfacontext* context,
       char* resolved_predicate = rdfa_resolve_relrev_curie(context, predicate);
       rdftriple* triple;
       /* ensure the list mapping exists */
+      rdfa_own_local_list_mappings(context);
       rdfa_create_list_mapping(
          context, context->local_list_mappings,
          context->new_subject, resolved_predicate);
@@ -72,6 +73,7 @@ void rdfa_save_incomplete_list_triples(
       char* resolved_curie = rdfa_resolve_relrev_curie(context, curie);
 
       /* ensure the list mapping exists */
+      rdfa_own_local_list_mappings(context);
       rdfa_create_list_mapping(
          context, context->local_list_mappings,
          context->new_subject, resolved_curie);
@@ -127,7 +129,22 @@ void rdfa_complete_list_triples(rdfacontext* context)
             context->list_mappings, context->new_subject, key) == NULL) &&
          (strcmp(key, RDFA_MAPPING_DELETED_KEY) != 0))
       {
-         char* predicate = strstr(key, " ") + 1;
+         char* predicate;
+
+         /* the list is emptied below so copy a mapping still shared
+          * with the parent context and continue in the copy */
+         if(!context->local_list_mappings_owned)
+         {
+            size_t offset = (size_t)(kptr - context->local_list_mappings);
+
+            rdfa_own_local_list_mappings(context);
+            kptr = context->local_list_mappings + offset;
+            mptr = kptr + 2;
+            key = (char*)kptr[0];
+            list = (rdfalist*)kptr[1];
+         }
+
+         predicate = strstr(key, " ") + 1;
          triple = (rdftriple*)list->items[0]->data;
          if(list->num_items == 1)
          {
@@ -1180,23 +1180,23 @@ static void end_element(void* parser_context, const char* name,
    {
       rdfa_complete_list_triples(context);
 
-      if(parent_context != NULL)
+      /* a mapping still shared with the parent context is unchanged */
+      if(parent_context != NULL && context->local_list_mappings_owned)
       {
-         /* copy the current mapping to the parent mapping */
-         rdfa_free_mapping(parent_context->local_list_mappings,
-            (free_mapping_value_fp)rdfa_free_list);
-         parent_context->local_list_mappings = rdfa_copy_mapping(
-            (void**)context->local_list_mappings,
-            (copy_mapping_value_fp)rdfa_replace_list);
+         /* move the current mapping to the parent mapping */
+         if(parent_context->local_list_mappings_owned)
+            rdfa_free_mapping(parent_context->local_list_mappings,
+               (free_mapping_value_fp)rdfa_free_list);
+         parent_context->local_list_mappings = context->local_list_mappings;
+         parent_context->local_list_mappings_owned = 1;
 
 #if defined(DEBUG) && DEBUG > 0
-         printf("parent_context->local_list_mappings (after copy): ");
-         rdfa_print_mapping(context->local_list_mappings,
+         printf("parent_context->local_list_mappings (after move): ");
+         rdfa_print_mapping(parent_context->local_list_mappings,
                (print_mapping_value_fp)rdfa_print_triple_list);
 #endif
-         rdfa_free_mapping(context->local_list_mappings,
-            (free_mapping_value_fp)rdfa_free_list);
          context->local_list_mappings = NULL;
+         context->local_list_mappings_owned = 0;
       }
    }
 
@@ -1442,6 +1442,12 @@ int rdfa_parse_chunk(rdfacontext* context, char* data, size_t wblen, int done)
       {
          return RDFA_PARSE_FAILED;
       }
+
+      /* the pre-read data has been consumed; later chunks go straight
+       * to the SAX2 parser so the working buffer is no longer needed */
+      free(context->working_buffer);
+      context->working_buffer = NULL;
+      context->wb_allocated = 0;
 #else
       /* create the SAX2 handler structure */
       memset(&handler, 0, sizeof(xmlSAXHandler));
@@ -209,6 +209,14 @@ typedef struct rdfacontext
    void** term_mappings;
    void** list_mappings;
    void** local_list_mappings;
+   /* non-zero if the mapping was made for this context rather than
+    * shared with the parent context (copied on write) */
+#ifndef LIBRDFA_IN_RAPTOR
+   unsigned char uri_mappings_owned;
+#endif
+   unsigned char term_mappings_owned;
+   unsigned char list_mappings_owned;
+   unsigned char local_list_mappings_owned;
    rdfalist* incomplete_triples;
    rdfalist* local_incomplete_triples;
    char* language;
@@ -478,6 +478,13 @@ void rdfa_complete_list_triples(rdfacontext* context);
 rdfacontext* rdfa_create_new_element_context(rdfalist* context_stack);
 void rdfa_free_context_stack(rdfacontext* context);
 
+/* Declarations needed before changing mappings shared with the parent
+ * context */
+#ifndef LIBRDFA_IN_RAPTOR
+void rdfa_own_uri_mappings(rdfacontext* context);
+#endif
+void rdfa_own_local_list_mappings(rdfacontext* context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -304,6 +304,7 @@ void rdfa_complete_incomplete_triples(rdfacontext* context)
             predicate, context->new_subject, RDF_TYPE_IRI, NULL, NULL);
 
          /* ensure the list mapping exists */
+         rdfa_own_local_list_mappings(context);
          rdfa_create_list_mapping(
             context, context->local_list_mappings,
             context->parent_subject, predicate);
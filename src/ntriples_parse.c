@@ -52,18 +52,37 @@
 */
 
 
+/* bytes that can end a line or change the quoting state while
+ * finding the end of a line
+ */
+#define RAPTOR_NTRIPLES_LINE_SCAN_CLASSES (RAPTOR_SCAN_BACKSLASH | \
+  RAPTOR_SCAN_LT | RAPTOR_SCAN_GT | RAPTOR_SCAN_DQUOTE | \
+  RAPTOR_SCAN_SQUOTE | RAPTOR_SCAN_NEWLINE)
+
+
+typedef struct raptor_ntriples_block_s raptor_ntriples_block;
+typedef struct raptor_ntriples_pool_s raptor_ntriples_pool;
+
 /* Prototypes for local functions */
-static void raptor_ntriples_generate_statement(raptor_parser* parser, raptor_term* subject_term, raptor_term* predicate_term, raptor_term* object_term, raptor_term* graph_term);
+static void raptor_ntriples_generate_statement(raptor_parser* parser, raptor_ntriples_block* block, raptor_term* subject_term, raptor_term* predicate_term, raptor_term* object_term, raptor_term* graph_term);
+static int raptor_ntriples_parse_line(raptor_parser* rdf_parser, raptor_locator* locator, unsigned char *buffer, size_t len, int max_terms, raptor_ntriples_block* block);
+#ifdef RAPTOR_THREADS
+static void raptor_ntriples_pool_free(raptor_ntriples_pool* pool);
+#endif
 
 /*
  * NTriples parser object
  */
 struct raptor_ntriples_parser_context_s {
-  /* current line */
+  /* line buffer: complete lines are parsed in place and only the
+   * partial line at the end is kept between chunks
+   */
   unsigned char *line;
-  /* current line length */
+  /* allocated size of line buffer */
+  size_t line_size;
+  /* bytes of data in line buffer */
   size_t line_length;
-  /* current char in line buffer */
+  /* offset of first unconsumed char in line buffer */
   size_t offset;
 
   char last_char;
@@ -75,6 +94,14 @@ struct raptor_ntriples_parser_context_s {
   int is_nquads;
 
   int literal_graph_warning;
+
+  /* terms when RAPTOR_OPTION_TERM_ARENA is set (or NULL) */
+  raptor_arena* arena;
+
+#ifdef RAPTOR_THREADS
+  /* worker threads when RAPTOR_OPTION_PARSE_THREADS is set (or NULL) */
+  raptor_ntriples_pool* pool;
+#endif
 };
 
 
@@ -118,21 +145,635 @@ raptor_ntriples_parse_terminate(raptor_parser* rdf_parser)
 {
   raptor_ntriples_parser_context *ntriples_parser;
   ntriples_parser = (raptor_ntriples_parser_context*)rdf_parser->context;
-  if(ntriples_parser->line_length)
+#ifdef RAPTOR_THREADS
+  if(ntriples_parser->pool)
+    raptor_ntriples_pool_free(ntriples_parser->pool);
+#endif
+  if(ntriples_parser->arena)
+    raptor_free_arena(ntriples_parser->arena);
+  if(ntriples_parser->line)
     RAPTOR_FREE(cdata, ntriples_parser->line);
 }
 
 
+/*
+ * raptor_ntriples_buffer_append:
+ * @rdf_parser: parser object
+ * @s: bytes to add
+ * @len: length of @s
+ *
+ * INTERNAL - Add bytes to the end of the line buffer
+ *
+ * Any unconsumed partial line is first moved to the start of the
+ * buffer.  The buffer is only grown (doubling) when that partial
+ * line plus @len bytes do not fit, so in steady state no allocation
+ * is done.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_ntriples_buffer_append(raptor_parser* rdf_parser,
+                              const unsigned char *s, size_t len)
+{
+  raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)rdf_parser->context;
+  size_t remaining = ntriples_parser->line_length - ntriples_parser->offset;
+  size_t need = remaining + len + 1;
+
+  if(ntriples_parser->offset) {
+    if(remaining)
+      memmove(ntriples_parser->line,
+              ntriples_parser->line + ntriples_parser->offset, remaining);
+    ntriples_parser->line_length = remaining;
+    ntriples_parser->offset = 0;
+  }
+
+  if(need > ntriples_parser->line_size) {
+    size_t new_size = ntriples_parser->line_size;
+    unsigned char *buffer;
+
+    if(!new_size)
+      new_size = RAPTOR_READ_BUFFER_SIZE + 1;
+    while(new_size < need)
+      new_size <<= 1;
+
+    buffer = RAPTOR_MALLOC(unsigned char*, new_size);
+    if(!buffer) {
+      raptor_parser_fatal_error(rdf_parser, "Out of memory");
+      return 1;
+    }
+
+    if(remaining)
+      memcpy(buffer, ntriples_parser->line, remaining);
+    if(ntriples_parser->line)
+      RAPTOR_FREE(char*, ntriples_parser->line);
+
+    ntriples_parser->line = buffer;
+    ntriples_parser->line_size = new_size;
+
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
+    RAPTOR_DEBUG2("grew buffer to %ld bytes\n", (long)new_size);
+#endif
+  }
+
+  memcpy(ntriples_parser->line + ntriples_parser->line_length, s, len);
+  ntriples_parser->line_length += len;
+  ntriples_parser->line[ntriples_parser->line_length] = '\0';
+
+  return 0;
+}
+
+
+#ifdef RAPTOR_THREADS
+/*
+ * Parallel parsing
+ *
+ * The calling thread splits the input into lines as in the serial
+ * case but copies them into blocks which are queued for a pool of
+ * worker threads.  Each worker runs raptor_ntriples_parse_line() over
+ * the lines of one block with its own locator.
+ *
+ * In ordered mode the statements of a block are kept in the block
+ * and passed to the statement handler by the calling thread, in
+ * input order.  In unordered mode the workers call the statement
+ * handler directly.
+ */
+
+/* Maximum lines and (approximate) bytes in one block */
+#define RAPTOR_NTRIPLES_BLOCK_LINES 2048
+#define RAPTOR_NTRIPLES_BLOCK_BYTES (1024 * 1024)
+
+typedef struct {
+  /* offset of line in block data */
+  size_t offset;
+  /* length of line */
+  size_t length;
+  /* input line number and byte offset of start of line */
+  int line;
+  int byte;
+} raptor_ntriples_block_line;
+
+typedef enum {
+  RAPTOR_NTRIPLES_BLOCK_FREE,
+  RAPTOR_NTRIPLES_BLOCK_FILLING,
+  RAPTOR_NTRIPLES_BLOCK_QUEUED,
+  RAPTOR_NTRIPLES_BLOCK_RUNNING,
+  RAPTOR_NTRIPLES_BLOCK_DONE
+} raptor_ntriples_block_state;
+
+struct raptor_ntriples_block_s {
+  raptor_ntriples_pool* pool;
+
+  raptor_ntriples_block_state state;
+
+  /* position of block in the input */
+  unsigned long sequence;
+
+  /* copy of the input lines, each NUL terminated */
+  unsigned char *data;
+  size_t data_length;
+  size_t data_size;
+
+  raptor_ntriples_block_line lines[RAPTOR_NTRIPLES_BLOCK_LINES];
+  int lines_count;
+
+  /* statements waiting for ordered delivery: 4 terms per statement */
+  raptor_term* terms[RAPTOR_NTRIPLES_BLOCK_LINES * 4];
+  int terms_count;
+
+  /* terms of this block if the parser uses an arena (or NULL) */
+  raptor_arena* arena;
+
+  /* non-0 if parsing a line failed */
+  int failed;
+
+  /* next block in work queue */
+  raptor_ntriples_block* next;
+};
+
+struct raptor_ntriples_pool_s {
+  raptor_parser* rdf_parser;
+
+  /* non-0 to deliver statements in input order */
+  int ordered;
+
+  /* locator template (URI and file) for workers */
+  raptor_locator locator;
+
+  pthread_mutex_t mutex;
+  /* signalled when a block is queued or the pool is stopping */
+  pthread_cond_t work_cond;
+  /* signalled when a worker finishes a block */
+  pthread_cond_t done_cond;
+
+  pthread_t* threads;
+  int threads_count;
+
+  raptor_ntriples_block* blocks;
+  int blocks_count;
+
+  /* FIFO of queued blocks */
+  raptor_ntriples_block* queue_head;
+  raptor_ntriples_block* queue_tail;
+
+  /* block being filled by the calling thread (or NULL) */
+  raptor_ntriples_block* current;
+
+  /* sequence of next block to queue and next block to deliver */
+  unsigned long queue_sequence;
+  unsigned long deliver_sequence;
+
+  int stop;
+};
+
+
+static void
+raptor_ntriples_block_parse(raptor_ntriples_block* block)
+{
+  raptor_ntriples_pool* pool = block->pool;
+  raptor_parser* rdf_parser = pool->rdf_parser;
+  raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)rdf_parser->context;
+  int max_terms = ntriples_parser->is_nquads ? 4 : 3;
+  raptor_locator locator = pool->locator;
+  int i;
+
+  for(i = 0; i < block->lines_count; i++) {
+    raptor_ntriples_block_line* line = &block->lines[i];
+
+    locator.line = line->line;
+    locator.column = 0;
+    locator.byte = line->byte;
+
+    if(raptor_ntriples_parse_line(rdf_parser, &locator,
+                                  block->data + line->offset, line->length,
+                                  max_terms, block)) {
+      block->failed = 1;
+      break;
+    }
+  }
+}
+
+
+static void*
+raptor_ntriples_pool_worker(void* arg)
+{
+  raptor_ntriples_pool* pool = (raptor_ntriples_pool*)arg;
+
+  pthread_mutex_lock(&pool->mutex);
+  while(1) {
+    raptor_ntriples_block* block;
+
+    while(!pool->queue_head && !pool->stop)
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+    if(pool->stop)
+      break;
+
+    block = pool->queue_head;
+    pool->queue_head = block->next;
+    if(!pool->queue_head)
+      pool->queue_tail = NULL;
+    block->next = NULL;
+    block->state = RAPTOR_NTRIPLES_BLOCK_RUNNING;
+
+    pthread_mutex_unlock(&pool->mutex);
+    raptor_ntriples_block_parse(block);
+    pthread_mutex_lock(&pool->mutex);
+
+    block->state = RAPTOR_NTRIPLES_BLOCK_DONE;
+    pthread_cond_broadcast(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+
+static void
+raptor_ntriples_pool_free(raptor_ntriples_pool* pool)
+{
+  int i;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for(i = 0; i < pool->threads_count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  RAPTOR_ATOMIC_ADD(&pool->rdf_parser->world->threads_active, -1);
+
+  for(i = 0; i < pool->blocks_count; i++) {
+    raptor_ntriples_block* block = &pool->blocks[i];
+    int j;
+
+    for(j = 0; j < block->terms_count; j++) {
+      if(block->terms[j])
+        raptor_free_term(block->terms[j]);
+    }
+    if(block->arena)
+      raptor_free_arena(block->arena);
+    if(block->data)
+      RAPTOR_FREE(char*, block->data);
+  }
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+
+  if(pool->blocks)
+    RAPTOR_FREE(raptor_ntriples_block*, pool->blocks);
+  if(pool->threads)
+    RAPTOR_FREE(pthread_t*, pool->threads);
+  RAPTOR_FREE(raptor_ntriples_pool, pool);
+}
+
+
+static raptor_ntriples_pool*
+raptor_new_ntriples_pool(raptor_parser* rdf_parser, int threads_count,
+                         int ordered)
+{
+  raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)rdf_parser->context;
+  raptor_ntriples_pool* pool;
+  int i;
+
+  pool = RAPTOR_CALLOC(raptor_ntriples_pool*, 1, sizeof(*pool));
+  if(!pool)
+    return NULL;
+
+  pool->rdf_parser = rdf_parser;
+  pool->ordered = ordered;
+  pool->locator = rdf_parser->locator;
+
+  pool->threads = RAPTOR_CALLOC(pthread_t*, threads_count, sizeof(pthread_t));
+  /* two blocks per worker: one being parsed, one queued or delivered */
+  pool->blocks_count = threads_count * 2;
+  pool->blocks = RAPTOR_CALLOC(raptor_ntriples_block*, pool->blocks_count,
+                               sizeof(raptor_ntriples_block));
+  if(!pool->threads || !pool->blocks) {
+    if(pool->blocks)
+      RAPTOR_FREE(raptor_ntriples_block*, pool->blocks);
+    if(pool->threads)
+      RAPTOR_FREE(pthread_t*, pool->threads);
+    RAPTOR_FREE(raptor_ntriples_pool, pool);
+    return NULL;
+  }
+
+  for(i = 0; i < pool->blocks_count; i++) {
+    pool->blocks[i].pool = pool;
+    /* workers cannot share the parser arena: one per block */
+    if(ntriples_parser->arena)
+      pool->blocks[i].arena = raptor_new_arena(0);
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  /* Start the default graph before workers can emit statements so
+   * that the parser flags are not written while they run
+   */
+  if(!rdf_parser->emitted_default_graph) {
+    raptor_parser_start_graph(rdf_parser, NULL, 0);
+    rdf_parser->emitted_default_graph++;
+  }
+
+  /* Enable world locking before any worker can touch the world;
+   * other parsers may be starting or stopping pools on the same world */
+  RAPTOR_ATOMIC_ADD(&rdf_parser->world->threads_active, 1);
+
+  for(i = 0; i < threads_count; i++) {
+    if(pthread_create(&pool->threads[i], NULL, raptor_ntriples_pool_worker,
+                      pool))
+      break;
+    pool->threads_count++;
+  }
+
+  if(!pool->threads_count) {
+    raptor_ntriples_pool_free(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+
+/*
+ * raptor_ntriples_pool_reap:
+ * @pool: pool
+ *
+ * INTERNAL - Recycle finished blocks, delivering statements in order
+ * if the pool is ordered.
+ *
+ * Return value: non-0 if a finished block failed to parse
+ */
+static int
+raptor_ntriples_pool_reap(raptor_ntriples_pool* pool)
+{
+  raptor_parser* rdf_parser = pool->rdf_parser;
+  int rc = 0;
+
+  while(!rc) {
+    raptor_ntriples_block* block = NULL;
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    for(i = 0; i < pool->blocks_count; i++) {
+      raptor_ntriples_block* b = &pool->blocks[i];
+      if(b->state == RAPTOR_NTRIPLES_BLOCK_DONE &&
+         (!pool->ordered || b->sequence == pool->deliver_sequence)) {
+        block = b;
+        break;
+      }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if(!block)
+      break;
+
+    /* No worker uses a finished block so no lock is needed here */
+    for(i = 0; i < block->terms_count; i += 4) {
+      raptor_ntriples_generate_statement(rdf_parser, NULL,
+                                         block->terms[i],
+                                         block->terms[i + 1],
+                                         block->terms[i + 2],
+                                         block->terms[i + 3]);
+    }
+    rc = block->failed;
+
+    block->terms_count = 0;
+    block->lines_count = 0;
+    block->data_length = 0;
+    block->failed = 0;
+    if(block->arena)
+      raptor_arena_reset(block->arena);
+
+    pthread_mutex_lock(&pool->mutex);
+    block->state = RAPTOR_NTRIPLES_BLOCK_FREE;
+    pool->deliver_sequence++;
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return rc;
+}
+
+
+/*
+ * raptor_ntriples_pool_wait:
+ * @pool: pool
+ * @all: non-0 to wait until all blocks are finished and recycled
+ *
+ * INTERNAL - Wait for a free block (or all blocks) to become available
+ *
+ * Return value: a free block, or NULL if @all was given or on failure.
+ */
+static raptor_ntriples_block*
+raptor_ntriples_pool_wait(raptor_ntriples_pool* pool, int all, int *failed_p)
+{
+  while(1) {
+    raptor_ntriples_block* block = NULL;
+    int busy = 0;
+    int ready = 0;
+    int i;
+
+    if(raptor_ntriples_pool_reap(pool)) {
+      *failed_p = 1;
+      return NULL;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    for(i = 0; i < pool->blocks_count; i++) {
+      raptor_ntriples_block* b = &pool->blocks[i];
+
+      if(b->state == RAPTOR_NTRIPLES_BLOCK_FREE) {
+        if(!block)
+          block = b;
+        continue;
+      }
+
+      busy++;
+      if(b->state == RAPTOR_NTRIPLES_BLOCK_DONE &&
+         (!pool->ordered || b->sequence == pool->deliver_sequence))
+        ready++;
+    }
+
+    if(all ? !busy : (block != NULL)) {
+      pthread_mutex_unlock(&pool->mutex);
+      return all ? NULL : block;
+    }
+
+    /* Sleep unless a block finished after the reap above */
+    if(!ready)
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+  }
+}
+
+
+static void
+raptor_ntriples_pool_submit(raptor_ntriples_pool* pool)
+{
+  raptor_ntriples_block* block = pool->current;
+
+  pool->current = NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  block->state = RAPTOR_NTRIPLES_BLOCK_QUEUED;
+  block->sequence = pool->queue_sequence++;
+  if(pool->queue_tail)
+    pool->queue_tail->next = block;
+  else
+    pool->queue_head = block;
+  pool->queue_tail = block;
+  pthread_cond_signal(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+
+/*
+ * raptor_ntriples_pool_add_line:
+ * @pool: pool
+ * @line: line to parse
+ * @len: length of @line
+ * @line_number: input line number of @line
+ * @byte: input byte offset of @line
+ *
+ * INTERNAL - Queue a copy of a line for parsing by the workers
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_ntriples_pool_add_line(raptor_ntriples_pool* pool,
+                              const unsigned char* line, size_t len,
+                              int line_number, int byte)
+{
+  raptor_ntriples_block* block = pool->current;
+  raptor_ntriples_block_line* block_line;
+  int failed = 0;
+
+  if(!len)
+    return 0;
+
+  if(!block) {
+    block = raptor_ntriples_pool_wait(pool, 0, &failed);
+    if(!block)
+      return 1;
+    block->state = RAPTOR_NTRIPLES_BLOCK_FILLING;
+    pool->current = block;
+  }
+
+  if(block->data_length + len + 1 > block->data_size) {
+    size_t new_size = block->data_size ? block->data_size : RAPTOR_NTRIPLES_BLOCK_BYTES;
+    unsigned char* data;
+
+    while(new_size < block->data_length + len + 1)
+      new_size <<= 1;
+
+    data = RAPTOR_MALLOC(unsigned char*, new_size);
+    if(!data) {
+      raptor_parser_fatal_error(pool->rdf_parser, "Out of memory");
+      return 1;
+    }
+    if(block->data_length)
+      memcpy(data, block->data, block->data_length);
+    if(block->data)
+      RAPTOR_FREE(char*, block->data);
+    block->data = data;
+    block->data_size = new_size;
+  }
+
+  block_line = &block->lines[block->lines_count++];
+  block_line->offset = block->data_length;
+  block_line->length = len;
+  block_line->line = line_number;
+  block_line->byte = byte;
+
+  memcpy(block->data + block->data_length, line, len);
+  block->data_length += len;
+  block->data[block->data_length++] = '\0';
+
+  if(block->lines_count == RAPTOR_NTRIPLES_BLOCK_LINES ||
+     block->data_length >= RAPTOR_NTRIPLES_BLOCK_BYTES)
+    raptor_ntriples_pool_submit(pool);
+
+  return 0;
+}
+
+
+/*
+ * raptor_ntriples_pool_finish:
+ * @pool: pool
+ *
+ * INTERNAL - Queue any partial block and wait for all blocks to be done
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_ntriples_pool_finish(raptor_ntriples_pool* pool)
+{
+  int failed = 0;
+
+  if(pool->current) {
+    if(pool->current->lines_count)
+      raptor_ntriples_pool_submit(pool);
+    else {
+      pool->current->state = RAPTOR_NTRIPLES_BLOCK_FREE;
+      pool->current = NULL;
+    }
+  }
+
+  raptor_ntriples_pool_wait(pool, 1, &failed);
+
+  return failed;
+}
+#endif
+
+
+static void
+raptor_ntriples_line_error(raptor_parser* rdf_parser, raptor_locator* locator,
+                           const char *message, ...)
+{
+  va_list arguments;
+
+  va_start(arguments, message);
+  raptor_log_error_varargs(rdf_parser->world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                           message, arguments);
+  va_end(arguments);
+}
+
+
 static void
 raptor_ntriples_generate_statement(raptor_parser* parser, 
+                                   raptor_ntriples_block* block,
                                    raptor_term *subject,
                                    raptor_term *predicate,
                                    raptor_term *object,
                                    raptor_term *graph)
 {
-  /* raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)parser->context; */
   raptor_statement *statement = &parser->statement;
+#ifdef RAPTOR_THREADS
+  raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)parser->context;
+  raptor_statement worker_statement;
+
+  if(block) {
+    /* In a worker thread */
+    if(block->pool->ordered && subject && predicate && object) {
+      /* Keep the terms for delivery in order by the calling thread */
+      raptor_term** terms = &block->terms[block->terms_count];
+      terms[0] = subject;
+      terms[1] = predicate;
+      terms[2] = object;
+      terms[3] = graph;
+      block->terms_count += 4;
+      return;
+    }
 
+    statement = &worker_statement;
+    raptor_statement_init(statement, parser->world);
+  } else if(ntriples_parser->pool) {
+    /* Delivering from a worker block: the pool started the graph */
+  } else
+#endif
   if(!parser->emitted_default_graph) {
     raptor_parser_start_graph(parser, NULL, 0);
     parser->emitted_default_graph++;
@@ -160,18 +801,58 @@ raptor_ntriples_generate_statement(raptor_parser* parser,
 
 
 
+/*
+ * raptor_ntriples_serialize_line:
+ * @parser: parser
+ * @tokens: subject, predicate, object and graph tokens of a line
+ *
+ * INTERNAL - Write a statement to the serializer set with raptor_parser_set_serializer()
+ *
+ * Does the same checks as raptor_ntriples_generate_statement() but
+ * passes the lexed tokens to the serializer.
+ */
+static void
+raptor_ntriples_serialize_line(raptor_parser* parser,
+                               raptor_ntriples_token* tokens)
+{
+  if(!parser->emitted_default_graph) {
+    raptor_parser_start_graph(parser, NULL, 0);
+    parser->emitted_default_graph++;
+  }
+
+  /* Do not generate a partial triple */
+  if(tokens[0].type == RAPTOR_TERM_TYPE_UNKNOWN ||
+     tokens[1].type == RAPTOR_TERM_TYPE_UNKNOWN ||
+     tokens[2].type == RAPTOR_TERM_TYPE_UNKNOWN)
+    return;
+
+  if(!raptor_ntriples_serialize_tokens(parser->serializer, tokens))
+    parser->serialized_count++;
+}
+
+
+
 #define MAX_NTRIPLES_TERMS 4
 
 static int
 raptor_ntriples_parse_line(raptor_parser* rdf_parser,
+                           raptor_locator* locator,
                            unsigned char *buffer, size_t len,
-                           int max_terms)
+                           int max_terms,
+                           raptor_ntriples_block* block)
 {
   raptor_ntriples_parser_context *ntriples_parser = (raptor_ntriples_parser_context*)rdf_parser->context;
   int i;
   unsigned char *p;
-  raptor_term* terms[MAX_NTRIPLES_TERMS+1] = {NULL, NULL, NULL, NULL, NULL};
+  raptor_ntriples_token tokens[MAX_NTRIPLES_TERMS+1];
+  raptor_term* terms[MAX_NTRIPLES_TERMS] = {NULL, NULL, NULL, NULL};
   int rc = 0;
+  raptor_arena* arena = ntriples_parser->arena;
+  
+#ifdef RAPTOR_THREADS
+  if(block)
+    arena = block->arena;
+#endif
   
   /* ASSERTION:
    * p always points to first char we are considering
@@ -190,8 +871,8 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
 
   while(len > 0 && isspace((int)*p)) {
     p++;
-    rdf_parser->locator.column++;
-    rdf_parser->locator.byte++;
+    locator->column++;
+    locator->byte++;
     len--;
   }
 
@@ -213,6 +894,9 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
   
   /* Must be triple/quad */
 
+  for(i = 0; i < MAX_NTRIPLES_TERMS + 1; i++)
+    tokens[i].type = RAPTOR_TERM_TYPE_UNKNOWN;
+
   for(i = 0; i < MAX_NTRIPLES_TERMS + 1; i++) {
     size_t term_len;
 
@@ -225,7 +909,7 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
         if(i == 3)
           break;
       }
-      raptor_parser_error(rdf_parser, "Unexpected end of line");
+      raptor_ntriples_line_error(rdf_parser, locator, "Unexpected end of line");
       goto cleanup;
     }
     
@@ -233,32 +917,32 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
     if(i == 3) {
       /* graph term (3): blank node or <URI> */
       if(*p != '<' && *p != '_') {
-        raptor_parser_error(rdf_parser, "Saw '%c', expected Graph term <URIref>, _:bnodeID", *p);
+        raptor_ntriples_line_error(rdf_parser, locator, "Saw '%c', expected Graph term <URIref>, _:bnodeID", *p);
         goto cleanup;
       }
     } else if(i == 2) {
       /* object term (2): expect either <URI> or _:name or literal */
       if(*p != '<' && *p != '_' && *p != '"') {
-        raptor_parser_error(rdf_parser, "Saw '%c', expected object term <URIref>, _:bnodeID or \"literal\"", *p);
+        raptor_ntriples_line_error(rdf_parser, locator, "Saw '%c', expected object term <URIref>, _:bnodeID or \"literal\"", *p);
         goto cleanup;
       }
     } else if(i == 1) {
       /* predicate term (1): expect URI only */
       if(*p != '<') {
-        raptor_parser_error(rdf_parser, "Saw '%c', expected predict term <URIref>", *p);
+        raptor_ntriples_line_error(rdf_parser, locator, "Saw '%c', expected predict term <URIref>", *p);
         goto cleanup;
       }
     } else {
       /* subject (0) or graph (3) terms: expect <URI> or _:name */
       if(*p != '<' && *p != '_') {
-        raptor_parser_error(rdf_parser, "Saw '%c', expected subject term <URIref> or _:bnodeID", *p);
+        raptor_ntriples_line_error(rdf_parser, locator, "Saw '%c', expected subject term <URIref> or _:bnodeID", *p);
         goto cleanup;
       }
     }
 
 
-    term_len = raptor_ntriples_parse_term(rdf_parser->world, &rdf_parser->locator,
-                                          p, &len, &terms[i], 0);
+    term_len = raptor_ntriples_lex_term(rdf_parser->world, locator,
+                                        p, &len, &tokens[i]);
     if(!term_len) {
       rc = 1;
       goto cleanup;
@@ -267,13 +951,10 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
     p += term_len;
     rc = 0;
 
-    if(terms[i] && terms[i]->type == RAPTOR_TERM_TYPE_URI) {
-      unsigned const char* uri_string;
-
+    if(tokens[i].type == RAPTOR_TERM_TYPE_URI) {
       /* Check for absolute URI */
-      uri_string = raptor_uri_as_string(terms[i]->value.uri);
-      if(!raptor_uri_uri_string_is_absolute(uri_string)) {
-        raptor_parser_error(rdf_parser, "URI %s is not absolute", uri_string);
+      if(!raptor_uri_uri_string_is_absolute(tokens[i].string)) {
+        raptor_ntriples_line_error(rdf_parser, locator, "URI %s is not absolute", tokens[i].string);
         goto cleanup;
       }
     }
@@ -282,23 +963,21 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
     while(len > 0 && isspace((int)*p)) {
       p++;
       len--;
-      rdf_parser->locator.column++;
-      rdf_parser->locator.byte++;
+      locator->column++;
+      locator->byte++;
     }
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-    if(terms[i]) {
-      unsigned char* c = raptor_term_to_string(terms[i]);
+    if(tokens[i].type != RAPTOR_TERM_TYPE_UNKNOWN)
       fprintf(stderr, "item %d: term '%s' type %d\n",
-              i, c, terms[i]->type);
-      raptor_free_memory(c);
-    } else
+              i, tokens[i].string, tokens[i].type);
+    else
       fprintf(stderr, "item %d: NULL term\n", i);
 #endif
 
     /* Look for terminating '.' after 3rd (ntriples) or 3rd/4th (nquads) term */
     if(i == (ntriples_parser->is_nquads ? 4 : 3) && *p != '.') {
-      raptor_parser_error(rdf_parser, "Missing terminating \".\"");
+      raptor_ntriples_line_error(rdf_parser, locator, "Missing terminating \".\"");
       return 0;
     }
 
@@ -306,20 +985,20 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
     if(*p == '.') {
       p++;
       len--;
-      rdf_parser->locator.column++;
-      rdf_parser->locator.byte++;
+      locator->column++;
+      locator->byte++;
 
       /* Skip whitespace after '.' */
       while(len > 0 && isspace((int)*p)) {
         p++;
         len--;
-        rdf_parser->locator.column++;
-        rdf_parser->locator.byte++;
+        locator->column++;
+        locator->byte++;
       }
 
       /* Only a comment is allowed here */
       if(*p && *p != '#') {
-        raptor_parser_error(rdf_parser, "Junk after terminating \".\"");
+        raptor_ntriples_line_error(rdf_parser, locator, "Junk after terminating \".\"");
         return 0;
       }
 
@@ -330,40 +1009,43 @@ raptor_ntriples_parse_line(raptor_parser* rdf_parser,
 
   if(ntriples_parser->is_nquads) {
     /* Check N-Quads has 3 or 4 terms */
-    if(terms[4]) {
-      raptor_free_term(terms[4]);
-      terms[4] = NULL;
-      raptor_parser_error(rdf_parser, "N-Quads only allows 3 or 4 terms");
+    if(tokens[4].type != RAPTOR_TERM_TYPE_UNKNOWN) {
+      raptor_ntriples_line_error(rdf_parser, locator, "N-Quads only allows 3 or 4 terms");
       goto cleanup;
     }
   } else {
     /* Check N-Triples has only 3 terms */
-    if(terms[3] || terms[4]) {
-      if(terms[4]) {
-        raptor_free_term(terms[4]);
-        terms[4] = NULL;
-      }
-      if(terms[3]) {
-        raptor_free_term(terms[3]);
-        terms[3] = NULL;
-      }
-      raptor_parser_error(rdf_parser, "N-Triples only allows 3 terms");
+    if(tokens[3].type != RAPTOR_TERM_TYPE_UNKNOWN ||
+       tokens[4].type != RAPTOR_TERM_TYPE_UNKNOWN) {
+      raptor_ntriples_line_error(rdf_parser, locator, "N-Triples only allows 3 terms");
       goto cleanup;
     }
   }
 
-  if(terms[3] && terms[3]->type == RAPTOR_TERM_TYPE_LITERAL) {
-    if(!ntriples_parser->literal_graph_warning++)
-      raptor_parser_warning(rdf_parser, "Ignoring N-Quad literal contexts");
+  if(tokens[3].type == RAPTOR_TERM_TYPE_LITERAL) {
+    if(RAPTOR_ATOMIC_ADD(&ntriples_parser->literal_graph_warning, 1) == 1)
+      raptor_log_error_formatted(rdf_parser->world, RAPTOR_LOG_LEVEL_WARN,
+                                 locator,
+                                 "Ignoring N-Quad literal contexts");
 
-    raptor_free_term(terms[3]);
-    terms[3] = NULL;
+    tokens[3].type = RAPTOR_TERM_TYPE_UNKNOWN;
   }
 
-  raptor_ntriples_generate_statement(rdf_parser, 
-                                     terms[0], terms[1], terms[2], terms[3]);
+  if(rdf_parser->serializer && !block) {
+    /* Converting: write the tokens without making any terms */
+    raptor_ntriples_serialize_line(rdf_parser, tokens);
+  } else {
+    for(i = 0; i < MAX_NTRIPLES_TERMS; i++) {
+      if(tokens[i].type != RAPTOR_TERM_TYPE_UNKNOWN)
+        terms[i] = raptor_ntriples_token_to_term(rdf_parser->world, locator,
+                                                 &tokens[i], arena);
+    }
+
+    raptor_ntriples_generate_statement(rdf_parser, block,
+                                       terms[0], terms[1], terms[2], terms[3]);
+  }
 
-  rdf_parser->locator.byte += RAPTOR_BAD_CAST(int, len);
+  locator->byte += RAPTOR_BAD_CAST(int, len);
 
  cleanup:
 
@@ -387,43 +1069,43 @@ raptor_ntriples_parse_chunk(raptor_parser* rdf_parser,
   RAPTOR_DEBUG2("adding %d bytes to buffer\n", (unsigned int)len);
 #endif
 
-  if(len) {
-    buffer = RAPTOR_MALLOC(unsigned char*, ntriples_parser->line_length + len + 1);
-    if(!buffer) {
-      raptor_parser_fatal_error(rdf_parser, "Out of memory");
-      return 1;
-    }
-
-    if(ntriples_parser->line_length) {
-      memcpy(buffer, ntriples_parser->line, ntriples_parser->line_length);
-      RAPTOR_FREE(char*, ntriples_parser->line);
-    }
-
-    ntriples_parser->line = buffer;
-
-    /* move pointer to end of cdata buffer */
-    ptr = buffer + ntriples_parser->line_length;
-
-    /* adjust stored length */
-    ntriples_parser->line_length += len;
-
-    /* now write new stuff at end of cdata buffer */
-    memcpy(ptr, s, len);
-    ptr += len;
-    *ptr = '\0';
-  } else
-    buffer = ntriples_parser->line;
+  if(len && raptor_ntriples_buffer_append(rdf_parser, s, len))
+    return 1;
 
+  buffer = ntriples_parser->line;
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   RAPTOR_DEBUG2("buffer now %ld bytes\n", ntriples_parser->line_length);
 #endif
 
-  if(!ntriples_parser->line_length)
+  if(!ntriples_parser->line_length && !is_end)
     return 0;
 
-  ptr = buffer + ntriples_parser->offset;
-  end_ptr = buffer + ntriples_parser->line_length;
+#ifdef RAPTOR_THREADS
+  /* converting straight to a serializer is done in this thread */
+  if(!ntriples_parser->pool && !rdf_parser->serializer &&
+     rdf_parser->locator.line == 1 && !rdf_parser->locator.byte) {
+    int threads = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                             RAPTOR_OPTION_PARSE_THREADS);
+    if(threads > 0) {
+      /* the duplicate statement filter and the statement batch are
+       * not thread safe */
+      int ordered = !RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                                RAPTOR_OPTION_PARSE_THREADS_UNORDERED) ||
+                    rdf_parser->unique_statement_handler ||
+                    rdf_parser->statement_batch_handler;
+      /* on failure fall back to parsing in this thread */
+      ntriples_parser->pool = raptor_new_ntriples_pool(rdf_parser, threads,
+                                                       ordered);
+    }
+  }
+#endif
+
+  ptr = end_ptr = buffer;
+  if(buffer) {
+    ptr += ntriples_parser->offset;
+    end_ptr += ntriples_parser->line_length;
+  }
   while((start = ptr) < end_ptr) {
     unsigned char *line_start = ptr;
 
@@ -448,6 +1130,14 @@ raptor_ntriples_parse_chunk(raptor_parser* rdf_parser,
       int bq = 0;
       while(ptr < end_ptr) {
         if(!bq) {
+          /* skip bytes that cannot change the state below */
+          if(!RAPTOR_SCAN_BYTE_IN(*ptr, RAPTOR_NTRIPLES_LINE_SCAN_CLASSES)) {
+            ptr += rdf_parser->world->scan_span(ptr, end_ptr - ptr,
+                                                RAPTOR_NTRIPLES_LINE_SCAN_CLASSES);
+            if(ptr == end_ptr)
+              break;
+          }
+
           if(*ptr == '\\') {
             bq = 1;
             ptr++;
@@ -495,7 +1185,17 @@ raptor_ntriples_parse_chunk(raptor_parser* rdf_parser,
     fputs("<<<\n", stderr);
 #endif
     *ptr = '\0';
-    if(raptor_ntriples_parse_line(rdf_parser, line_start, len, max_terms))
+#ifdef RAPTOR_THREADS
+    if(ntriples_parser->pool) {
+      if(raptor_ntriples_pool_add_line(ntriples_parser->pool, line_start, len,
+                                       rdf_parser->locator.line,
+                                       rdf_parser->locator.byte))
+        return 1;
+      rdf_parser->locator.byte += RAPTOR_BAD_CAST(int, len);
+    } else
+#endif
+    if(raptor_ntriples_parse_line(rdf_parser, &rdf_parser->locator,
+                                  line_start, len, max_terms, NULL))
       return 1;
     
     rdf_parser->locator.line++;
@@ -515,40 +1215,31 @@ raptor_ntriples_parse_chunk(raptor_parser* rdf_parser,
 #endif
   }
 
-  ntriples_parser->offset = start - buffer;
-
-  len = ntriples_parser->line_length - ntriples_parser->offset;
-    
-  if(len && ntriples_parser->line_length != len) {
-    /* collapse buffer */
-
-#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-    RAPTOR_DEBUG3("collapsing buffer from %ld to %ld bytes\n", ntriples_parser->line_length, len);
-#endif
-    buffer = RAPTOR_MALLOC(unsigned char*, len + 1);
-    if(!buffer) {
-      raptor_parser_fatal_error(rdf_parser, "Out of memory");
-      return 1;
-    }
-
-    memcpy(buffer, 
-           ntriples_parser->line + ntriples_parser->line_length - len,
-           len);
-    buffer[len] = '\0';
+  /* every statement parsed so far has been delivered */
+  if(ntriples_parser->arena)
+    raptor_arena_reset(ntriples_parser->arena);
 
-    RAPTOR_FREE(char*, ntriples_parser->line);
-
-    ntriples_parser->line = buffer;
-    ntriples_parser->line_length -= ntriples_parser->offset;
-    ntriples_parser->offset = 0;
+  if(buffer) {
+    ntriples_parser->offset = start - buffer;
 
-#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-    RAPTOR_DEBUG3("buffer now '%s' (%ld bytes)\n", ntriples_parser->line, ntriples_parser->line_length);
-#endif    
+    /* everything consumed: reuse the buffer from the start */
+    if(ntriples_parser->offset == ntriples_parser->line_length)
+      ntriples_parser->line_length = ntriples_parser->offset = 0;
   }
 
   /* exit now, no more input */
   if(is_end) {
+#ifdef RAPTOR_THREADS
+    if(ntriples_parser->pool) {
+      int rc = raptor_ntriples_pool_finish(ntriples_parser->pool);
+
+      raptor_ntriples_pool_free(ntriples_parser->pool);
+      ntriples_parser->pool = NULL;
+      if(rc)
+        return 1;
+    }
+#endif
+
     if(ntriples_parser->offset != ntriples_parser->line_length) {
        raptor_parser_error(rdf_parser, "Junk at end of input.");
        return 1;
@@ -577,11 +1268,38 @@ raptor_ntriples_parse_start(raptor_parser* rdf_parser)
   locator->byte = 0;
 
   ntriples_parser->last_char = '\0';
+  ntriples_parser->line_length = 0;
+  ntriples_parser->offset = 0;
+
+  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_TERM_ARENA)) {
+    /* on failure terms are allocated individually */
+    if(!ntriples_parser->arena)
+      ntriples_parser->arena = raptor_new_arena(0);
+  } else if(ntriples_parser->arena) {
+    raptor_free_arena(ntriples_parser->arena);
+    ntriples_parser->arena = NULL;
+  }
+
+#ifdef RAPTOR_THREADS
+  if(ntriples_parser->pool) {
+    raptor_ntriples_pool_free(ntriples_parser->pool);
+    ntriples_parser->pool = NULL;
+  }
+#endif
 
   return 0;
 }
 
 
+static int
+raptor_ntriples_parse_set_serializer(raptor_parser* rdf_parser,
+                                     raptor_serializer* serializer)
+{
+  /* tokens can only be written out by the line-based serializers */
+  return !raptor_serializer_is_ntriples(serializer);
+}
+
+
 #if defined RAPTOR_PARSER_NTRIPLES || defined RAPTOR_PARSER_NQUADS
 static int
 raptor_ntriples_parse_recognise_syntax(raptor_parser_factory* factory, 
@@ -696,6 +1414,7 @@ raptor_ntriples_parser_register_factory(raptor_parser_factory *factory)
   factory->start     = raptor_ntriples_parse_start;
   factory->chunk     = raptor_ntriples_parse_chunk;
   factory->recognise_syntax = raptor_ntriples_parse_recognise_syntax;
+  factory->set_serializer = raptor_ntriples_parse_set_serializer;
 
   return rc;
 }
@@ -785,6 +1504,7 @@ raptor_nquads_parser_register_factory(raptor_parser_factory *factory)
   factory->start     = raptor_ntriples_parse_start;
   factory->chunk     = raptor_ntriples_parse_chunk;
   factory->recognise_syntax = raptor_nquads_parse_recognise_syntax;
+  factory->set_serializer = raptor_ntriples_parse_set_serializer;
 
   return rc;
 }
@@ -49,8 +49,6 @@
  */
 
 
-static raptor_abbrev_subject* raptor_new_abbrev_subject(raptor_abbrev_node* node);
-
 /**
  * raptor_new_abbrev_node:
  * @world: raptor world
@@ -250,7 +248,17 @@ raptor_print_abbrev_po(raptor_abbrev_node** nodes, FILE* handle)
  **/
 
 
-static raptor_abbrev_subject*
+/**
+ * raptor_new_abbrev_subject:
+ * @node: subject node
+ *
+ * INTERNAL - Constructor for raptor_abbrev_subject
+ *
+ * The subject adds a reference to @node.
+ *
+ * Return value: new raptor abbrev subject or NULL on failure
+ **/
+raptor_abbrev_subject*
 raptor_new_abbrev_subject(raptor_abbrev_node* node)
 {
   raptor_abbrev_subject* subject;
@@ -440,13 +448,16 @@ raptor_abbrev_subject_find(raptor_avltree *subjects, raptor_term* node)
 
 /**
  * raptor_abbrev_subject_lookup:
- * @nodes: AVL-Tree of subject nodes
+ * @nodes: AVL-Tree of subject nodes (or NULL)
  * @subjects: AVL-Tree of URI-subject nodes
  * @blanks: AVL-Tree of blank-subject nodes
  * @term: node to find
  *
  * INTERNAL - Find a subject node in the appropriate uri/blank AVL-Tree of subject nodes or add it
  *
+ * If @nodes is NULL, a new subject gets a node of its own that is not
+ * shared with any objects.
+ *
  * Return value: node or NULL on failure
  */
 raptor_abbrev_subject* 
@@ -463,9 +474,16 @@ raptor_abbrev_subject_lookup(raptor_avltree* nodes,
 
   /* If not found, create one and insert it */
   if(!rv_subject) {
-    raptor_abbrev_node* node = raptor_abbrev_node_lookup(nodes, term);
+    raptor_abbrev_node* node;
+
+    if(nodes)
+      node = raptor_abbrev_node_lookup(nodes, term);
+    else
+      node = raptor_new_abbrev_node(term->world, term);
     if(node) {      
       rv_subject = raptor_new_abbrev_subject(node);
+      if(!nodes)
+        raptor_free_abbrev_node(node);
       if(rv_subject) {
         if(raptor_avltree_add(tree, rv_subject)) {
           rv_subject = NULL;
@@ -478,6 +496,183 @@ raptor_abbrev_subject_lookup(raptor_avltree* nodes,
 }
 
 
+/**
+ * raptor_abbrev_subjects_spill:
+ * @subjects: AVL-Tree of URI-subject nodes
+ * @rdf_type: rdf:type node
+ * @spill: spill to add a run to
+ *
+ * INTERNAL - Write the statements of subjects to a new run of a spill
+ *
+ * A subject's node type is written as an rdf:type statement flagged
+ * with #RAPTOR_SPILL_FLAG_NODE_TYPE.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_abbrev_subjects_spill(raptor_avltree* subjects,
+                             raptor_abbrev_node* rdf_type,
+                             raptor_spill* spill)
+{
+  raptor_avltree_iterator* iter;
+  int rc = 0;
+
+  if(raptor_spill_start_run(spill))
+    return 1;
+
+  iter = raptor_new_avltree_iterator(subjects, NULL, NULL, 1);
+  while(iter && !rc) {
+    raptor_abbrev_subject* subject;
+    raptor_avltree_iterator* po_iter;
+    raptor_statement statement;
+    raptor_statement type_statement;
+    int write_type;
+
+    subject = (raptor_abbrev_subject*)raptor_avltree_iterator_get(iter);
+    if(!subject)
+      break;
+
+    memset(&statement, '\0', sizeof(statement));
+    statement.subject = subject->node->term;
+
+    write_type = (subject->node_type != NULL);
+    if(write_type) {
+      type_statement = statement;
+      type_statement.predicate = rdf_type->term;
+      type_statement.object = subject->node_type->term;
+    }
+
+    po_iter = raptor_new_avltree_iterator(subject->properties, NULL, NULL, 1);
+    while(po_iter && !rc) {
+      raptor_abbrev_node** nodes;
+
+      nodes = (raptor_abbrev_node**)raptor_avltree_iterator_get(po_iter);
+      if(!nodes)
+        break;
+
+      statement.predicate = nodes[0]->term;
+      statement.object = nodes[1]->term;
+
+      /* keep the records in order */
+      if(write_type &&
+         raptor_statement_compare(&type_statement, &statement) <= 0) {
+        rc = raptor_spill_write(spill, &type_statement,
+                                RAPTOR_SPILL_FLAG_NODE_TYPE);
+        write_type = 0;
+      }
+      if(!rc)
+        rc = raptor_spill_write(spill, &statement, 0);
+
+      if(raptor_avltree_iterator_next(po_iter))
+        break;
+    }
+    if(po_iter)
+      raptor_free_avltree_iterator(po_iter);
+
+    if(write_type && !rc)
+      rc = raptor_spill_write(spill, &type_statement,
+                              RAPTOR_SPILL_FLAG_NODE_TYPE);
+
+    if(raptor_avltree_iterator_next(iter))
+      break;
+  }
+  if(iter)
+    raptor_free_avltree_iterator(iter);
+
+  if(raptor_spill_end_run(spill))
+    rc = 1;
+
+  return rc;
+}
+
+
+/**
+ * raptor_abbrev_subject_read_spill:
+ * @spill: spill being merged
+ * @nodes: AVL-Tree of blank and predicate nodes
+ *
+ * INTERNAL - Read the next subject from the merged runs of a spill
+ *
+ * Reads the statements of one subject written by
+ * raptor_abbrev_subjects_spill().  The node type is taken from the
+ * earliest run that has one; any others become rdf:type properties.
+ * Predicates and blank node objects are shared with @nodes which
+ * already holds their counts.
+ *
+ * Return value: new subject or NULL at the end or on failure
+ */
+raptor_abbrev_subject*
+raptor_abbrev_subject_read_spill(raptor_spill* spill, raptor_avltree* nodes)
+{
+  raptor_statement* statement;
+  raptor_abbrev_subject* subject;
+  raptor_abbrev_node* node;
+  raptor_abbrev_node* node_type = NULL;
+  int node_type_run = 0;
+  int flags;
+  int run;
+  int rc = 0;
+
+  statement = raptor_spill_merge_get(spill, &flags, &run);
+  if(!statement)
+    return NULL;
+
+  node = raptor_new_abbrev_node(statement->world, statement->subject);
+  if(!node)
+    return NULL;
+  subject = raptor_new_abbrev_subject(node);
+  raptor_free_abbrev_node(node);
+  if(!subject)
+    return NULL;
+
+  while(statement && !rc &&
+        raptor_term_equals(statement->subject, subject->node->term)) {
+    raptor_abbrev_node* predicate;
+    raptor_abbrev_node* object;
+
+    predicate = raptor_abbrev_node_lookup(nodes, statement->predicate);
+    if(statement->object->type == RAPTOR_TERM_TYPE_BLANK) {
+      object = raptor_abbrev_node_lookup(nodes, statement->object);
+      if(object)
+        object->ref_count++;
+    } else
+      object = raptor_new_abbrev_node(statement->world, statement->object);
+    if(!predicate || !object) {
+      if(object)
+        raptor_free_abbrev_node(object);
+      rc = 1;
+      break;
+    }
+
+    if((flags & RAPTOR_SPILL_FLAG_NODE_TYPE) &&
+       (!node_type || run < node_type_run)) {
+      node = node_type;
+      node_type = object;
+      node_type_run = run;
+      object = node;
+    }
+
+    if(object) {
+      if(raptor_abbrev_subject_add_property(subject, predicate, object) < 0)
+        rc = 1;
+      raptor_free_abbrev_node(object);
+    }
+
+    raptor_spill_merge_next(spill);
+    statement = raptor_spill_merge_get(spill, &flags, &run);
+  }
+
+  subject->node_type = node_type;
+
+  if(rc) {
+    raptor_free_abbrev_subject(subject);
+    subject = NULL;
+  }
+
+  return subject;
+}
+
+
 #ifdef ABBREV_DEBUG
 void
 raptor_print_subject(raptor_abbrev_subject* subject) 
@@ -0,0 +1,334 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_arena.c - Arena (bump) allocator for short-lived parser objects
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * An arena hands out memory from large blocks by moving a pointer
+ * along the current block.  Nothing is freed individually; a reset
+ * makes all the blocks available again and the arena is freed as a
+ * whole.  Allocations larger than a quarter of the block size get a
+ * block of their own.
+ */
+
+typedef struct raptor_arena_block_s raptor_arena_block;
+
+struct raptor_arena_block_s {
+  raptor_arena_block* next;
+  /* size of data */
+  size_t size;
+  /* followed by the block data, aligned as RAPTOR_ARENA_ALIGN */
+};
+
+struct raptor_arena_s {
+  /* blocks of block_size in use, most recent first */
+  raptor_arena_block* blocks;
+  /* blocks of block_size free for reuse after a reset */
+  raptor_arena_block* free_blocks;
+  /* oversized blocks, freed on reset */
+  raptor_arena_block* large_blocks;
+
+  size_t block_size;
+
+  /* next free byte and end of current block */
+  char* current;
+  char* end;
+};
+
+#define RAPTOR_ARENA_ALIGN (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+#define RAPTOR_ARENA_ROUND(n) (((n) + RAPTOR_ARENA_ALIGN - 1) & ~(RAPTOR_ARENA_ALIGN - 1))
+#define RAPTOR_ARENA_BLOCK_HEADER RAPTOR_ARENA_ROUND(sizeof(raptor_arena_block))
+#define RAPTOR_ARENA_BLOCK_DATA(b) ((char*)(b) + RAPTOR_ARENA_BLOCK_HEADER)
+
+#define RAPTOR_ARENA_DEFAULT_BLOCK_SIZE 65536
+
+
+/*
+ * raptor_new_arena:
+ * @block_size: size of memory blocks or 0 for the default
+ *
+ * INTERNAL - Constructor - create a new arena
+ *
+ * Return value: new arena or NULL on failure
+ */
+raptor_arena*
+raptor_new_arena(size_t block_size)
+{
+  raptor_arena* arena;
+
+  arena = RAPTOR_CALLOC(raptor_arena*, 1, sizeof(*arena));
+  if(!arena)
+    return NULL;
+
+  arena->block_size = block_size ? RAPTOR_ARENA_ROUND(block_size) :
+                                   RAPTOR_ARENA_DEFAULT_BLOCK_SIZE;
+
+  return arena;
+}
+
+
+static void
+raptor_arena_free_blocks(raptor_arena_block* block)
+{
+  while(block) {
+    raptor_arena_block* next = block->next;
+    RAPTOR_FREE(raptor_arena_block, block);
+    block = next;
+  }
+}
+
+
+/*
+ * raptor_free_arena:
+ * @arena: arena
+ *
+ * INTERNAL - Destructor - free an arena and all memory allocated from it
+ */
+void
+raptor_free_arena(raptor_arena* arena)
+{
+  if(!arena)
+    return;
+
+  raptor_arena_free_blocks(arena->blocks);
+  raptor_arena_free_blocks(arena->free_blocks);
+  raptor_arena_free_blocks(arena->large_blocks);
+  RAPTOR_FREE(raptor_arena, arena);
+}
+
+
+static raptor_arena_block*
+raptor_new_arena_block(size_t size)
+{
+  raptor_arena_block* block;
+
+  block = RAPTOR_MALLOC(raptor_arena_block*, RAPTOR_ARENA_BLOCK_HEADER + size);
+  if(!block)
+    return NULL;
+
+  block->next = NULL;
+  block->size = size;
+
+  return block;
+}
+
+
+/*
+ * raptor_arena_alloc:
+ * @arena: arena
+ * @size: number of bytes
+ *
+ * INTERNAL - Allocate memory from an arena
+ *
+ * The memory is not initialised and is valid until the next
+ * raptor_arena_reset() or raptor_free_arena().
+ *
+ * Return value: pointer to memory or NULL on failure
+ */
+void*
+raptor_arena_alloc(raptor_arena* arena, size_t size)
+{
+  raptor_arena_block* block;
+  char* p;
+
+  size = RAPTOR_ARENA_ROUND(size ? size : 1);
+
+  if(size <= (size_t)(arena->end - arena->current)) {
+    p = arena->current;
+    arena->current += size;
+    return p;
+  }
+
+  if(size > arena->block_size / 4) {
+    block = raptor_new_arena_block(size);
+    if(!block)
+      return NULL;
+    block->next = arena->large_blocks;
+    arena->large_blocks = block;
+    return RAPTOR_ARENA_BLOCK_DATA(block);
+  }
+
+  if(arena->free_blocks) {
+    block = arena->free_blocks;
+    arena->free_blocks = block->next;
+  } else {
+    block = raptor_new_arena_block(arena->block_size);
+    if(!block)
+      return NULL;
+  }
+
+  block->next = arena->blocks;
+  arena->blocks = block;
+
+  p = RAPTOR_ARENA_BLOCK_DATA(block);
+  arena->current = p + size;
+  arena->end = p + block->size;
+
+  return p;
+}
+
+
+/*
+ * raptor_arena_strndup:
+ * @arena: arena
+ * @string: string
+ * @length: length of @string
+ *
+ * INTERNAL - Copy a counted string into an arena, adding a NUL
+ *
+ * Return value: copied string or NULL on failure
+ */
+unsigned char*
+raptor_arena_strndup(raptor_arena* arena, const unsigned char* string,
+                     size_t length)
+{
+  unsigned char* s;
+
+  s = (unsigned char*)raptor_arena_alloc(arena, length + 1);
+  if(!s)
+    return NULL;
+
+  if(length)
+    memcpy(s, string, length);
+  s[length] = '\0';
+
+  return s;
+}
+
+
+/*
+ * raptor_arena_reset:
+ * @arena: arena
+ *
+ * INTERNAL - Release all allocations from an arena
+ *
+ * Standard sized blocks are kept for reuse; oversized ones are freed.
+ */
+void
+raptor_arena_reset(raptor_arena* arena)
+{
+  raptor_arena_block* block = arena->blocks;
+
+  while(block) {
+    raptor_arena_block* next = block->next;
+    block->next = arena->free_blocks;
+    arena->free_blocks = block;
+    block = next;
+  }
+  arena->blocks = NULL;
+
+  raptor_arena_free_blocks(arena->large_blocks);
+  arena->large_blocks = NULL;
+
+  arena->current = arena->end = NULL;
+}
+
+#endif
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_arena* arena;
+#define TEST_ALLOCS_COUNT 1000
+  unsigned char* strings[TEST_ALLOCS_COUNT];
+  char buffer[32];
+  unsigned char* big;
+  int round;
+  int i;
+  int failures = 0;
+
+  /* small blocks so that several are used */
+  arena = raptor_new_arena(1024);
+  if(!arena) {
+    fprintf(stderr, "%s: Failed to create arena\n", program);
+    exit(1);
+  }
+
+  for(round = 0; round < 3; round++) {
+    for(i = 0; i < TEST_ALLOCS_COUNT; i++) {
+      size_t len = (size_t)snprintf(buffer, sizeof(buffer), "string %d", i);
+
+      strings[i] = raptor_arena_strndup(arena, (const unsigned char*)buffer,
+                                        len);
+      if(!strings[i]) {
+        fprintf(stderr, "%s: Arena allocation %d failed\n", program, i);
+        exit(1);
+      }
+      if(((size_t)strings[i]) % sizeof(void*)) {
+        fprintf(stderr, "%s: Arena allocation %d is not aligned\n",
+                program, i);
+        failures++;
+      }
+    }
+
+    big = (unsigned char*)raptor_arena_alloc(arena, 5000);
+    if(!big) {
+      fprintf(stderr, "%s: Large arena allocation failed\n", program);
+      exit(1);
+    }
+    memset(big, 'x', 5000);
+
+    /* no allocation overwrote another */
+    for(i = 0; i < TEST_ALLOCS_COUNT; i++) {
+      snprintf(buffer, sizeof(buffer), "string %d", i);
+      if(strcmp((const char*)strings[i], buffer)) {
+        fprintf(stderr, "%s: Arena string %d is '%s' expected '%s'\n",
+                program, i, strings[i], buffer);
+        failures++;
+      }
+    }
+
+    raptor_arena_reset(arena);
+  }
+
+  raptor_free_arena(arena);
+
+  return failures;
+}
+
+#endif
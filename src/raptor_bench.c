@@ -0,0 +1,1268 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_bench.c - Benchmark of parsers and serializers on generated corpora
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ * Usage: raptor_bench [OPTIONS] [SHAPE...]
+ *
+ *   -n COUNT   statements in each corpus (default 20000)
+ *   -s SEED    seed of the corpus generator (default 1)
+ *   -d DIR     directory for the corpus files (default .)
+ *   -r REPEAT  time each job REPEAT times and report the fastest
+ *   -p NAMES   comma separated parsers to time (default all)
+ *   -o NAMES   comma separated serializers to time (default all)
+ *   -g         generate the corpus files only
+ *
+ * SHAPE is one of plain, literals, blanks, collections or namespaces
+ * (default all of them).  For each shape the same statements are
+ * generated from SEED and written as N-Triples, N-Quads, Turtle,
+ * RDF/XML, TriG and RDF/JSON files in DIR, as far as this raptor has
+ * the serializers for them.
+ *
+ * Every registered parser is then timed reading the corpus file in
+ * its syntax, and every registered serializer is timed writing the
+ * statements of the shape to a sink.  Each timing is one line of JSON
+ * on stdout with the throughput, the peak resident set size of the
+ * process doing the work and the number of allocations made per
+ * statement.  Where fork() is available each job runs in a child
+ * process so the peak RSS is its own.  Allocations are only counted
+ * when built with RAPTOR_BENCH_COUNT_ALLOCATIONS defined and the GNU C
+ * library, otherwise they are reported as null.  A job that fails or crashes is reported
+ * with status "failed"; the exit status is only non-0 if the corpora
+ * could not be written.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <time.h>
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+#define BENCH_FORK 1
+#endif
+
+
+static const char *program;
+
+
+/*
+ * Allocation counting: if RAPTOR_BENCH_COUNT_ALLOCATIONS is defined,
+ * with the GNU C library malloc() and friends are replaced by versions
+ * that count calls and hand on to the real allocator.  This covers
+ * allocations made by raptor and the libraries it uses.  It is off by
+ * default since it cannot be combined with allocators that also
+ * replace malloc(), such as AddressSanitizer.
+ */
+#if defined(RAPTOR_BENCH_COUNT_ALLOCATIONS) && defined(__GLIBC__)
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static unsigned long bench_allocations;
+
+void* malloc(size_t size);
+void* calloc(size_t nmemb, size_t size);
+void* realloc(void* ptr, size_t size);
+
+void*
+malloc(size_t size)
+{
+  bench_allocations++;
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t nmemb, size_t size)
+{
+  bench_allocations++;
+  return __libc_calloc(nmemb, size);
+}
+
+void*
+realloc(void* ptr, size_t size)
+{
+  bench_allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+#define BENCH_COUNT_ALLOCATIONS 1
+#endif
+
+
+static double
+bench_now(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+/* peak resident set size of this process in kilobytes or -1 */
+static long
+bench_peak_rss(void)
+{
+#if defined(HAVE_GETRUSAGE) && defined(HAVE_SYS_RESOURCE_H)
+  struct rusage usage;
+
+  if(getrusage(RUSAGE_SELF, &usage))
+    return -1;
+#ifdef __APPLE__
+  /* bytes, not kilobytes */
+  return (long)(usage.ru_maxrss / 1024);
+#else
+  return (long)usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+
+
+/* Corpus generator */
+
+#define BENCH_BASE "http://example.org/bench/"
+#define BENCH_VOCAB "http://example.org/vocab#"
+#define BENCH_WORDS_COUNT 16
+
+static const char* const bench_words[BENCH_WORDS_COUNT] = {
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+  "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "labore",
+  "magna", "aliqua"
+};
+
+/* statements in each graph of a corpus */
+#define BENCH_GRAPH_SIZE 1000
+/* items in each list of the collections shape */
+#define BENCH_LIST_LENGTH 500
+/* namespaces used by the namespaces shape */
+#define BENCH_NAMESPACES_COUNT 1000
+
+typedef struct {
+  raptor_world* world;
+  /* random number generator state */
+  unsigned long state;
+  /* number of statements to generate and generated so far */
+  unsigned long count;
+  unsigned long emitted;
+
+  raptor_statement_handler handler;
+  void* user_data;
+
+  /* buffer for building literals */
+  unsigned char* literal;
+  size_t literal_size;
+} bench_generator;
+
+
+typedef int (*bench_shape_function)(bench_generator* gen);
+
+typedef struct {
+  const char* name;
+  const char* label;
+  bench_shape_function generate;
+  /* number of vocabulary namespaces the shape uses */
+  int namespaces;
+} bench_shape;
+
+
+/* 24 bits from a 32 bit LCG so corpora are the same on every platform */
+static unsigned long
+bench_random(bench_generator* gen, unsigned long n)
+{
+  gen->state = (gen->state * 1103515245UL + 12345UL) & 0xffffffffUL;
+  return n ? ((gen->state >> 8) % n) : 0;
+}
+
+
+static raptor_term*
+bench_new_uri_term(bench_generator* gen, const char* prefix, unsigned long n)
+{
+  char buffer[128];
+
+  snprintf(buffer, sizeof(buffer), "%s%lu", prefix, n);
+  return raptor_new_term_from_uri_string(gen->world,
+                                         (const unsigned char*)buffer);
+}
+
+
+static raptor_term*
+bench_new_blank_term(bench_generator* gen, unsigned long n)
+{
+  char buffer[32];
+
+  snprintf(buffer, sizeof(buffer), "b%lu", n);
+  return raptor_new_term_from_blank(gen->world, (const unsigned char*)buffer);
+}
+
+
+/* a literal of @words random words, sometimes with characters that
+ * need escaping
+ */
+static raptor_term*
+bench_new_literal_term(bench_generator* gen, unsigned long words,
+                       int escapes)
+{
+  size_t len = 0;
+  unsigned long i;
+
+  for(i = 0; i < words; i++) {
+    const char* word = bench_words[bench_random(gen, BENCH_WORDS_COUNT)];
+    size_t word_len = strlen(word);
+
+    /* word, separator and the longest escape */
+    if(len + word_len + 4 > gen->literal_size) {
+      size_t size = gen->literal_size ? gen->literal_size * 2 : 1024;
+      unsigned char* literal;
+
+      while(size < len + word_len + 4)
+        size *= 2;
+      literal = RAPTOR_REALLOC(unsigned char*, gen->literal, size);
+      if(!literal)
+        return NULL;
+      gen->literal = literal;
+      gen->literal_size = size;
+    }
+
+    if(i) {
+      unsigned long r = escapes ? bench_random(gen, 40) : 1;
+
+      if(!r)
+        gen->literal[len++] = '\n';
+      else if(r == 1 || r > 4)
+        gen->literal[len++] = ' ';
+      else if(r == 2)
+        gen->literal[len++] = '"';
+      else if(r == 3)
+        gen->literal[len++] = '\t';
+      else {
+        /* U+00E9 */
+        gen->literal[len++] = 0xC3;
+        gen->literal[len++] = 0xA9;
+      }
+    }
+
+    memcpy(gen->literal + len, word, word_len);
+    len += word_len;
+  }
+
+  return raptor_new_term_from_counted_literal(gen->world, gen->literal, len,
+                                              NULL,
+                                              (const unsigned char*)"en", 2);
+}
+
+
+/* hand over a statement, taking ownership of the terms */
+static int
+bench_emit(bench_generator* gen, raptor_term* subject,
+           raptor_term* predicate, raptor_term* object)
+{
+  raptor_statement statement;
+  int rc = 1;
+
+  raptor_statement_init(&statement, gen->world);
+  statement.subject = subject;
+  statement.predicate = predicate;
+  statement.object = object;
+  statement.graph = bench_new_uri_term(gen, BENCH_BASE "graph/",
+                                       gen->emitted / BENCH_GRAPH_SIZE);
+
+  if(subject && predicate && object && statement.graph) {
+    gen->handler(gen->user_data, &statement);
+    gen->emitted++;
+    rc = 0;
+  }
+
+  raptor_statement_clear(&statement);
+
+  return rc;
+}
+
+
+/* IRIs and short literals */
+static int
+bench_shape_plain(bench_generator* gen)
+{
+  unsigned long resources = gen->count / 10 + 1;
+
+  while(gen->emitted < gen->count) {
+    raptor_term* object;
+    unsigned long r = bench_random(gen, 10);
+
+    if(r < 5)
+      object = bench_new_uri_term(gen, BENCH_BASE "r",
+                                  bench_random(gen, resources));
+    else
+      object = bench_new_literal_term(gen, 1 + bench_random(gen, 6), 0);
+
+    if(bench_emit(gen,
+                  bench_new_uri_term(gen, BENCH_BASE "r",
+                                     bench_random(gen, resources)),
+                  bench_new_uri_term(gen, BENCH_VOCAB "p",
+                                     bench_random(gen, 20)),
+                  object))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/* long literals with escapes and non-ASCII characters */
+static int
+bench_shape_literals(bench_generator* gen)
+{
+  unsigned long resources = gen->count / 10 + 1;
+
+  while(gen->emitted < gen->count) {
+    if(bench_emit(gen,
+                  bench_new_uri_term(gen, BENCH_BASE "r",
+                                     bench_random(gen, resources)),
+                  bench_new_uri_term(gen, BENCH_VOCAB "p",
+                                     bench_random(gen, 20)),
+                  bench_new_literal_term(gen, 20 + bench_random(gen, 200),
+                                         1)))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/* blank node subjects and objects */
+static int
+bench_shape_blanks(bench_generator* gen)
+{
+  unsigned long blanks = gen->count / 5 + 1;
+
+  while(gen->emitted < gen->count) {
+    raptor_term* object;
+
+    if(bench_random(gen, 2))
+      object = bench_new_blank_term(gen, bench_random(gen, blanks));
+    else
+      object = bench_new_literal_term(gen, 1 + bench_random(gen, 3), 0);
+
+    if(bench_emit(gen,
+                  bench_new_blank_term(gen, bench_random(gen, blanks)),
+                  bench_new_uri_term(gen, BENCH_VOCAB "p",
+                                     bench_random(gen, 20)),
+                  object))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/* long rdf:first / rdf:rest lists */
+static int
+bench_shape_collections(bench_generator* gen)
+{
+  unsigned long list = 0;
+  unsigned long blank = 0;
+
+  while(gen->emitted < gen->count) {
+    unsigned long i;
+
+    if(bench_emit(gen,
+                  bench_new_uri_term(gen, BENCH_BASE "list", list++),
+                  bench_new_uri_term(gen, BENCH_VOCAB "items", 0),
+                  bench_new_blank_term(gen, blank)))
+      return 1;
+
+    for(i = 0; i < BENCH_LIST_LENGTH && gen->emitted < gen->count; i++) {
+      raptor_term* rest;
+
+      if(bench_emit(gen,
+                    bench_new_blank_term(gen, blank),
+                    raptor_term_copy(RAPTOR_RDF_first_term(gen->world)),
+                    bench_new_uri_term(gen, BENCH_BASE "r",
+                                       bench_random(gen, 1000))))
+        return 1;
+
+      if(i == BENCH_LIST_LENGTH - 1 || gen->emitted + 1 >= gen->count)
+        rest = raptor_term_copy(RAPTOR_RDF_nil_term(gen->world));
+      else
+        rest = bench_new_blank_term(gen, blank + 1);
+
+      if(bench_emit(gen,
+                    bench_new_blank_term(gen, blank),
+                    raptor_term_copy(RAPTOR_RDF_rest_term(gen->world)),
+                    rest))
+        return 1;
+      blank++;
+    }
+  }
+
+  return 0;
+}
+
+
+/* predicates from many vocabularies */
+static int
+bench_shape_namespaces(bench_generator* gen)
+{
+  unsigned long resources = gen->count / 10 + 1;
+
+  while(gen->emitted < gen->count) {
+    char prefix[64];
+
+    snprintf(prefix, sizeof(prefix), "http://ns%lu.example.org/vocab#p",
+             bench_random(gen, BENCH_NAMESPACES_COUNT));
+
+    if(bench_emit(gen,
+                  bench_new_uri_term(gen, BENCH_BASE "r",
+                                     bench_random(gen, resources)),
+                  bench_new_uri_term(gen, prefix, bench_random(gen, 10)),
+                  bench_new_uri_term(gen, BENCH_BASE "r",
+                                     bench_random(gen, resources))))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+static const bench_shape bench_shapes[] = {
+  { "plain", "IRIs and short literals", bench_shape_plain, 1 },
+  { "literals", "long literals with escapes", bench_shape_literals, 1 },
+  { "blanks", "blank node subjects and objects", bench_shape_blanks, 1 },
+  { "collections", "long RDF collections", bench_shape_collections, 1 },
+  { "namespaces", "predicates from many namespaces", bench_shape_namespaces,
+    BENCH_NAMESPACES_COUNT },
+  { NULL, NULL, NULL, 0 }
+};
+
+
+static int
+bench_generate(raptor_world* world, const bench_shape* shape,
+               unsigned long count, unsigned long seed,
+               raptor_statement_handler handler, void* user_data)
+{
+  bench_generator gen;
+  int rc;
+
+  memset(&gen, '\0', sizeof(gen));
+  gen.world = world;
+  gen.state = seed & 0xffffffffUL;
+  gen.count = count;
+  gen.handler = handler;
+  gen.user_data = user_data;
+
+  rc = shape->generate(&gen);
+
+  if(gen.literal)
+    RAPTOR_FREE(char*, gen.literal);
+
+  return rc;
+}
+
+
+
+/* Corpus files */
+
+typedef struct {
+  /* parser syntax name */
+  const char* syntax;
+  /* serializer writing it or NULL for the TriG writer below */
+  const char* serializer;
+  const char* suffix;
+} bench_corpus;
+
+static const bench_corpus bench_corpora[] = {
+  { "ntriples", "ntriples", "nt" },
+  { "nquads", "nquads", "nq" },
+  { "turtle", "turtle", "ttl" },
+  { "rdfxml", "rdfxml", "rdf" },
+  { "trig", NULL, "trig" },
+  { "json", "json", "json" },
+  { NULL, NULL, NULL }
+};
+
+/* parsers without a syntax of their own read one of the above */
+static const struct {
+  const char* parser;
+  const char* syntax;
+} bench_parser_corpora[] = {
+  { "guess", "ntriples" },
+  { "rss-tag-soup", "rdfxml" },
+  { "grddl", "rdfxml" },
+  { NULL, NULL }
+};
+
+
+static char*
+bench_corpus_filename(const char* dir, const bench_shape* shape,
+                      const bench_corpus* corpus)
+{
+  size_t len = strlen(dir) + strlen(shape->name) + strlen(corpus->suffix) + 3;
+  char* filename;
+
+  filename = RAPTOR_MALLOC(char*, len);
+  if(filename)
+    snprintf(filename, len, "%s/%s.%s", dir, shape->name, corpus->suffix);
+
+  return filename;
+}
+
+
+static void
+bench_serialize_statement(void* user_data, raptor_statement* statement)
+{
+  raptor_serializer_serialize_statement((raptor_serializer*)user_data,
+                                        statement);
+}
+
+
+typedef struct {
+  raptor_iostream* iostr;
+  raptor_term* graph;
+} bench_trig_writer;
+
+/* TriG as a graph block per graph of N-Triples statements */
+static void
+bench_trig_statement(void* user_data, raptor_statement* statement)
+{
+  bench_trig_writer* writer = (bench_trig_writer*)user_data;
+
+  if(!writer->graph || !raptor_term_equals(writer->graph, statement->graph)) {
+    if(writer->graph) {
+      raptor_iostream_counted_string_write("}\n\n", 3, writer->iostr);
+      raptor_free_term(writer->graph);
+    }
+    writer->graph = raptor_term_copy(statement->graph);
+    raptor_term_escaped_write(statement->graph,
+                              RAPTOR_ESCAPED_WRITE_NTRIPLES_URI,
+                              writer->iostr);
+    raptor_iostream_counted_string_write(" {\n", 3, writer->iostr);
+  }
+
+  raptor_iostream_counted_string_write("  ", 2, writer->iostr);
+  raptor_statement_ntriples_write(statement, writer->iostr, 0);
+}
+
+
+static int
+bench_write_corpus_internal(raptor_world* world, const bench_shape* shape,
+                            const bench_corpus* corpus, const char* filename,
+                            unsigned long count, unsigned long seed)
+{
+  raptor_iostream* iostr;
+  raptor_uri* base_uri;
+  int rc = 1;
+
+  iostr = raptor_new_iostream_to_filename(world, filename);
+  if(!iostr) {
+    fprintf(stderr, "%s: Failed to write to %s\n", program, filename);
+    return 1;
+  }
+
+  base_uri = raptor_new_uri(world, (const unsigned char*)BENCH_BASE);
+
+  if(corpus->serializer) {
+    raptor_serializer* serializer;
+
+    serializer = raptor_new_serializer(world, corpus->serializer);
+    if(serializer) {
+      int i;
+
+      raptor_serializer_start_to_iostream(serializer, base_uri, iostr);
+
+      /* declare the vocabularies, all of them for a wide shape */
+      for(i = 0; i < shape->namespaces; i++) {
+        char ns[64];
+        char prefix[16];
+        raptor_uri* ns_uri;
+
+        if(shape->namespaces == 1) {
+          strcpy(ns, BENCH_VOCAB);
+          strcpy(prefix, "v");
+        } else {
+          snprintf(ns, sizeof(ns), "http://ns%d.example.org/vocab#", i);
+          snprintf(prefix, sizeof(prefix), "v%d", i);
+        }
+        ns_uri = raptor_new_uri(world, (const unsigned char*)ns);
+        if(ns_uri) {
+          raptor_serializer_set_namespace(serializer, ns_uri,
+                                          (const unsigned char*)prefix);
+          raptor_free_uri(ns_uri);
+        }
+      }
+
+      rc = bench_generate(world, shape, count, seed,
+                          bench_serialize_statement, serializer);
+      raptor_serializer_serialize_end(serializer);
+      raptor_free_serializer(serializer);
+    }
+  } else {
+    bench_trig_writer writer;
+
+    writer.iostr = iostr;
+    writer.graph = NULL;
+    rc = bench_generate(world, shape, count, seed, bench_trig_statement,
+                        &writer);
+    if(writer.graph) {
+      raptor_iostream_counted_string_write("}\n", 2, iostr);
+      raptor_free_term(writer.graph);
+    }
+  }
+
+  raptor_free_iostream(iostr);
+  if(base_uri)
+    raptor_free_uri(base_uri);
+
+  if(rc)
+    fprintf(stderr, "%s: Failed to generate %s\n", program, filename);
+
+  return rc;
+}
+
+
+/*
+ * Write a corpus file, in a child process if possible so that the
+ * memory used by the serializer does not count in the peak RSS of
+ * the jobs run later.
+ */
+static int
+bench_write_corpus(raptor_world* world, const bench_shape* shape,
+                   const bench_corpus* corpus, const char* filename,
+                   unsigned long count, unsigned long seed)
+{
+#ifdef BENCH_FORK
+  pid_t pid;
+  int status;
+
+  fflush(stdout);
+  fflush(stderr);
+  pid = fork();
+  if(pid < 0)
+    return 1;
+
+  if(!pid)
+    _exit(bench_write_corpus_internal(world, shape, corpus, filename, count,
+                                      seed));
+
+  if(waitpid(pid, &status, 0) != pid)
+    return 1;
+
+  return !(WIFEXITED(status) && !WEXITSTATUS(status));
+#else
+  return bench_write_corpus_internal(world, shape, corpus, filename, count,
+                                     seed);
+#endif
+}
+
+
+
+/* Drivers */
+
+typedef struct {
+  const char* kind;
+  const char* name;
+  const char* shape;
+  unsigned long statements;
+  unsigned long bytes;
+  double seconds;
+  long peak_rss;
+  long allocations;
+  int failed;
+} bench_result;
+
+
+static void
+bench_print_result(const bench_result* result)
+{
+  double seconds = result->seconds > 0.0 ? result->seconds : 1e-9;
+
+  fprintf(stdout,
+          "{\"kind\": \"%s\", \"name\": \"%s\", \"shape\": \"%s\", "
+          "\"status\": \"%s\", \"statements\": %lu, \"bytes\": %lu, "
+          "\"seconds\": %.6f, \"statements_per_second\": %.0f, "
+          "\"megabytes_per_second\": %.3f, \"peak_rss_kb\": %ld, ",
+          result->kind, result->name, result->shape,
+          result->failed ? "failed" : "ok",
+          result->statements, result->bytes, result->seconds,
+          (double)result->statements / seconds,
+          (double)result->bytes / seconds / (1024.0 * 1024.0),
+          result->peak_rss);
+  if(result->allocations >= 0)
+    fprintf(stdout, "\"allocations\": %ld, \"allocations_per_statement\": %.3f}\n",
+            result->allocations,
+            result->statements ?
+              (double)result->allocations / (double)result->statements : 0.0);
+  else
+    fputs("\"allocations\": null, \"allocations_per_statement\": null}\n",
+          stdout);
+  fflush(stdout);
+}
+
+
+static void
+bench_print_skipped(const char* kind, const char* name, const char* shape)
+{
+  fprintf(stdout,
+          "{\"kind\": \"%s\", \"name\": \"%s\", \"shape\": \"%s\", "
+          "\"status\": \"skipped\"}\n", kind, name, shape);
+  fflush(stdout);
+}
+
+
+static long
+bench_file_size(const char* filename)
+{
+  FILE* fh;
+  long size;
+
+  fh = fopen(filename, "rb");
+  if(!fh)
+    return -1;
+  if(fseek(fh, 0L, SEEK_END))
+    size = -1;
+  else
+    size = ftell(fh);
+  fclose(fh);
+
+  return size;
+}
+
+
+/* parser and serializer messages are not wanted in the results */
+static void
+bench_log_handler(void *user_data, raptor_log_message *message)
+{
+}
+
+
+static void
+bench_count_statement(void* user_data, raptor_statement* statement)
+{
+  (*(unsigned long*)user_data)++;
+}
+
+
+static void
+bench_parse(raptor_world* world, const char* parser_name,
+            const char* filename, bench_result* result)
+{
+  raptor_parser* parser;
+  unsigned char* uri_string;
+  raptor_uri* uri = NULL;
+  long file_size;
+  double start;
+
+  file_size = bench_file_size(filename);
+  result->bytes = file_size > 0 ? (unsigned long)file_size : 0;
+
+  parser = raptor_new_parser(world, parser_name);
+  uri_string = raptor_uri_filename_to_uri_string(filename);
+  if(uri_string)
+    uri = raptor_new_uri(world, uri_string);
+  if(!parser || !uri) {
+    result->failed = 1;
+    goto tidy;
+  }
+
+  raptor_parser_set_statement_handler(parser, &result->statements,
+                                      bench_count_statement);
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+  bench_allocations = 0;
+#endif
+  start = bench_now();
+  if(raptor_parser_parse_file(parser, uri, uri))
+    result->failed = 1;
+  result->seconds = bench_now() - start;
+#ifdef BENCH_COUNT_ALLOCATIONS
+  result->allocations = (long)bench_allocations;
+#endif
+
+  tidy:
+  if(parser)
+    raptor_free_parser(parser);
+  if(uri)
+    raptor_free_uri(uri);
+  if(uri_string)
+    raptor_free_memory(uri_string);
+}
+
+
+static void
+bench_collect_statement(void* user_data, raptor_statement* statement)
+{
+  raptor_sequence* seq = (raptor_sequence*)user_data;
+  raptor_statement* copy;
+
+  copy = raptor_new_statement_from_nodes(statement->world,
+                                         raptor_term_copy(statement->subject),
+                                         raptor_term_copy(statement->predicate),
+                                         raptor_term_copy(statement->object),
+                                         raptor_term_copy(statement->graph));
+  if(copy)
+    raptor_sequence_push(seq, copy);
+}
+
+
+static void
+bench_serialize(raptor_world* world, const char* serializer_name,
+                const bench_shape* shape, unsigned long count,
+                unsigned long seed, bench_result* result)
+{
+  raptor_sequence* seq;
+  raptor_serializer* serializer = NULL;
+  raptor_iostream* iostr = NULL;
+  raptor_uri* base_uri;
+  double start;
+  int i;
+
+  /* statements are made before timing starts */
+  seq = raptor_new_sequence((raptor_data_free_handler)raptor_free_statement,
+                            NULL);
+  base_uri = raptor_new_uri(world, (const unsigned char*)BENCH_BASE);
+  if(!seq || !base_uri ||
+     bench_generate(world, shape, count, seed, bench_collect_statement, seq)) {
+    result->failed = 1;
+    goto tidy;
+  }
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+  bench_allocations = 0;
+#endif
+  start = bench_now();
+
+  serializer = raptor_new_serializer(world, serializer_name);
+  iostr = raptor_new_iostream_to_sink(world);
+  if(!serializer || !iostr ||
+     raptor_serializer_start_to_iostream(serializer, base_uri, iostr)) {
+    result->failed = 1;
+    goto tidy;
+  }
+
+  for(i = 0; i < raptor_sequence_size(seq); i++) {
+    raptor_statement* statement;
+
+    statement = (raptor_statement*)raptor_sequence_get_at(seq, i);
+    if(raptor_serializer_serialize_statement(serializer, statement)) {
+      result->failed = 1;
+      break;
+    }
+  }
+  if(raptor_serializer_serialize_end(serializer))
+    result->failed = 1;
+
+  result->seconds = bench_now() - start;
+#ifdef BENCH_COUNT_ALLOCATIONS
+  result->allocations = (long)bench_allocations;
+#endif
+  result->statements = (unsigned long)raptor_sequence_size(seq);
+  result->bytes = raptor_iostream_tell(iostr);
+
+  tidy:
+  if(serializer)
+    raptor_free_serializer(serializer);
+  if(iostr)
+    raptor_free_iostream(iostr);
+  if(seq)
+    raptor_free_sequence(seq);
+  if(base_uri)
+    raptor_free_uri(base_uri);
+}
+
+
+typedef struct {
+  raptor_world* world;
+  /* parser or serializer name */
+  const char* name;
+  const bench_shape* shape;
+  /* corpus file for a parser, NULL for a serializer */
+  const char* filename;
+  unsigned long count;
+  unsigned long seed;
+} bench_job;
+
+
+static void
+bench_run_job(const bench_job* job, bench_result* result)
+{
+  memset(result, '\0', sizeof(*result));
+  result->kind = job->filename ? "parser" : "serializer";
+  result->name = job->name;
+  result->shape = job->shape->name;
+  result->allocations = -1;
+
+  if(job->filename)
+    bench_parse(job->world, job->name, job->filename, result);
+  else
+    bench_serialize(job->world, job->name, job->shape, job->count, job->seed,
+                    result);
+
+  result->peak_rss = bench_peak_rss();
+}
+
+
+/*
+ * Run a job @repeat times, each in a child process if possible, and
+ * print the fastest run.
+ *
+ * Return value: non-0 if the job failed
+ */
+static int
+bench_time_job(const bench_job* job, int repeat)
+{
+  bench_result best;
+  int i;
+
+  memset(&best, '\0', sizeof(best));
+  best.seconds = -1.0;
+
+  for(i = 0; i < repeat; i++) {
+    bench_result result;
+#ifdef BENCH_FORK
+    int fds[2];
+    pid_t pid;
+    int status;
+    size_t got = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+    if(pipe(fds))
+      return 1;
+
+    pid = fork();
+    if(pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      return 1;
+    }
+
+    if(!pid) {
+      close(fds[0]);
+      bench_run_job(job, &result);
+      if(write(fds[1], &result, sizeof(result)) != (ssize_t)sizeof(result))
+        _exit(1);
+      _exit(0);
+    }
+
+    close(fds[1]);
+    while(got < sizeof(result)) {
+      ssize_t n = read(fds[0], (char*)&result + got, sizeof(result) - got);
+      if(n <= 0)
+        break;
+      got += (size_t)n;
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    if(got < sizeof(result)) {
+      /* the child crashed */
+      memset(&result, '\0', sizeof(result));
+      result.allocations = -1;
+      result.peak_rss = -1;
+      result.failed = 1;
+    }
+    /* set the strings here rather than trust the child's pointers */
+    result.kind = job->filename ? "parser" : "serializer";
+    result.name = job->name;
+    result.shape = job->shape->name;
+#else
+    bench_run_job(job, &result);
+#endif
+
+    if(best.seconds < 0.0 || (!result.failed && result.seconds < best.seconds))
+      best = result;
+  }
+
+  bench_print_result(&best);
+
+  return best.failed;
+}
+
+
+/* non-0 if @name is in comma separated @names or @names is NULL */
+static int
+bench_name_selected(const char* names, const char* name)
+{
+  size_t len = strlen(name);
+
+  if(!names)
+    return 1;
+
+  while(*names) {
+    const char* end = strchr(names, ',');
+    size_t n = end ? (size_t)(end - names) : strlen(names);
+
+    if(n == len && !strncmp(names, name, len))
+      return 1;
+    if(!end)
+      break;
+    names = end + 1;
+  }
+
+  return 0;
+}
+
+
+static const char*
+bench_parser_syntax(const char* parser_name)
+{
+  int i;
+
+  for(i = 0; bench_corpora[i].syntax; i++)
+    if(!strcmp(bench_corpora[i].syntax, parser_name))
+      return parser_name;
+
+  for(i = 0; bench_parser_corpora[i].parser; i++)
+    if(!strcmp(bench_parser_corpora[i].parser, parser_name))
+      return bench_parser_corpora[i].syntax;
+
+  return NULL;
+}
+
+
+static int
+bench_shape_run(raptor_world* world, const bench_shape* shape,
+                const char* dir, unsigned long count, unsigned long seed,
+                int repeat, int generate_only,
+                const char* parser_names, const char* serializer_names)
+{
+  char* filenames[sizeof(bench_corpora) / sizeof(bench_corpora[0])];
+  bench_job job;
+  unsigned int i;
+  int rc = 0;
+
+  for(i = 0; bench_corpora[i].syntax; i++) {
+    const bench_corpus* corpus = &bench_corpora[i];
+
+    filenames[i] = NULL;
+    if(corpus->serializer &&
+       !raptor_world_is_serializer_name(world, corpus->serializer))
+      continue;
+
+    filenames[i] = bench_corpus_filename(dir, shape, corpus);
+    if(!filenames[i] ||
+       bench_write_corpus(world, shape, corpus, filenames[i], count, seed)) {
+      rc = 1;
+      goto tidy;
+    }
+  }
+
+  if(generate_only)
+    goto tidy;
+
+  job.world = world;
+  job.shape = shape;
+  job.count = count;
+  job.seed = seed;
+
+  for(i = 0; 1; i++) {
+    const raptor_syntax_description* desc;
+    const char* syntax;
+    unsigned int j;
+
+    desc = raptor_world_get_parser_description(world, i);
+    if(!desc)
+      break;
+    if(!bench_name_selected(parser_names, desc->names[0]))
+      continue;
+
+    job.name = desc->names[0];
+    job.filename = NULL;
+    syntax = bench_parser_syntax(desc->names[0]);
+    for(j = 0; syntax && bench_corpora[j].syntax; j++)
+      if(!strcmp(bench_corpora[j].syntax, syntax))
+        job.filename = filenames[j];
+
+    if(!job.filename) {
+      bench_print_skipped("parser", job.name, shape->name);
+      continue;
+    }
+    bench_time_job(&job, repeat);
+  }
+
+  for(i = 0; 1; i++) {
+    const raptor_syntax_description* desc;
+
+    desc = raptor_world_get_serializer_description(world, i);
+    if(!desc)
+      break;
+    if(!bench_name_selected(serializer_names, desc->names[0]))
+      continue;
+
+    job.name = desc->names[0];
+    job.filename = NULL;
+    bench_time_job(&job, repeat);
+  }
+
+  tidy:
+  for(i = 0; bench_corpora[i].syntax; i++)
+    if(filenames[i])
+      RAPTOR_FREE(char*, filenames[i]);
+
+  return rc;
+}
+
+
+static void
+bench_usage(void)
+{
+  int i;
+
+  fprintf(stderr, "Usage: %s [-n COUNT] [-s SEED] [-d DIR] [-r REPEAT] [-p PARSERS] [-o SERIALIZERS] [-g] [SHAPE...]\n", program);
+  fputs("Shapes:\n", stderr);
+  for(i = 0; bench_shapes[i].name; i++)
+    fprintf(stderr, "  %-12s %s\n", bench_shapes[i].name,
+            bench_shapes[i].label);
+}
+
+
+int main(int argc, char *argv[]);
+
+int
+main(int argc, char *argv[])
+{
+  raptor_world *world;
+  unsigned long count = 20000UL;
+  unsigned long seed = 1UL;
+  const char* dir = ".";
+  const char* parser_names = NULL;
+  const char* serializer_names = NULL;
+  int repeat = 1;
+  int generate_only = 0;
+  int first_shape;
+  int rc = 0;
+  int i;
+
+  program = raptor_basename(argv[0]);
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++) {
+    const char* arg = argv[i];
+
+    if(!strcmp(arg, "-g")) {
+      generate_only = 1;
+      continue;
+    }
+
+    if(arg[1] == '\0' || arg[2] != '\0' || i + 1 == argc) {
+      bench_usage();
+      return 1;
+    }
+
+    switch(arg[1]) {
+      case 'n':
+        count = strtoul(argv[++i], NULL, 10);
+        break;
+      case 's':
+        seed = strtoul(argv[++i], NULL, 10);
+        break;
+      case 'd':
+        dir = argv[++i];
+        break;
+      case 'r':
+        repeat = atoi(argv[++i]);
+        if(repeat < 1)
+          repeat = 1;
+        break;
+      case 'p':
+        parser_names = argv[++i];
+        break;
+      case 'o':
+        serializer_names = argv[++i];
+        break;
+      default:
+        bench_usage();
+        return 1;
+    }
+  }
+  first_shape = i;
+
+  for(i = first_shape; i < argc; i++) {
+    int j;
+
+    for(j = 0; bench_shapes[j].name; j++)
+      if(!strcmp(bench_shapes[j].name, argv[i]))
+        break;
+    if(!bench_shapes[j].name) {
+      fprintf(stderr, "%s: Unknown shape %s\n", program, argv[i]);
+      bench_usage();
+      return 1;
+    }
+  }
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    return 1;
+  raptor_world_set_log_handler(world, NULL, bench_log_handler);
+
+  if(!generate_only)
+    fprintf(stdout,
+            "{\"kind\": \"run\", \"raptor_version\": \"%s\", "
+            "\"statements\": %lu, \"seed\": %lu, \"repeat\": %d}\n",
+            raptor_version_string, count, seed, repeat);
+
+  for(i = 0; bench_shapes[i].name; i++) {
+    const bench_shape* shape = &bench_shapes[i];
+
+    if(first_shape < argc) {
+      int j;
+
+      for(j = first_shape; j < argc; j++)
+        if(!strcmp(shape->name, argv[j]))
+          break;
+      if(j == argc)
+        continue;
+    }
+
+    rc += bench_shape_run(world, shape, dir, count, seed, repeat,
+                          generate_only, parser_names, serializer_names);
+  }
+
+  raptor_free_world(world);
+
+  return rc ? 1 : 0;
+}
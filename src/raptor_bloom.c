@@ -0,0 +1,205 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_bloom.c - Bloom filter for checking items have been seen before
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * A Bloom filter remembers items as a few bits set in a fixed size
+ * bit array.  An item with any of its bits clear is certainly new;
+ * one with all of them set may have been added before.  The caller
+ * hashes each item twice and the bit positions are derived from the
+ * two hashes.
+ */
+
+struct raptor_bloom_s {
+  unsigned char* bits;
+  size_t bits_count;
+};
+
+/* number of bits set per item */
+#define RAPTOR_BLOOM_HASHES 6
+
+
+/*
+ * raptor_new_bloom:
+ * @size: size of the filter in bytes (> 0)
+ *
+ * INTERNAL - Constructor - create a new empty Bloom filter
+ *
+ * Return value: new filter or NULL on failure
+ */
+raptor_bloom*
+raptor_new_bloom(size_t size)
+{
+  raptor_bloom* bloom;
+
+  if(!size)
+    return NULL;
+
+  bloom = RAPTOR_CALLOC(raptor_bloom*, 1, sizeof(*bloom));
+  if(!bloom)
+    return NULL;
+
+  bloom->bits = RAPTOR_CALLOC(unsigned char*, size, 1);
+  if(!bloom->bits) {
+    RAPTOR_FREE(raptor_bloom, bloom);
+    return NULL;
+  }
+  bloom->bits_count = size << 3;
+
+  return bloom;
+}
+
+
+/*
+ * raptor_free_bloom:
+ * @bloom: Bloom filter
+ *
+ * INTERNAL - Destructor - free a Bloom filter
+ */
+void
+raptor_free_bloom(raptor_bloom* bloom)
+{
+  if(!bloom)
+    return;
+
+  RAPTOR_FREE(unsigned char*, bloom->bits);
+  RAPTOR_FREE(raptor_bloom, bloom);
+}
+
+
+/*
+ * raptor_bloom_add:
+ * @bloom: Bloom filter
+ * @hash1: first hash of item
+ * @hash2: second, independent hash of item
+ *
+ * INTERNAL - Add an item to the Bloom filter
+ *
+ * Return value: 1 if all the bits were already set so the item may
+ * have been added before, 0 if it is certainly new
+ */
+int
+raptor_bloom_add(raptor_bloom* bloom, unsigned int hash1, unsigned int hash2)
+{
+  int present = 1;
+  int i;
+
+  /* derive the bit positions from two hashes, Kirsch and Mitzenmacher */
+  hash2 |= 1;
+  for(i = 0; i < RAPTOR_BLOOM_HASHES; i++) {
+    size_t bit = (hash1 + (unsigned int)i * hash2) % bloom->bits_count;
+    unsigned char mask = (unsigned char)(1 << (bit & 7));
+
+    if(!(bloom->bits[bit >> 3] & mask)) {
+      bloom->bits[bit >> 3] |= mask;
+      present = 0;
+    }
+  }
+
+  return present;
+}
+
+#endif
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_bloom* bloom;
+#define TEST_ITEMS_COUNT 1000
+  /* with 4K bytes and 6 hashes, expect well under 1% false positives */
+#define TEST_MAX_FALSE_POSITIVES 10
+  unsigned int i;
+  int false_positives = 0;
+  int failures = 0;
+
+  bloom = raptor_new_bloom(4096);
+  if(!bloom) {
+    fprintf(stderr, "%s: Failed to create Bloom filter\n", program);
+    exit(1);
+  }
+
+  for(i = 0; i < TEST_ITEMS_COUNT; i++) {
+    /* two simple independent hashes of i */
+    unsigned int hash1 = (i + 1) * 2654435761U;
+    unsigned int hash2 = (i ^ 0x5bd1e995U) * 0x85ebca6bU;
+
+    if(raptor_bloom_add(bloom, hash1, hash2))
+      false_positives++;
+  }
+
+  if(false_positives > TEST_MAX_FALSE_POSITIVES) {
+    fprintf(stderr, "%s: %d of %d new items reported as present, expected at most %d\n",
+            program, false_positives, TEST_ITEMS_COUNT,
+            TEST_MAX_FALSE_POSITIVES);
+    failures++;
+  }
+
+  for(i = 0; i < TEST_ITEMS_COUNT; i++) {
+    unsigned int hash1 = (i + 1) * 2654435761U;
+    unsigned int hash2 = (i ^ 0x5bd1e995U) * 0x85ebca6bU;
+
+    if(!raptor_bloom_add(bloom, hash1, hash2)) {
+      fprintf(stderr, "%s: Item %u added twice was reported as new\n",
+              program, i);
+      failures++;
+      break;
+    }
+  }
+
+  raptor_free_bloom(bloom);
+
+  if(raptor_new_bloom(0)) {
+    fprintf(stderr, "%s: Created a Bloom filter of size 0\n", program);
+    failures++;
+  }
+
+  return failures;
+}
+
+#endif
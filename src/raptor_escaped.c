@@ -34,6 +34,33 @@
 #include "raptor_internal.h"
 
 
+/*
+ * raptor_string_escaped_plain_byte:
+ * @c: byte
+ * @delim: string delimiter or \0
+ * @flags: bit flags - see #raptor_escaped_write_bitflags
+ *
+ * INTERNAL - Check if a byte is printable ASCII written unchanged
+ * with @delim and @flags
+ *
+ * Return value: non-0 if @c needs no escaping
+ */
+static int
+raptor_string_escaped_plain_byte(const unsigned char c, const char delim,
+                                 unsigned int flags)
+{
+  if(c < 0x20 || c >= 0x7f || c == '\\' || c == delim)
+    return 0;
+
+  if(flags & RAPTOR_ESCAPED_WRITE_BITFLAG_SPARQL_URI_ESCAPES)
+    return !(c == 0x20 ||
+             c == '<' || c == '>' || c == '"' ||
+             c == '{' || c == '}' || c == '|' || c == '^' || c == '`');
+
+  return 1;
+}
+
+
 /**
  * raptor_string_escaped_write:
  * @string: UTF-8 string to write
@@ -64,6 +91,21 @@ raptor_string_escaped_write(const unsigned char *string,
     return 1;
   
   for(; (c=*string); string++, len--) {
+    if(raptor_string_escaped_plain_byte(c, delim, flags)) {
+      /* write the whole run of bytes needing no escapes in one go */
+      const unsigned char *run = string + 1;
+      size_t run_len;
+
+      while(raptor_string_escaped_plain_byte(*run, delim, flags))
+        run++;
+      run_len = RAPTOR_GOOD_CAST(size_t, run - string);
+      raptor_iostream_counted_string_write(string, run_len, iostr);
+
+      /* loop moves past the last byte of the run */
+      string += run_len - 1; len -= run_len - 1;
+      continue;
+    }
+
     if((delim && c == delim && (delim == '\'' || delim == '"')) ||
        c == '\\') {
       raptor_iostream_write_byte('\\', iostr);
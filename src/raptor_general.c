@@ -144,8 +144,20 @@ raptor_new_world_internal(unsigned int version_decimal)
                           RAPTOR_WORLD_FLAG_LIBXML_STRUCTURED_ERROR_SAVE ;
     /* set: URI Interning */
     world->uri_interning = 1;
+    /* set: URI Interning in a hash table */
+    world->uri_interning_hash = 1;
 
     world->internal_ignore_errors = 0;
+
+    world->grddl_xslt_cache_size = RAPTOR_GRDDL_XSLT_CACHE_DEFAULT_SIZE;
+
+    world->scan_span = raptor_scan_get_span_function(RAPTOR_SCAN_IMPL_BEST);
+
+#ifdef RAPTOR_THREADS
+    pthread_mutex_init(&world->uris_mutex, NULL);
+    pthread_mutex_init(&world->log_mutex, NULL);
+    pthread_mutex_init(&world->grddl_mutex, NULL);
+#endif
   }
   
   return world;
@@ -246,6 +258,12 @@ raptor_free_world(raptor_world* world)
 
   raptor_uri_finish(world);
 
+#ifdef RAPTOR_THREADS
+  pthread_mutex_destroy(&world->uris_mutex);
+  pthread_mutex_destroy(&world->log_mutex);
+  pthread_mutex_destroy(&world->grddl_mutex);
+#endif
+
   RAPTOR_FREE(raptor_world, world);
 }
 
@@ -293,7 +311,10 @@ raptor_world_default_generate_bnodeid_handler(void *user_data,
   if(user_bnodeid)
     return user_bnodeid;
 
-  id = ++world->default_generate_bnodeid_handler_base;
+  if(world->concurrent)
+    id = RAPTOR_ATOMIC_ADD(&world->default_generate_bnodeid_handler_base, 1);
+  else
+    id = ++world->default_generate_bnodeid_handler_base;
 
   id_length = raptor_format_integer(NULL, 0, id, /* base */ 10, -1, '\0');
 
@@ -430,6 +451,38 @@ raptor_world_set_libxslt_security_preferences(raptor_world *world,
 }
 
 
+/**
+ * raptor_world_get_grddl_xslt_cache_stats:
+ * @world: world
+ * @hits_p: pointer to store number of cache hits (or NULL)
+ * @misses_p: pointer to store number of cache misses (or NULL)
+ * 
+ * Get the counts of GRDDL XSLT stylesheet cache lookups
+ *
+ * A hit is a transform that used an already compiled stylesheet and
+ * a miss one that had to fetch and compile it.  The counts cover all
+ * the GRDDL parsers of @world.  See
+ * #RAPTOR_WORLD_FLAG_GRDDL_XSLT_CACHE_SIZE.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_world_get_grddl_xslt_cache_stats(raptor_world *world,
+                                        int *hits_p, int *misses_p)
+{
+  RAPTOR_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, raptor_world, -1);
+
+  RAPTOR_WORLD_LOCK(world, grddl_mutex);
+  if(hits_p)
+    *hits_p = world->grddl_xslt_cache_hits;
+  if(misses_p)
+    *misses_p = world->grddl_xslt_cache_misses;
+  RAPTOR_WORLD_UNLOCK(world, grddl_mutex);
+
+  return 0;
+}
+
+
 /**
  * raptor_world_set_flag:
  * @world: world
@@ -473,9 +526,28 @@ raptor_world_set_flag(raptor_world *world, raptor_world_flag flag, int value)
       world->uri_interning = value;
       break;
 
+    case RAPTOR_WORLD_FLAG_URI_INTERNING_HASH:
+      world->uri_interning_hash = value;
+      break;
+
+    case RAPTOR_WORLD_FLAG_CONCURRENT:
+#ifdef RAPTOR_ATOMICS
+      world->concurrent = value;
+#else
+      if(value)
+        rc = -2;
+#endif
+      break;
+
     case RAPTOR_WORLD_FLAG_WWW_SKIP_INIT_FINISH:
       world->www_skip_www_init_finish = value;
       break;
+
+    case RAPTOR_WORLD_FLAG_GRDDL_XSLT_CACHE_SIZE:
+      if(value < 0)
+        return -1;
+      world->grddl_xslt_cache_size = value;
+      break;
   }
 
   return rc;
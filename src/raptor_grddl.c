@@ -55,6 +55,7 @@
 #include <libxml/xpathInternals.h>
 #include <libxml/xinclude.h>
 #include <libxml/HTMLparser.h>
+#include <libxml/HTMLtree.h>
 
 #include <libxslt/xslt.h>
 #include <libxslt/transform.h>
@@ -148,9 +149,37 @@ struct raptor_grddl_parser_context_s {
   /* Check content type once */
   int content_type_check;
 
-  /* stringbuffer to use to store retrieved document */
+  /* stringbuffer to store the retrieved document when it is needed
+   * again after the XML parse, see keep_content */
   raptor_stringbuffer* sb;
 
+  /* non-0 to keep the document content in sb for an HTML parse if XML
+   * fails or for an RDF/XML parse.  Otherwise each chunk is dropped
+   * as soon as the XML push parser has seen it.  Content kept only for
+   * HTML is dropped once the HTML push parser takes over. */
+  int keep_content;
+
+  /* non-0 if the XML push parser failed on this document */
+  int xml_failed;
+
+  /* non-0 once the XML push parser has read a root element in a
+   * namespace.  The document is then kept as XML, any later errors
+   * are recovered by the XML parser and content kept only for an HTML
+   * parse is dropped. */
+  int xml_accepted;
+
+  /* non-0 once the root namespace and the <head profile> URIs have
+   * been looked for, and the status of the <head profile> parses */
+  int namespace_discovered;
+  int profiles_discovered;
+  int profiles_status;
+
+  /* non-0 if the HTML push parser could not be created */
+  int html_failed;
+
+  /* length of document content pushed so far */
+  size_t content_length;
+
   /* non-0 to perform an additional RDF/XML parse on a retrieved document
    * because it has been identified as RDF/XML. */
   int process_this_as_rdfxml;
@@ -396,8 +425,35 @@ raptor_grddl_parse_start(raptor_parser *rdf_parser)
 
   locator->line = 1;
  
+  /* Drop anything left from an earlier parse that did not finish */
+  if(grddl_parser->xml_ctxt) {
+    if(grddl_parser->xml_ctxt->myDoc) {
+      xmlFreeDoc(grddl_parser->xml_ctxt->myDoc);
+      grddl_parser->xml_ctxt->myDoc = NULL;
+    }
+    xmlFreeParserCtxt(grddl_parser->xml_ctxt);
+    grddl_parser->xml_ctxt = NULL;
+  }
+  if(grddl_parser->sb) {
+    raptor_free_stringbuffer(grddl_parser->sb);
+    grddl_parser->sb = NULL;
+  }
+
+  if(grddl_parser->xpathCtx) {
+    xmlXPathFreeContext(grddl_parser->xpathCtx);
+    grddl_parser->xpathCtx = NULL;
+  }
+
   grddl_parser->content_type_check = 0;
   grddl_parser->process_this_as_rdfxml = 0;
+  grddl_parser->keep_content = 0;
+  grddl_parser->xml_failed = 0;
+  grddl_parser->xml_accepted = 0;
+  grddl_parser->html_failed = 0;
+  grddl_parser->namespace_discovered = 0;
+  grddl_parser->profiles_discovered = 0;
+  grddl_parser->profiles_status = 0;
+  grddl_parser->content_length = 0;
 
   return 0;
 }
@@ -654,19 +710,20 @@ raptor_grddl_ensure_internal_parser(raptor_parser* rdf_parser,
 }
 
 
-/* Run a GRDDL transform using a pre-parsed XSLT stylesheet already
- * formed into a libxml document (with URI)
+/* Run a GRDDL transform using a compiled XSLT stylesheet.
+ *
+ * The stylesheet may be shared with other parsers via the world
+ * stylesheet cache so it is not modified here.
  */
 static int
 raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
                                      grddl_xml_context* xml_context,
-                                     xmlDocPtr xslt_doc,
+                                     xsltStylesheetPtr sheet,
                                      xmlDocPtr doc)
 {
   raptor_world* world = rdf_parser->world;
   raptor_grddl_parser_context* grddl_parser;
   int ret = 0;
-  xsltStylesheetPtr sheet = NULL;
   xmlDocPtr res = NULL;
   xmlChar *doc_txt = NULL;
   int doc_txt_len = 0;
@@ -678,6 +735,8 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
   raptor_uri* base_uri;
   char *quoted_base_uri = NULL;
   xsltTransformContextPtr userCtxt = NULL;
+  const char* method;
+  const char* media_type;
 
   grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
 
@@ -692,15 +751,6 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
   
   raptor_libxslt_set_global_state(rdf_parser);
 
-  /* This calls xsltGetDefaultSecurityPrefs() */
-  sheet = xsltParseStylesheetDoc(xslt_doc);
-  if(!sheet) {
-    raptor_parser_error(rdf_parser, "Failed to parse stylesheet in '%s'",
-                        raptor_uri_as_string(xslt_uri));
-    ret = 1;
-    goto cleanup_xslt;
-  }
-
   /* This calls xsltGetDefaultSecurityPrefs() */
   userCtxt = xsltNewTransformContext(sheet, doc);
 
@@ -746,15 +796,16 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
     goto cleanup_xslt;
   }
 
-  if(res->type == XML_HTML_DOCUMENT_NODE) {
-    if(sheet->method != NULL)
-      xmlFree(sheet->method);
-    sheet->method = (xmlChar*)xmlMalloc(5);
-    memcpy(sheet->method, "html", 5);
-  }
+  method = (const char*)sheet->method;
 
   /* write the resulting XML to a string */
-  xsltSaveResultToString(&doc_txt, &doc_txt_len, res, sheet);
+  if(res->type == XML_HTML_DOCUMENT_NODE &&
+     !(method && !strcmp(method, "html"))) {
+    /* an HTML result from a stylesheet not declaring html output */
+    method = "html";
+    htmlDocDumpMemoryFormat(res, &doc_txt, &doc_txt_len, 1);
+  } else
+    xsltSaveResultToString(&doc_txt, &doc_txt_len, res, sheet);
   
   if(!doc_txt || !doc_txt_len) {
     raptor_parser_warning(rdf_parser, "XSLT returned an empty document");
@@ -763,46 +814,37 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
 
   RAPTOR_DEBUG4("XSLT returned %d bytes document method %s media type %s\n",
                 doc_txt_len,
-                (sheet->method ? (const char*)sheet->method : "NULL"),
+                (method ? method : "NULL"),
                 (sheet->mediaType ? (const char*)sheet->mediaType : "NULL"));
 
   /* Set mime types for XSLT <xsl:output method> content */
-  if(sheet->mediaType == NULL && sheet->method) {
-    if(!(strcmp((const char*)sheet->method, "text"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(11);
-      memcpy(sheet->mediaType, "text/plain",11);
-    } else if(!(strcmp((const char*)sheet->method, "xml"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(16);
-      memcpy(sheet->mediaType, "application/xml",16);
-    } else if(!(strcmp((const char*)sheet->method, "html"))) {
-      sheet->mediaType = (xmlChar*)xmlMalloc(10);
-      memcpy(sheet->mediaType, "text/html",10);
-    }
+  media_type = (const char*)sheet->mediaType;
+  if(!media_type && method) {
+    if(!strcmp(method, "text"))
+      media_type = "text/plain";
+    else if(!strcmp(method, "xml"))
+      media_type = "application/xml";
+    else if(!strcmp(method, "html"))
+      media_type = "text/html";
   }
 
   /* Assume all that all media XML is RDF/XML and also that
    * with no information at all we have RDF/XML
    */
-  if(!sheet->mediaType ||
-     (sheet->mediaType &&
-      !strcmp((const char*)sheet->mediaType, "application/xml"))) {
-    if(sheet->mediaType)
-      xmlFree(sheet->mediaType);
-    sheet->mediaType = (xmlChar*)xmlMalloc(20);
-    memcpy(sheet->mediaType, "application/rdf+xml",20);
-  }
+  if(!media_type || !strcmp(media_type, "application/xml"))
+    media_type = "application/rdf+xml";
   
   parser_name = raptor_world_guess_parser_name(rdf_parser->world, NULL,
-                                               (const char*)sheet->mediaType,
+                                               media_type,
                                                doc_txt, doc_txt_len, NULL);
   if(!parser_name) {
     RAPTOR_DEBUG3("Parser %p: Guessed no parser from mime type '%s' and content - ending",
-                  rdf_parser, sheet->mediaType);
+                  rdf_parser, media_type);
     goto cleanup_xslt;
   }
   
   RAPTOR_DEBUG4("Parser %p: Guessed parser %s from mime type '%s' and content\n",
-                rdf_parser, parser_name, sheet->mediaType);
+                rdf_parser, parser_name, media_type);
 
   if(!strcmp((const char*)parser_name, "grddl")) {
     RAPTOR_DEBUG2("Parser %p: Ignoring guess to run grddl parser - ending",
@@ -836,9 +878,6 @@ raptor_grddl_run_grddl_transform_doc(raptor_parser* rdf_parser,
   if(res)
     xmlFreeDoc(res);
   
-  if(sheet)
-    xsltFreeStylesheet(sheet);
-  
   raptor_libxslt_reset_global_state(rdf_parser);
 
   return ret;
@@ -898,6 +937,35 @@ raptor_grddl_uri_xml_parse_bytes(raptor_www* www,
 #define FETCH_IGNORE_ERRORS 1
 #define FETCH_ACCEPT_XSLT   2
 
+
+/*
+ * raptor_grddl_uri_allowed:
+ * @rdf_parser: parser
+ * @uri: URI
+ *
+ * INTERNAL - Check the parser's policy allows fetching a URI
+ *
+ * Checks #RAPTOR_OPTION_NO_NET and the parser URI filter as a fetch
+ * would, so that results of fetches made by other parsers, such as
+ * cached stylesheets, are only used when this parser could fetch them.
+ *
+ * Return value: non-0 if the URI may be fetched
+ */
+static int
+raptor_grddl_uri_allowed(raptor_parser* rdf_parser, raptor_uri* uri)
+{
+  if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET)) {
+    if(!raptor_uri_uri_string_is_file_uri(raptor_uri_as_string(uri)))
+      return 0;
+  }
+
+  if(rdf_parser->uri_filter &&
+     rdf_parser->uri_filter(rdf_parser->uri_filter_user_data, uri))
+    return 0;
+
+  return 1;
+}
+
 static int
 raptor_grddl_fetch_uri(raptor_parser* rdf_parser, 
                        raptor_uri* uri,
@@ -958,57 +1026,272 @@ raptor_grddl_fetch_uri(raptor_parser* rdf_parser,
 }
 
 
+/*
+ * World cache of compiled XSLT stylesheets
+ *
+ * Entries are kept in a list, most recently used first, of at most
+ * world->grddl_xslt_cache_size entries keyed by the stylesheet URI.
+ * An entry is reference counted: the
+ * cache holds one reference and each running transform another, so an
+ * entry dropped from the cache while in use is freed when the last
+ * transform is done.  The list and counts are protected by
+ * grddl_mutex when the world is used by several threads.
+ */
+struct raptor_grddl_xslt_cache_entry_s {
+  struct raptor_grddl_xslt_cache_entry_s* next;
+
+  /* XSLT URI */
+  raptor_uri* uri;
+
+  xsltStylesheetPtr sheet;
+
+  int usage;
+};
+typedef struct raptor_grddl_xslt_cache_entry_s raptor_grddl_xslt_cache_entry;
+
+
+static void
+raptor_free_grddl_xslt_cache_entry(raptor_grddl_xslt_cache_entry* entry)
+{
+  if(entry->sheet)
+    xsltFreeStylesheet(entry->sheet);
+  raptor_free_uri(entry->uri);
+  RAPTOR_FREE(raptor_grddl_xslt_cache_entry, entry);
+}
+
+
+/*
+ * raptor_grddl_xslt_cache_release:
+ * @world: world
+ * @entry: cache entry
+ *
+ * INTERNAL - Give up a reference to a stylesheet cache entry
+ */
+static void
+raptor_grddl_xslt_cache_release(raptor_world* world,
+                                raptor_grddl_xslt_cache_entry* entry)
+{
+  int usage;
+
+  RAPTOR_WORLD_LOCK(world, grddl_mutex);
+  usage = --entry->usage;
+  RAPTOR_WORLD_UNLOCK(world, grddl_mutex);
+
+  if(!usage)
+    raptor_free_grddl_xslt_cache_entry(entry);
+}
+
+
+/*
+ * raptor_grddl_xslt_cache_get:
+ * @world: world
+ * @uri: XSLT URI
+ *
+ * INTERNAL - Find a compiled stylesheet and make it most recently used
+ *
+ * Return value: entry (to be released with
+ * raptor_grddl_xslt_cache_release()) or NULL if not cached
+ */
+static raptor_grddl_xslt_cache_entry*
+raptor_grddl_xslt_cache_get(raptor_world* world, raptor_uri* uri)
+{
+  raptor_grddl_xslt_cache_entry* entry;
+  raptor_grddl_xslt_cache_entry* prev = NULL;
+
+  RAPTOR_WORLD_LOCK(world, grddl_mutex);
+
+  for(entry = world->grddl_xslt_cache; entry; entry = entry->next) {
+    if(raptor_uri_equals(entry->uri, uri)) {
+      if(prev) {
+        /* move to the start of the list */
+        prev->next = entry->next;
+        entry->next = world->grddl_xslt_cache;
+        world->grddl_xslt_cache = entry;
+      }
+      entry->usage++;
+      break;
+    }
+    prev = entry;
+  }
+
+  if(entry)
+    world->grddl_xslt_cache_hits++;
+  else
+    world->grddl_xslt_cache_misses++;
+
+  RAPTOR_WORLD_UNLOCK(world, grddl_mutex);
+
+  return entry;
+}
+
+
+/*
+ * raptor_grddl_xslt_cache_add:
+ * @world: world
+ * @uri: XSLT URI
+ * @sheet: compiled stylesheet (becomes owned by the entry)
+ *
+ * INTERNAL - Add a compiled stylesheet as the most recently used,
+ * dropping the least recently used ones if the cache is full
+ *
+ * Return value: entry (to be released with
+ * raptor_grddl_xslt_cache_release()) or NULL on failure
+ */
+static raptor_grddl_xslt_cache_entry*
+raptor_grddl_xslt_cache_add(raptor_world* world, raptor_uri* uri,
+                            xsltStylesheetPtr sheet)
+{
+  raptor_grddl_xslt_cache_entry* entry;
+  raptor_grddl_xslt_cache_entry* dropped = NULL;
+  raptor_grddl_xslt_cache_entry* prev;
+  raptor_grddl_xslt_cache_entry* next;
+  int count;
+
+  entry = RAPTOR_CALLOC(raptor_grddl_xslt_cache_entry*, 1, sizeof(*entry));
+  if(!entry) {
+    xsltFreeStylesheet(sheet);
+    return NULL;
+  }
+
+  entry->uri = raptor_uri_copy(uri);
+  entry->sheet = sheet;
+  /* the caller */
+  entry->usage = 1;
+
+  if(world->grddl_xslt_cache_size <= 0)
+    return entry;
+
+  RAPTOR_WORLD_LOCK(world, grddl_mutex);
+
+  /* the cache */
+  entry->usage++;
+  entry->next = world->grddl_xslt_cache;
+  world->grddl_xslt_cache = entry;
+
+  /* unlink entries beyond the cache size or for the same stylesheet
+   * added by another parser meanwhile */
+  prev = entry;
+  count = 1;
+  for(next = entry->next; next; next = prev->next) {
+    if(count >= world->grddl_xslt_cache_size ||
+       raptor_uri_equals(next->uri, uri)) {
+      prev->next = next->next;
+      next->next = dropped;
+      dropped = next;
+    } else {
+      prev = next;
+      count++;
+    }
+  }
+
+  RAPTOR_WORLD_UNLOCK(world, grddl_mutex);
+
+  while(dropped) {
+    next = dropped->next;
+    RAPTOR_DEBUG2("Dropping cached XSLT stylesheet for URI '%s'\n",
+                  raptor_uri_as_string(dropped->uri));
+    raptor_grddl_xslt_cache_release(world, dropped);
+    dropped = next;
+  }
+
+  return entry;
+}
+
+
 /* Run a GRDDL transform using a XSLT stylesheet at a given URI */
 static int
 raptor_grddl_run_grddl_transform_uri(raptor_parser* rdf_parser,
                                      grddl_xml_context* xml_context, 
                                      xmlDocPtr doc)
 {
+  raptor_world* world = rdf_parser->world;
   xmlParserCtxtPtr xslt_ctxt = NULL;
   raptor_grddl_xml_parse_bytes_context xpbc;
   int ret = 0;
   raptor_uri* xslt_uri;
-  raptor_uri* base_uri;
   raptor_uri* old_locator_uri;
   raptor_locator *locator = &rdf_parser->locator;
+  raptor_grddl_xslt_cache_entry* entry;
+  xsltStylesheetPtr sheet;
 
   xslt_uri = xml_context->uri;
-  base_uri = xml_context->base_uri ? xml_context->base_uri : xml_context->uri;
 
-  RAPTOR_DEBUG3("Running GRDDL transform with XSLT URI %s and base URI %s\n",
-                raptor_uri_as_string(xslt_uri),
-                raptor_uri_as_string(base_uri));
+  RAPTOR_DEBUG2("Running GRDDL transform with XSLT URI %s\n",
+                raptor_uri_as_string(xslt_uri));
   
+  old_locator_uri = locator->uri;
+  locator->uri = xslt_uri;
+
+  /* a stylesheet this parser may not fetch is not taken from the
+   * cache either; the fetch below then fails as usual */
+  entry = NULL;
+  if(raptor_grddl_uri_allowed(rdf_parser, xslt_uri))
+    entry = raptor_grddl_xslt_cache_get(world, xslt_uri);
+  if(entry) {
+    RAPTOR_DEBUG2("Using cached XSLT stylesheet for URI '%s'\n",
+                  raptor_uri_as_string(xslt_uri));
+    goto transform;
+  }
+
   /* make an xsltStylesheetPtr via the raptor_grddl_uri_xml_parse_bytes 
-   * callback as bytes are returned
+   * callback as bytes are returned.  The stylesheet is parsed with its
+   * own URI as base so that it does not depend on the document.
    */
   xpbc.xc = NULL;
   xpbc.rdf_parser = rdf_parser;
-  xpbc.base_uri = base_uri;
+  xpbc.base_uri = xslt_uri;
 
-  old_locator_uri = locator->uri;
-  locator->uri = xslt_uri;
   ret = raptor_grddl_fetch_uri(rdf_parser,
                              xslt_uri,
                              raptor_grddl_uri_xml_parse_bytes, &xpbc,
                              NULL, NULL,
                              FETCH_ACCEPT_XSLT);
   xslt_ctxt = xpbc.xc;
-  if(ret) {
+  if(ret || !xslt_ctxt) {
     locator->uri = old_locator_uri;
     raptor_parser_warning(rdf_parser, "Fetching XSLT document URI '%s' failed",
                           raptor_uri_as_string(xslt_uri));
     ret = 0;
-  } else {
-    xmlParseChunk(xpbc.xc, NULL, 0, 1);
-  
-    ret = raptor_grddl_run_grddl_transform_doc(rdf_parser,
-                                               xml_context,
-                                               xslt_ctxt->myDoc,
-                                               doc);
+    goto tidy;
+  }
+
+  xmlParseChunk(xslt_ctxt, NULL, 0, 1);
+
+  raptor_libxslt_set_global_state(rdf_parser);
+  /* This calls xsltGetDefaultSecurityPrefs() and on success the
+   * stylesheet owns the document */
+  sheet = xsltParseStylesheetDoc(xslt_ctxt->myDoc);
+  raptor_libxslt_reset_global_state(rdf_parser);
+
+  if(!sheet) {
+    raptor_parser_error(rdf_parser, "Failed to parse stylesheet in '%s'",
+                        raptor_uri_as_string(xslt_uri));
+    if(xslt_ctxt->myDoc)
+      xmlFreeDoc(xslt_ctxt->myDoc);
+    xslt_ctxt->myDoc = NULL;
     locator->uri = old_locator_uri;
+    ret = 1;
+    goto tidy;
+  }
+  xslt_ctxt->myDoc = NULL;
+
+  entry = raptor_grddl_xslt_cache_add(world, xslt_uri, sheet);
+  if(!entry) {
+    locator->uri = old_locator_uri;
+    ret = 1;
+    goto tidy;
   }
 
+  transform:
+  ret = raptor_grddl_run_grddl_transform_doc(rdf_parser,
+                                             xml_context,
+                                             entry->sheet,
+                                             doc);
+  locator->uri = old_locator_uri;
+
+  raptor_grddl_xslt_cache_release(world, entry);
+
+  tidy:
   if(xslt_ctxt)
     xmlFreeParserCtxt(xslt_ctxt); 
   
@@ -1182,6 +1465,7 @@ raptor_grddl_run_xpath_match(raptor_parser* rdf_parser,
 
         xml_context = raptor_new_xml_context(rdf_parser->world, uri, base_uri);
         raptor_sequence_push(seq, xml_context);
+        raptor_free_uri(uri);
       }
       RAPTOR_FREE(char*, buffer);
     } else if(flags & MATCH_IS_HARDCODED) {
@@ -1355,237 +1639,263 @@ raptor_grddl_libxml_discard_error(void* user_data, const char *msg, ...)
 }
 
 
-static int
-raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
-                         const unsigned char *s, size_t len,
-                         int is_end)
+/*
+ * raptor_grddl_xml_parse_chunk:
+ * @rdf_parser: GRDDL parser
+ * @s: content chunk
+ * @len: length of @s
+ * @is_end: non-0 if this is the last chunk
+ *
+ * INTERNAL - Push a chunk of the document into the libxml XML parser
+ * creating it on the first chunk.  Once the XML parse fails the rest
+ * of the document is ignored and xml_failed is set.
+ *
+ * With the HTML tag soup option, xml_accepted is set when a root
+ * element in a namespace has been read and the XML parser is switched
+ * to recover from later errors rather than fail.
+ */
+static void
+raptor_grddl_xml_parse_chunk(raptor_parser* rdf_parser,
+                             const unsigned char *s, size_t len,
+                             int is_end)
 {
   raptor_grddl_parser_context* grddl_parser;
-  int i;
-  int ret = 0;
-  const unsigned char* uri_string;
-  raptor_uri* uri;
-  /* XML document DOM */
-  xmlDocPtr doc;
-  int expri;
-  unsigned char* buffer = NULL;
-  size_t buffer_len = 0;
-  int buffer_is_libxml = 0;
-  int loop;
-
-  if(!is_end && !rdf_parser->emitted_default_graph) {
-    /* Cannot tell if we have a statement yet but must ensure that
-     * the start default graph mark is done once and done before any
-     * statements.
-     */
-    raptor_parser_start_graph(rdf_parser, NULL, 0);
-    rdf_parser->emitted_default_graph++;
-  }
+  int saved_ignore_errors;
+  int rc = 0;
 
   grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
 
-  if(grddl_parser->content_type && !grddl_parser->content_type_check) {
-    grddl_parser->content_type_check++;
-    if(!strncmp(grddl_parser->content_type, "application/rdf+xml", 19)) {
-      RAPTOR_DEBUG3("Parser %p: Found document with type '%s' is RDF/XML\n",
-                    rdf_parser, grddl_parser->content_type);
-      grddl_parser->process_this_as_rdfxml = 1;
-    }
-    if(!strncmp(grddl_parser->content_type, "text/html", 9) ||
-       !strncmp(grddl_parser->content_type, "application/html+xml", 20)) {
-      RAPTOR_DEBUG3("Parser %p: Found document with type '%s' is HTML\n",
-                    rdf_parser, grddl_parser->content_type);
-      grddl_parser->html_base_processing = 1;
-    }
-  }
-  
-  if(!grddl_parser->sb)
-    grddl_parser->sb = raptor_new_stringbuffer();
-
-  raptor_stringbuffer_append_counted_string(grddl_parser->sb, s, len, 1);
-    
-  if(!is_end)
-    return 0;
-
-  buffer_len = raptor_stringbuffer_length(grddl_parser->sb);
-  buffer = RAPTOR_MALLOC(unsigned char*, buffer_len + 1);
-  if(buffer)
-    raptor_stringbuffer_copy_to_string(grddl_parser->sb, 
-                                       buffer, buffer_len);
-  
+  grddl_parser->content_length += len;
 
-  uri_string = raptor_uri_as_string(rdf_parser->base_uri);
+  if(grddl_parser->xml_failed)
+    return;
 
   /* Discard parsing errors */
+  saved_ignore_errors = rdf_parser->world->internal_ignore_errors;
   raptor_world_internal_set_ignore_errors(rdf_parser->world, 1);
 
-  RAPTOR_DEBUG4("Parser %p: URI %s: processing %d bytes of content\n",
-                rdf_parser, uri_string, (int)buffer_len);
-
-  for(loop = 0; loop < 2; loop++) {
-    int rc;
-
-    if(loop == 0) { 
-      int libxml_options = 0;
+  if(!grddl_parser->xml_ctxt) {
+    int libxml_options = 0;
 
-      RAPTOR_DEBUG2("Parser %p: Creating an XML parser\n", rdf_parser);
+    RAPTOR_DEBUG2("Parser %p: Creating an XML parser\n", rdf_parser);
 
-      /* try to create an XML parser context */
-      grddl_parser->xml_ctxt = xmlCreatePushParserCtxt(NULL, NULL,
-                                                       (const char*)buffer,
-                                                       RAPTOR_BAD_CAST(int, buffer_len),
-                                                       (const char*)uri_string);
-      if(!grddl_parser->xml_ctxt) {
-        RAPTOR_DEBUG2("Parser %p: Creating an XML parser failed\n", rdf_parser);
-        continue;
-      }
+    /* try to create an XML parser context */
+    grddl_parser->xml_ctxt = xmlCreatePushParserCtxt(NULL, NULL,
+                                                     (const char*)s,
+                                                     RAPTOR_BAD_CAST(int, len),
+                                                     (const char*)raptor_uri_as_string(rdf_parser->base_uri));
+    if(!grddl_parser->xml_ctxt) {
+      RAPTOR_DEBUG2("Parser %p: Creating an XML parser failed\n", rdf_parser);
+      grddl_parser->xml_failed = 1;
+      goto tidy;
+    }
 
 #ifdef RAPTOR_LIBXML_XML_PARSE_NONET
-      if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET))
-        libxml_options |= XML_PARSE_NONET;
+    if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET))
+      libxml_options |= XML_PARSE_NONET;
 #endif
 #ifdef HAVE_XMLCTXTUSEOPTIONS
-      xmlCtxtUseOptions(grddl_parser->xml_ctxt, libxml_options);
+    xmlCtxtUseOptions(grddl_parser->xml_ctxt, libxml_options);
 #endif
 
-
-      grddl_parser->xml_ctxt->vctxt.warning = raptor_grddl_libxml_discard_error;
-      grddl_parser->xml_ctxt->vctxt.error = raptor_grddl_libxml_discard_error;
+    grddl_parser->xml_ctxt->vctxt.warning = raptor_grddl_libxml_discard_error;
+    grddl_parser->xml_ctxt->vctxt.error = raptor_grddl_libxml_discard_error;
     
-      grddl_parser->xml_ctxt->replaceEntities = 1;
-      grddl_parser->xml_ctxt->loadsubset = 1;
-    } else { /* loop is 1 */
-  
-      /* try to create an HTML parser context */
-      if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_HTML_TAG_SOUP)) {
-        xmlCharEncoding enc;
-        int options;
-
-        RAPTOR_DEBUG2("Parser %p: Creating an HTML parser\n", rdf_parser);
-
-        enc = xmlDetectCharEncoding((const unsigned char*)buffer,
-                                    RAPTOR_BAD_CAST(int, buffer_len));
-        grddl_parser->html_ctxt = htmlCreatePushParserCtxt(/*sax*/ NULL, 
-                                                           /*user_data*/ NULL,
-                                                           (const char *)buffer,
-                                                           RAPTOR_BAD_CAST(int, buffer_len),
-                                                           (const char *)uri_string,
-                                                           enc);
-        if(!grddl_parser->html_ctxt) {
-          RAPTOR_DEBUG2("Parser %p: Creating an HTML parser failed\n",
-                        rdf_parser);
-          continue;
-        }
-  
-        /* HTML parser */
-        grddl_parser->html_ctxt->replaceEntities = 1;
-        grddl_parser->html_ctxt->loadsubset = 1;
+    grddl_parser->xml_ctxt->replaceEntities = 1;
+    grddl_parser->xml_ctxt->loadsubset = 1;
+
+    RAPTOR_DEBUG2("Parser %p: Parsing as XML\n", rdf_parser);
+
+    /* the first chunk was given to the parser above */
+    if(is_end)
+      rc = xmlParseChunk(grddl_parser->xml_ctxt, NULL, 0, 1);
+  } else
+    rc = xmlParseChunk(grddl_parser->xml_ctxt, (const char*)s,
+                       RAPTOR_BAD_CAST(int, len), is_end);
+
+  if(rc && grddl_parser->xml_accepted) {
+    RAPTOR_DEBUG2("Parser %p: Recovering from XML error\n", rdf_parser);
+  } else if(rc) {
+    RAPTOR_DEBUG2("Parser %p: Parsing as XML failed\n", rdf_parser);
+    if(grddl_parser->xml_ctxt->myDoc) {
+      xmlFreeDoc(grddl_parser->xml_ctxt->myDoc);
+      grddl_parser->xml_ctxt->myDoc = NULL;
+    }
+    xmlFreeParserCtxt(grddl_parser->xml_ctxt);
+    grddl_parser->xml_ctxt = NULL;
+    grddl_parser->xml_failed = 1;
+  } else if(!grddl_parser->xml_accepted &&
+            RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                       RAPTOR_OPTION_HTML_TAG_SOUP)) {
+    xmlNodePtr root = NULL;
+
+    if(grddl_parser->xml_ctxt->myDoc)
+      root = xmlDocGetRootElement(grddl_parser->xml_ctxt->myDoc);
+
+    /* An HTML parse of a root element with a namespace would lose it */
+    if(root && root->ns) {
+      RAPTOR_DEBUG2("Parser %p: Accepted document as XML\n", rdf_parser);
+      grddl_parser->xml_accepted = 1;
+      grddl_parser->xml_ctxt->recovery = 1;
+    }
+  }
+
+  tidy:
+  /* Restore error handling */
+  raptor_world_internal_set_ignore_errors(rdf_parser->world,
+                                          saved_ignore_errors);
+}
+
+
+/*
+ * raptor_grddl_html_parse_chunk:
+ * @rdf_parser: GRDDL parser
+ * @s: content chunk
+ * @len: length of @s
+ * @is_end: non-0 if this is the last chunk
+ *
+ * INTERNAL - Push a chunk of the document into the libxml HTML parser
+ * creating it on the first chunk, which must be all the content seen
+ * so far.  If the parser cannot be created, html_failed is set.
+ */
+static void
+raptor_grddl_html_parse_chunk(raptor_parser* rdf_parser,
+                              const unsigned char *s, size_t len,
+                              int is_end)
+{
+  raptor_grddl_parser_context* grddl_parser;
+  int saved_ignore_errors;
+  int rc = 0;
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  /* Discard parsing errors */
+  saved_ignore_errors = rdf_parser->world->internal_ignore_errors;
+  raptor_world_internal_set_ignore_errors(rdf_parser->world, 1);
+
+  if(!grddl_parser->html_ctxt) {
+    xmlCharEncoding enc;
+    int options;
+
+    RAPTOR_DEBUG2("Parser %p: Creating an HTML parser\n", rdf_parser);
+
+    enc = xmlDetectCharEncoding((const unsigned char*)s,
+                                RAPTOR_BAD_CAST(int, len));
+    grddl_parser->html_ctxt = htmlCreatePushParserCtxt(/*sax*/ NULL, 
+                                                       /*user_data*/ NULL,
+                                                       (const char *)s,
+                                                       RAPTOR_BAD_CAST(int, len),
+                                                       (const char *)raptor_uri_as_string(rdf_parser->base_uri),
+                                                       enc);
+    if(!grddl_parser->html_ctxt) {
+      RAPTOR_DEBUG2("Parser %p: Creating an HTML parser failed\n",
+                    rdf_parser);
+      grddl_parser->html_failed = 1;
+      goto tidy;
+    }
+
+    /* HTML parser */
+    grddl_parser->html_ctxt->replaceEntities = 1;
+    grddl_parser->html_ctxt->loadsubset = 1;
     
-        grddl_parser->html_ctxt->vctxt.error = raptor_grddl_libxml_discard_error;
+    grddl_parser->html_ctxt->vctxt.error = raptor_grddl_libxml_discard_error;
     
-        /* HTML_PARSE_NOWARNING disables sax->warning, vxtxt.warning  */
-        /* HTML_PARSE_NOERROR disables sax->error, vctxt.error */
-        options = HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING;
+    /* HTML_PARSE_NOWARNING disables sax->warning, vxtxt.warning  */
+    /* HTML_PARSE_NOERROR disables sax->error, vctxt.error */
+    options = HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING;
 #ifdef HTML_PARSE_RECOVER
-        options |= HTML_PARSE_RECOVER;
+    options |= HTML_PARSE_RECOVER;
 #endif
 #ifdef RAPTOR_LIBXML_HTML_PARSE_NONET
-        if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET))
-          options |= HTML_PARSE_NONET;
+    if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_NO_NET))
+      options |= HTML_PARSE_NONET;
 #endif
 
-        htmlCtxtUseOptions(grddl_parser->html_ctxt, options);
+    htmlCtxtUseOptions(grddl_parser->html_ctxt, options);
  
-      } else /* No HTML tag soup allowed so continue loop */
-        continue;
-    }
+    RAPTOR_DEBUG2("Parser %p: Parsing as HTML\n", rdf_parser);
 
+    /* the first chunk was given to the parser above */
+    if(is_end)
+      rc = htmlParseChunk(grddl_parser->html_ctxt, NULL, 0, 1);
+  } else
+    rc = htmlParseChunk(grddl_parser->html_ctxt, (const char*)s,
+                        RAPTOR_BAD_CAST(int, len), is_end);
 
-    if(grddl_parser->html_ctxt) {
-      RAPTOR_DEBUG2("Parser %p: Parsing as HTML\n", rdf_parser);
-      rc = htmlParseChunk(grddl_parser->html_ctxt, (const char*)s, 0, 1);
-      RAPTOR_DEBUG3("Parser %p: Parsing as HTML %s\n", rdf_parser,
-                    (rc ? "failed" : "succeeded"));
-      if(rc) {
-        if(grddl_parser->html_ctxt->myDoc) {
-          xmlFreeDoc(grddl_parser->html_ctxt->myDoc);
-          grddl_parser->html_ctxt->myDoc = NULL;
-        }
-        htmlFreeParserCtxt(grddl_parser->html_ctxt);
-        grddl_parser->html_ctxt = NULL;
-      }
-    } else {
-      RAPTOR_DEBUG2("Parser %p: Parsing as XML\n", rdf_parser);
-      rc = xmlParseChunk(grddl_parser->xml_ctxt, (const char*)s, 0, 1);
-      RAPTOR_DEBUG3("Parser %p: Parsing as XML %s\n", rdf_parser,
-                    (rc ? "failed" : "succeeded"));
-      if(rc) {
-        if(grddl_parser->xml_ctxt->myDoc) {
-          xmlFreeDoc(grddl_parser->xml_ctxt->myDoc);
-          grddl_parser->xml_ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(grddl_parser->xml_ctxt);
-        grddl_parser->xml_ctxt = NULL;
-      }
-    }
-
-    if(!rc)
-      break;
+  if(!is_end)
+    goto tidy;
 
+  RAPTOR_DEBUG3("Parser %p: Parsing as HTML %s\n", rdf_parser,
+                (rc ? "failed" : "succeeded"));
+  if(rc) {
+    if(grddl_parser->html_ctxt->myDoc) {
+      xmlFreeDoc(grddl_parser->html_ctxt->myDoc);
+      grddl_parser->html_ctxt->myDoc = NULL;
+    }
+    htmlFreeParserCtxt(grddl_parser->html_ctxt);
+    grddl_parser->html_ctxt = NULL;
+    grddl_parser->html_failed = 1;
   }
-  
+
+  tidy:
   /* Restore error handling */
-  raptor_world_internal_set_ignore_errors(rdf_parser->world, 0);
+  raptor_world_internal_set_ignore_errors(rdf_parser->world,
+                                          saved_ignore_errors);
+}
 
-  if(!grddl_parser->html_ctxt && !grddl_parser->xml_ctxt) {
-    raptor_parser_error(rdf_parser, "Failed to create HTML or XML parsers");
-    ret = 1;
-    goto tidy;
-  }
-  
-  raptor_grddl_done_uri(grddl_parser, rdf_parser->base_uri);
 
-  if(grddl_parser->html_ctxt)
-    doc = grddl_parser->html_ctxt->myDoc;
-  else
-    doc = grddl_parser->xml_ctxt->myDoc;
-  if(!doc) {
-    raptor_parser_error(rdf_parser, 
-                        "Failed to create XML DOM for GRDDL document");
-    ret = 1;
-    goto tidy;
-  }
+/*
+ * raptor_grddl_doc_has_head:
+ * @doc: XML DOM, possibly still being built
+ *
+ * INTERNAL - Check if the root element of a document has a head child
+ *
+ * Return value: non-0 if a head element has been read
+ */
+static int
+raptor_grddl_doc_has_head(xmlDocPtr doc)
+{
+  xmlNodePtr node;
 
-  if(!grddl_parser->grddl_processing)
-    goto transform;
-  
+  node = xmlDocGetRootElement(doc);
+  if(!node)
+    return 0;
 
-  if(grddl_parser->xinclude_processing) {
-    RAPTOR_DEBUG3("Parser %p: Running XInclude processing on URI '%s'\n",
-                  rdf_parser, raptor_uri_as_string(rdf_parser->base_uri));
-    if(xmlXIncludeProcess(doc) < 0) {
-      raptor_parser_error(rdf_parser, 
-                          "XInclude processing failed for GRDDL document");
-      ret = 1;
-      goto tidy;
-    } else {
-      int blen;
-      
-      /* write the result of XML Include to buffer */
-      RAPTOR_FREE(char*, buffer);
-      xmlDocDumpFormatMemory(doc, (xmlChar**)&buffer, &blen,
-                             1 /* indent the result */);
-      buffer_len = blen;
-      buffer_is_libxml = 1;
-      
-      RAPTOR_DEBUG3("Parser %p: XML Include processing returned %d bytes document\n",
-                    rdf_parser, (int)buffer_len);
-    }
+  for(node = node->children; node; node = node->next) {
+    if(node->type == XML_ELEMENT_NODE &&
+       !strcmp((const char*)node->name, "head"))
+      return 1;
   }
 
+  return 0;
+}
 
-  RAPTOR_DEBUG3("Parser %p: Running top-level GRDDL on URI '%s'\n",
-                rdf_parser, raptor_uri_as_string(rdf_parser->base_uri));
+
+/*
+ * raptor_grddl_discover_namespace:
+ * @rdf_parser: GRDDL parser
+ * @doc: XML DOM, possibly still being built
+ * @is_end: non-0 if the whole document has been read
+ *
+ * INTERNAL - Run GRDDL on the root namespace URI once the root element
+ * has been read so it can be fetched while the rest of the document
+ * is still arriving.  Only done once per document.
+ */
+static void
+raptor_grddl_discover_namespace(raptor_parser* rdf_parser, xmlDocPtr doc,
+                                int is_end)
+{
+  raptor_grddl_parser_context* grddl_parser;
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  if(grddl_parser->namespace_discovered)
+    return;
+
+  if(!is_end && !xmlDocGetRootElement(doc))
+    return;
+
+  grddl_parser->namespace_discovered = 1;
 
   /* Work out if there is a root namespace URI */
   if(1) {
@@ -1655,16 +1965,45 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
     xml_context = raptor_new_xml_context(rdf_parser->world, NULL, NULL);
     raptor_sequence_push(grddl_parser->profile_uris, xml_context);
   }
+}
 
 
+/*
+ * raptor_grddl_discover_profiles:
+ * @rdf_parser: GRDDL parser
+ * @doc: XML DOM, possibly still being built
+ * @is_end: non-0 if the whole document has been read
+ *
+ * INTERNAL - Run GRDDL on the <head profile> URIs once the head
+ * element has been read.  Only done once per document, after
+ * raptor_grddl_discover_namespace().
+ *
+ * Return value: the status of the last <head profile> parse
+ */
+static int
+raptor_grddl_discover_profiles(raptor_parser* rdf_parser, xmlDocPtr doc,
+                               int is_end)
+{
+  raptor_grddl_parser_context* grddl_parser;
+  raptor_uri* uri;
+  int i;
+  int ret = 0;
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  if(grddl_parser->profiles_discovered)
+    return grddl_parser->profiles_status;
+
+  if(!is_end && !raptor_grddl_doc_has_head(doc))
+    return 0;
+
   /* Create the XPath evaluation context */
   if(!grddl_parser->xpathCtx) {
     grddl_parser->xpathCtx = xmlXPathNewContext(doc);
     if(!grddl_parser->xpathCtx) {
       raptor_parser_error(rdf_parser,
                           "Failed to create XPath context for GRDDL document");
-      ret = 1;
-      goto tidy;
+      return 1;
     }
     
     xmlXPathRegisterNs(grddl_parser->xpathCtx,
@@ -1674,6 +2013,8 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
                        (const xmlChar*)"dataview",
                        (const xmlChar*)"http://www.w3.org/2003/g/data-view#");
   }
+
+  grddl_parser->profiles_discovered = 1;
   
   /* Try <head profile> URIs */
   if(1) {
@@ -1732,6 +2073,196 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
 
   } /* end head profile URIs */
 
+  grddl_parser->profiles_status = ret;
+
+  return ret;
+}
+
+
+static int
+raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
+                         const unsigned char *s, size_t len,
+                         int is_end)
+{
+  raptor_grddl_parser_context* grddl_parser;
+  int i;
+  int ret = 0;
+  const unsigned char* uri_string;
+  raptor_uri* uri;
+  /* XML document DOM */
+  xmlDocPtr doc;
+  int expri;
+  unsigned char* buffer = NULL;
+  size_t buffer_len = 0;
+  int buffer_is_libxml = 0;
+
+  if(!is_end && !rdf_parser->emitted_default_graph) {
+    /* Cannot tell if we have a statement yet but must ensure that
+     * the start default graph mark is done once and done before any
+     * statements.
+     */
+    raptor_parser_start_graph(rdf_parser, NULL, 0);
+    rdf_parser->emitted_default_graph++;
+  }
+
+  grddl_parser = (raptor_grddl_parser_context*)rdf_parser->context;
+
+  if(grddl_parser->content_type && !grddl_parser->content_type_check) {
+    grddl_parser->content_type_check++;
+    if(!strncmp(grddl_parser->content_type, "application/rdf+xml", 19)) {
+      RAPTOR_DEBUG3("Parser %p: Found document with type '%s' is RDF/XML\n",
+                    rdf_parser, grddl_parser->content_type);
+      grddl_parser->process_this_as_rdfxml = 1;
+    }
+    if(!strncmp(grddl_parser->content_type, "text/html", 9) ||
+       !strncmp(grddl_parser->content_type, "application/html+xml", 20)) {
+      RAPTOR_DEBUG3("Parser %p: Found document with type '%s' is HTML\n",
+                    rdf_parser, grddl_parser->content_type);
+      grddl_parser->html_base_processing = 1;
+    }
+  }
+  
+  if(!grddl_parser->xml_ctxt && !grddl_parser->xml_failed) {
+    /* First chunk: only keep a copy of the document if it will be
+     * needed again after the XML parse */
+    grddl_parser->keep_content = 
+      RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_HTML_TAG_SOUP) ||
+      grddl_parser->process_this_as_rdfxml;
+  }
+
+  if(grddl_parser->keep_content && len) {
+    if(!grddl_parser->sb)
+      grddl_parser->sb = raptor_new_stringbuffer();
+
+    if(grddl_parser->sb)
+      raptor_stringbuffer_append_counted_string(grddl_parser->sb, s, len, 1);
+  }
+
+  raptor_grddl_xml_parse_chunk(rdf_parser, s, len, is_end);
+
+  if(grddl_parser->html_ctxt)
+    raptor_grddl_html_parse_chunk(rdf_parser, s, len, is_end);
+  else if(grddl_parser->xml_failed && !grddl_parser->html_failed &&
+          grddl_parser->sb &&
+          RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_HTML_TAG_SOUP)) {
+    /* XML failed: hand the content so far to the HTML parser and push
+     * the rest of the document into it as it arrives */
+    raptor_grddl_html_parse_chunk(rdf_parser,
+                                  raptor_stringbuffer_as_string(grddl_parser->sb),
+                                  raptor_stringbuffer_length(grddl_parser->sb),
+                                  is_end);
+
+    if(!grddl_parser->process_this_as_rdfxml) {
+      raptor_free_stringbuffer(grddl_parser->sb);
+      grddl_parser->sb = NULL;
+      grddl_parser->keep_content = 0;
+    }
+  } else if(grddl_parser->xml_accepted && grddl_parser->sb &&
+            !grddl_parser->process_this_as_rdfxml) {
+    /* XML will not be given up so there will be no HTML parse */
+    raptor_free_stringbuffer(grddl_parser->sb);
+    grddl_parser->sb = NULL;
+    grddl_parser->keep_content = 0;
+  }
+
+  if(!is_end) {
+    /* Start GRDDL on the namespace and profiles as soon as the DOM
+     * that will be used at the end has them.  XInclude processing
+     * may change the DOM so that waits for the end. */
+    doc = NULL;
+    if(grddl_parser->grddl_processing &&
+       !grddl_parser->xinclude_processing) {
+      if(grddl_parser->html_ctxt)
+        doc = grddl_parser->html_ctxt->myDoc;
+      else if(grddl_parser->xml_ctxt &&
+              (grddl_parser->xml_accepted ||
+               !RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                           RAPTOR_OPTION_HTML_TAG_SOUP)))
+        doc = grddl_parser->xml_ctxt->myDoc;
+    }
+
+    if(doc) {
+      raptor_grddl_done_uri(grddl_parser, rdf_parser->base_uri);
+      raptor_grddl_discover_namespace(rdf_parser, doc, 0);
+      raptor_grddl_discover_profiles(rdf_parser, doc, 0);
+    }
+
+    return 0;
+  }
+
+  if(grddl_parser->sb) {
+    buffer_len = raptor_stringbuffer_length(grddl_parser->sb);
+    buffer = RAPTOR_MALLOC(unsigned char*, buffer_len + 1);
+    if(buffer)
+      raptor_stringbuffer_copy_to_string(grddl_parser->sb, 
+                                         buffer, buffer_len);
+    raptor_free_stringbuffer(grddl_parser->sb);
+    grddl_parser->sb = NULL;
+  }
+
+  uri_string = raptor_uri_as_string(rdf_parser->base_uri);
+
+  RAPTOR_DEBUG4("Parser %p: URI %s: processed %d bytes of content\n",
+                rdf_parser, uri_string, (int)grddl_parser->content_length);
+
+  if(!grddl_parser->html_ctxt && !grddl_parser->xml_ctxt) {
+    raptor_parser_error(rdf_parser, "Failed to create HTML or XML parsers");
+    ret = 1;
+    goto tidy;
+  }
+  
+  raptor_grddl_done_uri(grddl_parser, rdf_parser->base_uri);
+
+  if(grddl_parser->html_ctxt)
+    doc = grddl_parser->html_ctxt->myDoc;
+  else
+    doc = grddl_parser->xml_ctxt->myDoc;
+  if(!doc) {
+    raptor_parser_error(rdf_parser, 
+                        "Failed to create XML DOM for GRDDL document");
+    ret = 1;
+    goto tidy;
+  }
+
+  if(!grddl_parser->grddl_processing)
+    goto transform;
+  
+
+  if(grddl_parser->xinclude_processing) {
+    RAPTOR_DEBUG3("Parser %p: Running XInclude processing on URI '%s'\n",
+                  rdf_parser, raptor_uri_as_string(rdf_parser->base_uri));
+    if(xmlXIncludeProcess(doc) < 0) {
+      raptor_parser_error(rdf_parser, 
+                          "XInclude processing failed for GRDDL document");
+      ret = 1;
+      goto tidy;
+    } else {
+      int blen;
+      
+      /* write the result of XML Include to buffer */
+      if(buffer)
+        RAPTOR_FREE(char*, buffer);
+      xmlDocDumpFormatMemory(doc, (xmlChar**)&buffer, &blen,
+                             1 /* indent the result */);
+      buffer_len = blen;
+      buffer_is_libxml = 1;
+      
+      RAPTOR_DEBUG3("Parser %p: XML Include processing returned %d bytes document\n",
+                    rdf_parser, (int)buffer_len);
+    }
+  }
+
+
+  RAPTOR_DEBUG3("Parser %p: Running top-level GRDDL on URI '%s'\n",
+                rdf_parser, raptor_uri_as_string(rdf_parser->base_uri));
+
+  raptor_grddl_discover_namespace(rdf_parser, doc, 1);
+
+  ret = raptor_grddl_discover_profiles(rdf_parser, doc, 1);
+  if(!grddl_parser->xpathCtx) {
+    ret = 1;
+    goto tidy;
+  }
 
   /* Try XHTML document with alternate forms
    * <link type="application/rdf+xml" href="URI" />
@@ -1834,6 +2365,16 @@ raptor_grddl_parse_chunk(raptor_parser* rdf_parser,
   }
 
 
+  /* The root element said RDF/XML but the content was not kept so
+   * write it back out of the DOM */
+  if(grddl_parser->process_this_as_rdfxml && !buffer) {
+    int blen;
+
+    xmlDocDumpMemory(doc, (xmlChar**)&buffer, &blen);
+    buffer_len = blen;
+    buffer_is_libxml = 1;
+  }
+
   /* Process this document's content buffer as RDF/XML */
   if(grddl_parser->process_this_as_rdfxml && buffer) {
     RAPTOR_DEBUG3("Parser %p: Running additional RDF/XML parse on root document URI '%s' content\n",
@@ -2050,6 +2591,13 @@ raptor_terminate_parser_grddl_common(raptor_world *world)
     world->xslt_security_preferences = NULL;
   }
 
+  while(world->grddl_xslt_cache) {
+    raptor_grddl_xslt_cache_entry* entry = world->grddl_xslt_cache;
+
+    world->grddl_xslt_cache = entry->next;
+    raptor_grddl_xslt_cache_release(world, entry);
+  }
+
   xsltCleanupGlobals();
 }
 
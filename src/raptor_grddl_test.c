@@ -0,0 +1,349 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_grddl_test.c - Test the GRDDL XSLT stylesheet cache
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ * Usage: raptor_grddl_test
+ *
+ * Writes two XSLT stylesheets and a document using each in the
+ * current directory, then parses the documents with GRDDL parsers
+ * sharing one world whose stylesheet cache holds one stylesheet.
+ * Checks the statements found and the cache hits and misses for a
+ * repeated document, another document evicting the cached stylesheet
+ * and a second parser whose URI filter refuses the cached stylesheet.
+ *
+ * Then feeds XHTML documents using the second stylesheet to a parser
+ * in small chunks and checks the statements found, including one with
+ * markup errors after the head that are recovered as XML.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#define XSLT_TEMPLATE \
+"<?xml version=\"1.0\"?>\n" \
+"<xsl:stylesheet version=\"1.0\"\n" \
+"    xmlns:xsl=\"http://www.w3.org/1999/XSL/Transform\"\n" \
+"    xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\"\n" \
+"    xmlns:ex=\"http://example.org/terms#\">\n" \
+"  <xsl:template match=\"/\">\n" \
+"    <rdf:RDF>\n" \
+"      <rdf:Description rdf:about=\"http://example.org/%s\">\n" \
+"        <ex:name><xsl:value-of select=\"/*/@name\"/></ex:name>\n" \
+"      </rdf:Description>\n" \
+"    </rdf:RDF>\n" \
+"  </xsl:template>\n" \
+"</xsl:stylesheet>\n"
+
+#define DOCUMENT_TEMPLATE \
+"<?xml version=\"1.0\"?>\n" \
+"<doc xmlns:grddl=\"http://www.w3.org/2003/g/data-view#\"\n" \
+"     grddl:transformation=\"%s\" name=\"%s\"/>\n"
+
+#define XHTML_HEAD \
+"<?xml version=\"1.0\"?>\n" \
+"<html xmlns=\"http://www.w3.org/1999/xhtml\" name=\"chunked\">\n" \
+"  <head profile=\"http://www.w3.org/2003/g/data-view\">\n" \
+"    <title>Chunked</title>\n" \
+"    <link rel=\"transformation\" href=\"raptor_grddl_test-2.xsl\"/>\n" \
+"  </head>\n" \
+"  <body>\n"
+
+#define XHTML_PARAGRAPH "    <p>Paragraph</p>\n"
+
+/* not well-formed XML */
+#define XHTML_BAD_PARAGRAPH "    <p>Line<br>break</p>\n"
+
+#define XHTML_TAIL \
+"  </body>\n" \
+"</html>\n"
+
+#define XHTML_PARAGRAPHS_COUNT 200
+
+#define XHTML_CHUNK_SIZE 64
+
+static const char* const sheet_files[2] = {
+  "raptor_grddl_test-1.xsl", "raptor_grddl_test-2.xsl"
+};
+
+static const char* const document_files[2] = {
+  "raptor_grddl_test-1.xml", "raptor_grddl_test-2.xml"
+};
+
+
+static int
+write_test_file(const char* program, const char* filename,
+                const char* format, const char* arg1, const char* arg2)
+{
+  FILE* fh;
+
+  fh = fopen(filename, "w");
+  if(!fh) {
+    fprintf(stderr, "%s: Cannot write %s\n", program, filename);
+    return 1;
+  }
+  fprintf(fh, format, arg1, arg2);
+  fclose(fh);
+
+  return 0;
+}
+
+
+static void
+count_statements(void* user_data, raptor_statement* statement)
+{
+  (*(int*)user_data)++;
+}
+
+
+/* URI filter refusing the first stylesheet */
+static int
+refuse_first_sheet(void* user_data, raptor_uri* uri)
+{
+  const char* uri_string = (const char*)raptor_uri_as_string(uri);
+  size_t len = strlen(uri_string);
+  size_t sheet_len = strlen(sheet_files[0]);
+
+  return (len >= sheet_len &&
+          !strcmp(uri_string + len - sheet_len, sheet_files[0]));
+}
+
+
+/* Parse a document and return the number of statements or <0 */
+static int
+parse_document(raptor_parser* parser, int document)
+{
+  unsigned char* uri_string;
+  raptor_uri* uri;
+  int count = 0;
+  int rc;
+
+  uri_string = raptor_uri_filename_to_uri_string(document_files[document]);
+  if(!uri_string)
+    return -1;
+  uri = raptor_new_uri(raptor_parser_get_world(parser), uri_string);
+  raptor_free_memory(uri_string);
+  if(!uri)
+    return -1;
+
+  raptor_parser_set_statement_handler(parser, &count, count_statements);
+  rc = raptor_parser_parse_uri(parser, uri, NULL);
+  raptor_free_uri(uri);
+
+  return rc ? -1 : count;
+}
+
+
+/* Parse an XHTML document in chunks with a new parser and return the
+ * number of statements or <0 */
+static int
+parse_xhtml_chunks(raptor_world* world, int bad)
+{
+  raptor_parser* parser;
+  raptor_stringbuffer* sb;
+  const unsigned char* content;
+  size_t content_len;
+  size_t offset;
+  unsigned char* uri_string;
+  raptor_uri* base_uri;
+  int count = 0;
+  int rc;
+  int i;
+
+  sb = raptor_new_stringbuffer();
+  if(!sb)
+    return -1;
+  raptor_stringbuffer_append_string(sb, (const unsigned char*)XHTML_HEAD, 1);
+  for(i = 0; i < XHTML_PARAGRAPHS_COUNT; i++) {
+    const char* p = (bad && i == XHTML_PARAGRAPHS_COUNT / 2) ?
+      XHTML_BAD_PARAGRAPH : XHTML_PARAGRAPH;
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)p, 1);
+  }
+  raptor_stringbuffer_append_string(sb, (const unsigned char*)XHTML_TAIL, 1);
+  content = raptor_stringbuffer_as_string(sb);
+  content_len = raptor_stringbuffer_length(sb);
+
+  uri_string = raptor_uri_filename_to_uri_string("raptor_grddl_test-3.html");
+  if(!uri_string) {
+    raptor_free_stringbuffer(sb);
+    return -1;
+  }
+  base_uri = raptor_new_uri(world, uri_string);
+  raptor_free_memory(uri_string);
+  if(!base_uri) {
+    raptor_free_stringbuffer(sb);
+    return -1;
+  }
+
+  parser = raptor_new_parser(world, "grddl");
+  if(!parser) {
+    raptor_free_uri(base_uri);
+    raptor_free_stringbuffer(sb);
+    return -1;
+  }
+  raptor_parser_set_option(parser, RAPTOR_OPTION_NO_NET, NULL, 1);
+
+  raptor_parser_set_statement_handler(parser, &count, count_statements);
+  rc = raptor_parser_parse_start(parser, base_uri);
+  for(offset = 0; !rc && offset < content_len; offset += XHTML_CHUNK_SIZE) {
+    size_t len = content_len - offset;
+
+    if(len > XHTML_CHUNK_SIZE)
+      len = XHTML_CHUNK_SIZE;
+    rc = raptor_parser_parse_chunk(parser, content + offset, len, 0);
+  }
+  if(!rc)
+    rc = raptor_parser_parse_chunk(parser, NULL, 0, 1);
+
+  raptor_free_parser(parser);
+  raptor_free_uri(base_uri);
+  raptor_free_stringbuffer(sb);
+
+  return rc ? -1 : count;
+}
+
+
+static void
+ignore_log(void* user_data, raptor_log_message* message)
+{
+}
+
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+typedef struct {
+  const char* label;
+  /* 0 for the first parser, 1 for the one with the URI filter */
+  int parser;
+  int document;
+  int expected_statements;
+  int expected_hits;
+  int expected_misses;
+} grddl_step;
+
+static const grddl_step grddl_steps[] = {
+  { "first document", 0, 0, 1, 0, 1 },
+  { "first document again", 0, 0, 1, 1, 1 },
+  { "second document evicting the first stylesheet", 0, 1, 1, 1, 2 },
+  { "first document after eviction", 0, 0, 1, 1, 3 },
+  /* the cached stylesheet is not used and the refused fetch gives
+   * no statements */
+  { "first document with the filter", 1, 0, 0, 1, 3 },
+  { "second document with the filter", 1, 1, 1, 1, 4 },
+  { NULL, 0, 0, 0, 0, 0 }
+};
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_world* world;
+  raptor_parser* parsers[2];
+  const grddl_step* step;
+  int failures = 0;
+  int i;
+
+  for(i = 0; i < 2; i++) {
+    if(write_test_file(program, sheet_files[i], XSLT_TEMPLATE,
+                       document_files[i], NULL) ||
+       write_test_file(program, document_files[i], DOCUMENT_TEMPLATE,
+                       sheet_files[i], document_files[i]))
+      exit(1);
+  }
+
+  world = raptor_new_world();
+  if(!world ||
+     raptor_world_set_flag(world, RAPTOR_WORLD_FLAG_GRDDL_XSLT_CACHE_SIZE, 1) ||
+     raptor_world_open(world)) {
+    fprintf(stderr, "%s: Failed to create world\n", program);
+    exit(1);
+  }
+  raptor_world_set_log_handler(world, NULL, ignore_log);
+
+  for(i = 0; i < 2; i++) {
+    parsers[i] = raptor_new_parser(world, "grddl");
+    if(!parsers[i]) {
+      fprintf(stderr, "%s: Failed to create GRDDL parser\n", program);
+      exit(1);
+    }
+    /* only local files are used */
+    raptor_parser_set_option(parsers[i], RAPTOR_OPTION_NO_NET, NULL, 1);
+  }
+  raptor_parser_set_uri_filter(parsers[1], refuse_first_sheet, NULL);
+
+  for(step = grddl_steps; step->label; step++) {
+    int count;
+    int hits = -1;
+    int misses = -1;
+
+    count = parse_document(parsers[step->parser], step->document);
+    raptor_world_get_grddl_xslt_cache_stats(world, &hits, &misses);
+
+    if(count != step->expected_statements) {
+      fprintf(stderr, "%s: %s returned %d statements, expected %d\n",
+              program, step->label, count, step->expected_statements);
+      failures++;
+    }
+    if(hits != step->expected_hits || misses != step->expected_misses) {
+      fprintf(stderr,
+              "%s: %s gave %d cache hits and %d misses, expected %d and %d\n",
+              program, step->label, hits, misses,
+              step->expected_hits, step->expected_misses);
+      failures++;
+    }
+  }
+
+  for(i = 0; i < 2; i++) {
+    const char* label = i ? "chunked XHTML with markup errors" :
+      "chunked XHTML";
+    int count;
+
+    count = parse_xhtml_chunks(world, i);
+    if(count != 1) {
+      fprintf(stderr, "%s: %s returned %d statements, expected 1\n",
+              program, label, count);
+      failures++;
+    }
+  }
+
+  for(i = 0; i < 2; i++)
+    raptor_free_parser(parsers[i]);
+  raptor_free_world(world);
+
+  for(i = 0; i < 2; i++) {
+    remove(sheet_files[i]);
+    remove(document_files[i]);
+  }
+
+  return failures;
+}
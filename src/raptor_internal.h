@@ -81,6 +81,27 @@ void raptor_sign_free(void *ptr);
 #define __FUNCTION__ "???"
 #endif
 
+/* POSIX threads are used by the parallel line-based parsers */
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#define RAPTOR_THREADS 1
+#endif
+
+/* Atomic integer update returning the new value; used for shared
+ * counters when RAPTOR_WORLD_FLAG_CONCURRENT is set.  Concurrent
+ * worlds are not available without them.
+ */
+#if defined(RAPTOR_THREADS) && defined(__ATOMIC_SEQ_CST)
+#define RAPTOR_ATOMICS 1
+#define RAPTOR_ATOMIC_GET(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define RAPTOR_ATOMIC_ADD(ptr, n) __atomic_add_fetch((ptr), (n), __ATOMIC_SEQ_CST)
+#define RAPTOR_ATOMIC_CAS(ptr, oldv, newv) __sync_bool_compare_and_swap((ptr), (oldv), (newv))
+#else
+#define RAPTOR_ATOMIC_GET(ptr) (*(ptr))
+#define RAPTOR_ATOMIC_ADD(ptr, n) (*(ptr) += (n))
+#define RAPTOR_ATOMIC_CAS(ptr, oldv, newv) (*(ptr) == (oldv) ? (*(ptr) = (newv), 1) : 0)
+#endif
+
 #ifndef RAPTOR_DEBUG_FH
 #define RAPTOR_DEBUG_FH stderr
 #endif
@@ -224,7 +245,10 @@ extern void raptor_libxml_update_document_locator(raptor_sax2* sax2, raptor_loca
 typedef struct raptor_parser_factory_s raptor_parser_factory;
 typedef struct raptor_serializer_factory_s raptor_serializer_factory;
 typedef struct raptor_id_set_s raptor_id_set;
+typedef struct raptor_bloom_s raptor_bloom;
 typedef struct raptor_uri_detail_s raptor_uri_detail;
+typedef struct raptor_uri_resolver_s raptor_uri_resolver;
+typedef struct raptor_uri_relativiser_s raptor_uri_relativiser;
 
 
 /* raptor_option.c */
@@ -481,6 +505,9 @@ raptor_namespace** raptor_namespace_stack_to_array(raptor_namespace_stack *nstac
 #define RAPTOR_READ_BUFFER_SIZE 4096
 #endif
 
+/* Size of windows passed to the parser from a memory mapped file */
+#define RAPTOR_MMAP_WINDOW_SIZE (1024 * 1024)
+
 
 /*
  * Raptor parser object
@@ -525,6 +552,40 @@ struct raptor_parser_s {
   /* parser callbacks */
   raptor_statement_handler statement_handler;
 
+  /* batched statement delivery; when set, user_data points at this
+   * parser and statement_handler at raptor_parser_batch_statement_handler
+   * with the user's pointer kept in statement_batch_user_data
+   */
+  raptor_statement_batch_handler statement_batch_handler;
+  void* statement_batch_user_data;
+  raptor_statement* statement_batch;
+  int statement_batch_size;
+  int statement_batch_count;
+
+  /* serializer that the parser writes statements to directly instead
+   * of calling statement_handler (or NULL) and how many were written
+   */
+  raptor_serializer* serializer;
+  int serialized_count;
+
+  /* cached parsed base URI for resolving relative references
+   * (created on first use by raptor_parser_new_uri_relative_to_base)
+   */
+  raptor_uri_resolver* uri_resolver;
+
+  /* duplicate statement filter; when active, user_data points at this
+   * parser and statement_handler at raptor_parser_unique_statement_handler
+   * with the previous handler and user data kept in unique_user_data.
+   * Statements seen are held in unique_set (up to unique_set_limit of
+   * them) or only as bits in the Bloom filter unique_filter.
+   */
+  raptor_statement_handler unique_statement_handler;
+  void* unique_user_data;
+  raptor_statement_set* unique_set;
+  int unique_set_limit;
+  raptor_bloom* unique_filter;
+  int duplicate_count;
+
   raptor_graph_mark_handler graph_mark_handler;
 
   void* uri_filter_user_data;
@@ -550,6 +611,10 @@ struct raptor_parser_s {
 
   /* internal read buffer */
   unsigned char buffer[RAPTOR_READ_BUFFER_SIZE + 1];
+
+  /* larger read buffer when RAPTOR_OPTION_READ_BUFFER_SIZE is set */
+  unsigned char* large_buffer;
+  size_t large_buffer_size;
 };
 
 
@@ -605,6 +670,11 @@ struct raptor_parser_factory_s {
 
   /* get the locator (OPTIONAL) */
   raptor_locator* (*get_locator)(raptor_parser* rdf_parser);
+
+  /* check if statements can be written straight to a serializer
+   * (OPTIONAL) - return 0 if so, >0 if not supported for the serializer
+   */
+  int (*set_serializer)(raptor_parser* rdf_parser, raptor_serializer* serializer);
 };
 
 
@@ -636,6 +706,11 @@ struct raptor_serializer_s {
 
   /* Options (per-object) */
   raptor_object_options options;
+
+  /* relativiser bound to base_uri; created on first use by
+   * raptor_serializer_uri_to_relative_string()
+   */
+  raptor_uri_relativiser* relativiser;
 };
 
 
@@ -695,6 +770,7 @@ typedef struct
 
 /* raptor_serialize.c */
 raptor_serializer_factory* raptor_serializer_register_factory(raptor_world* world, int (*factory) (raptor_serializer_factory*));
+const unsigned char* raptor_serializer_uri_to_relative_string(raptor_serializer* serializer, raptor_uri* uri, size_t* length_p);
 
 
 /* raptor_general.c */
@@ -710,8 +786,96 @@ void raptor_stats_print(raptor_parser *rdf_parser, FILE *stream);
 RAPTOR_INTERNAL_API const char* raptor_basename(const char *name);
 int raptor_term_print_as_ntriples(const raptor_term *term, FILE* stream);
 
+/* raptor_arena.c */
+typedef struct raptor_arena_s raptor_arena;
+
+RAPTOR_INTERNAL_API raptor_arena* raptor_new_arena(size_t block_size);
+RAPTOR_INTERNAL_API void raptor_free_arena(raptor_arena* arena);
+RAPTOR_INTERNAL_API void* raptor_arena_alloc(raptor_arena* arena, size_t size);
+RAPTOR_INTERNAL_API unsigned char* raptor_arena_strndup(raptor_arena* arena, const unsigned char* string, size_t length);
+RAPTOR_INTERNAL_API void raptor_arena_reset(raptor_arena* arena);
+
+/* raptor_bloom.c */
+RAPTOR_INTERNAL_API raptor_bloom* raptor_new_bloom(size_t size);
+RAPTOR_INTERNAL_API void raptor_free_bloom(raptor_bloom* bloom);
+RAPTOR_INTERNAL_API int raptor_bloom_add(raptor_bloom* bloom, unsigned int hash1, unsigned int hash2);
+
+/* raptor_scan.c */
+
+/* classes of delimiter bytes a span scan stops at */
+#define RAPTOR_SCAN_BACKSLASH 0x01
+#define RAPTOR_SCAN_LT        0x02
+#define RAPTOR_SCAN_GT        0x04
+#define RAPTOR_SCAN_DQUOTE    0x08
+#define RAPTOR_SCAN_SQUOTE    0x10
+/* CR and LF */
+#define RAPTOR_SCAN_NEWLINE   0x20
+#define RAPTOR_SCAN_SPACE     0x40
+/* any byte with the top bit set */
+#define RAPTOR_SCAN_HIGH      0x80
+
+typedef enum {
+  RAPTOR_SCAN_IMPL_SCALAR,
+  RAPTOR_SCAN_IMPL_SSE2,
+  RAPTOR_SCAN_IMPL_AVX2,
+  RAPTOR_SCAN_IMPL_BEST
+} raptor_scan_impl;
+
+typedef size_t (*raptor_scan_span_function)(const unsigned char* s, size_t len, int classes);
+
+RAPTOR_INTERNAL_API extern const unsigned char raptor_scan_byte_classes[256];
+
+/* non-0 if byte @c is in one of @classes */
+#define RAPTOR_SCAN_BYTE_IN(c, classes) (raptor_scan_byte_classes[(unsigned char)(c)] & (classes))
+
+RAPTOR_INTERNAL_API raptor_scan_span_function raptor_scan_get_span_function(raptor_scan_impl impl);
+
+/* raptor_spill.c */
+typedef struct raptor_spill_s raptor_spill;
+
+/* statement carries a serializer's node type rather than a property */
+#define RAPTOR_SPILL_FLAG_NODE_TYPE 1
+
+RAPTOR_INTERNAL_API raptor_spill* raptor_new_spill(raptor_world* world);
+RAPTOR_INTERNAL_API void raptor_free_spill(raptor_spill* spill);
+RAPTOR_INTERNAL_API int raptor_spill_get_runs_count(raptor_spill* spill);
+RAPTOR_INTERNAL_API int raptor_spill_start_run(raptor_spill* spill);
+RAPTOR_INTERNAL_API int raptor_spill_write(raptor_spill* spill, raptor_statement* statement, int flags);
+RAPTOR_INTERNAL_API int raptor_spill_end_run(raptor_spill* spill);
+RAPTOR_INTERNAL_API int raptor_spill_merge_start(raptor_spill* spill);
+RAPTOR_INTERNAL_API raptor_statement* raptor_spill_merge_get(raptor_spill* spill, int* flags_p, int* run_p);
+RAPTOR_INTERNAL_API int raptor_spill_merge_next(raptor_spill* spill);
+size_t raptor_spill_statement_size(raptor_statement* statement);
+
+/* raptor_term.c */
+
+/* usage of a term allocated in an arena: not reference counted */
+#define RAPTOR_TERM_USAGE_ARENA -1
+
+raptor_term* raptor_new_term_from_uri_in_arena(raptor_arena* arena, raptor_world* world, raptor_uri* uri);
+raptor_term* raptor_new_term_from_counted_literal_in_arena(raptor_arena* arena, raptor_world* world, const unsigned char* literal, size_t literal_len, raptor_uri* datatype, const unsigned char* language, unsigned char language_len);
+raptor_term* raptor_new_term_from_counted_blank_in_arena(raptor_arena* arena, raptor_world* world, const unsigned char* blank, size_t length);
+
 /* raptor_ntriples.c */
-size_t raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator, unsigned char *string, size_t *len_p, raptor_term** term_p, int allow_turtle);
+
+/* An N-Triples term as lexed by raptor_ntriples_lex_term(): the
+ * strings are unescaped in place in the input and NUL terminated */
+typedef struct {
+  raptor_term_type type;
+  /* URI, literal value or blank node ID */
+  unsigned char* string;
+  size_t string_len;
+  /* literal language (or NULL) */
+  unsigned char* language;
+  unsigned char language_len;
+  /* literal datatype URI (or NULL) */
+  unsigned char* datatype;
+  size_t datatype_len;
+} raptor_ntriples_token;
+
+size_t raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator, unsigned char *string, size_t *len_p, raptor_term** term_p, int allow_turtle, raptor_arena* arena);
+size_t raptor_ntriples_lex_term(raptor_world* world, raptor_locator* locator, unsigned char *string, size_t *len_p, raptor_ntriples_token* token);
+raptor_term* raptor_ntriples_token_to_term(raptor_world* world, raptor_locator* locator, raptor_ntriples_token* token, raptor_arena* arena);
 
 /* raptor_parse.c */
 raptor_parser_factory* raptor_world_get_parser_factory(raptor_world* world, const char *name);  
@@ -812,10 +976,19 @@ void raptor_qname_print(FILE *stream, raptor_qname* name);
 
 /* raptor_uri.c */
 
+typedef struct raptor_uri_table_s raptor_uri_table;
+
 int raptor_uri_init(raptor_world* world);
 void raptor_uri_finish(raptor_world* world);
 raptor_uri* raptor_new_uri_from_rdf_ordinal(raptor_world* world, int ordinal);
 size_t raptor_uri_normalize_path(unsigned char* path_buffer, size_t path_len);
+unsigned int raptor_uri_get_hash(raptor_uri* uri);
+RAPTOR_INTERNAL_API raptor_uri_relativiser* raptor_new_uri_relativiser(raptor_uri* base_uri);
+RAPTOR_INTERNAL_API void raptor_free_uri_relativiser(raptor_uri_relativiser* rel);
+raptor_uri* raptor_uri_relativiser_get_base(raptor_uri_relativiser* rel);
+int raptor_uri_relativiser_set_base(raptor_uri_relativiser* rel, raptor_uri* base_uri);
+RAPTOR_INTERNAL_API const unsigned char* raptor_uri_relativiser_relativise(raptor_uri_relativiser* rel, raptor_uri* reference_uri, size_t* length_p);
+int raptor_uri_relativiser_escaped_write(raptor_uri_relativiser* rel, raptor_uri* uri, unsigned int flags, raptor_iostream *iostr);
 
 /* parsers */
 int raptor_init_parser_rdfxml(raptor_world* world);
@@ -833,6 +1006,9 @@ int raptor_init_parser_nquads(raptor_world* world);
 
 void raptor_terminate_parser_grddl_common(raptor_world *world);
 
+/* default for RAPTOR_WORLD_FLAG_GRDDL_XSLT_CACHE_SIZE */
+#define RAPTOR_GRDDL_XSLT_CACHE_DEFAULT_SIZE 16
+
 #ifdef RAPTOR_PARSER_RDFA
 #define rdfa_add_item raptor_librdfa_rdfa_add_item
 #define rdfa_append_to_list_mapping raptor_librdfa_rdfa_append_to_list_mapping
@@ -911,6 +1087,11 @@ void raptor_parser_save_content(raptor_parser* rdf_parser, int save);
 const unsigned char* raptor_parser_get_content(raptor_parser* rdf_parser, size_t* length_p);
 void raptor_parser_start_graph(raptor_parser* parser, raptor_uri* uri, int is_declared);
 void raptor_parser_end_graph(raptor_parser* parser, raptor_uri* uri, int is_declared);
+void raptor_parser_flush_statement_batch(raptor_parser* parser);
+raptor_uri* raptor_parser_new_uri_relative_to_base(raptor_parser* parser, raptor_uri* base_uri, const unsigned char* uri_string, size_t uri_len);
+
+/* default number of statements per raptor_statement_batch_handler call */
+#define RAPTOR_STATEMENT_BATCH_DEFAULT_SIZE 256
 
 /* raptor_rss.c */
 int raptor_init_serializer_rss10(raptor_world* world);
@@ -922,6 +1103,10 @@ extern const unsigned char * const raptor_atom_namespace_uri;
 RAPTOR_INTERNAL_API raptor_uri_detail* raptor_new_uri_detail(const unsigned char *uri_string);
 RAPTOR_INTERNAL_API void raptor_free_uri_detail(raptor_uri_detail* uri_detail);
 unsigned char* raptor_uri_detail_to_string(raptor_uri_detail *ud, size_t* len_p);
+int raptor_uri_reference_is_normalized_absolute(const unsigned char *uri_string, size_t uri_len);
+RAPTOR_INTERNAL_API raptor_uri_resolver* raptor_new_uri_resolver(raptor_world* world);
+RAPTOR_INTERNAL_API void raptor_free_uri_resolver(raptor_uri_resolver* resolver);
+RAPTOR_INTERNAL_API raptor_uri* raptor_uri_resolver_resolve(raptor_uri_resolver* resolver, raptor_uri* base_uri, const unsigned char *uri_string, size_t uri_len);
 
 /* serializers */
 /* raptor_serializer.c */
@@ -934,6 +1119,8 @@ int raptor_init_serializer_dot(raptor_world* world);
 /* raptor_serializer_ntriples.c */
 int raptor_init_serializer_ntriples(raptor_world* world);
 int raptor_init_serializer_nquads(raptor_world* world);
+int raptor_serializer_is_ntriples(raptor_serializer* serializer);
+int raptor_ntriples_serialize_tokens(raptor_serializer* serializer, const raptor_ntriples_token* tokens);
 
 /* raptor_serialize_rdfxml.c */  
 int raptor_init_serializer_rdfxml(raptor_world* world);
@@ -1052,7 +1239,7 @@ void raptor_www_libfetch_free(raptor_www *www);
 int raptor_www_libfetch_fetch(raptor_www *www);
 
 /* raptor_set.c */
-RAPTOR_INTERNAL_API raptor_id_set* raptor_new_id_set(raptor_world* world);
+RAPTOR_INTERNAL_API raptor_id_set* raptor_new_id_set(raptor_world* world, size_t filter_size);
 RAPTOR_INTERNAL_API void raptor_free_id_set(raptor_id_set* set);
 RAPTOR_INTERNAL_API int raptor_id_set_add(raptor_id_set* set, raptor_uri* base_uri, const unsigned char *item, size_t item_len);
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
@@ -1247,6 +1434,7 @@ typedef void (*raptor_simple_message_handler)(void *user_data, const char *messa
 
 
 /* turtle_common.c */
+RAPTOR_INTERNAL_API int raptor_turtle_unescape_string(const unsigned char *text, size_t len, int delim, raptor_simple_message_handler error_handler, void *error_data, int is_uri, unsigned char *string, size_t *string_len_p);
 RAPTOR_INTERNAL_API int raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer, const unsigned char *text, size_t len, int delim, raptor_simple_message_handler error_handler, void *error_data, int is_uri);
 
 
@@ -1295,6 +1483,7 @@ int raptor_abbrev_node_compare(raptor_abbrev_node* node1, raptor_abbrev_node* no
 int raptor_abbrev_node_equals(raptor_abbrev_node* node1, raptor_abbrev_node* node2);
 raptor_abbrev_node* raptor_abbrev_node_lookup(raptor_avltree* nodes, raptor_term* term);
 
+raptor_abbrev_subject* raptor_new_abbrev_subject(raptor_abbrev_node* node);
 void raptor_free_abbrev_subject(raptor_abbrev_subject* subject);
 int raptor_abbrev_subject_add_property(raptor_abbrev_subject* subject, raptor_abbrev_node* predicate, raptor_abbrev_node* object);
 int raptor_abbrev_subject_compare(raptor_abbrev_subject* subject1, raptor_abbrev_subject* subject2);
@@ -1302,6 +1491,8 @@ raptor_abbrev_subject* raptor_abbrev_subject_find(raptor_avltree *subjects, rapt
 raptor_abbrev_subject* raptor_abbrev_subject_lookup(raptor_avltree* nodes, raptor_avltree* subjects, raptor_avltree* blanks, raptor_term* term);
 int raptor_abbrev_subject_valid(raptor_abbrev_subject *subject);
 int raptor_abbrev_subject_invalidate(raptor_abbrev_subject *subject);
+int raptor_abbrev_subjects_spill(raptor_avltree* subjects, raptor_abbrev_node* rdf_type, raptor_spill* spill);
+raptor_abbrev_subject* raptor_abbrev_subject_read_spill(raptor_spill* spill, raptor_avltree* nodes);
 
 
 /* avltree */
@@ -1452,6 +1643,14 @@ struct raptor_world_s {
    */
   int xslt_security_preferences_policy;
 
+  /* Compiled GRDDL XSLT stylesheets, most recently used first, at
+   * most grddl_xslt_cache_size of them.  See raptor_grddl.c
+   */
+  struct raptor_grddl_xslt_cache_entry_s* grddl_xslt_cache;
+  int grddl_xslt_cache_size;
+  int grddl_xslt_cache_hits;
+  int grddl_xslt_cache_misses;
+
   /* Flags for libxml set by raptor_world_set_libxml_flags().
    * See #raptor_libxml_flags for meanings 
    */
@@ -1467,6 +1666,27 @@ struct raptor_world_s {
 
   raptor_avltree *uris_tree;
 
+  /* interned URIs when RAPTOR_WORLD_FLAG_URI_INTERNING_HASH is set
+   * (used instead of uris_tree): an array of uris_tables_count tables,
+   * more than one only for a concurrent world
+   */
+  raptor_uri_table *uris_table;
+  int uris_tables_count;
+
+#ifdef RAPTOR_THREADS
+  /* number of parser worker threads running against this world.
+   * While non-0, or if the world is concurrent, the mutexes below
+   * guard URI interning, logging and the GRDDL XSLT cache.
+   */
+  int threads_active;
+  pthread_mutex_t uris_mutex;
+  pthread_mutex_t log_mutex;
+  pthread_mutex_t grddl_mutex;
+#endif
+
+  /* delimiter scanner for the running CPU */
+  raptor_scan_span_function scan_span;
+
   raptor_uri* concepts[RDF_NS_LAST + 1];
 
   raptor_term* terms[RDF_NS_LAST + 1];
@@ -1477,6 +1697,14 @@ struct raptor_world_s {
   /* should */
   int uri_interning;
 
+  /* intern URIs in a hash table rather than an AVL tree */
+  int uri_interning_hash;
+
+  /* non-0 if the world may be used from several threads at once:
+   * see RAPTOR_WORLD_FLAG_CONCURRENT
+   */
+  int concurrent;
+
   /* generate blank node ID policy */
   void *generate_bnodeid_handler_user_data;
   raptor_generate_bnodeid_handler generate_bnodeid_handler;
@@ -1492,6 +1720,24 @@ struct raptor_world_s {
   raptor_uri* xsd_integer_uri;
 };
 
+/* Lock a world mutex only while parser worker threads are running
+ * or when the world is shared between threads
+ */
+#ifdef RAPTOR_THREADS
+#define RAPTOR_WORLD_LOCKING(world) (RAPTOR_ATOMIC_GET(&(world)->threads_active) || (world)->concurrent)
+#define RAPTOR_WORLD_LOCK(world, mutex) do { \
+  if(RAPTOR_WORLD_LOCKING(world)) \
+    pthread_mutex_lock(&(world)->mutex); \
+} while(0)
+#define RAPTOR_WORLD_UNLOCK(world, mutex) do { \
+  if(RAPTOR_WORLD_LOCKING(world)) \
+    pthread_mutex_unlock(&(world)->mutex); \
+} while(0)
+#else
+#define RAPTOR_WORLD_LOCK(world, mutex) do { } while(0)
+#define RAPTOR_WORLD_UNLOCK(world, mutex) do { } while(0)
+#endif
+
 /* raptor_www.c */
 int raptor_www_init(raptor_world* world);
 void raptor_www_finish(raptor_world* world);
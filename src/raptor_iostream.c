@@ -44,6 +44,10 @@
 #define RAPTOR_IOSTREAM_FLAGS_EOF           1
 #define RAPTOR_IOSTREAM_FLAGS_FREE_HANDLER  2
 
+/* Write buffer sizes for the iostreams that buffer output */
+#define RAPTOR_IOSTREAM_FILE_BUFFER_SIZE   16384
+#define RAPTOR_IOSTREAM_STRING_BUFFER_SIZE 1024
+
 struct raptor_iostream_s
 {
   raptor_world *world;
@@ -53,11 +57,37 @@ struct raptor_iostream_s
   size_t offset;
   unsigned int mode;
   int flags;
+
+  /* write buffer or NULL if writes go straight to the handler.
+   * Only used with handlers that have write_bytes.
+   */
+  unsigned char *buffer;
+  size_t buffer_size;
+  size_t buffer_length;
 };
 
 
 
 /* prototypes for local functions */
+static int raptor_iostream_flush_buffer(raptor_iostream* iostr);
+
+
+/*
+ * raptor_iostream_init_buffer:
+ * @iostr: write iostream
+ * @size: buffer size
+ *
+ * INTERNAL - Make writes to the iostream go via a buffer of @size bytes
+ *
+ * If the buffer cannot be allocated, the iostream stays unbuffered.
+ */
+static void
+raptor_iostream_init_buffer(raptor_iostream* iostr, size_t size)
+{
+  iostr->buffer = RAPTOR_MALLOC(unsigned char*, size);
+  if(iostr->buffer)
+    iostr->buffer_size = size;
+}
 
 
 static int
@@ -304,6 +334,7 @@ raptor_new_iostream_to_filename(raptor_world *world, const char *filename)
   iostr->handler = handler;
   iostr->user_data = (void*)handle;
   iostr->mode = mode;
+  raptor_iostream_init_buffer(iostr, RAPTOR_IOSTREAM_FILE_BUFFER_SIZE);
 
   if(iostr->handler->init && 
      iostr->handler->init(iostr->user_data)) {
@@ -369,6 +400,7 @@ raptor_new_iostream_to_file_handle(raptor_world *world, FILE *handle)
     RAPTOR_FREE(raptor_iostream, iostr);
     return NULL;
   }
+
   return iostr;
 }
 
@@ -522,6 +554,7 @@ raptor_new_iostream_to_string(raptor_world *world,
   iostr->handler = handler;
   iostr->user_data = (void*)con;
   iostr->mode = mode;
+  raptor_iostream_init_buffer(iostr, RAPTOR_IOSTREAM_STRING_BUFFER_SIZE);
 
   if(iostr->handler->init && iostr->handler->init(iostr->user_data)) {
     raptor_free_iostream(iostr);
@@ -694,6 +727,11 @@ raptor_free_iostream(raptor_iostream *iostr)
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     raptor_iostream_write_end(iostr);
 
+  if(iostr->buffer) {
+    raptor_iostream_flush_buffer(iostr);
+    RAPTOR_FREE(char*, iostr->buffer);
+  }
+
   if(iostr->handler->finish)
     iostr->handler->finish(iostr->user_data);
 
@@ -719,6 +757,14 @@ raptor_iostream_write_byte(const int byte, raptor_iostream *iostr)
 {
   iostr->offset++;
 
+  if(iostr->buffer) {
+    if(iostr->buffer_length == iostr->buffer_size &&
+       raptor_iostream_flush_buffer(iostr))
+      return 1;
+    iostr->buffer[iostr->buffer_length++] = RAPTOR_GOOD_CAST(unsigned char, byte);
+    return 0;
+  }
+
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     return 1;
   if(!iostr->handler->write_byte)
@@ -746,6 +792,22 @@ raptor_iostream_write_bytes(const void *ptr, size_t size, size_t nmemb,
 {
   int nobj;
   
+  if(iostr->buffer) {
+    size_t len = size * nmemb;
+
+    if(len > iostr->buffer_size - iostr->buffer_length &&
+       raptor_iostream_flush_buffer(iostr))
+      return -1;
+
+    /* anything that does not fit in the buffer goes straight through */
+    if(len < iostr->buffer_size) {
+      memcpy(iostr->buffer + iostr->buffer_length, ptr, len);
+      iostr->buffer_length += len;
+      iostr->offset += len;
+      return RAPTOR_BAD_CAST(int, nmemb);
+    }
+  }
+
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     return -1;
   if(!iostr->handler->write_bytes)
@@ -832,14 +894,70 @@ raptor_iostream_write_end(raptor_iostream *iostr)
   
   if(iostr->flags & RAPTOR_IOSTREAM_FLAGS_EOF)
     return 1;
-  if(iostr->handler->write_end)
-    rc = iostr->handler->write_end(iostr->user_data);
+  if(iostr->buffer) {
+    rc = raptor_iostream_flush_buffer(iostr);
+    RAPTOR_FREE(char*, iostr->buffer);
+    iostr->buffer = NULL;
+  }
+  if(iostr->handler->write_end) {
+    int end_rc = iostr->handler->write_end(iostr->user_data);
+    if(end_rc)
+      rc = end_rc;
+  }
   iostr->flags |= RAPTOR_IOSTREAM_FLAGS_EOF;
 
   return rc;
 }
 
 
+/*
+ * raptor_iostream_flush_buffer:
+ * @iostr: raptor iostream with a write buffer
+ *
+ * INTERNAL - Pass the buffered bytes to the handler in one write
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_iostream_flush_buffer(raptor_iostream* iostr)
+{
+  size_t length = iostr->buffer_length;
+  int nobj;
+
+  if(!length)
+    return 0;
+
+  iostr->buffer_length = 0;
+  nobj = iostr->handler->write_bytes(iostr->user_data, iostr->buffer,
+                                     1, length);
+  return (RAPTOR_BAD_CAST(size_t, nobj) != length);
+}
+
+
+/**
+ * raptor_iostream_flush:
+ * @iostr: raptor iostream
+ *
+ * Pass any output buffered by the iostream on to its handler.
+ *
+ * Iostreams writing to a filename or a string collect writes in a
+ * buffer that is flushed when it is full, by raptor_iostream_write_end()
+ * and by raptor_free_iostream().  Other iostreams, including those
+ * writing to a FILE* handle, are not buffered.  This does not flush
+ * any buffering below the handler such as in a FILE*.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+raptor_iostream_flush(raptor_iostream *iostr)
+{
+  if(!iostr->buffer)
+    return 0;
+
+  return raptor_iostream_flush_buffer(iostr);
+}
+
+
 /**
  * raptor_stringbuffer_write:
  * @sb: #raptor_stringbuffer to write
@@ -926,21 +1044,26 @@ int
 raptor_iostream_hexadecimal_write(unsigned int integer, int width,
                                   raptor_iostream* iostr)
 {
-  char *buf;
+  /* enough for the widths used by escapes */
+  char small_buf[17];
+  char *buf = small_buf;
   int nobj;
 
   if(width < 1)
     return 1;
   
-  buf = RAPTOR_MALLOC(char*, width + 1);
-  if(!buf)
-    return 1;
+  if(RAPTOR_GOOD_CAST(size_t, width) >= sizeof(small_buf)) {
+    buf = RAPTOR_MALLOC(char*, width + 1);
+    if(!buf)
+      return 1;
+  }
   
   (void)raptor_format_integer(buf, width + 1, integer, /* base */ 16,
                               width, '0');
 
   nobj = raptor_iostream_write_bytes(buf, 1, width, iostr);
-  RAPTOR_FREE(char*, buf);
+  if(buf != small_buf)
+    RAPTOR_FREE(char*, buf);
   return (nobj != width);
 }
 
@@ -1246,6 +1369,14 @@ test_write_to_file_handle(raptor_world *world, FILE* handle,
     rc = 1;
   }
 
+  /* writes go straight to the handle, not via an iostream buffer */
+  count = (unsigned long)ftell(handle);
+  if(count != expected_bytes_count) {
+    fprintf(stderr, "%s: %s handle has %d bytes before free, expected %d\n",
+            program, label, (int)count, expected_bytes_count);
+    rc = 1;
+  }
+
   tidy:
   if(iostr)
     raptor_free_iostream(iostr);
@@ -51,6 +51,9 @@ struct raptor_json_writer_s {
   raptor_world* world;
 
   raptor_uri* base_uri;
+
+  /* relativiser bound to base_uri */
+  raptor_uri_relativiser* relativiser;
   
   /* outputting to this iostream */
   raptor_iostream *iostr;
@@ -90,6 +93,12 @@ raptor_new_json_writer(raptor_world* world,
   json_writer->iostr = iostr;
   json_writer->base_uri = base_uri;
 
+  json_writer->relativiser = raptor_new_uri_relativiser(base_uri);
+  if(!json_writer->relativiser) {
+    RAPTOR_FREE(raptor_json_writer, json_writer);
+    return NULL;
+  }
+
   json_writer->indent_step = 2;
   
   return json_writer;
@@ -108,6 +117,9 @@ raptor_free_json_writer(raptor_json_writer* json_writer)
 {
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN(json_writer, raptor_json_writer);
 
+  if(json_writer->relativiser)
+    raptor_free_uri_relativiser(json_writer->relativiser);
+
   RAPTOR_FREE(raptor_json_writer, json_writer);
 }
 
@@ -180,7 +192,9 @@ raptor_json_writer_key_uri_value(raptor_json_writer* json_writer,
   size_t value_len;
   int rc = 0;
   
-  value = (const char*)raptor_uri_to_relative_counted_uri_string(json_writer->base_uri, uri, &value_len);
+  /* shared string */
+  value = (const char*)raptor_uri_relativiser_relativise(json_writer->relativiser,
+                                                         uri, &value_len);
   if(!value)
     return 1;
 
@@ -189,8 +203,6 @@ raptor_json_writer_key_uri_value(raptor_json_writer* json_writer,
                                     value, value_len);
   else
     rc = raptor_json_writer_quoted(json_writer, value, value_len);
-  
-  RAPTOR_FREE(char*, value);
 
   return rc;
 }
@@ -133,6 +133,9 @@ raptor_log_error(raptor_world* world, raptor_log_level level,
     if(world->internal_ignore_errors)
       return;
 
+    /* world->message is shared by all parser worker threads */
+    RAPTOR_WORLD_LOCK(world, log_mutex);
+
     memset(&world->message, '\0', sizeof(world->message));
     world->message.code = -1;
     world->message.domain = RAPTOR_DOMAIN_NONE;
@@ -146,6 +149,7 @@ raptor_log_error(raptor_world* world, raptor_log_level level,
        * functions are called.
        */
       handler(world->message_handler_user_data, &world->message);
+      RAPTOR_WORLD_UNLOCK(world, log_mutex);
       return;
     }
   }
@@ -160,4 +164,7 @@ raptor_log_error(raptor_world* world, raptor_log_level level,
   fputs(" - ", stderr);
   fputs(text, stderr);
   fputc('\n', stderr);
+
+  if(world)
+    RAPTOR_WORLD_UNLOCK(world, log_mutex);
 }
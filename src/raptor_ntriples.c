@@ -146,11 +146,39 @@ raptor_ntriples_parse_term_internal(raptor_world* world,
   unsigned long unichar = 0;
   unsigned int position = 0;
   int end_char_seen = 0;
+  int scan_classes = 0;
+
+  /* bytes that need looking at one by one; runs of other bytes are
+   * copied as they are
+   */
+  if(term_class == RAPTOR_TERM_CLASS_URI)
+    scan_classes = RAPTOR_SCAN_BACKSLASH | RAPTOR_SCAN_GT |
+                   RAPTOR_SCAN_SPACE | RAPTOR_SCAN_HIGH;
+  else if(term_class == RAPTOR_TERM_CLASS_STRING)
+    scan_classes = RAPTOR_SCAN_BACKSLASH | RAPTOR_SCAN_DQUOTE |
+                   RAPTOR_SCAN_HIGH;
 
   /* find end of string, fixing backslashed characters on the way */
   while(*lenp > 0) {
     int unichar_width;
 
+    if(scan_classes && !RAPTOR_SCAN_BYTE_IN(*p, scan_classes)) {
+      size_t run = world->scan_span(p, *lenp, scan_classes);
+
+      memmove(dest, p, run);
+      dest += run;
+      p += run;
+      (*lenp) -= run;
+      if(locator) {
+        locator->column += RAPTOR_BAD_CAST(int, run);
+        locator->byte += RAPTOR_BAD_CAST(int, run);
+      }
+      position += RAPTOR_BAD_CAST(unsigned int, run);
+
+      if(!*lenp)
+        break;
+    }
+
     c = *p;
 
     p++;
@@ -212,7 +240,8 @@ raptor_ntriples_parse_term_internal(raptor_world* world,
             locator->column--;
             locator->byte--;
           }
-          if(term_class == RAPTOR_TERM_CLASS_BNODEID && dest[-1] == '.') {
+          if(term_class == RAPTOR_TERM_CLASS_BNODEID && position > 0 &&
+             dest[-1] == '.') {
             /* If bnode id ended on '.' move back one */
             dest--;
 
@@ -439,31 +468,36 @@ raptor_parse_turtle_term_internal(raptor_world* world,
 
 
 /*
- * raptor_ntriples_parse_term:
+ * raptor_ntriples_lex_term:
  * @world: raptor world
  * @locator: raptor locator (in/out) (or NULL)
  * @string: string input (in)
  * @len_p: pointer to length of @string (in/out)
- * @term_p: pointer to store term (out)
- * @allow_turtle: non-0 to allow Turtle forms such as integers, boolean
+ * @token: pointer to token to fill (out)
  *
- * INTERNAL - Parse an N-Triples string into a #raptor_term
+ * INTERNAL - Lex an N-Triples <URI>, "literal" or _:blank term
+ *
+ * The term is unescaped in place in @string and the @token fields
+ * point into it, so no #raptor_term or #raptor_uri is made.  On an
+ * error the @token type is left as %RAPTOR_TERM_TYPE_UNKNOWN.
  *
  * The @len_p destination and @locator fields are modified as parsing
- * proceeds to be used in error messages.  The final value is written
- * into the #raptor_term pointed at by @term_p
+ * proceeds to be used in error messages.
  *
  * Return value: number of bytes processed or 0 on failure
  */
 size_t
-raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
-                           unsigned char *string, size_t *len_p,
-                           raptor_term** term_p, int allow_turtle)
+raptor_ntriples_lex_term(raptor_world* world, raptor_locator* locator,
+                         unsigned char *string, size_t *len_p,
+                         raptor_ntriples_token* token)
 {
   unsigned char *p = string;
   unsigned char *dest;
   size_t term_length = 0;
 
+  memset(token, 0, sizeof(*token));
+  token->type = RAPTOR_TERM_TYPE_UNKNOWN;
+
   switch(*p) {
     case '<':
       dest = p;
@@ -483,8 +517,6 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
       }
 
       if(1) {
-        raptor_uri *uri;
-
         /* Check for bad ordinal predicate */
         if(!strncmp((const char*)dest,
                     "http://www.w3.org/1999/02/22-rdf-syntax-ns#_", 44)) {
@@ -497,49 +529,12 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
           goto fail;
         }
 
-        uri = raptor_new_uri(world, dest);
-        if(!uri) {
-          raptor_log_error_formatted(world, RAPTOR_LOG_LEVEL_ERROR, locator, "Could not create URI for '%s'", (const char *)dest);
-          goto fail;
-        }
-
-        *term_p = raptor_new_term_from_uri(world, uri);
-        raptor_free_uri(uri);
+        token->type = RAPTOR_TERM_TYPE_URI;
+        token->string = dest;
+        token->string_len = strlen((const char*)dest);
       }
       break;
 
-    case '-':
-    case '+':
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-      if(allow_turtle) {
-        raptor_uri* datatype_uri = NULL;
-
-        dest = p;
-
-        if(raptor_parse_turtle_term_internal(world, locator,
-                                             (const unsigned char**)&p,
-                                             dest, len_p, &term_length,
-                                             &datatype_uri)) {
-          goto fail;
-        }
-
-        *term_p = raptor_new_term_from_literal(world,
-                                               dest,
-                                               datatype_uri,
-                                               NULL /* language */);
-      } else
-        goto fail;
-      break;
-
     case '"':
       dest = p;
 
@@ -560,7 +555,6 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
       if(1) {
         unsigned char *object_literal_language = NULL;
         unsigned char *object_literal_datatype = NULL;
-        raptor_uri* datatype_uri = NULL;
 
         if(*len_p && *p == '@') {
           unsigned char *q;
@@ -649,20 +643,16 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
           object_literal_language = NULL;
         }
 
+        token->type = RAPTOR_TERM_TYPE_LITERAL;
+        token->string = dest;
+        token->string_len = strlen((const char*)dest);
         if(object_literal_datatype) {
-          datatype_uri = raptor_new_uri(world,
-                                        object_literal_datatype);
-          if(!datatype_uri) {
-            raptor_log_error_formatted(world, RAPTOR_LOG_LEVEL_ERROR, locator, "Could not create literal datatype uri '%s'", object_literal_datatype);
-            goto fail;
-          }
-          object_literal_language = NULL;
+          token->datatype = object_literal_datatype;
+          token->datatype_len = strlen((const char*)object_literal_datatype);
+        } else if(object_literal_language) {
+          token->language = object_literal_language;
+          token->language_len = RAPTOR_BAD_CAST(unsigned char, strlen((const char*)object_literal_language));
         }
-
-        *term_p = raptor_new_term_from_literal(world,
-                                               dest,
-                                               datatype_uri,
-                                               object_literal_language);
       }
 
       break;
@@ -706,7 +696,9 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
           goto fail;
         }
 
-        *term_p = raptor_new_term_from_blank(world, dest);
+        token->type = RAPTOR_TERM_TYPE_BLANK;
+        token->string = dest;
+        token->string_len = strlen((const char*)dest);
 
         break;
 
@@ -719,3 +711,147 @@ raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
 
   return p - string;
 }
+
+
+/*
+ * raptor_ntriples_token_to_term:
+ * @world: raptor world
+ * @locator: raptor locator (or NULL)
+ * @token: lexed term
+ * @arena: arena to allocate the term from (or NULL)
+ *
+ * INTERNAL - Make a #raptor_term from a token made by raptor_ntriples_lex_term()
+ *
+ * Return value: new term or NULL on failure
+ */
+raptor_term*
+raptor_ntriples_token_to_term(raptor_world* world, raptor_locator* locator,
+                              raptor_ntriples_token* token,
+                              raptor_arena* arena)
+{
+  raptor_term* term = NULL;
+  raptor_uri* uri;
+
+  switch(token->type) {
+    case RAPTOR_TERM_TYPE_URI:
+      uri = raptor_new_uri(world, token->string);
+      if(!uri) {
+        raptor_log_error_formatted(world, RAPTOR_LOG_LEVEL_ERROR, locator, "Could not create URI for '%s'", (const char *)token->string);
+        break;
+      }
+
+      term = raptor_new_term_from_uri_in_arena(arena, world, uri);
+      raptor_free_uri(uri);
+      break;
+
+    case RAPTOR_TERM_TYPE_LITERAL:
+      uri = NULL;
+      if(token->datatype) {
+        uri = raptor_new_uri(world, token->datatype);
+        if(!uri) {
+          raptor_log_error_formatted(world, RAPTOR_LOG_LEVEL_ERROR, locator, "Could not create literal datatype uri '%s'", token->datatype);
+          break;
+        }
+      }
+
+      term = raptor_new_term_from_counted_literal_in_arena(arena, world,
+                                                           token->string,
+                                                           token->string_len,
+                                                           uri,
+                                                           token->language,
+                                                           token->language_len);
+      if(uri)
+        raptor_free_uri(uri);
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      term = raptor_new_term_from_counted_blank_in_arena(arena, world,
+                                                         token->string,
+                                                         token->string_len);
+      break;
+
+    case RAPTOR_TERM_TYPE_UNKNOWN:
+    default:
+      break;
+  }
+
+  return term;
+}
+
+
+/*
+ * raptor_ntriples_parse_term:
+ * @world: raptor world
+ * @locator: raptor locator (in/out) (or NULL)
+ * @string: string input (in)
+ * @len_p: pointer to length of @string (in/out)
+ * @term_p: pointer to store term (out)
+ * @allow_turtle: non-0 to allow Turtle forms such as integers, boolean
+ * @arena: arena to allocate the term from (or NULL)
+ *
+ * INTERNAL - Parse an N-Triples string into a #raptor_term
+ *
+ * The @len_p destination and @locator fields are modified as parsing
+ * proceeds to be used in error messages.  The final value is written
+ * into the #raptor_term pointed at by @term_p
+ *
+ * Return value: number of bytes processed or 0 on failure
+ */
+size_t
+raptor_ntriples_parse_term(raptor_world* world, raptor_locator* locator,
+                           unsigned char *string, size_t *len_p,
+                           raptor_term** term_p, int allow_turtle,
+                           raptor_arena* arena)
+{
+  unsigned char *p = string;
+  unsigned char *dest;
+  size_t term_length = 0;
+  size_t bytes;
+  raptor_ntriples_token token;
+
+  switch(*p) {
+    case '-':
+    case '+':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+      if(allow_turtle) {
+        raptor_uri* datatype_uri = NULL;
+
+        dest = p;
+
+        if(raptor_parse_turtle_term_internal(world, locator,
+                                             (const unsigned char**)&p,
+                                             dest, len_p, &term_length,
+                                             &datatype_uri)) {
+          goto fail;
+        }
+
+        *term_p = raptor_new_term_from_counted_literal_in_arena(arena, world,
+                                                                dest,
+                                                                strlen((const char*)dest),
+                                                                datatype_uri,
+                                                                NULL /* language */,
+                                                                0);
+      } else
+        goto fail;
+      break;
+
+    default:
+      bytes = raptor_ntriples_lex_term(world, locator, string, len_p, &token);
+      if(token.type != RAPTOR_TERM_TYPE_UNKNOWN)
+        *term_p = raptor_ntriples_token_to_term(world, locator, &token, arena);
+      return bytes;
+  }
+
+  fail:
+
+  return p - string;
+}
@@ -296,6 +296,66 @@ static const struct
     RAPTOR_OPTION_VALUE_TYPE_BOOL,
     "loadExternalEntities",
     "Parsers and SAX2 should load external entities."
+  },
+  { RAPTOR_OPTION_PARSE_THREADS,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "parseThreads",
+    "Number of worker threads for N-Triples and N-Quads parsing."
+  },
+  { RAPTOR_OPTION_PARSE_THREADS_UNORDERED,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "parseThreadsUnordered",
+    "Worker threads return statements as parsed, not in input order."
+  },
+  { RAPTOR_OPTION_TERM_ARENA,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "termArena",
+    "Allocate parsed terms from an arena reset after each chunk."
+  },
+  { RAPTOR_OPTION_READ_BUFFER_SIZE,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "readBufferSize",
+    "Size of blocks read from files and iostreams"
+  },
+  { RAPTOR_OPTION_MMAP_INPUT,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "mmapInput",
+    "Map regular files into memory when parsing"
+  },
+  { RAPTOR_OPTION_GROUPED_SUBJECTS,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_BOOL,
+    "groupedSubjects",
+    "Serializer input statements are grouped by subject"
+  },
+  { RAPTOR_OPTION_MEMORY_BUDGET,
+    RAPTOR_OPTION_AREA_SERIALIZER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "memoryBudget",
+    "Memory budget in kilobytes for holding statements"
+  },
+  { RAPTOR_OPTION_CHECK_RDF_ID_FILTER_SIZE,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "checkRdfIDFilterSize",
+    "RDF/XML parser checks rdf:ID values first with a Bloom filter of this size in KB"
+  },
+  { RAPTOR_OPTION_UNIQUE_STATEMENTS,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "uniqueStatements",
+    "Drop duplicate statements, remembering up to this many"
+  },
+  { RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE,
+    RAPTOR_OPTION_AREA_PARSER,
+    RAPTOR_OPTION_VALUE_TYPE_INT,
+    "uniqueStatementsFilterSize",
+    "Drop duplicate statements found with a Bloom filter of this size in KB"
   }
 };
 
@@ -43,6 +43,13 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H)
+#include <sys/mman.h>
+#define RAPTOR_PARSE_MMAP 1
+#endif
 
 /* Raptor includes */
 #include "raptor2.h"
@@ -52,6 +59,9 @@
 #ifndef STANDALONE
 
 /* prototypes for helper functions */
+static void raptor_parser_free_statement_batch(raptor_parser* parser);
+static int raptor_parser_start_unique_filter(raptor_parser* parser);
+static void raptor_parser_free_unique_filter(raptor_parser* parser);
 static void raptor_parser_set_strict(raptor_parser* rdf_parser, int is_strict);
 
 /* helper methods */
@@ -449,6 +459,11 @@ raptor_parser_parse_start(raptor_parser *rdf_parser, raptor_uri *uri)
   rdf_parser->locator.column = -1;
   rdf_parser->locator.byte   = -1;
 
+  if(raptor_parser_start_unique_filter(rdf_parser)) {
+    raptor_parser_fatal_error(rdf_parser, "Out of memory");
+    return 1;
+  }
+
   if(rdf_parser->factory->start)
     return rdf_parser->factory->start(rdf_parser);
   else
@@ -476,10 +491,19 @@ int
 raptor_parser_parse_chunk(raptor_parser* rdf_parser,
                           const unsigned char *buffer, size_t len, int is_end) 
 {
+  int rc;
+
   if(rdf_parser->sb)
     raptor_stringbuffer_append_counted_string(rdf_parser->sb, buffer, len, 1);
     
-  return rdf_parser->factory->chunk(rdf_parser, buffer, len, is_end);
+  rc = rdf_parser->factory->chunk(rdf_parser, buffer, len, is_end);
+
+  /* deliver the last partial batch at the end of the content or when
+   * the caller will stop parsing because of an error */
+  if((is_end || rc) && rdf_parser->statement_batch_count)
+    raptor_parser_flush_statement_batch(rdf_parser);
+
+  return rc;
 }
 
 
@@ -511,12 +535,67 @@ raptor_free_parser(raptor_parser* rdf_parser)
   if(rdf_parser->sb)
     raptor_free_stringbuffer(rdf_parser->sb);
 
+  if(rdf_parser->large_buffer)
+    RAPTOR_FREE(char*, rdf_parser->large_buffer);
+
+  raptor_parser_free_unique_filter(rdf_parser);
+  raptor_parser_free_statement_batch(rdf_parser);
+
+  if(rdf_parser->uri_resolver)
+    raptor_free_uri_resolver(rdf_parser->uri_resolver);
+
   raptor_object_options_clear(&rdf_parser->options);
 
   RAPTOR_FREE(raptor_parser, rdf_parser);
 }
 
 
+/*
+ * raptor_parser_get_read_buffer:
+ * @rdf_parser: parser
+ * @size_p: pointer to store the buffer size
+ *
+ * INTERNAL - Get a buffer for reading blocks of content
+ *
+ * The buffer is sized by #RAPTOR_OPTION_READ_BUFFER_SIZE and has room
+ * for a NUL after *@size_p bytes.
+ *
+ * Return value: buffer or NULL on failure
+ */
+static unsigned char*
+raptor_parser_get_read_buffer(raptor_parser* rdf_parser, size_t* size_p)
+{
+  int option_size;
+  size_t size;
+
+  option_size = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                           RAPTOR_OPTION_READ_BUFFER_SIZE);
+  size = (option_size > 0) ? RAPTOR_GOOD_CAST(size_t, option_size) :
+                             RAPTOR_READ_BUFFER_SIZE;
+
+  if(size <= RAPTOR_READ_BUFFER_SIZE) {
+    *size_p = size;
+    return rdf_parser->buffer;
+  }
+
+  if(rdf_parser->large_buffer_size != size) {
+    if(rdf_parser->large_buffer)
+      RAPTOR_FREE(char*, rdf_parser->large_buffer);
+    rdf_parser->large_buffer_size = 0;
+
+    rdf_parser->large_buffer = RAPTOR_MALLOC(unsigned char*, size + 1);
+    if(!rdf_parser->large_buffer) {
+      raptor_parser_fatal_error(rdf_parser, "Out of memory");
+      return NULL;
+    }
+    rdf_parser->large_buffer_size = size;
+  }
+
+  *size_p = size;
+  return rdf_parser->large_buffer;
+}
+
+
 /**
  * raptor_parser_parse_file_stream:
  * @rdf_parser: parser
@@ -537,6 +616,8 @@ raptor_parser_parse_file_stream(raptor_parser* rdf_parser,
 {
   int rc = 0;
   raptor_locator *locator = &rdf_parser->locator;
+  unsigned char* buffer;
+  size_t buffer_size;
 
   if(!stream || !base_uri)
     return 1;
@@ -544,14 +625,18 @@ raptor_parser_parse_file_stream(raptor_parser* rdf_parser,
   locator->line= locator->column = -1;
   locator->file= filename;
 
+  buffer = raptor_parser_get_read_buffer(rdf_parser, &buffer_size);
+  if(!buffer)
+    return 1;
+
   if(raptor_parser_parse_start(rdf_parser, base_uri))
     return 1;
   
   while(!feof(stream)) {
-    size_t len = fread(rdf_parser->buffer, 1, RAPTOR_READ_BUFFER_SIZE, stream);
-    int is_end = (len < RAPTOR_READ_BUFFER_SIZE);
-    rdf_parser->buffer[len] = '\0';
-    rc = raptor_parser_parse_chunk(rdf_parser, rdf_parser->buffer, len, is_end);
+    size_t len = fread(buffer, 1, buffer_size, stream);
+    int is_end = (len < buffer_size);
+    buffer[len] = '\0';
+    rc = raptor_parser_parse_chunk(rdf_parser, buffer, len, is_end);
     if(rc || is_end)
       break;
   }
@@ -560,6 +645,92 @@ raptor_parser_parse_file_stream(raptor_parser* rdf_parser,
 }
 
 
+#ifdef RAPTOR_PARSE_MMAP
+/*
+ * raptor_parser_parse_file_mmap:
+ * @rdf_parser: parser
+ * @filename: filename of content
+ * @base_uri: the base URI to use
+ *
+ * INTERNAL - Parse a regular file by mapping it into memory
+ *
+ * The mapping is private and writable since parsers may modify the
+ * chunks they are given in place.
+ *
+ * Return value: <0 if the file could not be mapped and nothing was
+ * parsed, otherwise non 0 on failure
+ */
+static int
+raptor_parser_parse_file_mmap(raptor_parser* rdf_parser, const char* filename,
+                              raptor_uri *base_uri)
+{
+  raptor_locator *locator = &rdf_parser->locator;
+  struct stat buf;
+  int fd;
+  void* map;
+  size_t map_size;
+  size_t window;
+  size_t offset;
+  int option_size;
+  int rc = 0;
+
+  fd = open(filename, O_RDONLY);
+  if(fd < 0)
+    return -1;
+
+  if(fstat(fd, &buf) || !S_ISREG(buf.st_mode) || buf.st_size <= 0) {
+    close(fd);
+    return -1;
+  }
+
+  map_size = RAPTOR_GOOD_CAST(size_t, buf.st_size);
+  if(RAPTOR_GOOD_CAST(off_t, map_size) != buf.st_size) {
+    /* too large for the address space */
+    close(fd);
+    return -1;
+  }
+
+  map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    return -1;
+
+#ifdef MADV_SEQUENTIAL
+  madvise(map, map_size, MADV_SEQUENTIAL);
+#endif
+
+  option_size = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                           RAPTOR_OPTION_READ_BUFFER_SIZE);
+  window = (option_size > 0) ? RAPTOR_GOOD_CAST(size_t, option_size) :
+                               RAPTOR_MMAP_WINDOW_SIZE;
+
+  locator->line= locator->column = -1;
+  locator->file= filename;
+
+  if(raptor_parser_parse_start(rdf_parser, base_uri)) {
+    munmap(map, map_size);
+    return 1;
+  }
+
+  for(offset = 0; 1; offset += window) {
+    size_t len = map_size - offset;
+    int is_end = (len <= window);
+
+    if(!is_end)
+      len = window;
+    rc = raptor_parser_parse_chunk(rdf_parser, (unsigned char*)map + offset,
+                                   len, is_end);
+    if(rc || is_end)
+      break;
+  }
+
+  munmap(map, map_size);
+
+  return (rc != 0);
+}
+#endif
+
+
 /**
  * raptor_parser_parse_file:
  * @rdf_parser: parser
@@ -597,6 +768,20 @@ raptor_parser_parse_file(raptor_parser* rdf_parser, raptor_uri *uri,
     }
 #endif
 
+#ifdef RAPTOR_PARSE_MMAP
+    if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_MMAP_INPUT)) {
+      if(!base_uri) {
+        base_uri = raptor_uri_copy(uri);
+        free_base_uri = 1;
+      }
+
+      rc = raptor_parser_parse_file_mmap(rdf_parser, filename, base_uri);
+      if(rc >= 0)
+        goto cleanup;
+      rc = 0;
+    }
+#endif
+
     fh = fopen(filename, "r");
     if(!fh) {
       raptor_parser_error(rdf_parser, "file '%s' open failed - %s",
@@ -976,11 +1161,439 @@ raptor_parser_set_statement_handler(raptor_parser* parser,
                                     void *user_data,
                                     raptor_statement_handler handler)
 {
+  raptor_parser_free_unique_filter(parser);
+  raptor_parser_free_statement_batch(parser);
+
   parser->user_data = user_data;
   parser->statement_handler = handler;
 }
 
 
+/*
+ * raptor_parser_batch_statement_handler:
+ * @user_data: parser
+ * @statement: statement from the parser
+ *
+ * INTERNAL - statement handler that adds to the current batch
+ *
+ * Installed as the parser statement handler by
+ * raptor_parser_set_statement_batch_handler().  The @user_data is the
+ * parser owning the batch, which for GRDDL child parsers is the
+ * outer parser whose user state they copied.
+ *
+ * The terms are shared by usage count so adding a statement does not
+ * copy any strings.
+ */
+static void
+raptor_parser_batch_statement_handler(void *user_data,
+                                      raptor_statement *statement)
+{
+  raptor_parser* parser = (raptor_parser*)user_data;
+  raptor_statement* s;
+
+  if(!parser->statement_batch_handler)
+    return;
+
+  s = &parser->statement_batch[parser->statement_batch_count++];
+  raptor_statement_init(s, parser->world);
+  if(statement->subject)
+    s->subject = raptor_term_copy(statement->subject);
+  if(statement->predicate)
+    s->predicate = raptor_term_copy(statement->predicate);
+  if(statement->object)
+    s->object = raptor_term_copy(statement->object);
+  if(statement->graph)
+    s->graph = raptor_term_copy(statement->graph);
+
+  if(parser->statement_batch_count == parser->statement_batch_size)
+    raptor_parser_flush_statement_batch(parser);
+}
+
+
+/*
+ * raptor_parser_flush_statement_batch:
+ * @parser: parser
+ *
+ * INTERNAL - deliver any pending statements to the batch handler
+ */
+void
+raptor_parser_flush_statement_batch(raptor_parser* parser)
+{
+  int count = parser->statement_batch_count;
+  int i;
+
+  if(!count)
+    return;
+
+  (*parser->statement_batch_handler)(parser->statement_batch_user_data,
+                                     parser->statement_batch, count);
+
+  for(i = 0; i < count; i++)
+    raptor_statement_clear(&parser->statement_batch[i]);
+  parser->statement_batch_count = 0;
+}
+
+
+/*
+ * raptor_parser_free_statement_batch:
+ * @parser: parser
+ *
+ * INTERNAL - discard the statement batch and stop batched delivery
+ */
+static void
+raptor_parser_free_statement_batch(raptor_parser* parser)
+{
+  int i;
+
+  if(!parser->statement_batch_handler)
+    return;
+
+  for(i = 0; i < parser->statement_batch_count; i++)
+    raptor_statement_clear(&parser->statement_batch[i]);
+
+  RAPTOR_FREE(raptor_statement*, parser->statement_batch);
+  parser->statement_batch = NULL;
+  parser->statement_batch_size = 0;
+  parser->statement_batch_count = 0;
+
+  parser->user_data = parser->statement_batch_user_data;
+  parser->statement_batch_user_data = NULL;
+  parser->statement_batch_handler = NULL;
+  parser->statement_handler = NULL;
+}
+
+
+/*
+ * raptor_parser_unique_filter_add:
+ * @parser: parser
+ * @statement: statement
+ *
+ * INTERNAL - Add a statement to the duplicate Bloom filter
+ *
+ * Return value: 1 if all the bits were already set
+ */
+static int
+raptor_parser_unique_filter_add(raptor_parser* parser,
+                                raptor_statement* statement)
+{
+  raptor_term* terms[4];
+  unsigned int hash1 = 0;
+  unsigned int hash2 = 0;
+  int i;
+
+  terms[0] = statement->subject;
+  terms[1] = statement->predicate;
+  terms[2] = statement->object;
+  terms[3] = statement->graph;
+
+  /* hash1 is raptor_statement_hash(); hash2 mixes the same term
+   * hashes differently so the bit positions do not all depend on
+   * one 32 bit value */
+  for(i = 0; i < 4; i++) {
+    unsigned int term_hash = raptor_term_hash(terms[i]);
+
+    hash1 = hash1 * 31U + term_hash;
+    hash2 = (hash2 ^ term_hash) * 0x85ebca6bU;
+    hash2 ^= hash2 >> 15;
+  }
+
+  return raptor_bloom_add(parser->unique_filter, hash1, hash2);
+}
+
+
+/*
+ * raptor_parser_unique_statement_handler:
+ * @user_data: parser
+ * @statement: statement from the parser
+ *
+ * INTERNAL - statement handler that drops duplicate statements
+ *
+ * Installed in front of the parser statement handler by
+ * raptor_parser_start_unique_filter() and passes statements not seen
+ * before on to it.
+ */
+static void
+raptor_parser_unique_statement_handler(void *user_data,
+                                       raptor_statement *statement)
+{
+  raptor_parser* parser = (raptor_parser*)user_data;
+  int rc;
+
+  if(parser->unique_filter)
+    rc = raptor_parser_unique_filter_add(parser, statement);
+  else if(raptor_statement_set_size(parser->unique_set) < parser->unique_set_limit)
+    rc = raptor_statement_set_add(parser->unique_set, statement);
+  else
+    /* full: only drop statements already remembered */
+    rc = raptor_statement_set_contains(parser->unique_set, statement);
+
+  if(rc > 0) {
+    parser->duplicate_count++;
+    return;
+  }
+
+  (*parser->unique_statement_handler)(parser->unique_user_data, statement);
+}
+
+
+/*
+ * raptor_parser_start_unique_filter:
+ * @parser: parser
+ *
+ * INTERNAL - start dropping duplicate statements if the options ask for it
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_parser_start_unique_filter(raptor_parser* parser)
+{
+  int limit;
+  int filter_size;
+
+  raptor_parser_free_unique_filter(parser);
+  parser->duplicate_count = 0;
+
+  limit = RAPTOR_OPTIONS_GET_NUMERIC(parser, RAPTOR_OPTION_UNIQUE_STATEMENTS);
+  filter_size = RAPTOR_OPTIONS_GET_NUMERIC(parser,
+                                           RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE);
+  if((limit <= 0 && filter_size <= 0) || !parser->statement_handler)
+    return 0;
+
+  /* a GRDDL child parser delivers to the filter of the parser it
+   * copied the user state from */
+  if(parser->statement_handler == raptor_parser_unique_statement_handler)
+    return 0;
+
+  if(filter_size > 0) {
+    size_t filter_bytes = RAPTOR_GOOD_CAST(size_t, filter_size) << 10;
+
+    parser->unique_filter = raptor_new_bloom(filter_bytes);
+    if(!parser->unique_filter)
+      return 1;
+  } else {
+    parser->unique_set = raptor_new_statement_set(parser->world);
+    if(!parser->unique_set)
+      return 1;
+    parser->unique_set_limit = limit;
+  }
+
+  parser->unique_statement_handler = parser->statement_handler;
+  parser->unique_user_data = parser->user_data;
+  parser->statement_handler = raptor_parser_unique_statement_handler;
+  parser->user_data = parser;
+
+  return 0;
+}
+
+
+/*
+ * raptor_parser_free_unique_filter:
+ * @parser: parser
+ *
+ * INTERNAL - stop dropping duplicate statements and restore the handler
+ */
+static void
+raptor_parser_free_unique_filter(raptor_parser* parser)
+{
+  if(parser->unique_set) {
+    raptor_free_statement_set(parser->unique_set);
+    parser->unique_set = NULL;
+  }
+
+  if(parser->unique_filter) {
+    raptor_free_bloom(parser->unique_filter);
+    parser->unique_filter = NULL;
+  }
+
+  if(!parser->unique_statement_handler)
+    return;
+
+  parser->statement_handler = parser->unique_statement_handler;
+  parser->user_data = parser->unique_user_data;
+  parser->unique_statement_handler = NULL;
+  parser->unique_user_data = NULL;
+}
+
+
+/*
+ * raptor_parser_new_uri_relative_to_base:
+ * @parser: parser
+ * @base_uri: in-scope base URI
+ * @uri_string: relative URI string
+ * @uri_len: length of URI string (or 0)
+ *
+ * INTERNAL - create a URI from a base URI and relative URI string
+ *
+ * As raptor_new_uri_relative_to_base_counted() but keeps the parsed
+ * @base_uri cached in the parser so it is only parsed again when the
+ * in-scope base changes.
+ *
+ * Return value: a new #raptor_uri object or NULL on failure.
+ */
+raptor_uri*
+raptor_parser_new_uri_relative_to_base(raptor_parser* parser,
+                                       raptor_uri* base_uri,
+                                       const unsigned char* uri_string,
+                                       size_t uri_len)
+{
+  if(!parser->uri_resolver) {
+    parser->uri_resolver = raptor_new_uri_resolver(parser->world);
+    if(!parser->uri_resolver)
+      return NULL;
+  }
+
+  return raptor_uri_resolver_resolve(parser->uri_resolver, base_uri,
+                                     uri_string, uri_len);
+}
+
+
+/**
+ * raptor_parser_set_statement_batch_handler:
+ * @parser: #raptor_parser parser object
+ * @user_data: user data pointer for callback
+ * @handler: new statement batch callback function or NULL
+ * @batch_size: maximum statements per call or <= 0 for the default
+ *
+ * Set a function to receive statements in batches for the parser.
+ *
+ * This replaces any handler set with
+ * raptor_parser_set_statement_handler().  The @handler is called
+ * with up to @batch_size statements at a time, and with any remaining
+ * statements when the content ends or parsing fails.  The statements
+ * and their terms are only valid until @handler returns.
+ *
+ * @user_data is also passed to any handler set with
+ * raptor_parser_set_graph_mark_handler() and pending statements are
+ * delivered before each graph mark so ordering is preserved.
+ *
+ * @handler is always called from the thread calling the parser, in
+ * input order, even if #RAPTOR_OPTION_PARSE_THREADS_UNORDERED is set.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+raptor_parser_set_statement_batch_handler(raptor_parser* parser,
+                                          void *user_data,
+                                          raptor_statement_batch_handler handler,
+                                          int batch_size)
+{
+  raptor_statement* batch;
+
+  raptor_parser_free_unique_filter(parser);
+
+  if(!handler) {
+    raptor_parser_set_statement_handler(parser, user_data, NULL);
+    return 0;
+  }
+
+  if(batch_size <= 0)
+    batch_size = RAPTOR_STATEMENT_BATCH_DEFAULT_SIZE;
+
+  batch = RAPTOR_CALLOC(raptor_statement*, RAPTOR_GOOD_CAST(size_t, batch_size),
+                        sizeof(*batch));
+  if(!batch)
+    return 1;
+
+  raptor_parser_free_statement_batch(parser);
+
+  parser->statement_batch = batch;
+  parser->statement_batch_size = batch_size;
+  parser->statement_batch_count = 0;
+  parser->statement_batch_handler = handler;
+  parser->statement_batch_user_data = user_data;
+
+  parser->user_data = parser;
+  parser->statement_handler = raptor_parser_batch_statement_handler;
+
+  return 0;
+}
+
+
+/**
+ * raptor_parser_set_serializer:
+ * @parser: #raptor_parser parser object
+ * @serializer: started serializer to write to or NULL to stop
+ *
+ * Write statements straight to a serializer when converting syntax.
+ *
+ * Where the parser can write to @serializer without making any
+ * terms, such as N-Triples or N-Quads to N-Triples or N-Quads, each
+ * statement is written as it is parsed with the same output as
+ * raptor_serializer_serialize_statement() and the statement handlers
+ * are not called.  The @serializer must already be started and must
+ * stay valid while the parser uses it.
+ *
+ * When not supported nothing is changed and the caller should
+ * serialize from a statement handler instead.  This includes when
+ * #RAPTOR_OPTION_UNIQUE_STATEMENTS or
+ * #RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE is set, so set those
+ * options first.
+ *
+ * Return value: 0 if statements will be written to @serializer, >0 if not supported for this parser and serializer
+ **/
+int
+raptor_parser_set_serializer(raptor_parser* parser,
+                             raptor_serializer* serializer)
+{
+  int rc;
+
+  parser->serialized_count = 0;
+
+  if(!serializer) {
+    parser->serializer = NULL;
+    return 0;
+  }
+
+  if(!parser->factory->set_serializer)
+    return 1;
+
+  /* duplicates are dropped from the statement handler */
+  if(RAPTOR_OPTIONS_GET_NUMERIC(parser, RAPTOR_OPTION_UNIQUE_STATEMENTS) > 0 ||
+     RAPTOR_OPTIONS_GET_NUMERIC(parser, RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE) > 0)
+    return 1;
+
+  rc = parser->factory->set_serializer(parser, serializer);
+  if(rc)
+    return rc;
+
+  parser->serializer = serializer;
+  return 0;
+}
+
+
+/**
+ * raptor_parser_get_serialized_count:
+ * @parser: #raptor_parser parser object
+ *
+ * Get the number of statements written to the serializer set with raptor_parser_set_serializer()
+ *
+ * Return value: statement count
+ **/
+int
+raptor_parser_get_serialized_count(raptor_parser* parser)
+{
+  return parser->serialized_count;
+}
+
+
+/**
+ * raptor_parser_get_duplicate_count:
+ * @parser: #raptor_parser parser object
+ *
+ * Get the number of duplicate statements dropped by the last parse
+ *
+ * Statements are only dropped when #RAPTOR_OPTION_UNIQUE_STATEMENTS
+ * or #RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE is set.
+ *
+ * Return value: statement count
+ **/
+int
+raptor_parser_get_duplicate_count(raptor_parser* parser)
+{
+  return parser->duplicate_count;
+}
+
+
 /**
  * raptor_parser_set_graph_mark_handler:
  * @parser: #raptor_parser parser object
@@ -998,7 +1611,10 @@ raptor_parser_set_graph_mark_handler(raptor_parser* parser,
                                      void *user_data,
                                      raptor_graph_mark_handler handler)
 {
-  parser->user_data = user_data;
+  if(parser->statement_batch_handler)
+    parser->statement_batch_user_data = user_data;
+  else
+    parser->user_data = user_data;
   parser->graph_mark_handler = handler;
 }
 
@@ -1657,8 +2273,17 @@ raptor_parser_start_graph(raptor_parser* parser, raptor_uri* uri,
   if(!parser->emit_graph_marks)
     return;
   
-  if(parser->graph_mark_handler)
-    (*parser->graph_mark_handler)(parser->user_data, uri, flags);
+  if(parser->graph_mark_handler) {
+    void* user_data = parser->user_data;
+
+    if(parser->unique_statement_handler)
+      user_data = parser->unique_user_data;
+    if(parser->statement_batch_handler) {
+      raptor_parser_flush_statement_batch(parser);
+      user_data = parser->statement_batch_user_data;
+    }
+    (*parser->graph_mark_handler)(user_data, uri, flags);
+  }
 }
 
 
@@ -1672,8 +2297,17 @@ raptor_parser_end_graph(raptor_parser* parser, raptor_uri* uri, int is_declared)
   if(!parser->emit_graph_marks)
     return;
   
-  if(parser->graph_mark_handler)
-    (*parser->graph_mark_handler)(parser->user_data, uri, flags);
+  if(parser->graph_mark_handler) {
+    void* user_data = parser->user_data;
+
+    if(parser->unique_statement_handler)
+      user_data = parser->unique_user_data;
+    if(parser->statement_batch_handler) {
+      raptor_parser_flush_statement_batch(parser);
+      user_data = parser->statement_batch_user_data;
+    }
+    (*parser->graph_mark_handler)(user_data, uri, flags);
+  }
 }
 
 
@@ -1730,10 +2364,16 @@ raptor_parser_parse_iostream(raptor_parser* rdf_parser, raptor_iostream *iostr,
                              raptor_uri *base_uri)
 {
   int rc = 0;
+  unsigned char* buffer;
+  size_t buffer_size;
 
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN_VALUE(rdf_parser, raptor_parser, 1);
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN_VALUE(iostr, raptor_iostr, 1);
 
+  buffer = raptor_parser_get_read_buffer(rdf_parser, &buffer_size);
+  if(!buffer)
+    return 1;
+
   rc = raptor_parser_parse_start(rdf_parser, base_uri);
   if(rc)
     return rc;
@@ -1743,14 +2383,13 @@ raptor_parser_parse_iostream(raptor_parser* rdf_parser, raptor_iostream *iostr,
     size_t len;
     int is_end;
 
-    ilen = raptor_iostream_read_bytes(rdf_parser->buffer, 1,
-                                      RAPTOR_READ_BUFFER_SIZE, iostr);
+    ilen = raptor_iostream_read_bytes(buffer, 1, buffer_size, iostr);
     if(ilen < 0)
       break;
     len = RAPTOR_GOOD_CAST(size_t, ilen);
-    is_end = (len < RAPTOR_READ_BUFFER_SIZE);
+    is_end = (len < buffer_size);
 
-    rc = raptor_parser_parse_chunk(rdf_parser, rdf_parser->buffer, len, is_end);
+    rc = raptor_parser_parse_chunk(rdf_parser, buffer, len, is_end);
     if(rc || is_end)
       break;
   }
@@ -1769,6 +2408,68 @@ raptor_parser_parse_iostream(raptor_parser* rdf_parser, raptor_iostream *iostr,
 int main(int argc, char *argv[]);
 
 
+static void
+count_statement_handler(void *user_data, raptor_statement *statement)
+{
+  (*(int*)user_data)++;
+}
+
+
+/* 7 statements of which 3 are duplicates */
+static const char * const unique_test_content =
+  "<http://example.org/s> <http://example.org/p> <http://example.org/o> .\n"
+  "<http://example.org/s> <http://example.org/p> \"x\"@en .\n"
+  "<http://example.org/s> <http://example.org/p> <http://example.org/o> .\n"
+  "<http://example.org/s> <http://example.org/p> <http://example.org/o> <http://example.org/g> .\n"
+  "<http://example.org/s> <http://example.org/p> \"x\"@en .\n"
+  "<http://example.org/s> <http://example.org/p> \"x\" .\n"
+  "<http://example.org/s> <http://example.org/p> <http://example.org/o> <http://example.org/g> .\n";
+
+
+static int
+test_unique_statements(raptor_world *world, const char *program,
+                       raptor_option option, int value,
+                       int expected_count, int expected_duplicates)
+{
+  raptor_parser* parser;
+  raptor_uri* base_uri;
+  int count = 0;
+  int duplicates;
+  int rc = 0;
+
+  parser = raptor_new_parser(world, "nquads");
+  if(!parser)
+    return 0;
+
+  base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/");
+  raptor_parser_set_statement_handler(parser, &count, count_statement_handler);
+  raptor_parser_set_option(parser, option, NULL, value);
+
+  if(raptor_parser_parse_start(parser, base_uri) ||
+     raptor_parser_parse_chunk(parser,
+                               (const unsigned char*)unique_test_content,
+                               strlen(unique_test_content), 1)) {
+    fprintf(stderr, "%s: parsing with option %d failed\n", program,
+            (int)option);
+    rc = 1;
+  }
+
+  duplicates = raptor_parser_get_duplicate_count(parser);
+  if(count != expected_count || duplicates != expected_duplicates) {
+    fprintf(stderr,
+            "%s: option %d value %d returned %d statements and %d duplicates, expected %d and %d\n",
+            program, (int)option, value, count, duplicates,
+            expected_count, expected_duplicates);
+    rc = 1;
+  }
+
+  raptor_free_uri(base_uri);
+  raptor_free_parser(parser);
+
+  return rc;
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -1820,6 +2521,17 @@ main(int argc, char *argv[])
   }
   RAPTOR_FREE(char*, s);
 
+  if(test_unique_statements(world, program,
+                            RAPTOR_OPTION_UNIQUE_STATEMENTS, 0, 7, 0) ||
+     test_unique_statements(world, program,
+                            RAPTOR_OPTION_UNIQUE_STATEMENTS, 100, 4, 3) ||
+     /* only the first statement is remembered */
+     test_unique_statements(world, program,
+                            RAPTOR_OPTION_UNIQUE_STATEMENTS, 1, 6, 1) ||
+     test_unique_statements(world, program,
+                            RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE, 1, 4, 3))
+    return 1;
+
   raptor_free_world(world);
   
   return 0;
@@ -0,0 +1,561 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_parse_file_test.c - Test parser options give the same statements
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ * Usage: raptor_parse_file_test [FILE.nt | FILE.nq]...
+ *
+ * Each file is parsed serially with the default options and then
+ * again with the options in parse_runs[] below.  The statements
+ * returned must match the serial parse, in the same order unless the
+ * run allows unordered delivery.  Files that fail to parse serially
+ * must fail in every run too.  A generated N-Triples and N-Quads
+ * document large enough to span several worker blocks is always
+ * checked as well.
+ *
+ * All the files are then parsed again from several threads sharing
+ * one #RAPTOR_WORLD_FLAG_CONCURRENT world, each thread using
+ * different parse options.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+/* lines in the generated document */
+#define GENERATED_LINES 20000
+
+
+typedef struct
+{
+  const char* label;
+  /* RAPTOR_OPTION_PARSE_THREADS */
+  int threads;
+  /* RAPTOR_OPTION_PARSE_THREADS_UNORDERED */
+  int unordered;
+  /* raptor_parser_set_statement_batch_handler() batch size or 0 */
+  int batch_size;
+  /* RAPTOR_OPTION_READ_BUFFER_SIZE */
+  int read_buffer_size;
+  /* RAPTOR_OPTION_MMAP_INPUT */
+  int mmap_input;
+} parse_run;
+
+static const parse_run parse_runs[] = {
+  { "threads", 4, 0, 0, 0, 0 },
+  { "threads unordered", 4, 1, 0, 0, 0 },
+  /* batches are always delivered in order */
+  { "threads batched", 4, 0, 100, 0, 0 },
+  { "threads unordered batched", 4, 1, 100, 0, 0 },
+  /* lines and escapes split across reads */
+  { "read buffer 7", 0, 0, 0, 7, 0 },
+  { "threads read buffer 7", 4, 0, 0, 7, 0 },
+  { "mmap", 0, 0, 0, 0, 1 },
+  { "mmap window 4096", 0, 0, 0, 4096, 1 },
+  { "threads mmap", 4, 0, 0, 0, 1 },
+  { NULL, 0, 0, 0, 0, 0 }
+};
+
+
+typedef struct
+{
+  raptor_sequence* statements;
+  int errors;
+#ifdef RAPTOR_THREADS
+  pthread_mutex_t lock;
+#endif
+} parse_results;
+
+
+static void
+parse_test_log_handler(void *user_data, raptor_log_message *message)
+{
+  /* bad input files are expected to fail quietly */
+}
+
+
+static char*
+parse_test_statement_to_string(raptor_statement* statement)
+{
+  raptor_term* terms[4];
+  unsigned char* strings[4];
+  size_t len = 0;
+  char* result;
+  char* p;
+  int i;
+
+  terms[0] = statement->subject;
+  terms[1] = statement->predicate;
+  terms[2] = statement->object;
+  terms[3] = statement->graph;
+
+  for(i = 0; i < 4; i++) {
+    strings[i] = terms[i] ? raptor_term_to_string(terms[i]) : NULL;
+    if(strings[i])
+      len += strlen((const char*)strings[i]);
+    len++;
+  }
+
+  result = (char*)malloc(len + 1);
+  p = result;
+  for(i = 0; i < 4; i++) {
+    if(strings[i]) {
+      size_t slen = strlen((const char*)strings[i]);
+      if(p) {
+        memcpy(p, strings[i], slen);
+        p += slen;
+      }
+      raptor_free_memory(strings[i]);
+    }
+    if(p)
+      *p++ = ' ';
+  }
+  if(p)
+    *p = '\0';
+
+  return result;
+}
+
+
+static void
+parse_test_statement_handler(void *user_data, raptor_statement *statement)
+{
+  parse_results* results = (parse_results*)user_data;
+  char* string = parse_test_statement_to_string(statement);
+
+  /* unordered runs deliver from the worker threads */
+#ifdef RAPTOR_THREADS
+  pthread_mutex_lock(&results->lock);
+#endif
+  if(!string || raptor_sequence_push(results->statements, string))
+    results->errors++;
+#ifdef RAPTOR_THREADS
+  pthread_mutex_unlock(&results->lock);
+#endif
+}
+
+
+static void
+parse_test_statement_batch_handler(void *user_data,
+                                   raptor_statement *statements, int count)
+{
+  int i;
+
+  for(i = 0; i < count; i++)
+    parse_test_statement_handler(user_data, &statements[i]);
+}
+
+
+/*
+ * Parse @filename as @syntax_name with the @run options (serial if
+ * NULL).  Returns the statements as strings or NULL if parsing failed.
+ */
+static raptor_sequence*
+parse_test_parse_file(raptor_world* world, const char* syntax_name,
+                      const char* filename, const parse_run* run)
+{
+  raptor_parser* parser;
+  unsigned char* uri_string;
+  raptor_uri* uri;
+  parse_results results;
+  int rc;
+
+  results.statements = raptor_new_sequence((raptor_data_free_handler)free,
+                                           NULL);
+  results.errors = 0;
+#ifdef RAPTOR_THREADS
+  pthread_mutex_init(&results.lock, NULL);
+#endif
+
+  parser = raptor_new_parser(world, syntax_name);
+  if(run) {
+    raptor_parser_set_option(parser, RAPTOR_OPTION_PARSE_THREADS, NULL,
+                             run->threads);
+    raptor_parser_set_option(parser, RAPTOR_OPTION_PARSE_THREADS_UNORDERED,
+                             NULL, run->unordered);
+    raptor_parser_set_option(parser, RAPTOR_OPTION_READ_BUFFER_SIZE, NULL,
+                             run->read_buffer_size);
+    raptor_parser_set_option(parser, RAPTOR_OPTION_MMAP_INPUT, NULL,
+                             run->mmap_input);
+  }
+  if(run && run->batch_size)
+    raptor_parser_set_statement_batch_handler(parser, &results,
+                                              parse_test_statement_batch_handler,
+                                              run->batch_size);
+  else
+    raptor_parser_set_statement_handler(parser, &results,
+                                        parse_test_statement_handler);
+
+  uri_string = raptor_uri_filename_to_uri_string(filename);
+  uri = raptor_new_uri(world, uri_string);
+  raptor_free_memory(uri_string);
+
+  rc = raptor_parser_parse_file(parser, uri, uri);
+
+  raptor_free_uri(uri);
+  raptor_free_parser(parser);
+#ifdef RAPTOR_THREADS
+  pthread_mutex_destroy(&results.lock);
+#endif
+
+  if(rc || results.errors) {
+    raptor_free_sequence(results.statements);
+    return NULL;
+  }
+
+  return results.statements;
+}
+
+
+static int
+parse_test_compare_strings(const void *a, const void *b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+
+/* Returns 0 if the sequences hold the same strings in the same order */
+static int
+parse_test_compare_sequences(raptor_sequence* seq1, raptor_sequence* seq2)
+{
+  int size = raptor_sequence_size(seq1);
+  int i;
+
+  if(size != raptor_sequence_size(seq2))
+    return 1;
+
+  for(i = 0; i < size; i++) {
+    if(strcmp((const char*)raptor_sequence_get_at(seq1, i),
+              (const char*)raptor_sequence_get_at(seq2, i)))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+static const char*
+parse_test_syntax_name(const char* filename)
+{
+  size_t len = strlen(filename);
+
+  if(len > 3 && !strcmp(filename + len - 3, ".nq"))
+    return "nquads";
+
+  return "ntriples";
+}
+
+
+/*
+ * Compare parses of @filename with each of parse_runs[] to a serial
+ * parse.  The sorted serial statements, or NULL if the serial parse
+ * failed, are returned in *@sorted_p.  Returns the number of failures.
+ */
+static int
+parse_test_file(const char* program, raptor_world* world,
+                const char* filename, raptor_sequence** sorted_p)
+{
+  const char* syntax_name = parse_test_syntax_name(filename);
+  raptor_sequence* expected;
+  raptor_sequence* sorted = NULL;
+  const parse_run* run;
+  int failures = 0;
+
+  expected = parse_test_parse_file(world, syntax_name, filename, NULL);
+  if(expected) {
+    /* the serial statements again, sorted for unordered runs */
+    sorted = parse_test_parse_file(world, syntax_name, filename, NULL);
+    if(sorted)
+      raptor_sequence_sort(sorted, parse_test_compare_strings);
+  }
+
+  for(run = parse_runs; run->label; run++) {
+    raptor_sequence* got;
+    int failed;
+
+    got = parse_test_parse_file(world, syntax_name, filename, run);
+
+    if(!expected || !got)
+      failed = (!expected != !got);
+    else if(run->unordered && !run->batch_size) {
+      raptor_sequence_sort(got, parse_test_compare_strings);
+      failed = !sorted || parse_test_compare_sequences(sorted, got);
+    } else
+      failed = parse_test_compare_sequences(expected, got);
+
+    if(failed) {
+      fprintf(stderr, "%s: %s parse of %s (%s) differs from serial parse - %s\n",
+              program, run->label, filename, syntax_name,
+              !expected ? "serial parse failed" :
+              !got ? "parse failed" : "statements differ");
+      failures++;
+    }
+
+    if(got)
+      raptor_free_sequence(got);
+  }
+
+  *sorted_p = sorted;
+  if(expected)
+    raptor_free_sequence(expected);
+
+  return failures;
+}
+
+
+#ifdef RAPTOR_THREADS
+#define CONCURRENT_THREADS 4
+
+typedef struct
+{
+  raptor_world* world;
+  int count;
+  char** filenames;
+  raptor_sequence** sorted;
+  /* file and parse run to start with */
+  int offset;
+  int failures;
+} parse_test_thread;
+
+
+/* Parse every file with a different parse run for each thread */
+static void*
+parse_test_thread_main(void* arg)
+{
+  parse_test_thread* thread = (parse_test_thread*)arg;
+  int runs_count = 0;
+  int i;
+
+  while(parse_runs[runs_count].label)
+    runs_count++;
+
+  for(i = 0; i < thread->count; i++) {
+    int index = (thread->offset + i) % thread->count;
+    const char* filename = thread->filenames[index];
+    const parse_run* run = &parse_runs[(thread->offset + i) % runs_count];
+    raptor_sequence* got;
+
+    got = parse_test_parse_file(thread->world,
+                                parse_test_syntax_name(filename),
+                                filename, run);
+    if(got)
+      raptor_sequence_sort(got, parse_test_compare_strings);
+
+    if(!got || !thread->sorted[index])
+      thread->failures += (!got != !thread->sorted[index]);
+    else
+      thread->failures += parse_test_compare_sequences(thread->sorted[index],
+                                                       got);
+
+    if(got)
+      raptor_free_sequence(got);
+  }
+
+  return NULL;
+}
+
+
+/*
+ * Parse all @filenames from CONCURRENT_THREADS threads sharing one
+ * concurrent world and compare with the serial parses in @sorted.
+ * Returns the number of failures.
+ */
+static int
+parse_test_concurrent(const char* program, int count, char** filenames,
+                      raptor_sequence** sorted)
+{
+  raptor_world* world;
+  parse_test_thread threads[CONCURRENT_THREADS];
+  pthread_t ids[CONCURRENT_THREADS];
+  int failures = 0;
+  int i;
+
+  world = raptor_new_world();
+  if(!world)
+    return 1;
+
+  if(raptor_world_set_flag(world, RAPTOR_WORLD_FLAG_CONCURRENT, 1)) {
+    /* atomics are not available */
+    raptor_free_world(world);
+    return 0;
+  }
+
+  if(raptor_world_open(world)) {
+    raptor_free_world(world);
+    return 1;
+  }
+  raptor_world_set_log_handler(world, NULL, parse_test_log_handler);
+
+  for(i = 0; i < CONCURRENT_THREADS; i++) {
+    threads[i].world = world;
+    threads[i].count = count;
+    threads[i].filenames = filenames;
+    threads[i].sorted = sorted;
+    threads[i].offset = i;
+    threads[i].failures = 0;
+    if(pthread_create(&ids[i], NULL, parse_test_thread_main, &threads[i])) {
+      fprintf(stderr, "%s: Failed to create thread\n", program);
+      threads[i].count = 0;
+      failures++;
+    }
+  }
+
+  for(i = 0; i < CONCURRENT_THREADS; i++) {
+    if(threads[i].count)
+      pthread_join(ids[i], NULL);
+    failures += threads[i].failures;
+  }
+
+  raptor_free_world(world);
+
+  if(failures)
+    fprintf(stderr, "%s: %d concurrent world parses differ from serial parses\n",
+            program, failures);
+
+  return failures;
+}
+#endif
+
+
+/*
+ * Write a document of GENERATED_LINES lines mixing all term types
+ * into @filename, with a graph term on every other line if @quads.
+ */
+static int
+parse_test_generate_file(const char* filename, int quads)
+{
+  FILE* fh;
+  int i;
+
+  fh = fopen(filename, "w");
+  if(!fh)
+    return 1;
+
+  for(i = 0; i < GENERATED_LINES; i++) {
+    fprintf(fh, "<http://example.org/s%d> ", i / 7);
+
+    fprintf(fh, "<http://example.org/p%d> ", i % 13);
+
+    switch(i % 5) {
+      case 0:
+        fprintf(fh, "_:b%d", i % 101);
+        break;
+      case 1:
+        fprintf(fh, "\"literal %d\\n\\u00E9\\\"\"@en", i);
+        break;
+      case 2:
+        fprintf(fh, "\"%d\"^^<http://www.w3.org/2001/XMLSchema#integer>", i);
+        break;
+      case 3:
+        fprintf(fh, "\"\"");
+        break;
+      default:
+        fprintf(fh, "<http://example.org/o%d>", i);
+        break;
+    }
+
+    if(quads && (i % 2))
+      fprintf(fh, " <http://example.org/g%d>", i % 17);
+
+    fputs(" .\n", fh);
+
+    if(!(i % 1000))
+      fputs("# comment line\n\n", fh);
+  }
+
+  fclose(fh);
+
+  return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_world *world;
+  static const char* generated_files[2] = {
+    "raptor_parse_file_test.nt",
+    "raptor_parse_file_test.nq"
+  };
+  int count;
+  char** filenames;
+  raptor_sequence** sorted;
+  int failures = 0;
+  int i;
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  raptor_world_set_log_handler(world, NULL, parse_test_log_handler);
+
+  /* the generated files followed by the arguments */
+  count = 2 + argc - 1;
+  filenames = (char**)calloc(RAPTOR_GOOD_CAST(size_t, count), sizeof(char*));
+  sorted = (raptor_sequence**)calloc(RAPTOR_GOOD_CAST(size_t, count),
+                                     sizeof(raptor_sequence*));
+  if(!filenames || !sorted)
+    exit(1);
+
+  for(i = 0; i < count; i++)
+    filenames[i] = (i < 2) ? (char*)generated_files[i] : argv[i - 1];
+
+  for(i = 0; i < 2; i++) {
+    if(parse_test_generate_file(generated_files[i], i)) {
+      fprintf(stderr, "%s: Failed to write %s\n", program,
+              generated_files[i]);
+      exit(1);
+    }
+  }
+
+  for(i = 0; i < count; i++)
+    failures += parse_test_file(program, world, filenames[i], &sorted[i]);
+
+#ifdef RAPTOR_THREADS
+  failures += parse_test_concurrent(program, count, filenames, sorted);
+#endif
+
+  for(i = 0; i < 2; i++)
+    remove(generated_files[i]);
+
+  for(i = 0; i < count; i++) {
+    if(sorted[i])
+      raptor_free_sequence(sorted[i]);
+  }
+  free(sorted);
+  free(filenames);
+
+  raptor_free_world(world);
+
+  if(failures)
+    fprintf(stderr, "%s: %d failures\n", program, failures);
+
+  return failures;
+}
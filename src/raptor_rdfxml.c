@@ -1017,7 +1017,16 @@ raptor_rdfxml_parse_start(raptor_parser* rdf_parser)
   
   /* Create a new id_set if needed */
   if(RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser, RAPTOR_OPTION_CHECK_RDF_ID)) {
-    rdf_xml_parser->id_set = raptor_new_id_set(rdf_parser->world);
+    int filter_size;
+    size_t filter_bytes = 0;
+
+    filter_size = RAPTOR_OPTIONS_GET_NUMERIC(rdf_parser,
+                                             RAPTOR_OPTION_CHECK_RDF_ID_FILTER_SIZE);
+    if(filter_size > 0)
+      filter_bytes = RAPTOR_GOOD_CAST(size_t, filter_size) << 10;
+
+    rdf_xml_parser->id_set = raptor_new_id_set(rdf_parser->world,
+                                               filter_bytes);
     if(!rdf_xml_parser->id_set)
       return 1;
   }
@@ -1526,8 +1535,8 @@ raptor_rdfxml_process_property_attributes(raptor_parser *rdf_parser,
       raptor_uri *base_uri;
       raptor_uri *object_uri;
       base_uri = raptor_rdfxml_inscope_base_uri(rdf_parser);
-      object_uri = raptor_new_uri_relative_to_base(rdf_parser->world, 
-                                                   base_uri, value);
+      object_uri = raptor_parser_new_uri_relative_to_base(rdf_parser,
+                                                          base_uri, value, 0);
       object_term = raptor_new_term_from_uri(rdf_parser->world, object_uri);
       raptor_free_uri(object_uri);
     }
@@ -1777,9 +1786,9 @@ raptor_rdfxml_start_element_grammar(raptor_parser *rdf_parser,
         } else if(element->rdf_attr[RDF_NS_about]) {
           raptor_uri* subject_uri;
 
-          subject_uri = raptor_new_uri_relative_to_base(rdf_parser->world,
-                                                        base_uri,
-                                                        (const unsigned char*)element->rdf_attr[RDF_NS_about]);
+          subject_uri = raptor_parser_new_uri_relative_to_base(rdf_parser,
+                                                               base_uri,
+                                                               (const unsigned char*)element->rdf_attr[RDF_NS_about], 0);
           if(!subject_uri)
             goto oom;
           
@@ -2140,9 +2149,9 @@ raptor_rdfxml_start_element_grammar(raptor_parser *rdf_parser,
         if(element->rdf_attr[RDF_NS_datatype]) {
           raptor_uri *datatype_uri;
           
-          datatype_uri = raptor_new_uri_relative_to_base(rdf_parser->world, 
-                                                         base_uri,
-                                                         (const unsigned char*)element->rdf_attr[RDF_NS_datatype]);
+          datatype_uri = raptor_parser_new_uri_relative_to_base(rdf_parser,
+                                                                base_uri,
+                                                                (const unsigned char*)element->rdf_attr[RDF_NS_datatype], 0);
           element->object_literal_datatype = datatype_uri;
           RAPTOR_FREE(char*, element->rdf_attr[RDF_NS_datatype]);
           element->rdf_attr[RDF_NS_datatype] = NULL; 
@@ -2610,9 +2619,9 @@ raptor_rdfxml_end_element_grammar(raptor_parser *rdf_parser,
             if(!element->object) {
               if(element->rdf_attr[RDF_NS_resource]) {
                 raptor_uri* resource_uri;
-                resource_uri = raptor_new_uri_relative_to_base(rdf_parser->world,
-                                                               raptor_rdfxml_inscope_base_uri(rdf_parser),
-                                                               (const unsigned char*)element->rdf_attr[RDF_NS_resource]);
+                resource_uri = raptor_parser_new_uri_relative_to_base(rdf_parser,
+                                                                      raptor_rdfxml_inscope_base_uri(rdf_parser),
+                                                                      (const unsigned char*)element->rdf_attr[RDF_NS_resource], 0);
                 if(!resource_uri)
                   goto oom;
                 
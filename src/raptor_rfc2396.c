@@ -42,34 +42,28 @@
 
 #ifndef STANDALONE
 
-/**
- * raptor_new_uri_detail:
+/*
+ * raptor_uri_detail_split:
+ * @ud: URI detail to fill in
+ * @buffer: component buffer of at least @uri_len + 6 bytes
  * @uri_string: The URI string to split
+ * @uri_len: length of @uri_string
  *
- * Create a URI detailed structure from a URI string.
- * 
- **/
-raptor_uri_detail*
-raptor_new_uri_detail(const unsigned char *uri_string)
+ * INTERNAL - Split a URI string into components stored in @buffer
+ *
+ * The extra 6 bytes of @buffer are for the 5 \0s that may be added
+ * for each component even if the entire URI is empty, plus one.
+ */
+static void
+raptor_uri_detail_split(raptor_uri_detail *ud, unsigned char *buffer,
+                        const unsigned char *uri_string, size_t uri_len)
 {
   const unsigned char *s = NULL;
   unsigned char *b = NULL;
-  raptor_uri_detail *ud;
-  size_t uri_len;
 
-  if(!uri_string)
-    return NULL;
-
-  uri_len = strlen((const char*)uri_string);
-
-  /* The extra +5 is for the 5 \0s that may be added for each component 
-   * even if the entire URI is empty 
-   */
-  ud = RAPTOR_CALLOC(raptor_uri_detail*, 1, sizeof(*ud) + uri_len + 5 + 1);
-  if(!ud)
-    return NULL;
+  memset(ud, 0, sizeof(*ud));
   ud->uri_len = uri_len;
-  ud->buffer = (unsigned char*)((unsigned char*)ud + sizeof(raptor_uri_detail));
+  ud->buffer = buffer;
   
   s = uri_string;
   b = ud->buffer;
@@ -166,6 +160,37 @@ raptor_new_uri_detail(const unsigned char *uri_string)
   }
 
   ud->is_hierarchical = (ud->path && *ud->path == '/');
+}
+
+
+/**
+ * raptor_new_uri_detail:
+ * @uri_string: The URI string to split
+ *
+ * Create a URI detailed structure from a URI string.
+ * 
+ **/
+raptor_uri_detail*
+raptor_new_uri_detail(const unsigned char *uri_string)
+{
+  raptor_uri_detail *ud;
+  size_t uri_len;
+
+  if(!uri_string)
+    return NULL;
+
+  uri_len = strlen((const char*)uri_string);
+
+  /* The extra +5 is for the 5 \0s that may be added for each component 
+   * even if the entire URI is empty 
+   */
+  ud = RAPTOR_CALLOC(raptor_uri_detail*, 1, sizeof(*ud) + uri_len + 5 + 1);
+  if(!ud)
+    return NULL;
+
+  raptor_uri_detail_split(ud,
+                          (unsigned char*)((unsigned char*)ud + sizeof(raptor_uri_detail)),
+                          uri_string, uri_len);
 
   return ud;
 }
@@ -421,45 +446,38 @@ raptor_uri_normalize_path(unsigned char* path_buffer, size_t path_len)
 
 
 
-/**
- * raptor_uri_resolve_uri_reference:
+/*
+ * raptor_uri_resolve_uri_detail:
  * @base_uri: Base URI string
- * @reference_uri: Reference URI string
+ * @base: parsed @base_uri or NULL if @ref is absolute, empty or a fragment
+ * @ref: parsed reference URI
+ * @path_buffer: scratch buffer of at least base path length + 1 + ref path length + 1 bytes
  * @buffer: Destination URI output buffer
  * @length: Length of destination output buffer
  *
- * Resolve a URI against a base URI to create a new absolute URI.
- * 
+ * INTERNAL - Resolve a parsed reference against a parsed base URI
+ *
+ * Neither @base nor @ref are modified so either may be kept and
+ * reused for further resolutions.
+ *
  * Return value: length of resolved string or 0 on failure (such as @buffer too small)
- **/
-size_t
-raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
-                                 const unsigned char *reference_uri,
-                                 unsigned char *buffer, size_t length)
+ */
+static size_t
+raptor_uri_resolve_uri_detail(const unsigned char *base_uri,
+                              const raptor_uri_detail *base,
+                              const raptor_uri_detail *ref,
+                              unsigned char *path_buffer,
+                              unsigned char *buffer, size_t length)
 {
-  raptor_uri_detail *ref = NULL;
-  raptor_uri_detail *base = NULL;
   raptor_uri_detail result; /* static - pointers go to inside ref or base */
-  unsigned char *path_buffer = NULL;
+  const unsigned char *base_path;
+  size_t base_path_len;
   unsigned char *p;
-  size_t result_len = 0;
   size_t l;
   
-#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 2
-  RAPTOR_DEBUG4("base uri='%s', reference_uri='%s, buffer size %d\n",
-                (base_uri ? (const char*)base_uri : "NULL"),
-                (reference_uri ? (const char*)reference_uri : "NULL"),
-                (int)length);
-#endif
-
   *buffer = '\0';
   memset(&result, 0, sizeof(result));
 
-  ref = raptor_new_uri_detail(reference_uri);
-  if(!ref)
-    goto resolve_tidy;
-  
-
   /* is reference URI "" or "#frag"? */
   if(!ref->scheme && !ref->authority && !ref->path && !ref->query) {
     unsigned char c;
@@ -470,10 +488,8 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
         p++, base_uri++, l--)
       *p = c;
 
-    if(!l) {
-      result_len = 0;
-      goto resolve_tidy;
-    }
+    if(!l)
+      return 0;
     *p = '\0';
     
     if(ref->fragment) {
@@ -484,15 +500,12 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
         *p++ = *src++;
         l--;
       }
-      if(!l) {
-        result_len = 0;
-        goto resolve_tidy;
-      }
+      if(!l)
+        return 0;
       *p = '\0';
     }
 
-    result_len = p - buffer;
-    goto resolve_tidy;
+    return p - buffer;
   }
   
   /* reference has a scheme - is an absolute URI */
@@ -503,13 +516,8 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
     result.authority = ref->authority;
     result.authority_len = ref->authority_len;
     
-    /* Allocate path so it can be normalized below */
+    /* Copy path so it can be normalized below */
     result.path_len = ref->path_len;
-    path_buffer = RAPTOR_MALLOC(unsigned char*, result.path_len + 1);
-    if(!path_buffer) {
-      result_len = 0;
-      goto resolve_tidy;
-    }
     if(ref->path_len)
       memcpy(path_buffer, ref->path, ref->path_len);
     path_buffer[result.path_len] = '\0';
@@ -520,9 +528,8 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
   
 
   /* now the reference URI must be schemeless, i.e. relative */
-  base = raptor_new_uri_detail(base_uri);
   if(!base)
-    goto resolve_tidy;
+    return 0;
 
   /* result URI must be of the base URI scheme */
   result.scheme = base->scheme;
@@ -549,11 +556,6 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
      * is a non-hierarchical URI then just copy the reference path
      * to the result and normalize.
      */
-    path_buffer = RAPTOR_MALLOC(unsigned char*, ref->path_len + 1);
-    if(!path_buffer) {
-      result_len = 0;
-      goto resolve_tidy;
-    }
     result.path = path_buffer;
     result.path_len = ref->path_len;
     if(ref->path)
@@ -565,45 +567,36 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
 
   /* need to resolve relative path */
 
-  /* Build the result path in path_buffer */
-  result.path_len = 0;
-
-  if(base->path)
-    result.path_len += base->path_len;
-  else {
+  if(base->path) {
+    base_path = base->path;
+    base_path_len = base->path_len;
+  } else {
     /* Add a missing path - makes the base URI 1 character longer */
-    base->path = (unsigned char*)"/"; /* static, but copied and not free()d  */
-    base->path_len = 1;
-    base->uri_len++;
-    result.path_len++;
+    base_path = (const unsigned char*)"/";
+    base_path_len = 1;
   }
 
-  if(ref->path)
-    result.path_len += ref->path_len;
-
-  /* the resulting path can be no longer than result.path_len */
-  path_buffer = RAPTOR_MALLOC(unsigned char*, result.path_len + 1);
-  if(!path_buffer) {
-    result_len = 0;
-    goto resolve_tidy;
-  }
+  /* Build the result path in path_buffer */
   result.path = path_buffer;
   *path_buffer = '\0';
 
   if(!ref->path) {
     /* If there is no reference path, copy the full base over */
-    result.path_len = base->path_len;
-    memcpy(path_buffer, base->path, result.path_len);
+    result.path_len = base_path_len;
+    memcpy(path_buffer, base_path, result.path_len);
   } else {
+    const unsigned char *bp;
+
     /** Otherwise copy base path up to previous / and append ref path */
-    for(p = base->path + base->path_len - 1; p > base->path && *p != '/'; p--)
+    result.path_len = 0;
+    for(bp = base_path + base_path_len - 1; bp > base_path && *bp != '/'; bp--)
       ;
 
-    if(p >= base->path) {
-      result.path_len = p-base->path + 1;
+    if(bp >= base_path) {
+      result.path_len = bp - base_path + 1;
 
       /* Found a /, copy everything before that to path_buffer */
-      memcpy(path_buffer, base->path, result.path_len);
+      memcpy(path_buffer, base_path, result.path_len);
       path_buffer[result.path_len] = '\0';
     }
 
@@ -642,8 +635,7 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
 
   if(l > length) {
     /* Output buffer is too small */
-    result_len = 0;
-    goto resolve_tidy;
+    return 0;
   }
 
   p = buffer;
@@ -678,7 +670,61 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
   }
   *p = '\0';
   
-  result_len = p - buffer;
+  return p - buffer;
+}
+
+
+/**
+ * raptor_uri_resolve_uri_reference:
+ * @base_uri: Base URI string
+ * @reference_uri: Reference URI string
+ * @buffer: Destination URI output buffer
+ * @length: Length of destination output buffer
+ *
+ * Resolve a URI against a base URI to create a new absolute URI.
+ * 
+ * Return value: length of resolved string or 0 on failure (such as @buffer too small)
+ **/
+size_t
+raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
+                                 const unsigned char *reference_uri,
+                                 unsigned char *buffer, size_t length)
+{
+  raptor_uri_detail *ref = NULL;
+  raptor_uri_detail *base = NULL;
+  unsigned char *path_buffer = NULL;
+  size_t path_len;
+  size_t result_len = 0;
+  
+#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 2
+  RAPTOR_DEBUG4("base uri='%s', reference_uri='%s, buffer size %d\n",
+                (base_uri ? (const char*)base_uri : "NULL"),
+                (reference_uri ? (const char*)reference_uri : "NULL"),
+                (int)length);
+#endif
+
+  *buffer = '\0';
+
+  ref = raptor_new_uri_detail(reference_uri);
+  if(!ref)
+    goto resolve_tidy;
+
+  path_len = ref->path_len;
+
+  /* only a schemeless, non-empty reference needs the base parsed */
+  if(!ref->scheme && (ref->authority || ref->path || ref->query)) {
+    base = raptor_new_uri_detail(base_uri);
+    if(!base)
+      goto resolve_tidy;
+    path_len += base->path_len + 1;
+  }
+  
+  path_buffer = RAPTOR_MALLOC(unsigned char*, path_len + 1);
+  if(!path_buffer)
+    goto resolve_tidy;
+
+  result_len = raptor_uri_resolve_uri_detail(base_uri, base, ref,
+                                             path_buffer, buffer, length);
 
   resolve_tidy:
   if(path_buffer)
@@ -696,6 +742,265 @@ raptor_uri_resolve_uri_reference(const unsigned char *base_uri,
   return result_len;
 }
 
+
+/*
+ * raptor_uri_reference_is_normalized_absolute:
+ * @uri_string: reference URI string
+ * @uri_len: length of @uri_string
+ *
+ * INTERNAL - Check if a reference is an absolute URI that resolves to itself
+ *
+ * This is true when the reference has a scheme and there is no
+ * "." or ".." path segment that normalization could remove, so the
+ * resolved URI is the reference string unchanged and neither the base
+ * nor the reference need to be parsed.  Any "/." sequence at all,
+ * even inside a query or fragment, conservatively fails the check.
+ *
+ * Return value: non-0 if @uri_string can be used as-is
+ */
+int
+raptor_uri_reference_is_normalized_absolute(const unsigned char *uri_string,
+                                            size_t uri_len)
+{
+  const unsigned char *s = uri_string;
+  const unsigned char *end = uri_string + uri_len;
+
+  /* scheme = alpha *( alpha | digit | "+" | "-" | "." ) ":" */
+  if(s == end || !isalpha((int)*s))
+    return 0;
+
+  for(s++; s < end && *s != ':'; s++) {
+    if(!isalnum((int)*s) && *s != '+' && *s != '-' && *s != '.')
+      return 0;
+  }
+
+  /* no scheme, or a path starting with a "." segment */
+  if(s == end || (s + 1 < end && s[1] == '.'))
+    return 0;
+
+  for(s++; s + 1 < end; s++) {
+    if(*s == '/' && s[1] == '.')
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * Cached parsed-base URI resolver
+ *
+ * Resolving a reference with raptor_uri_resolve_uri_reference() parses
+ * both the base and reference into newly allocated structures and
+ * allocates a path buffer every time.  A resolver keeps the parsed
+ * form of the last base URI plus scratch buffers for the reference,
+ * path and result that only grow, so resolving many references
+ * against the same in-scope base needs no allocation beyond the new
+ * #raptor_uri itself.
+ */
+struct raptor_uri_resolver_s {
+  raptor_world* world;
+
+  /* base URI that base_detail was parsed from (a counted reference) */
+  raptor_uri* base_uri;
+  raptor_uri_detail base_detail;
+  unsigned char *base_buffer;
+  size_t base_buffer_size;
+
+  /* scratch buffers reused between resolutions */
+  unsigned char *ref_buffer;
+  size_t ref_buffer_size;
+  unsigned char *path_buffer;
+  size_t path_buffer_size;
+  unsigned char *buffer;
+  size_t buffer_size;
+};
+
+
+/*
+ * raptor_new_uri_resolver:
+ * @world: raptor world
+ *
+ * INTERNAL - Constructor - create a new cached base URI resolver
+ *
+ * Return value: new resolver or NULL on failure
+ */
+raptor_uri_resolver*
+raptor_new_uri_resolver(raptor_world* world)
+{
+  raptor_uri_resolver* resolver;
+
+  resolver = RAPTOR_CALLOC(raptor_uri_resolver*, 1, sizeof(*resolver));
+  if(!resolver)
+    return NULL;
+
+  resolver->world = world;
+
+  return resolver;
+}
+
+
+/*
+ * raptor_free_uri_resolver:
+ * @resolver: resolver
+ *
+ * INTERNAL - Destructor - destroy a cached base URI resolver
+ */
+void
+raptor_free_uri_resolver(raptor_uri_resolver* resolver)
+{
+  if(!resolver)
+    return;
+
+  if(resolver->base_uri)
+    raptor_free_uri(resolver->base_uri);
+  if(resolver->base_buffer)
+    RAPTOR_FREE(char*, resolver->base_buffer);
+  if(resolver->ref_buffer)
+    RAPTOR_FREE(char*, resolver->ref_buffer);
+  if(resolver->path_buffer)
+    RAPTOR_FREE(char*, resolver->path_buffer);
+  if(resolver->buffer)
+    RAPTOR_FREE(char*, resolver->buffer);
+
+  RAPTOR_FREE(raptor_uri_resolver, resolver);
+}
+
+
+/* Grow a resolver scratch buffer to hold at least @size bytes */
+static int
+raptor_uri_resolver_grow(unsigned char **buffer_p, size_t *size_p, size_t size)
+{
+  unsigned char *new_buffer;
+
+  if(*size_p >= size)
+    return 0;
+
+  /* at least double to keep the number of reallocations low */
+  if(size < *size_p * 2)
+    size = *size_p * 2;
+
+  new_buffer = RAPTOR_MALLOC(unsigned char*, size);
+  if(!new_buffer)
+    return 1;
+
+  if(*buffer_p)
+    RAPTOR_FREE(char*, *buffer_p);
+  *buffer_p = new_buffer;
+  *size_p = size;
+
+  return 0;
+}
+
+
+/* Parse and cache @base_uri if it is not the currently cached base */
+static int
+raptor_uri_resolver_set_base(raptor_uri_resolver* resolver,
+                             raptor_uri* base_uri)
+{
+  const unsigned char *base_string;
+  size_t base_len;
+
+  if(resolver->base_uri == base_uri)
+    return 0;
+
+  base_string = raptor_uri_as_counted_string(base_uri, &base_len);
+
+  /* a different object with the same string can reuse the parse */
+  if(resolver->base_uri && raptor_uri_equals(resolver->base_uri, base_uri)) {
+    raptor_free_uri(resolver->base_uri);
+    resolver->base_uri = raptor_uri_copy(base_uri);
+    return 0;
+  }
+
+  if(resolver->base_uri) {
+    raptor_free_uri(resolver->base_uri);
+    resolver->base_uri = NULL;
+  }
+
+  if(raptor_uri_resolver_grow(&resolver->base_buffer,
+                              &resolver->base_buffer_size, base_len + 6))
+    return 1;
+
+  raptor_uri_detail_split(&resolver->base_detail, resolver->base_buffer,
+                          base_string, base_len);
+  resolver->base_uri = raptor_uri_copy(base_uri);
+
+  return 0;
+}
+
+
+/*
+ * raptor_uri_resolver_resolve:
+ * @resolver: resolver
+ * @base_uri: in-scope base URI
+ * @uri_string: reference URI string
+ * @uri_len: length of @uri_string (or 0)
+ *
+ * INTERNAL - Resolve a reference against a base URI using cached state
+ *
+ * Gives the same result as raptor_new_uri_relative_to_base_counted()
+ * but @base_uri is only parsed again when it changes.
+ *
+ * Return value: a new #raptor_uri object or NULL on failure.
+ */
+raptor_uri*
+raptor_uri_resolver_resolve(raptor_uri_resolver* resolver,
+                            raptor_uri* base_uri,
+                            const unsigned char *uri_string, size_t uri_len)
+{
+  raptor_uri_detail ref;
+  const unsigned char *base_string;
+  size_t base_len;
+  size_t path_len;
+  size_t result_len;
+
+  if(!base_uri || !uri_string)
+    return NULL;
+
+  if(!uri_len)
+    uri_len = strlen(RAPTOR_GOOD_CAST(const char*, uri_string));
+
+  /* If URI string is empty, just copy base URI */
+  if(!*uri_string)
+    return raptor_uri_copy(base_uri);
+
+  if(raptor_uri_reference_is_normalized_absolute(uri_string, uri_len))
+    return raptor_new_uri_from_counted_string(resolver->world,
+                                              uri_string, uri_len);
+
+  if(raptor_uri_resolver_grow(&resolver->ref_buffer,
+                              &resolver->ref_buffer_size, uri_len + 6))
+    return NULL;
+  raptor_uri_detail_split(&ref, resolver->ref_buffer, uri_string, uri_len);
+
+  path_len = ref.path_len;
+  if(!ref.scheme) {
+    if(raptor_uri_resolver_set_base(resolver, base_uri))
+      return NULL;
+    path_len += resolver->base_detail.path_len + 1;
+  }
+
+  base_string = raptor_uri_as_counted_string(base_uri, &base_len);
+
+  /* +1 for adding any missing URI path '/' */
+  if(raptor_uri_resolver_grow(&resolver->path_buffer,
+                              &resolver->path_buffer_size, path_len + 1) ||
+     raptor_uri_resolver_grow(&resolver->buffer,
+                              &resolver->buffer_size, base_len + uri_len + 2))
+    return NULL;
+
+  result_len = raptor_uri_resolve_uri_detail(base_string,
+                                             ref.scheme ? NULL : &resolver->base_detail,
+                                             &ref,
+                                             resolver->path_buffer,
+                                             resolver->buffer,
+                                             base_len + uri_len + 1);
+
+  return raptor_new_uri_from_counted_string(resolver->world,
+                                            resolver->buffer, result_len);
+}
+
 #endif
 
 
@@ -709,6 +1014,10 @@ int main(int argc, char *argv[]);
 
 static const char *program;
 
+/* resolver shared by all checks so that cached bases get reused */
+static raptor_world *world = NULL;
+static raptor_uri_resolver *resolver = NULL;
+
 
 static int
 check_resolve(const char *base_uri, const char *reference_uri, 
@@ -733,6 +1042,30 @@ check_resolve(const char *base_uri, const char *reference_uri,
           program, base_uri, reference_uri, 
           buffer);
 #endif
+
+  /* The resolver returns the base URI unchanged for "" */
+  if(resolver && *reference_uri) {
+    raptor_uri *base;
+    raptor_uri *uri;
+    int rc = 0;
+
+    base = raptor_new_uri(world, (const unsigned char*)base_uri);
+    uri = raptor_uri_resolver_resolve(resolver, base,
+                                      (const unsigned char*)reference_uri, 0);
+    if(!uri || strcmp((const char*)raptor_uri_as_string(uri), result_uri)) {
+      fprintf(stderr,
+              "%s: raptor_uri_resolver_resolve(%s, %s) FAILED giving '%s' != '%s'\n",
+              program, base_uri, reference_uri,
+              uri ? (const char*)raptor_uri_as_string(uri) : "NULL",
+              result_uri);
+      rc = 1;
+    }
+    if(uri)
+      raptor_free_uri(uri);
+    raptor_free_uri(base);
+    return rc;
+  }
+
   return 0;
 }
 
@@ -762,6 +1095,13 @@ main(int argc, char *argv[])
   int failures = 0;
 
   program = raptor_basename(argv[0]);
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    return 1;
+  resolver = raptor_new_uri_resolver(world);
+  if(!resolver)
+    return 1;
   
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   fprintf(stderr, "%s: Using base URI '%s'\n", program, base_uri);
@@ -875,6 +1215,9 @@ main(int argc, char *argv[])
                             "http://example.com/folder1/folder2/../folder1/../entity1",
                             "http://example.com/folder1/entity1");
 
+  raptor_free_uri_resolver(resolver);
+  raptor_free_world(world);
+
   return failures;
 }
 
@@ -0,0 +1,428 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_scan.c - Fast scanning of byte runs up to a delimiter
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+/*
+ * Class of each byte value as a bitmask of RAPTOR_SCAN_* flags.
+ * Used by the scalar scanner, for the ends of a vector scan and by
+ * callers through RAPTOR_SCAN_BYTE_IN().
+ */
+#define BS RAPTOR_SCAN_BACKSLASH
+#define LT RAPTOR_SCAN_LT
+#define GT RAPTOR_SCAN_GT
+#define DQ RAPTOR_SCAN_DQUOTE
+#define SQ RAPTOR_SCAN_SQUOTE
+#define NL RAPTOR_SCAN_NEWLINE
+#define SP RAPTOR_SCAN_SPACE
+#define HI RAPTOR_SCAN_HIGH
+
+const unsigned char raptor_scan_byte_classes[256] = {
+  /* 0x00 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  NL, 0,  0,  NL, 0,  0,
+  /* 0x10 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  /* 0x20 */ SP, 0,  DQ, 0,  0,  0,  0,  SQ, 0,  0,  0,  0,  0,  0,  0,  0,
+  /* 0x30 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  LT, 0,  GT, 0,
+  /* 0x40 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  /* 0x50 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  BS, 0,  0,  0,
+  /* 0x60 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  /* 0x70 */ 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+  /* 0x80 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0x90 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xA0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xB0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xC0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xD0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xE0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI,
+  /* 0xF0 */ HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI, HI
+};
+
+#undef BS
+#undef LT
+#undef GT
+#undef DQ
+#undef SQ
+#undef NL
+#undef SP
+#undef HI
+
+
+static size_t
+raptor_scan_span_scalar(const unsigned char* s, size_t len, int classes)
+{
+  size_t i = 0;
+
+  while(i < len && !(raptor_scan_byte_classes[s[i]] & classes))
+    i++;
+
+  return i;
+}
+
+
+#if defined(__SSE2__) || defined(HAVE_AVX2_DISPATCH)
+
+/* maximum number of distinct delimiter bytes in all classes */
+#define RAPTOR_SCAN_MAX_NEEDLES 8
+
+/* bytes checked one at a time before a vector scan */
+#define RAPTOR_SCAN_SCALAR_PREFIX 8
+
+/*
+ * raptor_scan_needles:
+ * @classes: bitmask of RAPTOR_SCAN_* classes
+ * @needles: array of RAPTOR_SCAN_MAX_NEEDLES bytes to fill
+ *
+ * INTERNAL - Get the delimiter bytes for a set of classes
+ *
+ * Unused entries repeat the first byte so that a vector scanner can
+ * always compare against all RAPTOR_SCAN_MAX_NEEDLES of them.
+ * RAPTOR_SCAN_HIGH is not a byte and is handled by the caller.
+ */
+static void
+raptor_scan_needles(int classes, unsigned char* needles)
+{
+  int count = 0;
+  int i;
+
+  if(classes & RAPTOR_SCAN_BACKSLASH)
+    needles[count++] = '\\';
+  if(classes & RAPTOR_SCAN_LT)
+    needles[count++] = '<';
+  if(classes & RAPTOR_SCAN_GT)
+    needles[count++] = '>';
+  if(classes & RAPTOR_SCAN_DQUOTE)
+    needles[count++] = '"';
+  if(classes & RAPTOR_SCAN_SQUOTE)
+    needles[count++] = '\'';
+  if(classes & RAPTOR_SCAN_NEWLINE) {
+    needles[count++] = '\n';
+    needles[count++] = '\r';
+  }
+  if(classes & RAPTOR_SCAN_SPACE)
+    needles[count++] = ' ';
+
+  for(i = count; i < RAPTOR_SCAN_MAX_NEEDLES; i++)
+    needles[i] = needles[0];
+}
+
+
+static int
+raptor_scan_first_bit(unsigned int mask)
+{
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+
+  while(!(mask & 1)) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+#endif
+
+
+#ifdef __SSE2__
+
+static size_t
+raptor_scan_span_sse2(const unsigned char* s, size_t len, int classes)
+{
+  unsigned char needles[RAPTOR_SCAN_MAX_NEEDLES];
+  __m128i n0, n1, n2, n3, n4, n5, n6, n7;
+  int high = (classes & RAPTOR_SCAN_HIGH);
+  size_t i = 0;
+
+  /* delimiters are often close together: look at the first few
+   * bytes before setting up the vectors
+   */
+  for(; i < RAPTOR_SCAN_SCALAR_PREFIX; i++) {
+    if(i == len || (raptor_scan_byte_classes[s[i]] & classes))
+      return i;
+  }
+
+  raptor_scan_needles(classes, needles);
+  n0 = _mm_set1_epi8((char)needles[0]);
+  n1 = _mm_set1_epi8((char)needles[1]);
+  n2 = _mm_set1_epi8((char)needles[2]);
+  n3 = _mm_set1_epi8((char)needles[3]);
+  n4 = _mm_set1_epi8((char)needles[4]);
+  n5 = _mm_set1_epi8((char)needles[5]);
+  n6 = _mm_set1_epi8((char)needles[6]);
+  n7 = _mm_set1_epi8((char)needles[7]);
+
+  for(; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+    __m128i m;
+    unsigned int mask;
+
+    m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, n0),
+                                  _mm_cmpeq_epi8(v, n1)),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, n2),
+                                  _mm_cmpeq_epi8(v, n3)));
+    m = _mm_or_si128(m,
+                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, n4),
+                                               _mm_cmpeq_epi8(v, n5)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, n6),
+                                               _mm_cmpeq_epi8(v, n7))));
+    if(high)
+      m = _mm_or_si128(m, v);
+
+    mask = (unsigned int)_mm_movemask_epi8(m);
+    if(mask)
+      return i + raptor_scan_first_bit(mask);
+  }
+
+  return i + raptor_scan_span_scalar(s + i, len - i, classes);
+}
+
+#endif
+
+
+#ifdef HAVE_AVX2_DISPATCH
+
+__attribute__((target("avx2")))
+static size_t
+raptor_scan_span_avx2(const unsigned char* s, size_t len, int classes)
+{
+  unsigned char needles[RAPTOR_SCAN_MAX_NEEDLES];
+  __m256i n0, n1, n2, n3, n4, n5, n6, n7;
+  int high = (classes & RAPTOR_SCAN_HIGH);
+  size_t i = 0;
+
+  for(; i < RAPTOR_SCAN_SCALAR_PREFIX; i++) {
+    if(i == len || (raptor_scan_byte_classes[s[i]] & classes))
+      return i;
+  }
+
+  raptor_scan_needles(classes, needles);
+  n0 = _mm256_set1_epi8((char)needles[0]);
+  n1 = _mm256_set1_epi8((char)needles[1]);
+  n2 = _mm256_set1_epi8((char)needles[2]);
+  n3 = _mm256_set1_epi8((char)needles[3]);
+  n4 = _mm256_set1_epi8((char)needles[4]);
+  n5 = _mm256_set1_epi8((char)needles[5]);
+  n6 = _mm256_set1_epi8((char)needles[6]);
+  n7 = _mm256_set1_epi8((char)needles[7]);
+
+  for(; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+    __m256i m;
+    unsigned int mask;
+
+    m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, n0),
+                                        _mm256_cmpeq_epi8(v, n1)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, n2),
+                                        _mm256_cmpeq_epi8(v, n3)));
+    m = _mm256_or_si256(m,
+                        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, n4),
+                                                        _mm256_cmpeq_epi8(v, n5)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, n6),
+                                                        _mm256_cmpeq_epi8(v, n7))));
+    if(high)
+      m = _mm256_or_si256(m, v);
+
+    mask = (unsigned int)_mm256_movemask_epi8(m);
+    if(mask) {
+      _mm256_zeroupper();
+      return i + raptor_scan_first_bit(mask);
+    }
+  }
+
+  /* avoid AVX to SSE transition penalties in the caller; compilers
+   * do not always add this themselves
+   */
+  _mm256_zeroupper();
+
+  return i + raptor_scan_span_scalar(s + i, len - i, classes);
+}
+
+#endif
+
+
+/*
+ * raptor_scan_get_span_function:
+ * @impl: implementation to get
+ *
+ * INTERNAL - Get a span scanning function
+ *
+ * With #RAPTOR_SCAN_IMPL_BEST the fastest implementation supported
+ * by the running CPU is returned, falling back to the scalar one.
+ *
+ * The returned function takes a string, its length and a bitmask of
+ * RAPTOR_SCAN_* classes, which must include at least one class other
+ * than #RAPTOR_SCAN_HIGH, and returns the length of the initial run
+ * of bytes not in any of the classes.
+ *
+ * Return value: function or NULL if @impl is not available
+ */
+raptor_scan_span_function
+raptor_scan_get_span_function(raptor_scan_impl impl)
+{
+  switch(impl) {
+    case RAPTOR_SCAN_IMPL_SCALAR:
+      return raptor_scan_span_scalar;
+
+    case RAPTOR_SCAN_IMPL_SSE2:
+#ifdef __SSE2__
+      return raptor_scan_span_sse2;
+#else
+      break;
+#endif
+
+    case RAPTOR_SCAN_IMPL_AVX2:
+#ifdef HAVE_AVX2_DISPATCH
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx2"))
+        return raptor_scan_span_avx2;
+#endif
+      break;
+
+    case RAPTOR_SCAN_IMPL_BEST:
+    default:
+#ifdef HAVE_AVX2_DISPATCH
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx2"))
+        return raptor_scan_span_avx2;
+#endif
+#ifdef __SSE2__
+      return raptor_scan_span_sse2;
+#else
+      return raptor_scan_span_scalar;
+#endif
+  }
+
+  return NULL;
+}
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static const int test_classes[] = {
+  RAPTOR_SCAN_BACKSLASH | RAPTOR_SCAN_LT | RAPTOR_SCAN_GT |
+  RAPTOR_SCAN_DQUOTE | RAPTOR_SCAN_SQUOTE | RAPTOR_SCAN_NEWLINE,
+  RAPTOR_SCAN_BACKSLASH | RAPTOR_SCAN_GT | RAPTOR_SCAN_SPACE |
+  RAPTOR_SCAN_HIGH,
+  RAPTOR_SCAN_BACKSLASH | RAPTOR_SCAN_DQUOTE | RAPTOR_SCAN_HIGH,
+  RAPTOR_SCAN_NEWLINE,
+  0xff
+};
+
+static const char* const impl_names[] = { "scalar", "SSE2", "AVX2" };
+
+#define TEST_BUFFER_SIZE 200
+#define TEST_ROUNDS 1000
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  static const unsigned char alphabet[] = "abc:/#.<>\"'\\ \r\n\xc3\xa9";
+  unsigned char buffer[TEST_BUFFER_SIZE];
+  unsigned long seed = 1;
+  int round;
+  int impl;
+  int failures = 0;
+
+  if(!raptor_scan_get_span_function(RAPTOR_SCAN_IMPL_BEST)) {
+    fprintf(stderr, "%s: No span function\n", program);
+    return 1;
+  }
+
+  for(impl = RAPTOR_SCAN_IMPL_SSE2; impl <= RAPTOR_SCAN_IMPL_AVX2; impl++) {
+    raptor_scan_span_function span;
+
+    span = raptor_scan_get_span_function((raptor_scan_impl)impl);
+    if(!span)
+      continue;
+
+    for(round = 0; round < TEST_ROUNDS; round++) {
+      size_t len;
+      size_t i;
+      unsigned int c;
+
+      /* mostly plain bytes with the odd delimiter at a random offset */
+      seed = seed * 1103515245UL + 12345UL;
+      len = (seed >> 8) % TEST_BUFFER_SIZE;
+      for(i = 0; i < len; i++) {
+        seed = seed * 1103515245UL + 12345UL;
+        if((seed >> 16) % 50)
+          buffer[i] = (unsigned char)('a' + (seed >> 8) % 26);
+        else
+          buffer[i] = alphabet[(seed >> 8) % (sizeof(alphabet) - 1)];
+      }
+
+      for(c = 0; c < sizeof(test_classes) / sizeof(int); c++) {
+        size_t expected;
+        size_t got;
+
+        /* every start offset to cover unaligned loads and tails */
+        for(i = 0; i <= len; i++) {
+          expected = raptor_scan_span_scalar(buffer + i, len - i,
+                                             test_classes[c]);
+          got = span(buffer + i, len - i, test_classes[c]);
+          if(got != expected) {
+            fprintf(stderr,
+                    "%s: %s span of %d bytes with classes 0x%x returned %d expected %d\n",
+                    program, impl_names[impl], (int)(len - i),
+                    test_classes[c], (int)got, (int)expected);
+            failures++;
+            if(failures > 10)
+              return failures;
+          }
+        }
+      }
+    }
+  }
+
+  return failures;
+}
+
+#endif
@@ -606,6 +606,8 @@ raptor_serializer_serialize_end(raptor_serializer *rdf_serializer)
     rc = 0;
 
   if(rdf_serializer->iostream) {
+    if(raptor_iostream_flush(rdf_serializer->iostream))
+      rc = 1;
     if(rdf_serializer->free_iostream_on_end)
       raptor_free_iostream(rdf_serializer->iostream);
     rdf_serializer->iostream = NULL;
@@ -637,12 +639,46 @@ raptor_free_serializer(raptor_serializer* rdf_serializer)
   if(rdf_serializer->base_uri)
     raptor_free_uri(rdf_serializer->base_uri);
 
+  if(rdf_serializer->relativiser)
+    raptor_free_uri_relativiser(rdf_serializer->relativiser);
+
   raptor_object_options_clear(&rdf_serializer->options);
 
   RAPTOR_FREE(raptor_serializer, rdf_serializer);
 }
 
 
+/*
+ * raptor_serializer_uri_to_relative_string:
+ * @serializer: serializer
+ * @uri: URI
+ * @length_p: pointer to store string length or NULL
+ *
+ * INTERNAL - Get a URI string relative to the serializer base URI
+ *
+ * The relativiser keeps the base URI parsed between calls and is
+ * rebound whenever the serializer base URI changes.  The string is
+ * shared and only valid until the next call or until @uri is freed.
+ *
+ * Return value: shared URI string or NULL on failure
+ */
+const unsigned char*
+raptor_serializer_uri_to_relative_string(raptor_serializer* serializer,
+                                         raptor_uri* uri, size_t* length_p)
+{
+  if(!serializer->relativiser) {
+    serializer->relativiser = raptor_new_uri_relativiser(serializer->base_uri);
+    if(!serializer->relativiser)
+      return NULL;
+  } else if(raptor_uri_relativiser_set_base(serializer->relativiser,
+                                            serializer->base_uri))
+    return NULL;
+
+  return raptor_uri_relativiser_relativise(serializer->relativiser, uri,
+                                           length_p);
+}
+
+
 /**
  * raptor_serializer_get_iostream:
  * @serializer: #raptor_serializer object
@@ -787,5 +823,8 @@ raptor_serializer_flush(raptor_serializer *rdf_serializer)
   else
     rc = 0;
 
+  if(!rc && rdf_serializer->iostream)
+    rc = raptor_iostream_flush(rdf_serializer->iostream);
+
   return rc;
 }
@@ -57,6 +57,12 @@ typedef struct {
 
   int need_object_comma;
 
+  /* Bytes of statements to hold in avltree before writing them to a
+   * run of spill or 0 to hold everything in memory
+   */
+  size_t memory_budget;
+  size_t memory_used;
+  raptor_spill* spill;
 } raptor_json_context;
 
 
@@ -105,6 +111,11 @@ raptor_json_serialize_terminate(raptor_serializer* serializer)
     raptor_free_avltree(context->avltree);
     context->avltree = NULL;
   }
+
+  if(context->spill) {
+    raptor_free_spill(context->spill);
+    context->spill = NULL;
+  }
 }
 
 
@@ -114,6 +125,7 @@ raptor_json_serialize_start(raptor_serializer* serializer)
   raptor_json_context* context = (raptor_json_context*)serializer->context;
   raptor_uri* base_uri;
   char* value;
+  int budget;
   
   base_uri = RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_RELATIVE_URIS)
              ? serializer->base_uri : NULL;
@@ -133,6 +145,13 @@ raptor_json_serialize_start(raptor_serializer* serializer)
       context->json_writer = NULL;
       return 1;
     }
+
+    budget = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                        RAPTOR_OPTION_MEMORY_BUDGET);
+    context->memory_budget = 0;
+    context->memory_used = 0;
+    if(budget > 0)
+      context->memory_budget = RAPTOR_GOOD_CAST(size_t, budget) * 1024;
   }
 
   /* start callback */
@@ -158,6 +177,63 @@ raptor_json_serialize_start(raptor_serializer* serializer)
 }
 
 
+/*
+ * raptor_json_spill_statements:
+ * @serializer: #raptor_serializer object
+ *
+ * Write the statements held in memory to a new run of the spill.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_json_spill_statements(raptor_serializer* serializer)
+{
+  raptor_json_context* context = (raptor_json_context*)serializer->context;
+  raptor_avltree_iterator* iter;
+  raptor_avltree* avltree;
+  int rc = 0;
+
+  if(!context->spill) {
+    context->spill = raptor_new_spill(serializer->world);
+    if(!context->spill)
+      return 1;
+  }
+
+  if(raptor_spill_start_run(context->spill))
+    return 1;
+
+  iter = raptor_new_avltree_iterator(context->avltree, NULL, NULL, 1);
+  while(iter && !rc) {
+    raptor_statement* statement;
+
+    statement = (raptor_statement*)raptor_avltree_iterator_get(iter);
+    if(!statement)
+      break;
+    rc = raptor_spill_write(context->spill, statement, 0);
+
+    if(raptor_avltree_iterator_next(iter))
+      break;
+  }
+  if(iter)
+    raptor_free_avltree_iterator(iter);
+
+  if(raptor_spill_end_run(context->spill) || rc)
+    return 1;
+
+  avltree = raptor_new_avltree((raptor_data_compare_handler)raptor_statement_compare,
+                               (raptor_data_free_handler)raptor_free_statement,
+                               0);
+  if(!avltree)
+    return 1;
+
+  raptor_free_avltree(context->avltree);
+  context->avltree = avltree;
+  context->memory_used = 0;
+
+  return 0;
+}
+
+
 static int
 raptor_json_serialize_statement(raptor_serializer* serializer, 
                                 raptor_statement *statement)
@@ -166,9 +242,19 @@ raptor_json_serialize_statement(raptor_serializer* serializer,
 
   if(context->is_resource) {
     raptor_statement* s = raptor_statement_copy(statement);
+    int rc;
+
     if(!s)
       return 1;
-    return raptor_avltree_add(context->avltree, s);
+    rc = raptor_avltree_add(context->avltree, s);
+    if(rc || !context->memory_budget)
+      return rc;
+
+    context->memory_used += raptor_spill_statement_size(statement);
+    if(context->memory_used > context->memory_budget)
+      rc = raptor_json_spill_statements(serializer);
+
+    return rc;
   }
 
   if(context->need_subject_comma) {
@@ -337,6 +423,7 @@ raptor_json_serialize_end(raptor_serializer* serializer)
 {
   raptor_json_context* context = (raptor_json_context*)serializer->context;
   char* value;
+  int merged;
   
   raptor_json_writer_newline(context->json_writer);
 
@@ -345,9 +432,34 @@ raptor_json_serialize_end(raptor_serializer* serializer)
     raptor_json_writer_start_block(context->json_writer, '{');
     raptor_json_writer_newline(context->json_writer);
     
-    raptor_avltree_visit(context->avltree,
-                         raptor_json_serialize_avltree_visit,
-                         serializer);
+    merged = (context->spill && !raptor_json_spill_statements(serializer));
+    if(merged) {
+      /* statements from the runs in order; the visit handler keeps a
+       * pointer to the last one so it is freed after the next visit */
+      raptor_statement* statement;
+
+      if(!raptor_spill_merge_start(context->spill)) {
+        while((statement = raptor_spill_merge_get(context->spill, NULL, NULL))) {
+          raptor_statement* last = context->last_statement;
+
+          /* duplicates may be in several runs */
+          if(!last || raptor_statement_compare(last, statement)) {
+            statement = raptor_statement_copy(statement);
+            if(!statement)
+              break;
+            raptor_json_serialize_avltree_visit(0, statement, serializer);
+            if(last)
+              raptor_free_statement(last);
+          }
+
+          if(raptor_spill_merge_next(context->spill))
+            break;
+        }
+      }
+    } else
+      raptor_avltree_visit(context->avltree,
+                           raptor_json_serialize_avltree_visit,
+                           serializer);
 
     /* end last triples block */
     if(context->last_statement) {
@@ -358,6 +470,17 @@ raptor_json_serialize_end(raptor_serializer* serializer)
       raptor_json_writer_end_block(context->json_writer, '}');
       raptor_json_writer_newline(context->json_writer);
     }
+
+    if(merged) {
+      if(context->last_statement)
+        raptor_free_statement(context->last_statement);
+      context->last_statement = NULL;
+    }
+
+    if(context->spill) {
+      raptor_free_spill(context->spill);
+      context->spill = NULL;
+    }
   } else {
     /* end triples array */
     raptor_json_writer_end_block(context->json_writer, ']');
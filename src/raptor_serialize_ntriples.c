@@ -229,6 +229,129 @@ raptor_ntriples_serialize_statement(raptor_serializer* serializer,
 }
 
 
+/*
+ * raptor_ntriples_token_write:
+ * @token: N-Triples token
+ * @iostr: raptor iostream
+ *
+ * INTERNAL - Write a lexed N-Triples term as raptor_term_escaped_write() would write the term made from it
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_ntriples_token_write(const raptor_ntriples_token* token,
+                            raptor_iostream* iostr)
+{
+  switch(token->type) {
+    case RAPTOR_TERM_TYPE_LITERAL:
+      raptor_iostream_write_byte('"', iostr);
+      raptor_string_escaped_write(token->string, token->string_len, '"',
+                                  RAPTOR_ESCAPED_WRITE_NTRIPLES_LITERAL,
+                                  iostr);
+      raptor_iostream_write_byte('"', iostr);
+
+      if(token->language) {
+        raptor_iostream_write_byte('@', iostr);
+        raptor_iostream_counted_string_write(token->language,
+                                             token->language_len, iostr);
+      }
+      if(token->datatype) {
+        raptor_iostream_counted_string_write("^^<", 3, iostr);
+        raptor_string_escaped_write(token->datatype, token->datatype_len,
+                                    '>', RAPTOR_ESCAPED_WRITE_NTRIPLES_URI,
+                                    iostr);
+        raptor_iostream_write_byte('>', iostr);
+      }
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      raptor_iostream_counted_string_write("_:", 2, iostr);
+      raptor_iostream_counted_string_write(token->string, token->string_len,
+                                           iostr);
+      break;
+
+    case RAPTOR_TERM_TYPE_URI:
+      raptor_iostream_write_byte('<', iostr);
+      raptor_string_escaped_write(token->string, token->string_len, '>',
+                                  RAPTOR_ESCAPED_WRITE_NTRIPLES_URI, iostr);
+      raptor_iostream_write_byte('>', iostr);
+      break;
+
+    case RAPTOR_TERM_TYPE_UNKNOWN:
+    default:
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * raptor_ntriples_serialize_tokens:
+ * @serializer: N-Triples or N-Quads serializer
+ * @tokens: array of 4 tokens: subject, predicate, object, graph
+ *
+ * INTERNAL - Serialize a statement straight from N-Triples tokens
+ *
+ * Used by the N-Triples and N-Quads parsers to convert without making
+ * any terms.  The output is the same as for the statement made from
+ * @tokens.  The graph token is used if it is not of type
+ * %RAPTOR_TERM_TYPE_UNKNOWN.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_ntriples_serialize_tokens(raptor_serializer* serializer,
+                                 const raptor_ntriples_token* tokens)
+{
+  raptor_ntriples_serializer_context* ntriples_serializer;
+  raptor_iostream* iostr = serializer->iostream;
+
+  ntriples_serializer = (raptor_ntriples_serializer_context*)serializer->context;
+
+  if(!iostr)
+    return 1;
+
+  if(raptor_ntriples_token_write(&tokens[0], iostr))
+    return 1;
+
+  raptor_iostream_write_byte(' ', iostr);
+  if(raptor_ntriples_token_write(&tokens[1], iostr))
+    return 1;
+
+  raptor_iostream_write_byte(' ', iostr);
+  if(raptor_ntriples_token_write(&tokens[2], iostr))
+    return 1;
+
+  if(tokens[3].type != RAPTOR_TERM_TYPE_UNKNOWN &&
+     ntriples_serializer->is_nquads) {
+    raptor_iostream_write_byte(' ', iostr);
+    if(raptor_ntriples_token_write(&tokens[3], iostr))
+      return 1;
+  }
+
+  raptor_iostream_counted_string_write(" .\n", 3, iostr);
+
+  return 0;
+}
+
+
+/*
+ * raptor_serializer_is_ntriples:
+ * @serializer: serializer
+ *
+ * INTERNAL - Check for an N-Triples or N-Quads serializer
+ *
+ * Return value: non-0 if raptor_ntriples_serialize_tokens() can be used
+ */
+int
+raptor_serializer_is_ntriples(raptor_serializer* serializer)
+{
+  return serializer->factory->serialize_statement ==
+         raptor_ntriples_serialize_statement;
+}
+
+
 #if 0
 /* end a serialize */
 static int
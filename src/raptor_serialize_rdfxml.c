@@ -332,8 +332,8 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
   raptor_xml_writer* xml_writer = context->xml_writer;
   unsigned char* uri_string = NULL; /* predicate URI */
   unsigned char* name = NULL;  /* where to split predicate name */
-  unsigned char* subject_uri_string = NULL;
-  unsigned char* object_uri_string = NULL;
+  const unsigned char* subject_uri_string = NULL;
+  const unsigned char* object_uri_string = NULL;
   const unsigned char* nsprefix = (const unsigned char*)"ns0";
   int rc = 1;
   size_t len;
@@ -346,7 +346,6 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
   int attrs_count = 0;
   raptor_uri* base_uri = NULL;
   raptor_term_type object_type;
-  int allocated = 1;
   int object_is_parseTypeLiteral = 0;
   
   if(raptor_rdfxml_ensure_writen_header(serializer, context))
@@ -435,28 +434,21 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
       break;
 
     case RAPTOR_TERM_TYPE_URI:
-      allocated = 1;
       if(RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_RELATIVE_URIS)) {
-        subject_uri_string = raptor_uri_to_relative_uri_string(serializer->base_uri,
-                                                               statement->subject->value.uri);
+        /* shared string */
+        subject_uri_string = raptor_serializer_uri_to_relative_string(serializer,
+                                                                      statement->subject->value.uri,
+                                                                      NULL);
         if(!subject_uri_string)
           goto oom;
-      } else {
+      } else
         subject_uri_string = raptor_uri_as_string(statement->subject->value.uri);
-        allocated = 0;
-      }
 
       attrs[attrs_count] = raptor_new_qname_from_namespace_local_name(serializer->world, context->rdf_nspace, (const unsigned char*)"about",  subject_uri_string);
-      if(!attrs[attrs_count]) {
-        if(allocated)
-          RAPTOR_FREE(char*, subject_uri_string);
+      if(!attrs[attrs_count])
         goto oom;
-      }
       attrs_count++;
 
-      if(allocated)
-        RAPTOR_FREE(char*, subject_uri_string);
-
       break;
 
     case RAPTOR_TERM_TYPE_LITERAL:
@@ -572,16 +564,17 @@ raptor_rdfxml_serialize_statement(raptor_serializer* serializer,
     case RAPTOR_TERM_TYPE_URI:
       /* must be URI */
       if(RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_RELATIVE_URIS)) {
-        object_uri_string = raptor_uri_to_relative_uri_string(serializer->base_uri,
-                                                              statement->object->value.uri);
+        /* shared string */
+        object_uri_string = raptor_serializer_uri_to_relative_string(serializer,
+                                                                     statement->object->value.uri,
+                                                                     NULL);
       } else {
-        object_uri_string = raptor_uri_to_string(statement->object->value.uri);
+        object_uri_string = raptor_uri_as_string(statement->object->value.uri);
       }
       if(!object_uri_string)
         goto oom;
 
       attrs[attrs_count] = raptor_new_qname_from_namespace_local_name(serializer->world, context->rdf_nspace, (const unsigned char*)"resource", object_uri_string);
-      RAPTOR_FREE(char*, object_uri_string);
 
       if(!attrs[attrs_count])
         goto oom;
@@ -86,6 +86,13 @@ typedef struct {
 
   /* If non-0, emit typed nodes */
   int write_typed_nodes;
+
+  /* Bytes of URI subject statements to hold before writing them to
+   * a run of spill or 0 to hold everything in memory
+   */
+  size_t memory_budget;
+  size_t memory_used;
+  raptor_spill* spill;
 } raptor_rdfxmla_context;
 
 
@@ -153,7 +160,7 @@ raptor_rdfxmla_emit_resource_uri(raptor_serializer *serializer,
   raptor_xml_writer *xml_writer = context->xml_writer;
   raptor_qname **attrs;
   unsigned char *attr_name;
-  unsigned char *attr_value;
+  const unsigned char *attr_value;
   
   RAPTOR_DEBUG2("Emitting resource predicate URI %s\n",
                 raptor_uri_as_string(uri));
@@ -165,19 +172,22 @@ raptor_rdfxmla_emit_resource_uri(raptor_serializer *serializer,
   attr_name = (unsigned char *)"resource";
 
   if(RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_RELATIVE_URIS))
-    /* newly allocated string */
-    attr_value = raptor_uri_to_relative_uri_string(serializer->base_uri, uri);
+    /* shared string */
+    attr_value = raptor_serializer_uri_to_relative_string(serializer, uri,
+                                                          NULL);
   else
     attr_value = raptor_uri_as_string(uri);
 
+  if(!attr_value) {
+    RAPTOR_FREE(qnamearray, attrs);
+    return 1;
+  }
+
   attrs[0] = raptor_new_qname_from_namespace_local_name(serializer->world,
                                                         context->rdf_nspace,
                                                         attr_name, 
                                                         attr_value);
       
-  if(RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_RELATIVE_URIS))
-    RAPTOR_FREE(char*, attr_value);
-
   if(!attrs[0]) {
     RAPTOR_FREE(qnamearray, attrs);
     return 1;
@@ -632,7 +642,7 @@ raptor_rdfxmla_emit_subject(raptor_serializer *serializer,
   raptor_xml_element *element = NULL;
   raptor_qname **attrs;
   unsigned char *attr_name;
-  unsigned char *attr_value;
+  const unsigned char *attr_value;
   raptor_uri *base_uri = NULL;
   int subject_is_single_node;
   raptor_term *subject_term = subject->node->term;
@@ -703,13 +713,15 @@ raptor_rdfxmla_emit_subject(raptor_serializer *serializer,
     attr_name = (unsigned char*)"about";
     if(context->is_xmp) {
       /* XML rdf:about value is always "" */
-      attr_value = RAPTOR_CALLOC(unsigned char*, 1, sizeof(unsigned char));
+      attr_value = (const unsigned char*)"";
     } else if(RAPTOR_OPTIONS_GET_NUMERIC(serializer,
                                          RAPTOR_OPTION_RELATIVE_URIS))
-      attr_value = raptor_uri_to_relative_uri_string(serializer->base_uri,
-                                                     subject_term->value.uri);
+      /* shared string */
+      attr_value = raptor_serializer_uri_to_relative_string(serializer,
+                                                            subject_term->value.uri,
+                                                            NULL);
     else
-      attr_value = raptor_uri_to_string(subject_term->value.uri);
+      attr_value = raptor_uri_as_string(subject_term->value.uri);
     
   } else if(subject_term->type == RAPTOR_TERM_TYPE_BLANK) {
     if(subject->node->count_as_subject &&
@@ -730,9 +742,6 @@ raptor_rdfxmla_emit_subject(raptor_serializer *serializer,
                                                           attr_name,
                                                           attr_value);
     
-    if(subject_term->type != RAPTOR_TERM_TYPE_BLANK)
-      RAPTOR_FREE(char*, attr_value);
-    
     if(!attrs[0]) {
       RAPTOR_FREE(qnamearray, attrs);
       goto oom;  
@@ -913,6 +922,11 @@ raptor_rdfxmla_serialize_terminate(raptor_serializer* serializer)
     context->rdf_RDF_element = NULL;
   }
 
+  if(context->spill) {
+    raptor_free_spill(context->spill);
+    context->spill = NULL;
+  }
+
   if(context->rdf_nspace) {
     raptor_free_namespace(context->rdf_nspace);
     context->rdf_nspace = NULL;
@@ -1189,6 +1203,16 @@ raptor_rdfxmla_serialize_start(raptor_serializer* serializer)
 
     context->xml_writer = xml_writer;
   }
+
+  /* XMP output depends on the order statements arrive in */
+  context->memory_budget = 0;
+  context->memory_used = 0;
+  if(!context->is_xmp) {
+    int budget = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                            RAPTOR_OPTION_MEMORY_BUDGET);
+    if(budget > 0)
+      context->memory_budget = RAPTOR_GOOD_CAST(size_t, budget) * 1024;
+  }
   
   return 0;
 }
@@ -1285,6 +1309,104 @@ raptor_rdfxmla_ensure_writen_header(raptor_serializer* serializer,
 }
   
 
+/*
+ * raptor_rdfxmla_spill_subjects:
+ * @serializer: #raptor_serializer object
+ *
+ * Write the URI subjects held in memory to a new run of the spill.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_rdfxmla_spill_subjects(raptor_serializer* serializer)
+{
+  raptor_rdfxmla_context* context = (raptor_rdfxmla_context*)serializer->context;
+  raptor_avltree* subjects;
+
+  if(!context->spill) {
+    context->spill = raptor_new_spill(serializer->world);
+    if(!context->spill)
+      return 1;
+  }
+
+  if(raptor_abbrev_subjects_spill(context->subjects, context->rdf_type,
+                                  context->spill))
+    return 1;
+
+  subjects =
+    raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_subject_compare,
+                       (raptor_data_free_handler)raptor_free_abbrev_subject, 0);
+  if(!subjects)
+    return 1;
+
+  raptor_free_avltree(context->subjects);
+  context->subjects = subjects;
+  context->memory_used = 0;
+
+  return 0;
+}
+
+
+/*
+ * raptor_rdfxmla_spill_check:
+ * @serializer: #raptor_serializer object
+ * @statement: statement just added
+ *
+ * Count a statement against the memory budget and spill when over it.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_rdfxmla_spill_check(raptor_serializer* serializer,
+                           raptor_statement* statement)
+{
+  raptor_rdfxmla_context* context = (raptor_rdfxmla_context*)serializer->context;
+
+  if(!context->memory_budget ||
+     statement->subject->type != RAPTOR_TERM_TYPE_URI)
+    return 0;
+
+  context->memory_used += raptor_spill_statement_size(statement);
+  if(context->memory_used <= context->memory_budget)
+    return 0;
+
+  return raptor_rdfxmla_spill_subjects(serializer);
+}
+
+
+/*
+ * raptor_rdfxmla_emit_spill:
+ * @serializer: #raptor_serializer object
+ *
+ * Emit RDF/XML for the URI subjects merged from the runs of the spill.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_rdfxmla_emit_spill(raptor_serializer* serializer)
+{
+  raptor_rdfxmla_context* context = (raptor_rdfxmla_context*)serializer->context;
+  raptor_abbrev_subject* subject;
+  int rc = 0;
+
+  if(raptor_spill_merge_start(context->spill))
+    return 1;
+
+  while(!rc &&
+        (subject = raptor_abbrev_subject_read_spill(context->spill,
+                                                    context->nodes))) {
+    rc = raptor_rdfxmla_emit_subject(serializer, subject,
+                                     context->starting_depth);
+    raptor_free_abbrev_subject(subject);
+  }
+
+  raptor_free_spill(context->spill);
+  context->spill = NULL;
+
+  return rc;
+}
+
+
 /* serialize a statement */
 static int
 raptor_rdfxmla_serialize_statement(raptor_serializer* serializer, 
@@ -1294,6 +1416,8 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
   raptor_abbrev_subject* subject = NULL;
   raptor_abbrev_node* predicate = NULL;
   raptor_abbrev_node* object = NULL;
+  int object_owned = 0;
+  int spillable;
   int rv = 0;
   raptor_term_type object_type;
   
@@ -1305,7 +1429,12 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
     return 1;
   }  
 
-  subject = raptor_abbrev_subject_lookup(context->nodes, context->subjects,
+  /* URI subjects may be spilled so do not share nodes */
+  spillable = (context->memory_budget &&
+               statement->subject->type == RAPTOR_TERM_TYPE_URI);
+
+  subject = raptor_abbrev_subject_lookup(spillable ? NULL : context->nodes,
+                                         context->subjects,
                                          context->blanks,
                                          statement->subject);
   if(!subject)
@@ -1322,16 +1451,24 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
     return 1;
   }
   
-  object = raptor_abbrev_node_lookup(context->nodes,
-                                     statement->object);
+  if(spillable && object_type != RAPTOR_TERM_TYPE_BLANK) {
+    /* Only blank node objects need counting across subjects so other
+     * objects are not kept in the nodes tree that lives to the end */
+    object = raptor_new_abbrev_node(serializer->world, statement->object);
+    object_owned = 1;
+  } else
+    object = raptor_abbrev_node_lookup(context->nodes,
+                                       statement->object);
   if(!object)
     return 1;          
 
 
   if(statement->predicate->type == RAPTOR_TERM_TYPE_URI) {
     predicate = raptor_abbrev_node_lookup(context->nodes, statement->predicate);
-    if(!predicate)
-      return 1;
+    if(!predicate) {
+      rv = 1;
+      goto tidy;
+    }
 
     if(!subject->node_type && 
        raptor_abbrev_node_equals(predicate, context->rdf_type) &&
@@ -1341,12 +1478,10 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
        * purposes. Note that it is perfectly legal to have
        * multiple type definitions.  All definitions after the
        * first go in the property list */
-      subject->node_type = raptor_abbrev_node_lookup(context->nodes,
-                                                     statement->object);
-      if(!subject->node_type)
-        return 1;
+      subject->node_type = object;
       subject->node_type->ref_count++;
-      return 0;
+      rv = raptor_rdfxmla_spill_check(serializer, statement);
+      goto tidy;
     
     } else {
       int add_property = 1;
@@ -1389,7 +1524,7 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
           raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                                      "Unable to add properties to subject %p",
                                      subject);
-          return rv;
+          goto tidy;
         }
       }
     }
@@ -1398,16 +1533,21 @@ raptor_rdfxmla_serialize_statement(raptor_serializer* serializer,
     raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                                "Cannot serialize a triple with predicate node type %u",
                                statement->predicate->type);
-    return 1;
+    rv = 1;
+    goto tidy;
   }
   
   if(object_type == RAPTOR_TERM_TYPE_URI ||
      object_type == RAPTOR_TERM_TYPE_BLANK)
     object->count_as_object++;
-    
 
-  return 0;
+  rv = raptor_rdfxmla_spill_check(serializer, statement);
+
+  tidy:
+  if(object_owned)
+    raptor_free_abbrev_node(object);
 
+  return rv;
 }
 
 
@@ -1422,6 +1562,11 @@ raptor_rdfxmla_serialize_end(raptor_serializer* serializer)
   if(xml_writer) {
     if(!raptor_rdfxmla_ensure_writen_header(serializer, context)) {
 
+      /* URI subjects from the spill and memory are merged then the
+       * blank subjects follow as usual */
+      if(context->spill && !raptor_rdfxmla_spill_subjects(serializer))
+        raptor_rdfxmla_emit_spill(serializer);
+
       raptor_rdfxmla_emit(serializer);  
 
       if(context->write_rdf_RDF) {
@@ -102,6 +102,24 @@ typedef struct {
   int mkr_rs_ntuple;
   int mkr_rs_nvalue;
   int mkr_rs_processing_value;
+
+  /* Non 0 if input is grouped by subject and URI subjects are
+   * written as soon as the subject changes
+   */
+  int grouped_subjects;
+
+  /* URI subject currently being collected when grouped_subjects is set */
+  raptor_abbrev_subject* stream_subject;
+
+  /* Non 0 if stream_subject has a blank node object */
+  int stream_subject_blanks;
+
+  /* Bytes of URI subject statements to hold before writing them to
+   * a run of spill or 0 to hold everything in memory
+   */
+  size_t memory_budget;
+  size_t memory_used;
+  raptor_spill* spill;
 } raptor_turtle_context;
 
 
@@ -1191,6 +1209,16 @@ raptor_turtle_serialize_terminate(raptor_serializer* serializer)
     context->turtle_writer = NULL;
   }
 
+  if(context->stream_subject) {
+    raptor_free_abbrev_subject(context->stream_subject);
+    context->stream_subject = NULL;
+  }
+
+  if(context->spill) {
+    raptor_free_spill(context->spill);
+    context->spill = NULL;
+  }
+
   if(context->rdf_nspace) {
     raptor_free_namespace(context->rdf_nspace);
     context->rdf_nspace = NULL;
@@ -1356,6 +1384,20 @@ raptor_turtle_serialize_start(raptor_serializer* serializer)
 
   context->turtle_writer = turtle_writer;
 
+  /* mKR result sets span several subjects so are never streamed */
+  context->grouped_subjects = !context->emit_mkr &&
+    RAPTOR_OPTIONS_GET_NUMERIC(serializer, RAPTOR_OPTION_GROUPED_SUBJECTS);
+
+  /* grouped input is already written as it arrives */
+  context->memory_budget = 0;
+  context->memory_used = 0;
+  if(!context->grouped_subjects) {
+    int budget = RAPTOR_OPTIONS_GET_NUMERIC(serializer,
+                                            RAPTOR_OPTION_MEMORY_BUDGET);
+    if(budget > 0)
+      context->memory_budget = RAPTOR_GOOD_CAST(size_t, budget) * 1024;
+  }
+
   return 0;
 }
 
@@ -1384,6 +1426,160 @@ raptor_turtle_ensure_writen_header(raptor_serializer* serializer,
   context->written_header = 1;
 }
 
+
+/*
+ * raptor_turtle_stream_end_subject:
+ * @serializer: #raptor_serializer object
+ *
+ * Finish the URI subject being collected from grouped input.
+ *
+ * The subject is written now unless it has blank node objects.  Those
+ * are kept with the other subjects until the end since a blank node
+ * can only be nested once all references to it are known.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_turtle_stream_end_subject(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_abbrev_subject* subject = context->stream_subject;
+  int rc;
+
+  if(!subject)
+    return 0;
+
+  context->stream_subject = NULL;
+
+  if(context->stream_subject_blanks)
+    return (raptor_avltree_add(context->subjects, subject) < 0);
+
+  raptor_turtle_ensure_writen_header(serializer, context);
+  rc = raptor_turtle_emit_subject(serializer, subject, 0);
+  raptor_free_abbrev_subject(subject);
+
+  return rc;
+}
+
+
+/*
+ * raptor_turtle_stream_subject_lookup:
+ * @serializer: #raptor_serializer object
+ * @term: URI subject term
+ *
+ * Get the subject to add a statement about @term to for grouped input.
+ *
+ * Return value: subject or NULL on failure
+ **/
+static raptor_abbrev_subject*
+raptor_turtle_stream_subject_lookup(raptor_serializer* serializer,
+                                    raptor_term* term)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_abbrev_subject* subject;
+  raptor_abbrev_node* node;
+
+  if(context->stream_subject) {
+    if(raptor_term_equals(context->stream_subject->node->term, term))
+      return context->stream_subject;
+
+    if(raptor_turtle_stream_end_subject(serializer))
+      return NULL;
+  }
+
+  /* a subject that was kept back for the end gets any later statements */
+  if(raptor_avltree_size(context->subjects)) {
+    subject = raptor_abbrev_subject_find(context->subjects, term);
+    if(subject)
+      return subject;
+  }
+
+  node = raptor_new_abbrev_node(serializer->world, term);
+  if(!node)
+    return NULL;
+
+  subject = raptor_new_abbrev_subject(node);
+  raptor_free_abbrev_node(node);
+  if(!subject)
+    return NULL;
+
+  context->stream_subject = subject;
+  context->stream_subject_blanks = 0;
+
+  return subject;
+}
+
+
+/*
+ * raptor_turtle_spill_subjects:
+ * @serializer: #raptor_serializer object
+ *
+ * Write the URI subjects held in memory to a new run of the spill.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_turtle_spill_subjects(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_avltree* subjects;
+
+  if(!context->spill) {
+    context->spill = raptor_new_spill(serializer->world);
+    if(!context->spill)
+      return 1;
+  }
+
+  if(raptor_abbrev_subjects_spill(context->subjects, context->rdf_type,
+                                  context->spill))
+    return 1;
+
+  subjects =
+    raptor_new_avltree((raptor_data_compare_handler)raptor_abbrev_subject_compare,
+                       (raptor_data_free_handler)raptor_free_abbrev_subject, 0);
+  if(!subjects)
+    return 1;
+
+  raptor_free_avltree(context->subjects);
+  context->subjects = subjects;
+  context->memory_used = 0;
+
+  return 0;
+}
+
+
+/*
+ * raptor_turtle_emit_spill:
+ * @serializer: #raptor_serializer object
+ *
+ * Emit Turtle for the URI subjects merged from the runs of the spill.
+ *
+ * Return value: non-0 on failure
+ **/
+static int
+raptor_turtle_emit_spill(raptor_serializer* serializer)
+{
+  raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
+  raptor_abbrev_subject* subject;
+  int rc = 0;
+
+  if(raptor_spill_merge_start(context->spill))
+    return 1;
+
+  while(!rc &&
+        (subject = raptor_abbrev_subject_read_spill(context->spill,
+                                                    context->nodes))) {
+    rc = raptor_turtle_emit_subject(serializer, subject, 0);
+    raptor_free_abbrev_subject(subject);
+  }
+
+  raptor_free_spill(context->spill);
+  context->spill = NULL;
+
+  return rc;
+}
+
+
 /* serialize a statement */
 static int
 raptor_turtle_serialize_statement(raptor_serializer* serializer,
@@ -1393,6 +1589,7 @@ raptor_turtle_serialize_statement(raptor_serializer* serializer,
   raptor_abbrev_subject* subject = NULL;
   raptor_abbrev_node* predicate = NULL;
   raptor_abbrev_node* object = NULL;
+  int object_owned = 0;
   int rv;
   raptor_term_type object_type;
 
@@ -1404,9 +1601,20 @@ raptor_turtle_serialize_statement(raptor_serializer* serializer,
     return 1;
   }
 
-  subject = raptor_abbrev_subject_lookup(context->nodes, context->subjects,
-                                         context->blanks,
-                                         statement->subject);
+  if(context->grouped_subjects &&
+     statement->subject->type == RAPTOR_TERM_TYPE_URI)
+    subject = raptor_turtle_stream_subject_lookup(serializer,
+                                                  statement->subject);
+  else if(context->memory_budget &&
+          statement->subject->type == RAPTOR_TERM_TYPE_URI)
+    /* URI subjects may be spilled so do not share nodes */
+    subject = raptor_abbrev_subject_lookup(NULL, context->subjects,
+                                           context->blanks,
+                                           statement->subject);
+  else
+    subject = raptor_abbrev_subject_lookup(context->nodes, context->subjects,
+                                           context->blanks,
+                                           statement->subject);
   if(!subject) {
     return 1;
   }
@@ -1422,36 +1630,60 @@ raptor_turtle_serialize_statement(raptor_serializer* serializer,
     return 1;
   }
 
-  object = raptor_abbrev_node_lookup(context->nodes, statement->object);
-  if(!object)
+  if(statement->predicate->type != RAPTOR_TERM_TYPE_URI) {
+    raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                               "Do not know how to serialize node type %u",
+                               statement->predicate->type);
     return 1;
+  }
 
+  if((context->grouped_subjects || context->memory_budget) &&
+     object_type != RAPTOR_TERM_TYPE_BLANK) {
+    /* Only blank node objects need counting across subjects so other
+     * objects are not kept in the nodes tree that lives to the end */
+    object = raptor_new_abbrev_node(serializer->world, statement->object);
+    object_owned = 1;
+  } else
+    object = raptor_abbrev_node_lookup(context->nodes, statement->object);
+  if(!object)
+    return 1;
 
-  if(statement->predicate->type == RAPTOR_TERM_TYPE_URI) {
-    predicate = raptor_abbrev_node_lookup(context->nodes, statement->predicate);
-    if(!predicate)
-      return 1;
+  predicate = raptor_abbrev_node_lookup(context->nodes, statement->predicate);
+  if(!predicate) {
+    rv = 1;
+    goto tidy;
+  }
 	
-    rv = raptor_abbrev_subject_add_property(subject, predicate, object);
-    if(rv < 0) {
-      raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                                 "Unable to add properties to subject %p",
-                                 subject);
-      return rv;
-    }
-
-  } else {
+  rv = raptor_abbrev_subject_add_property(subject, predicate, object);
+  if(rv < 0) {
     raptor_log_error_formatted(serializer->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                               "Do not know how to serialize node type %u",
-                               statement->predicate->type);
-    return 1;
+                               "Unable to add properties to subject %p",
+                               subject);
+    goto tidy;
   }
 
   if(object_type == RAPTOR_TERM_TYPE_URI ||
      object_type == RAPTOR_TERM_TYPE_BLANK)
     object->count_as_object++;
 
-  return 0;
+  if(object_type == RAPTOR_TERM_TYPE_BLANK &&
+     subject == context->stream_subject)
+    context->stream_subject_blanks = 1;
+
+  rv = 0;
+
+  if(context->memory_budget &&
+     statement->subject->type == RAPTOR_TERM_TYPE_URI) {
+    context->memory_used += raptor_spill_statement_size(statement);
+    if(context->memory_used > context->memory_budget)
+      rv = raptor_turtle_spill_subjects(serializer);
+  }
+
+  tidy:
+  if(object_owned)
+    raptor_free_abbrev_node(object);
+
+  return rv;
 }
 
 
@@ -1461,8 +1693,15 @@ raptor_turtle_serialize_end(raptor_serializer* serializer)
 {
   raptor_turtle_context* context = (raptor_turtle_context*)serializer->context;
 
+  raptor_turtle_stream_end_subject(serializer);
+
   raptor_turtle_ensure_writen_header(serializer, context);
 
+  /* URI subjects from the spill and memory are merged then the blank
+   * subjects follow as usual */
+  if(context->spill && !raptor_turtle_spill_subjects(serializer))
+    raptor_turtle_emit_spill(serializer);
+
   raptor_turtle_emit(serializer);
 
   /* reset serializer for reuse */
@@ -50,31 +50,52 @@
  *  Destroy Set
  *  Check a (base, ID) pair present add it if not, return if added/not
  *
+ * IDs are kept in one open addressed hash table keyed by (base, ID)
+ * where base is the index of the base URI in a small array since
+ * documents rarely use more than a few.  The ID strings are copied
+ * into an arena.
+ *
+ * With a filter size, a Bloom filter of that many bytes is checked
+ * first.  A pair that is not in the filter is certainly new so the
+ * table is only probed for a free slot; one that is may have been
+ * seen before and is compared with the stored IDs.
  */
 
-struct raptor_base_id_set_s
+typedef struct
 {
-  raptor_world* world;
+  /* ID string in the arena or NULL if the slot is empty */
+  const unsigned char* id;
+  size_t id_len;
 
-  /* The base URI of this set of IDs */
-  raptor_uri *uri;
-  
-  /* neighbour ID sets */
-  struct raptor_base_id_set_s* prev;
-  struct raptor_base_id_set_s* next;
+  unsigned int hash;
 
-  /* binary tree */
-  raptor_avltree* tree;
-};
-typedef struct raptor_base_id_set_s raptor_base_id_set;
+  /* index into bases array */
+  int base;
+} raptor_id_set_entry;
 
 
 struct raptor_id_set_s
 {
   raptor_world* world;
 
-  /* start of trees, 1 per base URI */
-  struct raptor_base_id_set_s* first;
+  /* base URIs seen so far */
+  raptor_uri** bases;
+  int bases_count;
+  int bases_size;
+
+  /* index of most recently used base URI */
+  int last_base;
+
+  /* hash table of size entries (a power of 2) */
+  raptor_id_set_entry* entries;
+  size_t size;
+  size_t count;
+
+  /* storage for ID strings */
+  raptor_arena* arena;
+
+  /* Bloom filter checked before the table or NULL */
+  raptor_bloom* filter;
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   int hits;
@@ -83,18 +104,22 @@ struct raptor_id_set_s
 };
 
 
+#define RAPTOR_ID_SET_INITIAL_SIZE 256
+
+
 /* functions implementing the ID set api */
 
 /**
  * raptor_new_id_set:
  * @world: raptor_world object
+ * @filter_size: size of Bloom filter in bytes or 0 for none
  *
  * INTERNAL - Constructor - create a new ID set.
  * 
- * Return value: non 0 on failure
+ * Return value: new set or NULL on failure
  **/
 raptor_id_set*
-raptor_new_id_set(raptor_world* world)
+raptor_new_id_set(raptor_world* world, size_t filter_size)
 {
   raptor_id_set* set = RAPTOR_CALLOC(raptor_id_set*, 1, sizeof(*set));
   if(!set)
@@ -102,25 +127,21 @@ raptor_new_id_set(raptor_world* world)
 
   set->world = world;
 
-  return set;
-}
+  set->arena = raptor_new_arena(0);
+  if(!set->arena)
+    goto oom;
 
+  if(filter_size) {
+    set->filter = raptor_new_bloom(filter_size);
+    if(!set->filter)
+      goto oom;
+  }
 
-/**
- * raptor_free_base_id_set:
- * @set: #raptor_base_id_set
- *
- * INTERNAL - Destructor - Free a Base ID Set.
- *
- **/
-static void
-raptor_free_base_id_set(raptor_base_id_set *base) 
-{
-  if(base->tree)
-    raptor_free_avltree(base->tree);
-  if(base->uri)
-    raptor_free_uri(base->uri);
-  RAPTOR_FREE(raptor_base_id_set, base);
+  return set;
+
+  oom:
+  raptor_free_id_set(set);
+  return NULL;
 }
 
 
@@ -134,20 +155,111 @@ raptor_free_base_id_set(raptor_base_id_set *base)
 void
 raptor_free_id_set(raptor_id_set *set) 
 {
-  raptor_base_id_set *base;
+  int i;
 
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN(set, raptor_id_set);
 
-  base = set->first;
-  while(base) {
-    raptor_base_id_set *next = base->next;
-    raptor_free_base_id_set(base);
-    base = next;
-  }
+  for(i = 0; i < set->bases_count; i++)
+    raptor_free_uri(set->bases[i]);
+  if(set->bases)
+    RAPTOR_FREE(raptor_uri**, set->bases);
+
+  if(set->entries)
+    RAPTOR_FREE(raptor_id_set_entry*, set->entries);
+
+  if(set->arena)
+    raptor_free_arena(set->arena);
+
+  if(set->filter)
+    raptor_free_bloom(set->filter);
+
   RAPTOR_FREE(raptor_id_set, set);
 }
 
 
+/*
+ * raptor_id_set_base_index:
+ * @set: #raptor_id_set
+ * @base_uri: base URI
+ *
+ * INTERNAL - Find the index of a base URI, adding it if not present
+ *
+ * Return value: index or <0 on failure
+ */
+static int
+raptor_id_set_base_index(raptor_id_set* set, raptor_uri* base_uri)
+{
+  int i;
+
+  if(set->bases_count && 
+     raptor_uri_equals(set->bases[set->last_base], base_uri))
+    return set->last_base;
+
+  for(i = 0; i < set->bases_count; i++) {
+    if(raptor_uri_equals(set->bases[i], base_uri)) {
+      set->last_base = i;
+      return i;
+    }
+  }
+
+  if(set->bases_count == set->bases_size) {
+    int bases_size = set->bases_size ? set->bases_size << 1 : 4;
+    raptor_uri** bases;
+
+    bases = RAPTOR_REALLOC(raptor_uri**, set->bases,
+                           sizeof(raptor_uri*) * bases_size);
+    if(!bases)
+      return -1;
+    set->bases = bases;
+    set->bases_size = bases_size;
+  }
+
+  set->bases[set->bases_count] = raptor_uri_copy(base_uri);
+  set->last_base = set->bases_count;
+
+  return set->bases_count++;
+}
+
+
+/*
+ * raptor_id_set_grow:
+ * @set: #raptor_id_set
+ *
+ * INTERNAL - Double the size of the hash table
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_id_set_grow(raptor_id_set* set)
+{
+  size_t size = set->size ? set->size << 1 : RAPTOR_ID_SET_INITIAL_SIZE;
+  raptor_id_set_entry* entries;
+  size_t i;
+
+  entries = RAPTOR_CALLOC(raptor_id_set_entry*, size, sizeof(*entries));
+  if(!entries)
+    return 1;
+
+  for(i = 0; i < set->size; i++) {
+    raptor_id_set_entry* entry = &set->entries[i];
+    size_t j;
+
+    if(!entry->id)
+      continue;
+
+    for(j = entry->hash & (size - 1); entries[j].id; j = (j + 1) & (size - 1))
+      ;
+    entries[j] = *entry;
+  }
+
+  if(set->entries)
+    RAPTOR_FREE(raptor_id_set_entry*, set->entries);
+  set->entries = entries;
+  set->size = size;
+
+  return 0;
+}
+
 
 /**
  * raptor_id_set_add:
@@ -164,74 +276,66 @@ int
 raptor_id_set_add(raptor_id_set* set, raptor_uri *base_uri,
                   const unsigned char *id, size_t id_len)
 {
-  raptor_base_id_set *base;
-  char* item;
+  raptor_id_set_entry* entry;
+  unsigned int hash1 = 2166136261U;
+  unsigned int hash2 = 5381;
+  int base;
+  /* non-0 if the pair may be in the table */
+  int maybe_present = 1;
+  size_t i;
   
   if(!base_uri || !id || !id_len)
     return -1;
 
-  base = set->first;
-  while(base) {
-    if(raptor_uri_equals(base->uri, base_uri))
-      break;
-    base = base->next;
-  }
-
-  if(!base) {
-    /* a set for this base_uri not found */
-    base = RAPTOR_CALLOC(raptor_base_id_set*, 1, sizeof(*base));
-    if(!base)
-      return -1;
+  base = raptor_id_set_base_index(set, base_uri);
+  if(base < 0)
+    return -1;
 
-    base->world = set->world;
+  /* FNV-1a and DJ Bernstein hashes of the base index and ID */
+  hash1 = (hash1 ^ (unsigned int)base) * 16777619U;
+  hash2 = ((hash2 << 5) + hash2) + (unsigned int)base;
+  for(i = 0; i < id_len; i++) {
+    hash1 = (hash1 ^ id[i]) * 16777619U;
+    hash2 = ((hash2 << 5) + hash2) + id[i];
+  }
 
-    base->uri = raptor_uri_copy(base_uri);
+  if(set->filter)
+    maybe_present = raptor_bloom_add(set->filter, hash1, hash2);
 
-    base->tree = raptor_new_avltree((raptor_data_compare_handler)strcmp,
-                                    free, 0);
-  
-    /* Add to the start of the list */
-    if(set->first)
-      set->first->prev = base;
-    /* base->prev = NULL; */
-    base->next = set->first;
-
-    set->first = base;
-  } else {
-    /* If not at the start of the list, move there */
-    if(base != set->first) {
-      /* remove from the list */
-      base->prev->next = base->next;
-      if(base->next)
-        base->next->prev = base->prev;
-      /* add at the start of the list */
-      set->first->prev = base;
-      base->prev = NULL;
-      base->next = set->first;
-    }
+  /* keep the table at most half full */
+  if((set->count + 1) << 1 > set->size) {
+    if(raptor_id_set_grow(set))
+      return -1;
   }
-  
-  item = (char*)raptor_avltree_search(base->tree, id);
 
-  /* if already there, error */
-  if(item) {
+  for(i = hash1 & (set->size - 1); ; i = (i + 1) & (set->size - 1)) {
+    entry = &set->entries[i];
+    if(!entry->id)
+      break;
+
+    /* if already there, error */
+    if(maybe_present && entry->hash == hash1 && entry->base == base &&
+       entry->id_len == id_len && !memcmp(entry->id, id, id_len)) {
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-    set->misses++;
+      set->misses++;
 #endif
-    return 1;
+      return 1;
+    }
   }
   
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   set->hits++;
 #endif
   
-  item = RAPTOR_MALLOC(char*, id_len + 1);
-  if(!item)
-    return 1;
-
-  memcpy(item, id, id_len + 1);
+  entry->id = raptor_arena_strndup(set->arena, id, id_len);
+  if(!entry->id)
+    return -1;
+  entry->id_len = id_len;
+  entry->hash = hash1;
+  entry->base = base;
+  set->count++;
 
-  return raptor_avltree_add(base->tree, item);
+  return 0;
 }
 
 
@@ -259,6 +363,8 @@ main(int argc, char *argv[])
   const char *items[8] = { "ron", "amy", "jen", "bij", "jib", "daj", "jim", NULL };
   raptor_id_set *set;
   raptor_uri *base_uri;
+  raptor_uri *other_base_uri;
+  char id[20];
   int i = 0;
   
   world = raptor_new_world();
@@ -266,12 +372,13 @@ main(int argc, char *argv[])
     exit(1);
     
   base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/base#");
+  other_base_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/other#");
 
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   fprintf(stderr, "%s: Creating set\n", program);
 #endif
 
-  set = raptor_new_id_set(world);
+  set = raptor_new_id_set(world, 0);
   if(!set) {
     fprintf(stderr, "%s: Failed to create set\n", program);
     exit(1);
@@ -309,6 +416,44 @@ if(rc) {
     }
   }
 
+  /* same IDs with another base are not duplicates */
+  for(i = 0; items[i]; i++) {
+    size_t len = strlen(items[i]);
+    int rc;
+
+    rc = raptor_id_set_add(set, other_base_uri, (const unsigned char*)items[i], len);
+    if(rc) {
+      fprintf(stderr, "%s: Adding set item %d '%s' with other base failed, returning error %d\n",
+              program, i, items[i], rc);
+      exit(1);
+    }
+  }
+
+  /* enough items to make the set grow */
+  for(i = 0; i < 10000; i++) {
+    int rc;
+
+    sprintf(id, "id%d", i);
+    rc = raptor_id_set_add(set, base_uri, (const unsigned char*)id, strlen(id));
+    if(rc) {
+      fprintf(stderr, "%s: Adding set item '%s' failed, returning error %d\n",
+              program, id, rc);
+      exit(1);
+    }
+  }
+
+  for(i = 0; i < 10000; i++) {
+    int rc;
+
+    sprintf(id, "id%d", i);
+    rc = raptor_id_set_add(set, base_uri, (const unsigned char*)id, strlen(id));
+    if(rc != 1) {
+      fprintf(stderr, "%s: Adding duplicate set item '%s' returned %d, expected 1\n",
+              program, id, rc);
+      exit(1);
+    }
+  }
+
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
   raptor_id_set_stats_print(set, stderr);
 #endif
@@ -318,7 +463,42 @@ if(rc) {
 #endif
   raptor_free_id_set(set);
 
+  /* A small Bloom filter gives false positives that are confirmed
+   * against the table */
+  set = raptor_new_id_set(world, 64);
+  if(!set) {
+    fprintf(stderr, "%s: Failed to create filter set\n", program);
+    exit(1);
+  }
+
+  for(i = 0; i < 1000; i++) {
+    int rc;
+
+    sprintf(id, "id%d", i);
+    rc = raptor_id_set_add(set, base_uri, (const unsigned char*)id, strlen(id));
+    if(rc) {
+      fprintf(stderr, "%s: Adding filter set item '%s' failed, returning error %d\n",
+              program, id, rc);
+      exit(1);
+    }
+  }
+
+  for(i = 0; i < 1000; i++) {
+    int rc;
+
+    sprintf(id, "id%d", i);
+    rc = raptor_id_set_add(set, base_uri, (const unsigned char*)id, strlen(id));
+    if(rc != 1) {
+      fprintf(stderr, "%s: Adding duplicate filter set item '%s' returned %d, expected 1\n",
+              program, id, rc);
+      exit(1);
+    }
+  }
+
+  raptor_free_id_set(set);
+
   raptor_free_uri(base_uri);
+  raptor_free_uri(other_base_uri);
   
   raptor_free_world(world);
   
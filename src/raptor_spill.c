@@ -0,0 +1,989 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_spill.c - Sorted runs of statements in temporary files
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+/* most runs kept at once, each an open temporary file */
+#define RAPTOR_SPILL_MAX_RUNS 64
+
+
+#ifndef STANDALONE
+
+/*
+ * A spill is a set of runs, each a temporary file of statements
+ * written in raptor_statement_compare() order.  Serializers that keep
+ * the whole graph in memory write out what they hold as a run when it
+ * grows past their memory budget, and at the end read back the runs
+ * merged into one ordered sequence.
+ *
+ * When there are RAPTOR_SPILL_MAX_RUNS runs, the newest runs are
+ * merged into one larger run.  Each run has a level, 0 when written
+ * and one more than the runs it was merged from, and levels never
+ * increase from the oldest run to the newest.  The runs merged are
+ * the newest ones up to the level of the second newest, so each
+ * statement is copied about once per RAPTOR_SPILL_MAX_RUNS times more
+ * runs.  A heap of the runs picks the lowest statement when merging.
+ *
+ * Records are in a private binary format only ever read back by the
+ * same process: a flags byte, the number of the run the record was
+ * first written to, then subject, predicate, object and graph terms.
+ * Each term is a type byte (0 for none) followed by its counted
+ * strings.
+ */
+
+typedef struct {
+  FILE* handle;
+
+  /* see above */
+  int level;
+
+  /* next record from the run or NULL at the end */
+  raptor_statement* statement;
+  int flags;
+  int origin;
+
+  /* strings of the record being read */
+  unsigned char* buffer;
+  size_t buffer_size;
+} raptor_spill_run;
+
+
+struct raptor_spill_s {
+  raptor_world* world;
+
+  /* run being written or NULL */
+  FILE* handle;
+
+  /* number of the run being written, counting from 0 */
+  int origin;
+
+  raptor_spill_run* runs;
+  int runs_count;
+  int runs_size;
+
+  /* heap of the indexes of runs that have a statement, ordered by
+   * raptor_spill_run_less(); the first is the current run of a merge */
+  int heap[RAPTOR_SPILL_MAX_RUNS];
+  int heap_count;
+};
+
+
+/* statements are not expected to have strings longer than this */
+#define RAPTOR_SPILL_MAX_STRING_LEN ((size_t)1 << 31)
+
+
+static int raptor_spill_end_run_merge(raptor_spill* spill);
+
+
+/* Close a run's file and free its record */
+static void
+raptor_spill_run_clear(raptor_spill_run* run)
+{
+  fclose(run->handle);
+  if(run->statement)
+    raptor_free_statement(run->statement);
+  if(run->buffer)
+    RAPTOR_FREE(char*, run->buffer);
+  memset(run, '\0', sizeof(*run));
+}
+
+
+/*
+ * raptor_new_spill:
+ * @world: raptor world
+ *
+ * INTERNAL - Constructor - create a new spill with no runs
+ *
+ * Return value: new spill or NULL on failure
+ */
+raptor_spill*
+raptor_new_spill(raptor_world* world)
+{
+  raptor_spill* spill;
+
+  spill = RAPTOR_CALLOC(raptor_spill*, 1, sizeof(*spill));
+  if(!spill)
+    return NULL;
+
+  spill->world = world;
+  spill->origin = -1;
+
+  return spill;
+}
+
+
+/*
+ * raptor_free_spill:
+ * @spill: spill
+ *
+ * INTERNAL - Destructor - free a spill and remove its temporary files
+ */
+void
+raptor_free_spill(raptor_spill* spill)
+{
+  int i;
+
+  if(!spill)
+    return;
+
+  if(spill->handle)
+    fclose(spill->handle);
+
+  for(i = 0; i < spill->runs_count; i++)
+    raptor_spill_run_clear(&spill->runs[i]);
+  if(spill->runs)
+    RAPTOR_FREE(raptor_spill_run, spill->runs);
+
+  RAPTOR_FREE(raptor_spill, spill);
+}
+
+
+/*
+ * raptor_spill_get_runs_count:
+ * @spill: spill
+ *
+ * INTERNAL - Get the number of finished runs
+ *
+ * This is at most RAPTOR_SPILL_MAX_RUNS since older runs are merged.
+ *
+ * Return value: number of runs
+ */
+int
+raptor_spill_get_runs_count(raptor_spill* spill)
+{
+  return spill->runs_count;
+}
+
+
+/*
+ * raptor_spill_start_run:
+ * @spill: spill
+ *
+ * INTERNAL - Start writing a new run to a temporary file
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spill_start_run(raptor_spill* spill)
+{
+  if(spill->handle)
+    return 1;
+
+  spill->handle = tmpfile();
+  if(!spill->handle) {
+    raptor_log_error(spill->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                     "Cannot create temporary file for serializing");
+    return 1;
+  }
+  spill->origin++;
+
+  return 0;
+}
+
+
+static void
+raptor_spill_write_string(FILE* handle, const unsigned char* string,
+                          size_t len)
+{
+  fwrite(&len, sizeof(len), 1, handle);
+  if(len)
+    fwrite(string, 1, len, handle);
+}
+
+
+static void
+raptor_spill_write_term(FILE* handle, raptor_term* term)
+{
+  unsigned char type = 0;
+  const unsigned char* string;
+  size_t len;
+
+  if(term)
+    type = RAPTOR_GOOD_CAST(unsigned char, term->type);
+  fputc(type, handle);
+
+  if(!term)
+    return;
+
+  switch(term->type) {
+    case RAPTOR_TERM_TYPE_URI:
+      string = raptor_uri_as_counted_string(term->value.uri, &len);
+      raptor_spill_write_string(handle, string, len);
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      raptor_spill_write_string(handle, term->value.blank.string,
+                                term->value.blank.string_len);
+      break;
+
+    case RAPTOR_TERM_TYPE_LITERAL:
+      raptor_spill_write_string(handle, term->value.literal.string,
+                                term->value.literal.string_len);
+      if(term->value.literal.datatype) {
+        string = raptor_uri_as_counted_string(term->value.literal.datatype,
+                                              &len);
+        fputc(1, handle);
+        raptor_spill_write_string(handle, string, len);
+      } else
+        fputc(0, handle);
+      raptor_spill_write_string(handle, term->value.literal.language,
+                                term->value.literal.language_len);
+      break;
+
+    case RAPTOR_TERM_TYPE_UNKNOWN:
+    default:
+      break;
+  }
+}
+
+
+static int
+raptor_spill_write_record(FILE* handle, raptor_statement* statement,
+                          int flags, int origin)
+{
+  fputc(flags, handle);
+  fwrite(&origin, sizeof(origin), 1, handle);
+  raptor_spill_write_term(handle, statement->subject);
+  raptor_spill_write_term(handle, statement->predicate);
+  raptor_spill_write_term(handle, statement->object);
+  raptor_spill_write_term(handle, statement->graph);
+
+  return ferror(handle);
+}
+
+
+/*
+ * raptor_spill_write:
+ * @spill: spill
+ * @statement: statement
+ * @flags: bit flags to store with the statement
+ *
+ * INTERNAL - Add a statement to the current run
+ *
+ * Statements must be added in raptor_statement_compare() order.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spill_write(raptor_spill* spill, raptor_statement* statement,
+                   int flags)
+{
+  if(!spill->handle)
+    return 1;
+
+  return raptor_spill_write_record(spill->handle, statement, flags,
+                                   spill->origin);
+}
+
+
+/*
+ * raptor_spill_end_run:
+ * @spill: spill
+ *
+ * INTERNAL - Finish the current run
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spill_end_run(raptor_spill* spill)
+{
+  raptor_spill_run* run;
+
+  if(!spill->handle)
+    return 1;
+
+  if(fflush(spill->handle) || ferror(spill->handle)) {
+    raptor_log_error(spill->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                     "Cannot write temporary file for serializing");
+    fclose(spill->handle);
+    spill->handle = NULL;
+    return 1;
+  }
+
+  if(spill->runs_count == spill->runs_size) {
+    int size = spill->runs_size ? spill->runs_size * 2 : 8;
+    raptor_spill_run* runs;
+
+    runs = RAPTOR_REALLOC(raptor_spill_run*, spill->runs,
+                          RAPTOR_GOOD_CAST(size_t, size) * sizeof(*runs));
+    if(!runs)
+      return 1;
+    spill->runs = runs;
+    spill->runs_size = size;
+  }
+
+  run = &spill->runs[spill->runs_count++];
+  memset(run, '\0', sizeof(*run));
+  run->handle = spill->handle;
+  spill->handle = NULL;
+
+  if(spill->runs_count == RAPTOR_SPILL_MAX_RUNS)
+    return raptor_spill_end_run_merge(spill);
+
+  return 0;
+}
+
+
+/* Read a counted string into the run buffer at *offset_p */
+static int
+raptor_spill_read_string(raptor_spill_run* run, size_t* offset_p,
+                         size_t* len_p)
+{
+  size_t len;
+  size_t need;
+
+  if(fread(&len, sizeof(len), 1, run->handle) != 1 ||
+     len > RAPTOR_SPILL_MAX_STRING_LEN)
+    return 1;
+
+  need = *offset_p + len + 1;
+  if(need > run->buffer_size) {
+    size_t size = run->buffer_size ? run->buffer_size : 256;
+    unsigned char* buffer;
+
+    while(size < need)
+      size <<= 1;
+    buffer = RAPTOR_REALLOC(unsigned char*, run->buffer, size);
+    if(!buffer)
+      return 1;
+    run->buffer = buffer;
+    run->buffer_size = size;
+  }
+
+  if(len && fread(run->buffer + *offset_p, 1, len, run->handle) != len)
+    return 1;
+  run->buffer[*offset_p + len] = '\0';
+
+  *len_p = len;
+  return 0;
+}
+
+
+/* Read a term; *term_p is set to NULL for no term */
+static int
+raptor_spill_read_term(raptor_world* world, raptor_spill_run* run,
+                       raptor_term** term_p)
+{
+  int type;
+  size_t offset = 0;
+  size_t len;
+  size_t datatype_offset;
+  size_t datatype_len = 0;
+  size_t language_offset;
+  size_t language_len;
+  raptor_uri* datatype = NULL;
+
+  *term_p = NULL;
+
+  type = fgetc(run->handle);
+  if(type == EOF)
+    return 1;
+
+  switch(type) {
+    case 0:
+      return 0;
+
+    case RAPTOR_TERM_TYPE_URI:
+      if(raptor_spill_read_string(run, &offset, &len))
+        return 1;
+      *term_p = raptor_new_term_from_counted_uri_string(world, run->buffer,
+                                                        len);
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      if(raptor_spill_read_string(run, &offset, &len))
+        return 1;
+      *term_p = raptor_new_term_from_counted_blank(world, run->buffer, len);
+      break;
+
+    case RAPTOR_TERM_TYPE_LITERAL:
+      if(raptor_spill_read_string(run, &offset, &len))
+        return 1;
+
+      datatype_offset = offset = len + 1;
+      type = fgetc(run->handle);
+      if(type == EOF)
+        return 1;
+      if(type) {
+        if(raptor_spill_read_string(run, &offset, &datatype_len))
+          return 1;
+        offset += datatype_len + 1;
+      }
+
+      language_offset = offset;
+      if(raptor_spill_read_string(run, &offset, &language_len))
+        return 1;
+
+      if(type) {
+        datatype = raptor_new_uri_from_counted_string(world,
+                                                      run->buffer + datatype_offset,
+                                                      datatype_len);
+        if(!datatype)
+          return 1;
+      }
+
+      *term_p = raptor_new_term_from_counted_literal(world,
+                                                     run->buffer, len,
+                                                     datatype,
+                                                     language_len ? run->buffer + language_offset : NULL,
+                                                     RAPTOR_GOOD_CAST(unsigned char, language_len));
+      if(datatype)
+        raptor_free_uri(datatype);
+      break;
+
+    default:
+      return 1;
+  }
+
+  return (*term_p == NULL);
+}
+
+
+/* Read the next record of a run, setting run->statement NULL at the end */
+static int
+raptor_spill_read_record(raptor_world* world, raptor_spill_run* run)
+{
+  raptor_statement* statement;
+  int flags;
+
+  run->statement = NULL;
+
+  flags = fgetc(run->handle);
+  if(flags == EOF)
+    return ferror(run->handle);
+
+  statement = raptor_new_statement(world);
+  if(!statement)
+    return 1;
+
+  if(fread(&run->origin, sizeof(run->origin), 1, run->handle) != 1 ||
+     raptor_spill_read_term(world, run, &statement->subject) ||
+     raptor_spill_read_term(world, run, &statement->predicate) ||
+     raptor_spill_read_term(world, run, &statement->object) ||
+     raptor_spill_read_term(world, run, &statement->graph)) {
+    raptor_free_statement(statement);
+    raptor_log_error(world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                     "Cannot read temporary file for serializing");
+    return 1;
+  }
+
+  run->statement = statement;
+  run->flags = flags;
+
+  return 0;
+}
+
+
+/* Compare the records of two runs; equal statements are ordered by
+ * the run they were first written to */
+static int
+raptor_spill_run_less(raptor_spill* spill, int a, int b)
+{
+  raptor_spill_run* run_a = &spill->runs[a];
+  raptor_spill_run* run_b = &spill->runs[b];
+  int d;
+
+  d = raptor_statement_compare(run_a->statement, run_b->statement);
+  if(d)
+    return d < 0;
+
+  return run_a->origin < run_b->origin;
+}
+
+
+/* Move the run at heap position @i down to its place */
+static void
+raptor_spill_heap_down(raptor_spill* spill, int i)
+{
+  int* heap = spill->heap;
+
+  while(1) {
+    int least = i;
+    int child = 2 * i + 1;
+    int tmp;
+
+    if(child < spill->heap_count &&
+       raptor_spill_run_less(spill, heap[child], heap[least]))
+      least = child;
+    child++;
+    if(child < spill->heap_count &&
+       raptor_spill_run_less(spill, heap[child], heap[least]))
+      least = child;
+    if(least == i)
+      break;
+
+    tmp = heap[i];
+    heap[i] = heap[least];
+    heap[least] = tmp;
+    i = least;
+  }
+}
+
+
+/* Free the records of all runs and empty the heap */
+static void
+raptor_spill_merge_stop(raptor_spill* spill)
+{
+  int i;
+
+  for(i = 0; i < spill->runs_count; i++) {
+    if(spill->runs[i].statement) {
+      raptor_free_statement(spill->runs[i].statement);
+      spill->runs[i].statement = NULL;
+    }
+  }
+  spill->heap_count = 0;
+}
+
+
+/* Start merging the runs from index @first to the last one */
+static int
+raptor_spill_merge_runs_start(raptor_spill* spill, int first)
+{
+  int i;
+
+  raptor_spill_merge_stop(spill);
+
+  for(i = first; i < spill->runs_count; i++) {
+    raptor_spill_run* run = &spill->runs[i];
+
+    rewind(run->handle);
+    if(raptor_spill_read_record(spill->world, run)) {
+      raptor_spill_merge_stop(spill);
+      return 1;
+    }
+
+    if(run->statement)
+      spill->heap[spill->heap_count++] = i;
+  }
+
+  for(i = spill->heap_count / 2 - 1; i >= 0; i--)
+    raptor_spill_heap_down(spill, i);
+
+  return 0;
+}
+
+
+/* Replace the current record with the next one from its run */
+static int
+raptor_spill_merge_advance(raptor_spill* spill)
+{
+  raptor_spill_run* run = &spill->runs[spill->heap[0]];
+
+  raptor_free_statement(run->statement);
+
+  if(raptor_spill_read_record(spill->world, run)) {
+    /* stop the merge here */
+    raptor_spill_merge_stop(spill);
+    return 1;
+  }
+
+  /* a finished run leaves the heap */
+  if(!run->statement)
+    spill->heap[0] = spill->heap[--spill->heap_count];
+  raptor_spill_heap_down(spill, 0);
+
+  return 0;
+}
+
+
+/*
+ * raptor_spill_end_run_merge:
+ * @spill: spill
+ *
+ * INTERNAL - Merge the newest runs into one when there are too many
+ *
+ * Return value: non-0 on failure
+ */
+static int
+raptor_spill_end_run_merge(raptor_spill* spill)
+{
+  FILE* handle;
+  int first;
+  int level;
+  int rc = 0;
+  int i;
+
+  /* the newest runs with the level of the second newest or lower */
+  level = spill->runs[spill->runs_count - 2].level;
+  first = spill->runs_count - 2;
+  while(first > 0 && spill->runs[first - 1].level <= level)
+    first--;
+
+  handle = tmpfile();
+  if(!handle) {
+    raptor_log_error(spill->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                     "Cannot create temporary file for serializing");
+    return 1;
+  }
+
+  rc = raptor_spill_merge_runs_start(spill, first);
+  while(!rc && spill->heap_count) {
+    raptor_spill_run* run = &spill->runs[spill->heap[0]];
+
+    rc = raptor_spill_write_record(handle, run->statement, run->flags,
+                                   run->origin);
+    if(!rc)
+      rc = raptor_spill_merge_advance(spill);
+  }
+
+  if(rc || fflush(handle) || ferror(handle)) {
+    raptor_log_error(spill->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                     "Cannot write temporary file for serializing");
+    raptor_spill_merge_stop(spill);
+    fclose(handle);
+    return 1;
+  }
+
+  for(i = first; i < spill->runs_count; i++)
+    raptor_spill_run_clear(&spill->runs[i]);
+
+  spill->runs[first].handle = handle;
+  spill->runs[first].level = level + 1;
+  spill->runs_count = first + 1;
+
+  return 0;
+}
+
+
+/*
+ * raptor_spill_merge_start:
+ * @spill: spill
+ *
+ * INTERNAL - Start reading all the runs merged in order
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_spill_merge_start(raptor_spill* spill)
+{
+  if(spill->handle)
+    return 1;
+
+  return raptor_spill_merge_runs_start(spill, 0);
+}
+
+
+/*
+ * raptor_spill_merge_get:
+ * @spill: spill
+ * @flags_p: pointer to store the statement flags (or NULL)
+ * @run_p: pointer to store the number of the run it was written to (or NULL)
+ *
+ * INTERNAL - Get the current statement of the merged runs
+ *
+ * Statements come out in raptor_statement_compare() order and equal
+ * statements in the order of the runs they were written to, which
+ * are numbered from 0 in the order they were started.  Duplicates are
+ * not removed.  The statement is owned by the spill and valid until
+ * raptor_spill_merge_next() is called.
+ *
+ * Return value: statement or NULL at the end
+ */
+raptor_statement*
+raptor_spill_merge_get(raptor_spill* spill, int* flags_p, int* run_p)
+{
+  raptor_spill_run* run;
+
+  if(!spill->heap_count)
+    return NULL;
+
+  run = &spill->runs[spill->heap[0]];
+  if(flags_p)
+    *flags_p = run->flags;
+  if(run_p)
+    *run_p = run->origin;
+
+  return run->statement;
+}
+
+
+/*
+ * raptor_spill_merge_next:
+ * @spill: spill
+ *
+ * INTERNAL - Move to the next statement of the merged runs
+ *
+ * Return value: non-0 at the end or on failure
+ */
+int
+raptor_spill_merge_next(raptor_spill* spill)
+{
+  if(!spill->heap_count)
+    return 1;
+
+  return raptor_spill_merge_advance(spill) || !spill->heap_count;
+}
+
+
+/*
+ * raptor_spill_statement_size:
+ * @statement: statement
+ *
+ * INTERNAL - Estimate the memory a serializer uses to hold a statement
+ *
+ * Return value: approximate size in bytes
+ */
+size_t
+raptor_spill_statement_size(raptor_statement* statement)
+{
+  raptor_term* terms[4];
+  /* statement, tree nodes and allocator overheads */
+  size_t size = sizeof(raptor_statement) + 8 * sizeof(void*);
+  int i;
+
+  terms[0] = statement->subject;
+  terms[1] = statement->predicate;
+  terms[2] = statement->object;
+  terms[3] = statement->graph;
+
+  for(i = 0; i < 4; i++) {
+    raptor_term* term = terms[i];
+    size_t len;
+
+    if(!term)
+      continue;
+
+    size += sizeof(raptor_term);
+    switch(term->type) {
+      case RAPTOR_TERM_TYPE_URI:
+        (void)raptor_uri_as_counted_string(term->value.uri, &len);
+        size += len;
+        break;
+
+      case RAPTOR_TERM_TYPE_BLANK:
+        size += term->value.blank.string_len;
+        break;
+
+      case RAPTOR_TERM_TYPE_LITERAL:
+        size += term->value.literal.string_len +
+                term->value.literal.language_len;
+        break;
+
+      case RAPTOR_TERM_TYPE_UNKNOWN:
+      default:
+        break;
+    }
+  }
+
+  return size;
+}
+
+#endif
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static int
+compare_statement_pointers(const void* a, const void* b)
+{
+  return raptor_statement_compare(*(raptor_statement* const*)a,
+                                  *(raptor_statement* const*)b);
+}
+
+
+/* enough runs for the newest ones to be merged more than once */
+#define TEST_RUNS_COUNT 200
+#define TEST_STATEMENTS_COUNT 10
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_world *world;
+  raptor_spill* spill;
+  raptor_statement* statements[TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT];
+  raptor_statement* statement;
+  raptor_statement* last = NULL;
+  raptor_uri* datatype;
+  char buffer[64];
+  int run;
+  int i;
+  int count;
+  int last_run = -1;
+  int failures = 0;
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  datatype = raptor_new_uri(world,
+                            (const unsigned char*)"http://example.org/type");
+
+  /* Statements with every kind of term; run r holds every
+   * TEST_RUNS_COUNT-th statement so the runs interleave when merged
+   * and the last two runs hold the same statements.
+   */
+  for(i = 0; i < TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT; i++) {
+    int n = i % (TEST_STATEMENTS_COUNT * (TEST_RUNS_COUNT - 1));
+    raptor_term* object;
+
+    statement = raptor_new_statement(world);
+
+    snprintf(buffer, sizeof(buffer), "http://example.org/s%03d", n / 7);
+    statement->subject = raptor_new_term_from_uri_string(world,
+                                                         (const unsigned char*)buffer);
+    snprintf(buffer, sizeof(buffer), "http://example.org/p%d", n % 3);
+    statement->predicate = raptor_new_term_from_uri_string(world,
+                                                           (const unsigned char*)buffer);
+    snprintf(buffer, sizeof(buffer), "object\n%d \"\xc3\xa9\"", n);
+    switch(n % 4) {
+      case 0:
+        object = raptor_new_term_from_blank(world,
+                                            (const unsigned char*)buffer + 7);
+        break;
+      case 1:
+        object = raptor_new_term_from_literal(world,
+                                              (const unsigned char*)buffer,
+                                              datatype, NULL);
+        break;
+      case 2:
+        object = raptor_new_term_from_literal(world,
+                                              (const unsigned char*)buffer,
+                                              NULL,
+                                              (const unsigned char*)"en");
+        break;
+      default:
+        object = raptor_new_term_from_literal(world,
+                                              (const unsigned char*)"",
+                                              NULL, NULL);
+        statement->graph = raptor_new_term_from_uri_string(world,
+                                                           (const unsigned char*)"http://example.org/g");
+        break;
+    }
+    statement->object = object;
+    statements[i] = statement;
+  }
+
+  spill = raptor_new_spill(world);
+  if(!spill) {
+    fprintf(stderr, "%s: Failed to create spill\n", program);
+    exit(1);
+  }
+
+  for(run = 0; run < TEST_RUNS_COUNT; run++) {
+    raptor_statement* sorted[TEST_STATEMENTS_COUNT];
+
+    for(i = 0; i < TEST_STATEMENTS_COUNT; i++)
+      sorted[i] = statements[run * TEST_STATEMENTS_COUNT + i];
+    qsort(sorted, TEST_STATEMENTS_COUNT, sizeof(sorted[0]),
+          compare_statement_pointers);
+
+    if(raptor_spill_start_run(spill)) {
+      fprintf(stderr, "%s: Failed to start run %d\n", program, run);
+      exit(1);
+    }
+    for(i = 0; i < TEST_STATEMENTS_COUNT; i++)
+      raptor_spill_write(spill, sorted[i], run);
+    if(raptor_spill_end_run(spill)) {
+      fprintf(stderr, "%s: Failed to end run %d\n", program, run);
+      exit(1);
+    }
+  }
+
+  if(raptor_spill_get_runs_count(spill) > RAPTOR_SPILL_MAX_RUNS) {
+    fprintf(stderr, "%s: Spill has %d runs, expected at most %d\n", program,
+            raptor_spill_get_runs_count(spill), RAPTOR_SPILL_MAX_RUNS);
+    failures++;
+  }
+
+  if(raptor_spill_merge_start(spill)) {
+    fprintf(stderr, "%s: Failed to start merge\n", program);
+    exit(1);
+  }
+
+  count = 0;
+  while((statement = raptor_spill_merge_get(spill, &i, &run))) {
+    if(i != run) {
+      fprintf(stderr, "%s: Statement %d has flags %d from run %d\n",
+              program, count, i, run);
+      failures++;
+    }
+
+    if(last) {
+      int d = raptor_statement_compare(last, statement);
+      if(d > 0 || (!d && run <= last_run)) {
+        fprintf(stderr, "%s: Statement %d is out of order\n", program,
+                count);
+        failures++;
+      }
+      raptor_free_statement(last);
+    }
+
+    for(i = 0; i < TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT; i++) {
+      if(!raptor_statement_compare(statement, statements[i]))
+        break;
+    }
+    if(i == TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT) {
+      fprintf(stderr, "%s: Statement %d was not written: ", program, count);
+      raptor_statement_print(statement, stderr);
+      fputc('\n', stderr);
+      failures++;
+    }
+
+    last = raptor_statement_copy(statement);
+    last_run = run;
+    count++;
+
+    if(raptor_spill_merge_next(spill))
+      break;
+  }
+  if(last)
+    raptor_free_statement(last);
+
+  if(count != TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT) {
+    fprintf(stderr, "%s: Merge returned %d statements, expected %d\n",
+            program, count, TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT);
+    failures++;
+  }
+
+  raptor_free_spill(spill);
+
+  for(i = 0; i < TEST_RUNS_COUNT * TEST_STATEMENTS_COUNT; i++)
+    raptor_free_statement(statements[i]);
+  raptor_free_uri(datatype);
+  raptor_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -422,3 +422,32 @@ raptor_statement_equals(const raptor_statement* s1, const raptor_statement* s2)
 
   return 1;
 }
+
+
+/**
+ * raptor_statement_hash:
+ * @statement: statement
+ *
+ * Get a hash value for a #raptor_statement
+ *
+ * Combines the raptor_term_hash() values of the subject, predicate,
+ * object and graph so statements that are equal by
+ * raptor_statement_compare() always have the same hash value.
+ *
+ * Return value: hash value (0 for a NULL statement)
+ */
+unsigned int
+raptor_statement_hash(const raptor_statement *statement)
+{
+  unsigned int hash;
+
+  if(!statement)
+    return 0;
+
+  hash = raptor_term_hash(statement->subject);
+  hash = hash * 31U + raptor_term_hash(statement->predicate);
+  hash = hash * 31U + raptor_term_hash(statement->object);
+  hash = hash * 31U + raptor_term_hash(statement->graph);
+
+  return hash;
+}
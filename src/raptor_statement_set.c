@@ -0,0 +1,436 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_statement_set.c - Hash set of statements
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * Open addressing with linear probing over slots holding the
+ * statement hash and a copy of the statement.  The hash is kept in
+ * the slot so that probing and growing the table only compares terms
+ * when the full hashes match.
+ */
+typedef struct {
+  unsigned int hash;
+  /* NULL if the slot is empty */
+  raptor_statement* statement;
+} raptor_statement_set_slot;
+
+struct raptor_statement_set_s {
+  raptor_world* world;
+
+  raptor_statement_set_slot* slots;
+  /* number of slots - a power of 2 */
+  int size;
+  /* number of statements */
+  int count;
+};
+
+#define RAPTOR_STATEMENT_SET_INITIAL_SIZE 64
+
+
+/**
+ * raptor_new_statement_set:
+ * @world: raptor world
+ *
+ * Constructor - create a new statement set
+ *
+ * A statement set holds statements that are distinct by
+ * raptor_statement_compare(), so the graph is significant.  Adding
+ * and searching use raptor_statement_hash() so they take constant
+ * time on average rather than the logarithmic number of term
+ * comparisons of a #raptor_avltree.
+ *
+ * Return value: new statement set or NULL on failure
+ **/
+raptor_statement_set*
+raptor_new_statement_set(raptor_world* world)
+{
+  raptor_statement_set* set;
+
+  RAPTOR_CHECK_CONSTRUCTOR_WORLD(world);
+
+  raptor_world_open(world);
+
+  set = RAPTOR_CALLOC(raptor_statement_set*, 1, sizeof(*set));
+  if(!set)
+    return NULL;
+
+  set->world = world;
+  set->size = RAPTOR_STATEMENT_SET_INITIAL_SIZE;
+  set->slots = RAPTOR_CALLOC(raptor_statement_set_slot*, set->size,
+                             sizeof(*set->slots));
+  if(!set->slots) {
+    RAPTOR_FREE(raptor_statement_set, set);
+    return NULL;
+  }
+
+  return set;
+}
+
+
+/**
+ * raptor_free_statement_set:
+ * @set: statement set
+ *
+ * Destructor - destroy a statement set and the statements it holds
+ **/
+void
+raptor_free_statement_set(raptor_statement_set* set)
+{
+  int i;
+
+  if(!set)
+    return;
+
+  for(i = 0; i < set->size; i++) {
+    if(set->slots[i].statement)
+      raptor_free_statement(set->slots[i].statement);
+  }
+
+  RAPTOR_FREE(raptor_statement_set_slot*, set->slots);
+  RAPTOR_FREE(raptor_statement_set, set);
+}
+
+
+/* Check two statements are equal including the graph */
+static int
+raptor_statement_set_equals(const raptor_statement* s1,
+                            const raptor_statement* s2)
+{
+  if(!raptor_statement_equals(s1, s2))
+    return 0;
+
+  if(!s1->graph || !s2->graph)
+    return !s1->graph && !s2->graph;
+
+  return raptor_term_equals(s1->graph, s2->graph);
+}
+
+
+/* Find the slot holding @statement or the empty slot it would go in */
+static raptor_statement_set_slot*
+raptor_statement_set_find(raptor_statement_set* set,
+                          const raptor_statement* statement,
+                          unsigned int hash)
+{
+  unsigned int mask = (unsigned int)set->size - 1;
+  unsigned int i;
+
+  for(i = hash & mask; set->slots[i].statement; i = (i + 1) & mask) {
+    if(set->slots[i].hash == hash &&
+       raptor_statement_set_equals(set->slots[i].statement, statement))
+      break;
+  }
+
+  return &set->slots[i];
+}
+
+
+/* Double the number of slots */
+static int
+raptor_statement_set_grow(raptor_statement_set* set)
+{
+  raptor_statement_set_slot* old_slots = set->slots;
+  int old_size = set->size;
+  unsigned int mask;
+  int i;
+
+  set->slots = RAPTOR_CALLOC(raptor_statement_set_slot*, old_size * 2,
+                             sizeof(*set->slots));
+  if(!set->slots) {
+    set->slots = old_slots;
+    return 1;
+  }
+  set->size = old_size * 2;
+  mask = (unsigned int)set->size - 1;
+
+  for(i = 0; i < old_size; i++) {
+    unsigned int j;
+
+    if(!old_slots[i].statement)
+      continue;
+
+    /* all distinct so only an empty slot needs to be found */
+    for(j = old_slots[i].hash & mask; set->slots[j].statement;
+        j = (j + 1) & mask)
+      ;
+    set->slots[j] = old_slots[i];
+  }
+
+  RAPTOR_FREE(raptor_statement_set_slot*, old_slots);
+
+  return 0;
+}
+
+
+/**
+ * raptor_statement_set_add:
+ * @set: statement set
+ * @statement: statement to add
+ *
+ * Add a statement to a statement set
+ *
+ * The set takes a copy of @statement with raptor_statement_copy()
+ * which only adds a reference to a statement that was allocated.
+ *
+ * Return value: 0 if added, >0 if an equal statement was already present or <0 on failure
+ **/
+int
+raptor_statement_set_add(raptor_statement_set* set,
+                         raptor_statement* statement)
+{
+  raptor_statement_set_slot* slot;
+  unsigned int hash;
+
+  if(!set || !statement)
+    return -1;
+
+  hash = raptor_statement_hash(statement);
+  slot = raptor_statement_set_find(set, statement, hash);
+  if(slot->statement)
+    return 1;
+
+  /* keep the load factor at or below 1/2 */
+  if((set->count + 1) * 2 > set->size) {
+    if(raptor_statement_set_grow(set))
+      return -1;
+    slot = raptor_statement_set_find(set, statement, hash);
+  }
+
+  slot->statement = raptor_statement_copy(statement);
+  if(!slot->statement)
+    return -1;
+  slot->hash = hash;
+  set->count++;
+
+  return 0;
+}
+
+
+/**
+ * raptor_statement_set_contains:
+ * @set: statement set
+ * @statement: statement to look for
+ *
+ * Check if a statement set holds a statement
+ *
+ * Return value: non-0 if an equal statement is in the set
+ **/
+int
+raptor_statement_set_contains(raptor_statement_set* set,
+                              const raptor_statement* statement)
+{
+  if(!set || !statement)
+    return 0;
+
+  return raptor_statement_set_find(set, statement,
+                                   raptor_statement_hash(statement))->statement != NULL;
+}
+
+
+/**
+ * raptor_statement_set_size:
+ * @set: statement set
+ *
+ * Get the number of statements in a statement set
+ *
+ * Return value: number of statements or <0 on failure
+ **/
+int
+raptor_statement_set_size(raptor_statement_set* set)
+{
+  if(!set)
+    return -1;
+
+  return set->count;
+}
+
+
+/**
+ * raptor_statement_set_visit:
+ * @set: statement set
+ * @visit_handler: function to call for each statement
+ * @user_data: user data for @visit_handler
+ *
+ * Call a function for each statement in a statement set
+ *
+ * The order is unspecified.  The set must not be changed during the
+ * visit.
+ *
+ * Return value: non-0 if a visit handler returned non-0 to stop early
+ **/
+int
+raptor_statement_set_visit(raptor_statement_set* set,
+                           raptor_statement_set_visit_handler visit_handler,
+                           void* user_data)
+{
+  int i;
+
+  if(!set || !visit_handler)
+    return 1;
+
+  for(i = 0; i < set->size; i++) {
+    if(set->slots[i].statement &&
+       visit_handler(set->slots[i].statement, user_data))
+      return 1;
+  }
+
+  return 0;
+}
+
+#endif
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static int
+count_visit_handler(raptor_statement* statement, void* user_data)
+{
+  (*(int*)user_data)++;
+  return 0;
+}
+
+
+#define TEST_STATEMENTS_COUNT 1000
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = raptor_basename(argv[0]);
+  raptor_world *world;
+  raptor_statement_set* set = NULL;
+  raptor_uri* predicate_uri;
+  raptor_uri* graph_uri;
+  raptor_statement* s;
+  char buffer[64];
+  int failures = 0;
+  int i;
+  int rc;
+  int visited = 0;
+
+  world = raptor_new_world();
+  if(!world || raptor_world_open(world))
+    exit(1);
+
+  set = raptor_new_statement_set(world);
+  if(!set) {
+    fprintf(stderr, "%s: raptor_new_statement_set() failed\n", program);
+    exit(1);
+  }
+
+  predicate_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/p");
+  graph_uri = raptor_new_uri(world, (const unsigned char*)"http://example.org/g");
+
+  /* Add each statement twice, the second time with a graph */
+  for(i = 0; i < TEST_STATEMENTS_COUNT * 2; i++) {
+    int n = i % TEST_STATEMENTS_COUNT;
+
+    sprintf(buffer, "b%d", n);
+    s = raptor_new_statement_from_nodes(world,
+                                        raptor_new_term_from_blank(world, (const unsigned char*)buffer),
+                                        raptor_new_term_from_uri(world, predicate_uri),
+                                        raptor_new_term_from_literal(world, (const unsigned char*)buffer, NULL, (n & 1) ? (const unsigned char*)"en" : NULL),
+                                        (i < TEST_STATEMENTS_COUNT) ? NULL : raptor_new_term_from_uri(world, graph_uri));
+
+    rc = raptor_statement_set_add(set, s);
+    if(rc) {
+      fprintf(stderr, "%s: adding statement %d returned %d expected 0\n",
+              program, i, rc);
+      failures++;
+    }
+
+    /* adding the same statement again must find it */
+    rc = raptor_statement_set_add(set, s);
+    if(rc <= 0) {
+      fprintf(stderr, "%s: adding duplicate statement %d returned %d expected >0\n",
+              program, i, rc);
+      failures++;
+    }
+
+    raptor_free_statement(s);
+  }
+
+  if(raptor_statement_set_size(set) != TEST_STATEMENTS_COUNT * 2) {
+    fprintf(stderr, "%s: set size %d expected %d\n", program,
+            raptor_statement_set_size(set), TEST_STATEMENTS_COUNT * 2);
+    failures++;
+  }
+
+  /* an equal but separately constructed statement is found */
+  sprintf(buffer, "b%d", 3);
+  s = raptor_new_statement_from_nodes(world,
+                                      raptor_new_term_from_blank(world, (const unsigned char*)buffer),
+                                      raptor_new_term_from_uri(world, predicate_uri),
+                                      raptor_new_term_from_literal(world, (const unsigned char*)buffer, NULL, (const unsigned char*)"en"),
+                                      NULL);
+  if(!raptor_statement_set_contains(set, s)) {
+    fprintf(stderr, "%s: set does not contain an added statement\n", program);
+    failures++;
+  }
+
+  /* and one differing only by language is not */
+  raptor_free_term(s->object);
+  s->object = raptor_new_term_from_literal(world, (const unsigned char*)buffer, NULL, NULL);
+  if(raptor_statement_set_contains(set, s)) {
+    fprintf(stderr, "%s: set contains a statement never added\n", program);
+    failures++;
+  }
+  raptor_free_statement(s);
+
+  raptor_statement_set_visit(set, count_visit_handler, &visited);
+  if(visited != TEST_STATEMENTS_COUNT * 2) {
+    fprintf(stderr, "%s: visited %d statements expected %d\n", program,
+            visited, TEST_STATEMENTS_COUNT * 2);
+    failures++;
+  }
+
+  raptor_free_uri(predicate_uri);
+  raptor_free_uri(graph_uri);
+  raptor_free_statement_set(set);
+  raptor_free_world(world);
+
+  return failures;
+}
+
+#endif
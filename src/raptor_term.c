@@ -52,6 +52,72 @@
 */
 raptor_term*
 raptor_new_term_from_uri(raptor_world* world, raptor_uri* uri)
+{
+  return raptor_new_term_from_uri_in_arena(NULL, world, uri);
+}
+
+
+/* Allocate a zeroed term structure from @arena or the heap */
+static raptor_term*
+raptor_term_alloc(raptor_arena* arena)
+{
+  raptor_term *t;
+
+  if(!arena) {
+    t = RAPTOR_CALLOC(raptor_term*, 1, sizeof(*t));
+    if(t)
+      t->usage = 1;
+    return t;
+  }
+
+  t = (raptor_term*)raptor_arena_alloc(arena, sizeof(*t));
+  if(t) {
+    memset(t, 0, sizeof(*t));
+    t->usage = RAPTOR_TERM_USAGE_ARENA;
+  }
+  return t;
+}
+
+
+/* Copy a counted string to @arena or the heap, adding a NUL */
+static unsigned char*
+raptor_term_strndup(raptor_arena* arena, const unsigned char* string,
+                    size_t length)
+{
+  unsigned char* s;
+
+  if(arena)
+    return raptor_arena_strndup(arena, string, length);
+
+  s = RAPTOR_MALLOC(unsigned char*, length + 1);
+  if(!s)
+    return NULL;
+  if(length)
+    memcpy(s, string, length);
+  s[length] = '\0';
+
+  return s;
+}
+
+
+/*
+ * raptor_new_term_from_uri_in_arena:
+ * @arena: arena to allocate from (or NULL)
+ * @world: raptor world
+ * @uri: uri
+ *
+ * INTERNAL - Constructor - create a new URI statement term
+ *
+ * If @arena is given the term structure is allocated from it, is not
+ * reference counted and is valid until the arena is reset.
+ * raptor_free_term() then only releases the URI and raptor_term_copy()
+ * makes a new heap term.
+ *
+ * Return value: new term or NULL on failure
+ */
+raptor_term*
+raptor_new_term_from_uri_in_arena(raptor_arena* arena, raptor_world* world,
+                                  raptor_uri* uri)
 {
   raptor_term *t;
 
@@ -62,11 +128,10 @@ raptor_new_term_from_uri(raptor_world* world, raptor_uri* uri)
   
   raptor_world_open(world);
 
-  t = RAPTOR_CALLOC(raptor_term*, 1, sizeof(*t));
+  t = raptor_term_alloc(arena);
   if(!t)
     return NULL;
 
-  t->usage = 1;
   t->world = world;
   t->type = RAPTOR_TERM_TYPE_URI;
   t->value.uri = raptor_uri_copy(uri);
@@ -169,6 +234,40 @@ raptor_new_term_from_counted_literal(raptor_world* world,
                                      raptor_uri* datatype,
                                      const unsigned char* language,
                                      unsigned char language_len)
+{
+  return raptor_new_term_from_counted_literal_in_arena(NULL, world,
+                                                       literal, literal_len,
+                                                       datatype,
+                                                       language, language_len);
+}
+
+
+/*
+ * raptor_new_term_from_counted_literal_in_arena:
+ * @arena: arena to allocate from (or NULL)
+ * @world: raptor world
+ * @literal: UTF-8 encoded literal string (or NULL for empty literal)
+ * @literal_len: length of literal
+ * @datatype: literal datatype URI (or NULL)
+ * @language: literal language (or NULL for no language)
+ * @language_len: literal language length
+ *
+ * INTERNAL - Constructor - create a new literal statement term
+ *
+ * As raptor_new_term_from_counted_literal() allocating the term and
+ * its strings from @arena if given: see
+ * raptor_new_term_from_uri_in_arena().
+ *
+ * Return value: new term or NULL on failure
+ */
+raptor_term*
+raptor_new_term_from_counted_literal_in_arena(raptor_arena* arena,
+                                              raptor_world* world,
+                                              const unsigned char* literal,
+                                              size_t literal_len,
+                                              raptor_uri* datatype,
+                                              const unsigned char* language,
+                                              unsigned char language_len)
 {
   raptor_term *t;
   unsigned char* new_literal = NULL;
@@ -185,26 +284,24 @@ raptor_new_term_from_counted_literal(raptor_world* world,
     return NULL;
   
 
-  new_literal = RAPTOR_MALLOC(unsigned char*, literal_len + 1);
-  if(!new_literal)
-    return NULL;
-
   if(!literal || !*literal)
     literal_len = 0;
 
-  if(literal_len) {
-    memcpy(new_literal, literal, literal_len);
-    new_literal[literal_len] = '\0';
-  } else
-    *new_literal = '\0';
+  new_literal = raptor_term_strndup(arena, literal, literal_len);
+  if(!new_literal)
+    return NULL;
 
   if(language) {
     unsigned char c;
     unsigned char* l;
     
-    new_language = RAPTOR_MALLOC(unsigned char*, language_len + 1);
+    if(arena)
+      new_language = (unsigned char*)raptor_arena_alloc(arena, language_len + 1);
+    else
+      new_language = RAPTOR_MALLOC(unsigned char*, language_len + 1);
     if(!new_language) {
-      RAPTOR_FREE(char*, new_literal);
+      if(!arena)
+        RAPTOR_FREE(char*, new_literal);
       return NULL;
     }
 
@@ -222,17 +319,18 @@ raptor_new_term_from_counted_literal(raptor_world* world,
     datatype = raptor_uri_copy(datatype);
   
 
-  t = RAPTOR_CALLOC(raptor_term*, 1, sizeof(*t));
+  t = raptor_term_alloc(arena);
   if(!t) {
-    if(new_literal)
-      RAPTOR_FREE(char*, new_literal);
-    if(new_language)
-      RAPTOR_FREE(char*, new_language);
+    if(!arena) {
+      if(new_literal)
+        RAPTOR_FREE(char*, new_literal);
+      if(new_language)
+        RAPTOR_FREE(char*, new_language);
+    }
     if(datatype)
       raptor_free_uri(datatype);
     return NULL;
   }
-  t->usage = 1;
   t->world = world;
   t->type = RAPTOR_TERM_TYPE_LITERAL;
   t->value.literal.string = new_literal;
@@ -309,6 +407,32 @@ raptor_new_term_from_literal(raptor_world* world,
 raptor_term*
 raptor_new_term_from_counted_blank(raptor_world* world,
                                    const unsigned char* blank, size_t length)
+{
+  return raptor_new_term_from_counted_blank_in_arena(NULL, world,
+                                                     blank, length);
+}
+
+
+/*
+ * raptor_new_term_from_counted_blank_in_arena:
+ * @arena: arena to allocate from (or NULL)
+ * @world: raptor world
+ * @blank: UTF-8 encoded blank node identifier (or NULL)
+ * @length: length of identifier (or 0)
+ *
+ * INTERNAL - Constructor - create a new blank node statement term
+ *
+ * As raptor_new_term_from_counted_blank() allocating the term and
+ * its identifier from @arena if given: see
+ * raptor_new_term_from_uri_in_arena().
+ *
+ * Return value: new term or NULL on failure
+ */
+raptor_term*
+raptor_new_term_from_counted_blank_in_arena(raptor_arena* arena,
+                                            raptor_world* world,
+                                            const unsigned char* blank,
+                                            size_t length)
 {
   raptor_term *t;
   unsigned char* new_id;
@@ -318,23 +442,30 @@ raptor_new_term_from_counted_blank(raptor_world* world,
   raptor_world_open(world);
 
   if (blank) {
-    new_id = RAPTOR_MALLOC(unsigned char*, length + 1);
+    new_id = raptor_term_strndup(arena, blank, length);
     if(!new_id)
       return NULL;
-    memcpy(new_id, blank, length);
-    new_id[length] = '\0';
   } else {
-    new_id = raptor_world_generate_bnodeid(world);
-    length = strlen((const char*)new_id);
+    unsigned char* id = raptor_world_generate_bnodeid(world);
+    if(!id)
+      return NULL;
+    length = strlen((const char*)id);
+    if(arena) {
+      new_id = raptor_arena_strndup(arena, id, length);
+      RAPTOR_FREE(char*, id);
+      if(!new_id)
+        return NULL;
+    } else
+      new_id = id;
   }
 
-  t = RAPTOR_CALLOC(raptor_term*, 1, sizeof(*t));
+  t = raptor_term_alloc(arena);
   if(!t) {
-    RAPTOR_FREE(char*, new_id);
+    if(!arena)
+      RAPTOR_FREE(char*, new_id);
     return NULL;
   }
 
-  t->usage = 1;
   t->world = world;
   t->type = RAPTOR_TERM_TYPE_BLANK;
   t->value.blank.string = new_id;
@@ -413,7 +544,7 @@ raptor_new_term_from_counted_string(raptor_world* world,
   locator.line = -1;
 
   bytes_read = raptor_ntriples_parse_term(world, &locator,
-                                          string, &length, &term, 1);
+                                          string, &length, &term, 1, NULL);
 
   if(!bytes_read || length != 0) {
     if(term)
@@ -439,7 +570,35 @@ raptor_term_copy(raptor_term* term)
   if(!term)
     return NULL;
 
-  term->usage++;
+  /* an arena term lives only until the arena is reset: copy it out */
+  if(term->usage == RAPTOR_TERM_USAGE_ARENA) {
+    switch(term->type) {
+      case RAPTOR_TERM_TYPE_URI:
+        return raptor_new_term_from_uri(term->world, term->value.uri);
+
+      case RAPTOR_TERM_TYPE_LITERAL:
+        return raptor_new_term_from_counted_literal(term->world,
+                                                    term->value.literal.string,
+                                                    term->value.literal.string_len,
+                                                    term->value.literal.datatype,
+                                                    term->value.literal.language,
+                                                    term->value.literal.language_len);
+
+      case RAPTOR_TERM_TYPE_BLANK:
+        return raptor_new_term_from_counted_blank(term->world,
+                                                  term->value.blank.string,
+                                                  term->value.blank.string_len);
+
+      case RAPTOR_TERM_TYPE_UNKNOWN:
+      default:
+        return NULL;
+    }
+  }
+
+  if(term->world->concurrent)
+    RAPTOR_ATOMIC_ADD(&term->usage, 1);
+  else
+    term->usage++;
   return term;
 }
 
@@ -457,7 +616,26 @@ raptor_free_term(raptor_term *term)
   if(!term)
     return;
   
-  if(--term->usage)
+  if(term->usage == RAPTOR_TERM_USAGE_ARENA) {
+    /* memory belongs to the arena: only release the URI references */
+    if(term->type == RAPTOR_TERM_TYPE_URI) {
+      if(term->value.uri) {
+        raptor_free_uri(term->value.uri);
+        term->value.uri = NULL;
+      }
+    } else if(term->type == RAPTOR_TERM_TYPE_LITERAL) {
+      if(term->value.literal.datatype) {
+        raptor_free_uri(term->value.literal.datatype);
+        term->value.literal.datatype = NULL;
+      }
+    }
+    return;
+  }
+
+  if(term->world->concurrent) {
+    if(RAPTOR_ATOMIC_ADD(&term->usage, -1))
+      return;
+  } else if(--term->usage)
     return;
   
   switch(term->type) {
@@ -757,6 +935,78 @@ raptor_term_compare(const raptor_term *t1,  const raptor_term *t2)
 
   return d;
 }
+
+
+/* Continue a FNV-1a hash with a NUL-terminated string */
+static unsigned int
+raptor_term_hash_string(unsigned int hash, const unsigned char* string)
+{
+  while(*string) {
+    hash ^= *string++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+
+/* Mix a hash value into a running hash */
+#define RAPTOR_TERM_HASH_MIX(hash, value) \
+  ((hash) ^ ((value) + 0x9e3779b9U + ((hash) << 6) + ((hash) >> 2)))
+
+
+/**
+ * raptor_term_hash:
+ * @term: term (or NULL)
+ *
+ * Get a hash value for a #raptor_term
+ *
+ * Terms that are equal by raptor_term_equals() or
+ * raptor_term_compare() always have the same hash value.  URI hashes
+ * are computed once when the #raptor_uri is constructed so hashing
+ * a URI term does not read the URI string.
+ *
+ * Return value: hash value (0 for a NULL term)
+ */
+unsigned int
+raptor_term_hash(const raptor_term *term)
+{
+  unsigned int hash;
+
+  if(!term)
+    return 0;
+
+  /* start from the FNV-1a offset basis varied by the term type */
+  hash = 2166136261U ^ (unsigned int)term->type;
+
+  switch(term->type) {
+    case RAPTOR_TERM_TYPE_URI:
+      hash = RAPTOR_TERM_HASH_MIX(hash, raptor_uri_get_hash(term->value.uri));
+      break;
+
+    case RAPTOR_TERM_TYPE_BLANK:
+      hash = raptor_term_hash_string(hash, term->value.blank.string);
+      break;
+      
+    case RAPTOR_TERM_TYPE_LITERAL:
+      hash = raptor_term_hash_string(hash, term->value.literal.string);
+      if(term->value.literal.language) {
+        /* separate the string from the language */
+        hash = RAPTOR_TERM_HASH_MIX(hash, '@');
+        hash = raptor_term_hash_string(hash, term->value.literal.language);
+      }
+      if(term->value.literal.datatype)
+        hash = RAPTOR_TERM_HASH_MIX(hash,
+                                    raptor_uri_get_hash(term->value.literal.datatype));
+      break;
+      
+    case RAPTOR_TERM_TYPE_UNKNOWN:
+    default:
+      break;
+  }
+
+  return hash;
+}
 #endif
 
 
@@ -1017,6 +1267,20 @@ main(int argc, char *argv[])
     rc = 1;
     goto tidy;
   }
+
+  if(raptor_term_hash(term1) != raptor_term_hash(term5)) {
+    fprintf(stderr, "%s: raptor_term_hash (URI %s) differs for equal terms\n",
+            program, uri_string1);
+    rc = 1;
+    goto tidy;
+  }
+
+  if(raptor_term_hash(term1) == raptor_term_hash(term4)) {
+    fprintf(stderr, "%s: raptor_term_hash (URI %s, URI %s) returned the same hash\n",
+            program, uri_string1, uri_string2);
+    rc = 1;
+    goto tidy;
+  }
   
 
   tidy:
@@ -59,6 +59,9 @@ struct raptor_turtle_writer_s {
  
   raptor_uri* base_uri;
 
+  /* relativiser bound to base_uri, created on first reference */
+  raptor_uri_relativiser* relativiser;
+
   int my_nstack;
   raptor_namespace_stack *nstack;
   int nstack_depth;
@@ -235,6 +238,9 @@ raptor_free_turtle_writer(raptor_turtle_writer* turtle_writer)
   if(turtle_writer->nstack && turtle_writer->my_nstack)
     raptor_free_namespaces(turtle_writer->nstack);
 
+  if(turtle_writer->relativiser)
+    raptor_free_uri_relativiser(turtle_writer->relativiser);
+
   RAPTOR_FREE(raptor_turtle_writer, turtle_writer);
 }
 
@@ -350,9 +356,22 @@ int
 raptor_turtle_writer_reference(raptor_turtle_writer* turtle_writer, 
                                raptor_uri* uri)
 {
-  return raptor_uri_escaped_write(uri, turtle_writer->base_uri, 
-                                  RAPTOR_ESCAPED_WRITE_TURTLE_URI,
-                                  turtle_writer->iostr);
+  if(!turtle_writer->base_uri)
+    return raptor_uri_escaped_write(uri, NULL,
+                                    RAPTOR_ESCAPED_WRITE_TURTLE_URI,
+                                    turtle_writer->iostr);
+
+  if(!turtle_writer->relativiser) {
+    turtle_writer->relativiser = raptor_new_uri_relativiser(turtle_writer->base_uri);
+    if(!turtle_writer->relativiser)
+      return 1;
+  } else if(raptor_uri_relativiser_set_base(turtle_writer->relativiser,
+                                            turtle_writer->base_uri))
+    return 1;
+
+  return raptor_uri_relativiser_escaped_write(turtle_writer->relativiser, uri,
+                                              RAPTOR_ESCAPED_WRITE_TURTLE_URI,
+                                              turtle_writer->iostr);
 }
 
 
@@ -608,6 +627,16 @@ raptor_turtle_writer_set_option(raptor_turtle_writer *turtle_writer,
     case RAPTOR_OPTION_HTML_LINK:
     case RAPTOR_OPTION_WWW_TIMEOUT:
     case RAPTOR_OPTION_STRICT:
+    case RAPTOR_OPTION_PARSE_THREADS:
+    case RAPTOR_OPTION_PARSE_THREADS_UNORDERED:
+    case RAPTOR_OPTION_TERM_ARENA:
+    case RAPTOR_OPTION_READ_BUFFER_SIZE:
+    case RAPTOR_OPTION_MMAP_INPUT:
+    case RAPTOR_OPTION_GROUPED_SUBJECTS:
+    case RAPTOR_OPTION_MEMORY_BUDGET:
+    case RAPTOR_OPTION_CHECK_RDF_ID_FILTER_SIZE:
+    case RAPTOR_OPTION_UNIQUE_STATEMENTS:
+    case RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE:
       
     /* Shared */
     case RAPTOR_OPTION_NO_NET:
@@ -732,6 +761,16 @@ raptor_turtle_writer_get_option(raptor_turtle_writer *turtle_writer,
     case RAPTOR_OPTION_HTML_LINK:
     case RAPTOR_OPTION_WWW_TIMEOUT:
     case RAPTOR_OPTION_STRICT:
+    case RAPTOR_OPTION_PARSE_THREADS:
+    case RAPTOR_OPTION_PARSE_THREADS_UNORDERED:
+    case RAPTOR_OPTION_TERM_ARENA:
+    case RAPTOR_OPTION_READ_BUFFER_SIZE:
+    case RAPTOR_OPTION_MMAP_INPUT:
+    case RAPTOR_OPTION_GROUPED_SUBJECTS:
+    case RAPTOR_OPTION_MEMORY_BUDGET:
+    case RAPTOR_OPTION_CHECK_RDF_ID_FILTER_SIZE:
+    case RAPTOR_OPTION_UNIQUE_STATEMENTS:
+    case RAPTOR_OPTION_UNIQUE_STATEMENTS_FILTER_SIZE:
 
     /* Shared */
     case RAPTOR_OPTION_NO_NET:
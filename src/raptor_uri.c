@@ -72,11 +72,249 @@ struct raptor_uri_s {
   unsigned int length;
   /* usage count */
   int usage;
+  /* hash of string */
+  unsigned int hash;
 };
 
 
 #ifndef STANDALONE
 
+/*
+ * Interned URI hash table
+ *
+ * Open addressing with linear probing.  Removed entries are replaced
+ * by a marker so that probe sequences continue past them; markers are
+ * dropped when the table is rebuilt.
+ *
+ * A concurrent world splits the URIs over RAPTOR_URI_TABLE_SHARDS
+ * tables by the top bits of the hash, each with its own lock.
+ */
+struct raptor_uri_table_s {
+  /* slots: NULL (empty), RAPTOR_URI_TABLE_DELETED or a URI */
+  raptor_uri** slots;
+  /* number of slots - a power of 2 */
+  size_t size;
+  /* number of URIs in the table */
+  size_t count;
+  /* number of slots not empty: URIs and deleted markers */
+  size_t used;
+#ifdef RAPTOR_THREADS
+  /* guards this table in a concurrent world */
+  pthread_mutex_t mutex;
+#endif
+};
+
+#define RAPTOR_URI_TABLE_INITIAL_SIZE 1024
+
+/* Number of tables in a concurrent world - a power of 2, at most 256 */
+#define RAPTOR_URI_TABLE_SHARDS 64
+
+static raptor_uri raptor_uri_table_deleted_marker;
+#define RAPTOR_URI_TABLE_DELETED (&raptor_uri_table_deleted_marker)
+
+
+/* FNV-1a hash of a counted string */
+static unsigned int
+raptor_uri_hash_string(const unsigned char *string, size_t length)
+{
+  unsigned int hash = 2166136261U;
+
+  while(length--) {
+    hash ^= *string++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+
+static void raptor_free_uri_tables(raptor_uri_table* tables, int count);
+
+static raptor_uri_table*
+raptor_new_uri_tables(int count)
+{
+  raptor_uri_table* tables;
+  int i;
+
+  tables = RAPTOR_CALLOC(raptor_uri_table*, count, sizeof(*tables));
+  if(!tables)
+    return NULL;
+
+  for(i = 0; i < count; i++) {
+    raptor_uri_table* table = &tables[i];
+
+    table->size = RAPTOR_URI_TABLE_INITIAL_SIZE;
+    table->slots = RAPTOR_CALLOC(raptor_uri**, table->size,
+                                 sizeof(raptor_uri*));
+    if(!table->slots) {
+      raptor_free_uri_tables(tables, i);
+      return NULL;
+    }
+#ifdef RAPTOR_THREADS
+    pthread_mutex_init(&table->mutex, NULL);
+#endif
+  }
+
+  return tables;
+}
+
+
+static void
+raptor_free_uri_tables(raptor_uri_table* tables, int count)
+{
+  int i;
+
+  for(i = 0; i < count; i++) {
+#ifdef RAPTOR_THREADS
+    pthread_mutex_destroy(&tables[i].mutex);
+#endif
+    RAPTOR_FREE(raptor_uri**, tables[i].slots);
+  }
+  RAPTOR_FREE(raptor_uri_table, tables);
+}
+
+
+/* Get the table holding URIs with the given hash (or NULL) */
+static raptor_uri_table*
+raptor_world_uri_table(raptor_world* world, unsigned int hash)
+{
+  if(!world->uris_table)
+    return NULL;
+
+  return &world->uris_table[(hash >> 24) & (world->uris_tables_count - 1)];
+}
+
+
+/* Lock URI interning for a table (or the tree) if needed */
+static void
+raptor_uri_interning_lock(raptor_world* world, raptor_uri_table* table)
+{
+#ifdef RAPTOR_THREADS
+  if(world->concurrent) {
+    if(table)
+      pthread_mutex_lock(&table->mutex);
+  } else
+    RAPTOR_WORLD_LOCK(world, uris_mutex);
+#endif
+}
+
+
+static void
+raptor_uri_interning_unlock(raptor_world* world, raptor_uri_table* table)
+{
+#ifdef RAPTOR_THREADS
+  if(world->concurrent) {
+    if(table)
+      pthread_mutex_unlock(&table->mutex);
+  } else
+    RAPTOR_WORLD_UNLOCK(world, uris_mutex);
+#endif
+}
+
+
+static raptor_uri*
+raptor_uri_table_search(raptor_uri_table* table, unsigned int hash,
+                        const unsigned char *string, size_t length)
+{
+  size_t mask = table->size - 1;
+  size_t i;
+  raptor_uri* uri;
+
+  for(i = hash & mask; (uri = table->slots[i]); i = (i + 1) & mask) {
+    if(uri != RAPTOR_URI_TABLE_DELETED && uri->hash == hash &&
+       uri->length == length && !memcmp(uri->string, string, length))
+      return uri;
+  }
+
+  return NULL;
+}
+
+
+/* Rebuild the table with room for at least one more URI */
+static int
+raptor_uri_table_resize(raptor_uri_table* table)
+{
+  raptor_uri** old_slots = table->slots;
+  size_t old_size = table->size;
+  size_t new_size = RAPTOR_URI_TABLE_INITIAL_SIZE;
+  size_t mask;
+  size_t i;
+
+  /* keep the table at most half full after rebuilding */
+  while(new_size < (table->count + 1) * 2)
+    new_size <<= 1;
+
+  table->slots = RAPTOR_CALLOC(raptor_uri**, new_size, sizeof(raptor_uri*));
+  if(!table->slots) {
+    table->slots = old_slots;
+    return 1;
+  }
+
+  table->size = new_size;
+  table->used = table->count;
+  mask = new_size - 1;
+
+  for(i = 0; i < old_size; i++) {
+    raptor_uri* uri = old_slots[i];
+    size_t j;
+
+    if(!uri || uri == RAPTOR_URI_TABLE_DELETED)
+      continue;
+
+    for(j = uri->hash & mask; table->slots[j]; j = (j + 1) & mask)
+      ;
+    table->slots[j] = uri;
+  }
+
+  RAPTOR_FREE(raptor_uri**, old_slots);
+
+  return 0;
+}
+
+
+static int
+raptor_uri_table_add(raptor_uri_table* table, raptor_uri* uri)
+{
+  size_t mask;
+  size_t i;
+
+  /* rebuild when more than 3/4 of the slots are not empty */
+  if((table->used + 1) * 4 > table->size * 3) {
+    if(raptor_uri_table_resize(table))
+      return 1;
+  }
+
+  mask = table->size - 1;
+  for(i = uri->hash & mask; table->slots[i]; i = (i + 1) & mask) {
+    if(table->slots[i] == RAPTOR_URI_TABLE_DELETED)
+      break;
+  }
+
+  if(!table->slots[i])
+    table->used++;
+  table->slots[i] = uri;
+  table->count++;
+
+  return 0;
+}
+
+
+static void
+raptor_uri_table_delete(raptor_uri_table* table, raptor_uri* uri)
+{
+  size_t mask = table->size - 1;
+  size_t i;
+
+  for(i = uri->hash & mask; table->slots[i]; i = (i + 1) & mask) {
+    if(table->slots[i] == uri) {
+      table->slots[i] = RAPTOR_URI_TABLE_DELETED;
+      table->count--;
+      return;
+    }
+  }
+}
+
+
 /**
  * raptor_new_uri_from_counted_string:
  * @world: raptor_world object
@@ -97,6 +335,8 @@ raptor_new_uri_from_counted_string(raptor_world* world,
 {
   raptor_uri* new_uri;
   unsigned char *new_string;
+  unsigned int hash;
+  raptor_uri_table* table;
   
   RAPTOR_CHECK_CONSTRUCTOR_WORLD(world);
 
@@ -105,7 +345,22 @@ raptor_new_uri_from_counted_string(raptor_world* world,
 
   raptor_world_open(world);
 
-  if(world->uris_tree) {
+  hash = raptor_uri_hash_string(uri_string, length);
+  table = raptor_world_uri_table(world, hash);
+
+  raptor_uri_interning_lock(world, table);
+
+  if(table) {
+    /* if existing URI found in table, return it */
+    new_uri = raptor_uri_table_search(table, hash, uri_string, length);
+    if(new_uri) {
+      if(world->concurrent)
+        RAPTOR_ATOMIC_ADD(&new_uri->usage, 1);
+      else
+        new_uri->usage++;
+      goto unlock;
+    }
+  } else if(world->uris_tree) {
     raptor_uri key; /* on stack - not allocated */
 
     /* just to be safe */
@@ -143,6 +398,7 @@ raptor_new_uri_from_counted_string(raptor_world* world,
 
   new_uri->world = world;
   new_uri->length = (unsigned int)length;
+  new_uri->hash = hash;
 
   new_string = RAPTOR_MALLOC(unsigned char*, length + 1);
   if(!new_string) {
@@ -157,8 +413,14 @@ raptor_new_uri_from_counted_string(raptor_world* world,
 
   new_uri->usage = 1; /* for user */
 
-  /* store in tree */
-  if(world->uris_tree) {
+  /* store in table or tree */
+  if(table) {
+    if(raptor_uri_table_add(table, new_uri)) {
+      RAPTOR_FREE(char*, new_string);
+      RAPTOR_FREE(raptor_uri, new_uri);
+      new_uri = NULL;
+    }
+  } else if(world->uris_tree) {
     if(raptor_avltree_add(world->uris_tree, new_uri)) {
       RAPTOR_FREE(char*, new_string);
       RAPTOR_FREE(raptor_uri, new_uri);
@@ -167,6 +429,7 @@ raptor_new_uri_from_counted_string(raptor_world* world,
   }
 
  unlock:
+  raptor_uri_interning_unlock(world, table);
 
   return new_uri;
 }
@@ -279,6 +542,10 @@ raptor_new_uri_relative_to_base_counted(raptor_world* world,
   /* If URI string is empty, just copy base URI */
   if(!*uri_string)
     return raptor_uri_copy(base_uri);
+
+  /* An absolute URI with no dot segments resolves to itself */
+  if(raptor_uri_reference_is_normalized_absolute(uri_string, uri_len))
+    return raptor_new_uri_from_counted_string(world, uri_string, uri_len);
   
   /* +1 for adding any missing URI path '/' */
   buffer_length = base_uri->length + uri_len + 1;
@@ -471,23 +738,49 @@ raptor_new_uri_from_uri_or_file_string(raptor_world* world,
 void
 raptor_free_uri(raptor_uri *uri)
 {
+  raptor_world* world;
+  raptor_uri_table* table;
+  int usage;
+
   if(!uri)
     return;
 
-  uri->usage--;
+  world = uri->world;
+
+  if(world->concurrent) {
+    /* drop a reference without locking unless it may be the last */
+    while((usage = RAPTOR_ATOMIC_GET(&uri->usage)) > 1) {
+      if(RAPTOR_ATOMIC_CAS(&uri->usage, usage, usage - 1))
+        return;
+    }
+  }
+
+  table = raptor_world_uri_table(world, uri->hash);
+  raptor_uri_interning_lock(world, table);
+
+  /* a concurrent lookup may have found the URI since the check above */
+  if(world->concurrent)
+    usage = RAPTOR_ATOMIC_ADD(&uri->usage, -1);
+  else
+    usage = --uri->usage;
   
 #if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-  RAPTOR_DEBUG3("URI %s usage count now %d\n", uri->string, uri->usage);
+  RAPTOR_DEBUG3("URI %s usage count now %d\n", uri->string, usage);
 #endif
 
   /* decrement usage, don't free if not 0 yet*/
-  if(uri->usage > 0) {
+  if(usage > 0) {
+    raptor_uri_interning_unlock(world, table);
     return;
   }
 
   /* this does not free the uri */
-  if(uri->world->uris_tree)
-    raptor_avltree_delete(uri->world->uris_tree, uri);
+  if(table)
+    raptor_uri_table_delete(table, uri);
+  else if(world->uris_tree)
+    raptor_avltree_delete(world->uris_tree, uri);
+
+  raptor_uri_interning_unlock(world, table);
 
   if(uri->string)
     RAPTOR_FREE(char*, uri->string);
@@ -516,6 +809,9 @@ raptor_uri_equals(raptor_uri* uri1, raptor_uri* uri2)
     else if (uri1->length != uri2->length)
       /* Different if lengths are different */
       return 0;
+    else if (uri1->hash != uri2->hash)
+      /* Different if the cached string hashes are different */
+      return 0;
     else
       /* Same length compare: do not need strncmp() NUL checking */
       return memcmp((const char*)uri1->string, (const char*)uri2->string,
@@ -529,6 +825,23 @@ raptor_uri_equals(raptor_uri* uri1, raptor_uri* uri2)
 }
 
 
+/*
+ * raptor_uri_get_hash:
+ * @uri: URI object
+ *
+ * INTERNAL - Get the hash of the URI string computed at construction
+ *
+ * Equal URIs always have equal hashes.
+ *
+ * Return value: hash value
+ */
+unsigned int
+raptor_uri_get_hash(raptor_uri* uri)
+{
+  return uri->hash;
+}
+
+
 /**
  * raptor_uri_compare:
  * @uri1: URI 1 (may be NULL)
@@ -578,7 +891,14 @@ raptor_uri_copy(raptor_uri *uri)
 {
   RAPTOR_ASSERT_OBJECT_POINTER_RETURN_VALUE(uri, raptor_uri, NULL);
   
-  uri->usage++;
+  if(uri->world->concurrent)
+    RAPTOR_ATOMIC_ADD(&uri->usage, 1);
+  else {
+    RAPTOR_WORLD_LOCK(uri->world, uris_mutex);
+    uri->usage++;
+    RAPTOR_WORLD_UNLOCK(uri->world, uris_mutex);
+  }
+
   return uri;
 }
 
@@ -1161,7 +1481,22 @@ raptor_new_uri_for_retrieval(raptor_uri* old_uri)
 int
 raptor_uri_init(raptor_world* world)
 {
-  if(world->uri_interning && !world->uris_tree) {
+  /* a concurrent world always uses hash tables */
+  if(world->uri_interning &&
+     (world->uri_interning_hash || world->concurrent)) {
+    if(!world->uris_table) {
+      world->uris_tables_count = world->concurrent ? RAPTOR_URI_TABLE_SHARDS : 1;
+      world->uris_table = raptor_new_uri_tables(world->uris_tables_count);
+      if(!world->uris_table) {
+#ifdef RAPTOR_DEBUG
+        RAPTOR_FATAL1("Failed to create raptor URI table");
+#else
+        raptor_log_error(world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                         "Failed to create raptor URI table");
+#endif
+      }
+    }
+  } else if(world->uri_interning && !world->uris_tree) {
     world->uris_tree = raptor_new_avltree((raptor_data_compare_handler)raptor_uri_compare,
                                           /* free */ NULL, 0);
     if(!world->uris_tree) {
@@ -1182,6 +1517,11 @@ raptor_uri_init(raptor_world* world)
 void
 raptor_uri_finish(raptor_world* world)
 {
+  if(world->uris_table) {
+    raptor_free_uri_tables(world->uris_table, world->uris_tables_count);
+    world->uris_table = NULL;
+  }
+
   if(world->uris_tree) {
     raptor_free_avltree(world->uris_tree);
     world->uris_tree = NULL;
@@ -1333,23 +1673,25 @@ raptor_uri_path_make_relative_path(const unsigned char *from_path, size_t from_p
 }
 
 
-/**
- * raptor_uri_to_relative_counted_uri_string:
+/*
+ * raptor_uri_detail_to_relative_counted_uri_string:
  * @base_uri: The base absolute URI to resolve against (or NULL)
+ * @base: parsed @base_uri or NULL to parse it here
  * @reference_uri: The reference absolute URI to use
  * @length_p: Location to store the length of the relative URI string or NULL
  *
- * Get the counted relative URI string of a URI against a base URI.
- * 
+ * INTERNAL - Get the counted relative URI string using a parsed base URI
+ *
  * Return value: A newly allocated relative URI string or NULL on failure
- **/
-
-unsigned char*
-raptor_uri_to_relative_counted_uri_string(raptor_uri *base_uri, 
-                                          raptor_uri *reference_uri,
-                                          size_t *length_p) {
-  raptor_uri_detail *base_detail = NULL, *reference_detail;
-  const unsigned char *base, *reference_str, *base_file, *reference_file;
+ */
+static unsigned char*
+raptor_uri_detail_to_relative_counted_uri_string(raptor_uri *base_uri,
+                                                 raptor_uri_detail *base,
+                                                 raptor_uri *reference_uri,
+                                                 size_t *length_p)
+{
+  raptor_uri_detail *base_detail = base, *reference_detail;
+  const unsigned char *base_str, *reference_str, *base_file, *reference_file;
   unsigned char *suffix, *cur_ptr;
   size_t base_len, reference_len, reference_file_len, suffix_len;
   unsigned char *result = NULL;
@@ -1369,10 +1711,12 @@ raptor_uri_to_relative_counted_uri_string(raptor_uri *base_uri,
   if(!base_uri)
     goto buildresult;
   
-  base = raptor_uri_as_counted_string(base_uri, &base_len);
-  base_detail = raptor_new_uri_detail(base);
-  if(!base_detail)
-    goto err;
+  if(!base_detail) {
+    base_str = raptor_uri_as_counted_string(base_uri, &base_len);
+    base_detail = raptor_new_uri_detail(base_str);
+    if(!base_detail)
+      goto err;
+  }
   
   /* Check if the whole URIs are equal */
   if(raptor_uri_equals(base_uri, reference_uri)) {
@@ -1499,7 +1843,7 @@ raptor_uri_to_relative_counted_uri_string(raptor_uri *base_uri,
   }
   
   err:
-  if(base_detail)
+  if(base_detail && base_detail != base)
     raptor_free_uri_detail(base_detail);
   raptor_free_uri_detail(reference_detail);
   
@@ -1507,6 +1851,27 @@ raptor_uri_to_relative_counted_uri_string(raptor_uri *base_uri,
 }
 
 
+/**
+ * raptor_uri_to_relative_counted_uri_string:
+ * @base_uri: The base absolute URI to resolve against (or NULL)
+ * @reference_uri: The reference absolute URI to use
+ * @length_p: Location to store the length of the relative URI string or NULL
+ *
+ * Get the counted relative URI string of a URI against a base URI.
+ * 
+ * Return value: A newly allocated relative URI string or NULL on failure
+ **/
+
+unsigned char*
+raptor_uri_to_relative_counted_uri_string(raptor_uri *base_uri, 
+                                          raptor_uri *reference_uri,
+                                          size_t *length_p) {
+  return raptor_uri_detail_to_relative_counted_uri_string(base_uri, NULL,
+                                                          reference_uri,
+                                                          length_p);
+}
+
+
 /**
  * raptor_uri_to_relative_uri_string:
  * @base_uri: The base absolute URI to resolve against
@@ -1525,6 +1890,317 @@ raptor_uri_to_relative_uri_string(raptor_uri *base_uri,
 }
 
 
+/*
+ * Base-bound URI relativiser
+ *
+ * raptor_uri_to_relative_counted_uri_string() parses the base URI on
+ * every call.  A relativiser keeps the base URI parsed and remembers
+ * the "directory" prefix of the base (scheme, authority and the path
+ * up to and including the last '/').  A reference that starts with
+ * that prefix and has no further '/' in its path is in the same
+ * directory as the base, and its relative form is a suffix of the
+ * reference string (or "." followed by one) so it needs no parsing
+ * and no allocation.  Anything else goes through the general code
+ * with the cached base.
+ */
+struct raptor_uri_relativiser_s {
+  /* base URI (a counted reference) or NULL */
+  raptor_uri* base_uri;
+  raptor_uri_detail* base_detail;
+
+  /* length of the directory prefix of base_uri or 0 if the base has
+   * no path containing a '/'
+   */
+  size_t base_dir_len;
+  /* file name part of the base path after the last '/' */
+  const unsigned char* base_file;
+  size_t base_file_len;
+
+  /* buffer for results that cannot point into the reference string */
+  unsigned char* result;
+  size_t result_size;
+};
+
+
+/*
+ * raptor_new_uri_relativiser:
+ * @base_uri: base URI to make URIs relative to (or NULL)
+ *
+ * INTERNAL - Constructor - create a relativiser bound to a base URI
+ *
+ * Return value: new relativiser or NULL on failure
+ */
+raptor_uri_relativiser*
+raptor_new_uri_relativiser(raptor_uri* base_uri)
+{
+  raptor_uri_relativiser* rel;
+
+  rel = RAPTOR_CALLOC(raptor_uri_relativiser*, 1, sizeof(*rel));
+  if(!rel)
+    return NULL;
+
+  if(raptor_uri_relativiser_set_base(rel, base_uri)) {
+    raptor_free_uri_relativiser(rel);
+    return NULL;
+  }
+
+  return rel;
+}
+
+
+/*
+ * raptor_free_uri_relativiser:
+ * @rel: relativiser
+ *
+ * INTERNAL - Destructor - destroy a relativiser
+ */
+void
+raptor_free_uri_relativiser(raptor_uri_relativiser* rel)
+{
+  if(!rel)
+    return;
+
+  if(rel->result)
+    RAPTOR_FREE(char*, rel->result);
+  if(rel->base_detail)
+    raptor_free_uri_detail(rel->base_detail);
+  if(rel->base_uri)
+    raptor_free_uri(rel->base_uri);
+
+  RAPTOR_FREE(raptor_uri_relativiser, rel);
+}
+
+
+/*
+ * raptor_uri_relativiser_get_base:
+ * @rel: relativiser
+ *
+ * INTERNAL - Get the base URI a relativiser is bound to
+ *
+ * Return value: shared base URI or NULL
+ */
+raptor_uri*
+raptor_uri_relativiser_get_base(raptor_uri_relativiser* rel)
+{
+  return rel->base_uri;
+}
+
+
+/*
+ * raptor_uri_relativiser_set_base:
+ * @rel: relativiser
+ * @base_uri: new base URI (or NULL)
+ *
+ * INTERNAL - Bind a relativiser to a new base URI
+ *
+ * Does nothing if @base_uri is the currently bound object.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_uri_relativiser_set_base(raptor_uri_relativiser* rel,
+                                raptor_uri* base_uri)
+{
+  raptor_uri_detail* ud;
+  const unsigned char* p;
+
+  if(rel->base_uri == base_uri)
+    return 0;
+
+  if(rel->base_detail) {
+    raptor_free_uri_detail(rel->base_detail);
+    rel->base_detail = NULL;
+  }
+  if(rel->base_uri) {
+    raptor_free_uri(rel->base_uri);
+    rel->base_uri = NULL;
+  }
+  rel->base_dir_len = 0;
+  rel->base_file = NULL;
+  rel->base_file_len = 0;
+
+  if(!base_uri)
+    return 0;
+
+  ud = raptor_new_uri_detail(base_uri->string);
+  if(!ud)
+    return 1;
+
+  rel->base_detail = ud;
+  rel->base_uri = raptor_uri_copy(base_uri);
+
+  if(ud->path) {
+    for(p = ud->path + ud->path_len; p > ud->path && p[-1] != '/'; p--)
+      ;
+    if(p > ud->path) {
+      rel->base_file = p;
+      rel->base_file_len = ud->path_len - (p - ud->path);
+
+      /* the path is copied after scheme ":" and authority "//" */
+      rel->base_dir_len = p - ud->path;
+      if(ud->scheme)
+        rel->base_dir_len += ud->scheme_len + 1;
+      if(ud->authority)
+        rel->base_dir_len += 2 + ud->authority_len;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * raptor_uri_relativiser_relativise:
+ * @rel: relativiser
+ * @reference_uri: The reference absolute URI to use
+ * @length_p: Location to store the length of the relative URI string or NULL
+ *
+ * INTERNAL - Get the relative URI string of a URI against the bound base
+ *
+ * Gives the same string as raptor_uri_to_relative_counted_uri_string()
+ * but the result is shared: it points into @reference_uri or into
+ * @rel and is only valid until the next call or until @reference_uri
+ * is freed.
+ *
+ * Return value: shared relative URI string or NULL on failure
+ */
+const unsigned char*
+raptor_uri_relativiser_relativise(raptor_uri_relativiser* rel,
+                                  raptor_uri* reference_uri,
+                                  size_t* length_p)
+{
+  const unsigned char* ref_str;
+  const unsigned char* tail;
+  const unsigned char* file_end;
+  const unsigned char* base_str;
+  size_t ref_len;
+  size_t tail_len;
+  size_t file_len;
+  size_t len;
+  
+  if(!reference_uri)
+    return NULL;
+
+  ref_str = reference_uri->string;
+  ref_len = reference_uri->length;
+
+  if(!rel->base_uri) {
+    /* Nothing to be relative to */
+    if(length_p)
+      *length_p = ref_len;
+    return ref_str;
+  }
+
+  if(reference_uri == rel->base_uri ||
+     raptor_uri_equals(reference_uri, rel->base_uri)) {
+    if(length_p)
+      *length_p = 0;
+    return ref_str + ref_len;
+  }
+
+  base_str = rel->base_uri->string;
+
+  if(rel->base_dir_len && ref_len >= rel->base_dir_len &&
+     !memcmp(ref_str, base_str, rel->base_dir_len)) {
+    tail = ref_str + rel->base_dir_len;
+    tail_len = ref_len - rel->base_dir_len;
+
+    /* find the end of the file name (start of any query or fragment) */
+    for(file_end = tail; *file_end && *file_end != '/' &&
+          *file_end != '?' && *file_end != '#'; file_end++)
+      ;
+    file_len = file_end - tail;
+
+    if(*file_end != '/') {
+      /* Same directory as the base */
+      if(file_len == rel->base_file_len &&
+         !memcmp(tail, rel->base_file, file_len)) {
+        /* Same file name: only the query and fragment are needed */
+        if(length_p)
+          *length_p = tail_len - file_len;
+        return file_end;
+      }
+
+      if(file_len || !rel->base_file_len) {
+        if(length_p)
+          *length_p = tail_len;
+        return tail;
+      }
+
+      /* Empty file name against a non-empty base file name: "." */
+      len = tail_len + 1;
+      if(len + 1 > rel->result_size) {
+        if(rel->result)
+          RAPTOR_FREE(char*, rel->result);
+        rel->result_size = 0;
+        rel->result = RAPTOR_MALLOC(unsigned char*, len + 1);
+        if(!rel->result)
+          return NULL;
+        rel->result_size = len + 1;
+      }
+      rel->result[0] = '.';
+      memcpy(rel->result + 1, tail, tail_len + 1);
+      if(length_p)
+        *length_p = len;
+      return rel->result;
+    }
+  }
+
+  /* General case: parse the reference against the cached base */
+  if(rel->result) {
+    RAPTOR_FREE(char*, rel->result);
+    rel->result_size = 0;
+  }
+  rel->result = raptor_uri_detail_to_relative_counted_uri_string(rel->base_uri,
+                                                                 rel->base_detail,
+                                                                 reference_uri,
+                                                                 &len);
+  if(!rel->result)
+    return NULL;
+  rel->result_size = len + 1;
+
+  if(length_p)
+    *length_p = len;
+  return rel->result;
+}
+
+
+/*
+ * raptor_uri_relativiser_escaped_write:
+ * @rel: relativiser
+ * @uri: uri to write
+ * @flags: bit flags - see #raptor_escaped_write_bitflags
+ * @iostr: raptor iostream
+ *
+ * INTERNAL - Write a #raptor_uri relative to the bound base with escapes
+ *
+ * As raptor_uri_escaped_write() with the relativiser base URI.
+ *
+ * Return value: non-0 on failure
+ */
+int
+raptor_uri_relativiser_escaped_write(raptor_uri_relativiser* rel,
+                                     raptor_uri* uri,
+                                     unsigned int flags,
+                                     raptor_iostream *iostr)
+{
+  const unsigned char *uri_str;
+  size_t len;
+
+  if(!uri)
+    return 1;
+  
+  raptor_iostream_write_byte('<', iostr);
+  uri_str = raptor_uri_relativiser_relativise(rel, uri, &len);
+  if(!uri_str)
+    return 1;
+  raptor_string_escaped_write(uri_str, len, '>', flags, iostr);
+  raptor_iostream_write_byte('>', iostr);
+
+  return 0;
+}
+
+
 /**
  * raptor_uri_print:
  * @uri: URI to print
@@ -1902,6 +2578,27 @@ assert_uri_to_relative(raptor_world *world, const char *base, const char *uri, c
     return 1;
   }
   RAPTOR_FREE(char*, output);
+
+  if(1) {
+    raptor_uri_relativiser* rel;
+    const unsigned char* shared;
+    size_t shared_length = 0;
+
+    /* The relativiser must agree, including with a fast path */
+    rel = raptor_new_uri_relativiser(base_uri);
+    shared = rel ? raptor_uri_relativiser_relativise(rel, reference_uri,
+                                                     &shared_length) : NULL;
+    result = !shared || strcmp(relative, (const char*)shared) ||
+             shared_length != length;
+    if(result)
+      fprintf(stderr,
+              "%s: raptor_uri_relativiser_relativise FAILED: base='%s', uri='%s', expected='%s', got='%s'\n",
+              program, base, uri, relative, shared ? (const char*)shared : "NULL");
+    raptor_free_uri_relativiser(rel);
+    if(result)
+      return 1;
+  }
+
   if(base_uri)
     raptor_free_uri(base_uri);
   raptor_free_uri(reference_uri);
@@ -1909,6 +2606,161 @@ assert_uri_to_relative(raptor_world *world, const char *base, const char *uri, c
 }
 
 
+#define INTERN_URIS_COUNT 5000
+
+static int
+assert_uri_interning(int hash)
+{
+  raptor_world *world;
+  raptor_uri* uris[INTERN_URIS_COUNT];
+  unsigned char uri_string[64];
+  int failures = 0;
+  int i;
+
+  world = raptor_new_world();
+  if(!world)
+    return 1;
+  raptor_world_set_flag(world, RAPTOR_WORLD_FLAG_URI_INTERNING_HASH, hash);
+  if(raptor_world_open(world)) {
+    raptor_free_world(world);
+    return 1;
+  }
+
+  /* enough URIs to make the table grow */
+  for(i = 0; i < INTERN_URIS_COUNT; i++) {
+    snprintf((char*)uri_string, sizeof(uri_string),
+             "http://example.org/intern/%d", i);
+    uris[i] = raptor_new_uri(world, uri_string);
+  }
+
+  /* free every other URI then look them all up again */
+  for(i = 0; i < INTERN_URIS_COUNT; i += 2) {
+    raptor_free_uri(uris[i]);
+    uris[i] = NULL;
+  }
+
+  for(i = 0; i < INTERN_URIS_COUNT; i++) {
+    raptor_uri* uri;
+
+    snprintf((char*)uri_string, sizeof(uri_string),
+             "http://example.org/intern/%d", i);
+    uri = raptor_new_uri(world, uri_string);
+
+    if(!uri || strcmp((const char*)raptor_uri_as_string(uri),
+                      (const char*)uri_string)) {
+      fprintf(stderr, "%s: interning %s with %s FAILED giving %s\n",
+              program, uri_string, hash ? "hash" : "tree",
+              uri ? (const char*)raptor_uri_as_string(uri) : "NULL");
+      failures++;
+    } else if(uris[i] && uri != uris[i]) {
+      fprintf(stderr, "%s: interning %s with %s FAILED giving a new URI\n",
+              program, uri_string, hash ? "hash" : "tree");
+      failures++;
+    }
+
+    if(uris[i])
+      raptor_free_uri(uri);
+    else
+      uris[i] = uri;
+  }
+
+  for(i = 0; i < INTERN_URIS_COUNT; i++)
+    raptor_free_uri(uris[i]);
+
+  raptor_free_world(world);
+
+  return failures;
+}
+
+
+#ifdef RAPTOR_ATOMICS
+#define CONCURRENT_THREADS_COUNT 4
+#define CONCURRENT_URIS_COUNT 2000
+
+static void*
+concurrent_uri_interning_thread(void* arg)
+{
+  raptor_world *world = (raptor_world*)arg;
+  raptor_uri* uris[CONCURRENT_URIS_COUNT];
+  unsigned char uri_string[64];
+  int round;
+  int i;
+  long failures = 0;
+
+  for(round = 0; round < 10; round++) {
+    for(i = 0; i < CONCURRENT_URIS_COUNT; i++) {
+      snprintf((char*)uri_string, sizeof(uri_string),
+               "http://example.org/concurrent/%d", i);
+      uris[i] = raptor_new_uri(world, uri_string);
+      if(!uris[i] || strcmp((const char*)raptor_uri_as_string(uris[i]),
+                            (const char*)uri_string))
+        failures++;
+      else
+        raptor_free_uri(raptor_uri_copy(uris[i]));
+    }
+
+    for(i = 0; i < CONCURRENT_URIS_COUNT; i++)
+      raptor_free_uri(uris[i]);
+  }
+
+  return (void*)failures;
+}
+
+
+static int
+assert_concurrent_uri_interning(void)
+{
+  raptor_world *world;
+  pthread_t threads[CONCURRENT_THREADS_COUNT];
+  int failures = 0;
+  int i;
+
+  world = raptor_new_world();
+  if(!world)
+    return 1;
+  raptor_world_set_flag(world, RAPTOR_WORLD_FLAG_CONCURRENT, 1);
+  if(raptor_world_open(world)) {
+    raptor_free_world(world);
+    return 1;
+  }
+
+  for(i = 0; i < CONCURRENT_THREADS_COUNT; i++)
+    pthread_create(&threads[i], NULL, concurrent_uri_interning_thread, world);
+
+  for(i = 0; i < CONCURRENT_THREADS_COUNT; i++) {
+    void* result = NULL;
+
+    pthread_join(threads[i], &result);
+    if(result) {
+      fprintf(stderr, "%s: concurrent URI interning FAILED for %ld URIs\n",
+              program, (long)result);
+      failures++;
+    }
+  }
+
+  /* every URI was freed so interning creates a new one */
+  for(i = 0; i < CONCURRENT_URIS_COUNT; i++) {
+    unsigned char uri_string[64];
+    raptor_uri* uri;
+
+    snprintf((char*)uri_string, sizeof(uri_string),
+             "http://example.org/concurrent/%d", i);
+    uri = raptor_new_uri(world, uri_string);
+    if(uri->usage != 1) {
+      fprintf(stderr, "%s: concurrent URI %s was not freed, usage %d\n",
+              program, uri_string, uri->usage - 1);
+      failures++;
+    }
+    raptor_free_uri(uri);
+  }
+
+  raptor_free_world(world);
+
+  return failures;
+}
+#endif
+
+
 int
 main(int argc, char *argv[]) 
 {
@@ -2058,6 +2910,10 @@ main(int argc, char *argv[])
   failures += assert_uri_to_relative(world, "http://example.org", "http://a.example.org", "http://a.example.org");
   failures += assert_uri_to_relative(world, "http://abcdefgh.example.org/foo/bar/", "http://ijklmnop.example.org/", "http://ijklmnop.example.org/");
   failures += assert_uri_to_relative(world, "http://example.org", "http://example.org/a/b/c/d/efgh", "/a/b/c/d/efgh");
+  failures += assert_uri_to_relative(world, "http://example.com/base/", "http://example.com/base/?q", "?q");
+  failures += assert_uri_to_relative(world, "http://example.com/base/foo?q", "http://example.com/base/foo", "");
+  failures += assert_uri_to_relative(world, "http://example.com/base/foo", "http://example.com/base/", ".");
+  failures += assert_uri_to_relative(world, "http://example.com/base/foo", "http://example.com/base/a/b", "a/b");
 
   if(1) {
     int ret;
@@ -2080,6 +2936,12 @@ main(int argc, char *argv[])
     raptor_free_uri(u2);
   }
 
+  failures += assert_uri_interning(1);
+  failures += assert_uri_interning(0);
+#ifdef RAPTOR_ATOMICS
+  failures += assert_concurrent_uri_interning();
+#endif
+
   raptor_free_world(world);
 
   return failures ;
@@ -0,0 +1,164 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * raptor_uri_bench.c - Benchmark of URI interning in a hash table vs tree
+ *
+ * Copyright (C) 2014, David Beckett http://www.dajobe.org/
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ * Usage: raptor_uri_bench [COUNT...]
+ *
+ * For each COUNT (default 1000000 10000000 50000000) create COUNT
+ * distinct URIs with a long shared prefix, look each up again and
+ * then free them all, once with URIs interned in a hash table and
+ * once in a balanced tree.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <raptor_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <time.h>
+
+/* Raptor includes */
+#include "raptor2.h"
+#include "raptor_internal.h"
+
+
+static const char *program;
+
+#define URI_PREFIX "http://data.example.org/dataset/2011/resource/entity/"
+
+
+static double
+bench_now(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+static int
+bench_interning(unsigned long count, int hash)
+{
+  raptor_world *world;
+  raptor_uri** uris;
+  unsigned char uri_string[128];
+  size_t len;
+  unsigned long i;
+  double start, t_new, t_lookup, t_free;
+
+  uris = RAPTOR_CALLOC(raptor_uri**, count, sizeof(raptor_uri*));
+  if(!uris) {
+    fprintf(stderr, "%s: Out of memory for %lu URIs\n", program, count);
+    return 1;
+  }
+
+  world = raptor_new_world();
+  if(!world) {
+    RAPTOR_FREE(raptor_uri**, uris);
+    return 1;
+  }
+  raptor_world_set_flag(world, RAPTOR_WORLD_FLAG_URI_INTERNING_HASH, hash);
+  if(raptor_world_open(world)) {
+    raptor_free_world(world);
+    RAPTOR_FREE(raptor_uri**, uris);
+    return 1;
+  }
+
+  start = bench_now();
+  for(i = 0; i < count; i++) {
+    len = snprintf((char*)uri_string, sizeof(uri_string), "%s%lu",
+                   URI_PREFIX, i);
+    uris[i] = raptor_new_uri_from_counted_string(world, uri_string, len);
+    if(!uris[i]) {
+      fprintf(stderr, "%s: Failed to create URI %s\n", program, uri_string);
+      count = i;
+      break;
+    }
+  }
+  t_new = bench_now() - start;
+
+  /* every lookup finds an interned URI */
+  start = bench_now();
+  for(i = 0; i < count; i++) {
+    raptor_uri* uri;
+
+    len = snprintf((char*)uri_string, sizeof(uri_string), "%s%lu",
+                   URI_PREFIX, i);
+    uri = raptor_new_uri_from_counted_string(world, uri_string, len);
+    raptor_free_uri(uri);
+  }
+  t_lookup = bench_now() - start;
+
+  start = bench_now();
+  for(i = 0; i < count; i++)
+    raptor_free_uri(uris[i]);
+  t_free = bench_now() - start;
+
+  raptor_free_world(world);
+  RAPTOR_FREE(raptor_uri**, uris);
+
+  fprintf(stdout, "%-5s %10lu URIs  new %8.3fs  lookup %8.3fs  free %8.3fs\n",
+          hash ? "hash" : "tree", count, t_new, t_lookup, t_free);
+
+  return 0;
+}
+
+
+int main(int argc, char *argv[]);
+
+int
+main(int argc, char *argv[])
+{
+  static const unsigned long default_counts[3] = {
+    1000000UL, 10000000UL, 50000000UL
+  };
+  int rc = 0;
+  int i;
+
+  program = raptor_basename(argv[0]);
+
+  if(argc > 1) {
+    for(i = 1; i < argc; i++) {
+      unsigned long count = strtoul(argv[i], NULL, 10);
+      rc += bench_interning(count, 1);
+      rc += bench_interning(count, 0);
+    }
+  } else {
+    for(i = 0; i < 3; i++) {
+      rc += bench_interning(default_counts[i], 1);
+      rc += bench_interning(default_counts[i], 0);
+    }
+  }
+
+  return rc;
+}
@@ -47,18 +47,21 @@
 #include <turtle_common.h>
 
 /**
- * raptor_stringbuffer_append_turtle_string:
- * @stringbuffer: String buffer to add to
+ * raptor_turtle_unescape_string:
  * @text: turtle string to decode
  * @len: length of string
  * @delim: terminating delimiter for string - only ', " or &gt; are allowed
  * @error_handler: error handling function
  * @error_data: error handler data
+ * @is_uri: non-0 if the string is a URI
+ * @string: buffer of at least @len + 1 bytes for the decoded string
+ * @string_len_p: pointer to store the decoded length
  *
- * Append to a stringbuffer a Turtle-escaped string.
+ * Decode a Turtle-escaped string into a buffer.
  *
  * The passed in string is handled according to the Turtle string
  * escape rules giving a UTF-8 encoded output of the Unicode codepoints.
+ * The output is never longer than the input and is NUL terminated.
  *
  * The Turtle escapes are \b \f \n \r \t \\
  * \uXXXX \UXXXXXXXX where X is [A-F0-9]
@@ -70,29 +73,24 @@
  * Return value: non-0 on failure
  **/
 int
-raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
-                                         const unsigned char *text,
-                                         size_t len, int delim,
-                                         raptor_simple_message_handler error_handler, 
-                                         void *error_data,
-                                         int is_uri)
+raptor_turtle_unescape_string(const unsigned char *text, size_t len,
+                              int delim,
+                              raptor_simple_message_handler error_handler, 
+                              void *error_data,
+                              int is_uri,
+                              unsigned char *string, size_t *string_len_p)
 {
   size_t i;
   const unsigned char *s;
   unsigned char *d;
-  unsigned char *string = RAPTOR_MALLOC(unsigned char*, len + 1);
   const char* label = (is_uri ? "URI" : "string");
 
-  if(!string)
-    return -1;
-
   for(s = text, d = string, i = 0; i < len; s++, i++) {
     unsigned char c=*s;
 
     if(c == ' ' &&  is_uri) {
       error_handler(error_data,
                     "Turtle %s error - character '%c'", label, c);
-      RAPTOR_FREE(char*, string);
       return 1;
     }
 
@@ -103,7 +101,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
         if(is_uri) {
           error_handler(error_data,
                         "Turtle %s error - illegal URI escape '\\%c'", label, c);
-          RAPTOR_FREE(char*, string);
           return 1;
         }
         if(c == 'n')
@@ -133,7 +130,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
         if(i+ulen > len) {
           error_handler(error_data,
                         "Turtle %s error - \\%c over end of line", label, c);
-          RAPTOR_FREE(char*, string);
           return 1;
         }
 
@@ -143,7 +139,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
             error_handler(error_data,
                           "Turtle %s error - illegal hex digit %c in Unicode escape '%c%s...'",
                           label, cc, c, s);
-            RAPTOR_FREE(char*, string);
             return 1;
           }
         }
@@ -153,7 +148,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
           error_handler(error_data,
                         "Turtle %s error - illegal Unicode escape '%c%s...'",
                         label, c, s);
-          RAPTOR_FREE(char*, string);
           return 1;
         }
 
@@ -170,7 +164,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
           error_handler(error_data,
                         "Turtle %s error - illegal Unicode character with code point #x%lX (max #x%lX).", 
                         label, unichar, raptor_unicode_max_codepoint);
-          RAPTOR_FREE(char*, string);
           return 1;
         }
           
@@ -180,7 +173,6 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
           error_handler(error_data,
                         "Turtle %s error - illegal Unicode character with code point #x%lX.", 
                         label, unichar);
-          RAPTOR_FREE(char*, string);
           return 1;
         }
         d += (size_t)unichar_width;
@@ -197,12 +189,211 @@ raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
   *d='\0';
 
   /* calculate output string size */
-  len = d-string;
-  
+  *string_len_p = RAPTOR_GOOD_CAST(size_t, d - string);
+
+  return 0;
+}
+
+
+
+
+/**
+ * raptor_stringbuffer_append_turtle_string:
+ * @stringbuffer: String buffer to add to
+ * @text: turtle string to decode
+ * @len: length of string
+ * @delim: terminating delimiter for string - only ', " or &gt; are allowed
+ * @error_handler: error handling function
+ * @error_data: error handler data
+ * @is_uri: non-0 if the string is a URI
+ *
+ * Append to a stringbuffer a Turtle-escaped string.
+ *
+ * See raptor_turtle_unescape_string() for the escapes handled.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+raptor_stringbuffer_append_turtle_string(raptor_stringbuffer* stringbuffer,
+                                         const unsigned char *text,
+                                         size_t len, int delim,
+                                         raptor_simple_message_handler error_handler, 
+                                         void *error_data,
+                                         int is_uri)
+{
+  unsigned char *string = RAPTOR_MALLOC(unsigned char*, len + 1);
+
+  if(!string)
+    return -1;
+
+  if(raptor_turtle_unescape_string(text, len, delim, error_handler,
+                                   error_data, is_uri, string, &len)) {
+    RAPTOR_FREE(char*, string);
+    return 1;
+  }
+
   /* string gets owned by the stringbuffer after this */
   return raptor_stringbuffer_append_counted_string(stringbuffer, 
                                                    string, len, 0);
+}
+
+
+/**
+ * turtle_parser_scratch_buffer:
+ * @turtle_parser: turtle parser
+ * @size: bytes needed
+ *
+ * Get the parser's scratch buffer for decoding tokens, growing it to
+ * at least @size bytes.  The first scratch_length bytes are kept.
+ *
+ * Return value: buffer or NULL on failure
+ **/
+unsigned char*
+turtle_parser_scratch_buffer(raptor_turtle_parser* turtle_parser, size_t size)
+{
+  unsigned char* scratch;
+  size_t scratch_size;
+
+  if(size <= turtle_parser->scratch_size)
+    return turtle_parser->scratch;
+
+  scratch_size = turtle_parser->scratch_size ? turtle_parser->scratch_size : 256;
+  while(scratch_size < size)
+    scratch_size <<= 1;
+
+  scratch = RAPTOR_REALLOC(unsigned char*, turtle_parser->scratch,
+                           scratch_size);
+  if(!scratch)
+    return NULL;
+
+  turtle_parser->scratch = scratch;
+  turtle_parser->scratch_size = scratch_size;
+
+  return scratch;
+}
+
+
+/* DJ Bernstein hash of the prefixed name bytes */
+static unsigned int
+turtle_qname_cache_hash(const unsigned char *name, size_t name_len)
+{
+  unsigned int hash = 5381;
+
+  for(; name_len; name_len--)
+    hash = ((hash << 5) + hash) + *name++; /* hash * 33 + c */
+
+  return hash & (TURTLE_QNAME_CACHE_SIZE - 1);
+}
+
+
+/**
+ * turtle_qname_cache_get:
+ * @turtle_parser: turtle parser
+ * @name: prefixed name as lexed, before escapes are expanded
+ * @name_len: length of @name
+ *
+ * Look up the URI a prefixed name expanded to earlier in this parse.
+ *
+ * Return value: shared URI (not a copy) or NULL if not cached
+ **/
+raptor_uri*
+turtle_qname_cache_get(raptor_turtle_parser* turtle_parser,
+                       const unsigned char *name, size_t name_len)
+{
+  turtle_qname_cache_entry* entry;
+
+  if(!turtle_parser->qname_cache)
+    return NULL;
+
+  entry = &turtle_parser->qname_cache[turtle_qname_cache_hash(name, name_len)];
+  if(entry->uri && entry->name_len == name_len &&
+     !memcmp(entry->name, name, name_len))
+    return entry->uri;
+
+  return NULL;
+}
+
+
+/**
+ * turtle_qname_cache_add:
+ * @turtle_parser: turtle parser
+ * @name: prefixed name as lexed, before escapes are expanded
+ * @name_len: length of @name
+ * @uri: URI @name expands to
+ *
+ * Remember the URI for a prefixed name, replacing any entry in the
+ * same slot.  A copy of @uri is taken.
+ *
+ * Return value: non-0 on failure
+ **/
+int
+turtle_qname_cache_add(raptor_turtle_parser* turtle_parser,
+                       const unsigned char *name, size_t name_len,
+                       raptor_uri* uri)
+{
+  turtle_qname_cache_entry* entry;
+  unsigned char *new_name;
+
+  if(!turtle_parser->qname_cache) {
+    turtle_parser->qname_cache = RAPTOR_CALLOC(turtle_qname_cache_entry*,
+                                               TURTLE_QNAME_CACHE_SIZE,
+                                               sizeof(turtle_qname_cache_entry));
+    if(!turtle_parser->qname_cache)
+      return 1;
+  }
+
+  entry = &turtle_parser->qname_cache[turtle_qname_cache_hash(name, name_len)];
+
+  if(entry->name && entry->name_len >= name_len)
+    new_name = entry->name;
+  else {
+    new_name = RAPTOR_MALLOC(unsigned char*, name_len + 1);
+    if(!new_name)
+      return 1;
+    if(entry->name)
+      RAPTOR_FREE(char*, entry->name);
+  }
+  memcpy(new_name, name, name_len);
+  new_name[name_len] = '\0';
+
+  if(entry->uri)
+    raptor_free_uri(entry->uri);
+
+  entry->name = new_name;
+  entry->name_len = name_len;
+  entry->uri = raptor_uri_copy(uri);
+
+  return 0;
+}
+
+
+/**
+ * turtle_qname_cache_clear:
+ * @turtle_parser: turtle parser
+ *
+ * Empty and free the prefixed name cache.  Must be called whenever a
+ * namespace prefix is declared since that may change what cached
+ * names expand to.
+ **/
+void
+turtle_qname_cache_clear(raptor_turtle_parser* turtle_parser)
+{
+  int i;
+
+  if(!turtle_parser->qname_cache)
+    return;
+
+  for(i = 0; i < TURTLE_QNAME_CACHE_SIZE; i++) {
+    turtle_qname_cache_entry* entry = &turtle_parser->qname_cache[i];
+
+    if(entry->name)
+      RAPTOR_FREE(char*, entry->name);
+    if(entry->uri)
+      raptor_free_uri(entry->uri);
+  }
 
+  RAPTOR_FREE(turtle_qname_cache_entry*, turtle_parser->qname_cache);
+  turtle_parser->qname_cache = NULL;
 }
 
 
@@ -35,10 +35,32 @@ RAPTOR_INTERNAL_API int turtle_syntax_error(raptor_parser *rdf_parser, const cha
 RAPTOR_INTERNAL_API raptor_uri* turtle_qname_to_uri(raptor_parser *rdf_parser, unsigned char *name, size_t name_len);
 RAPTOR_INTERNAL_API size_t raptor_turtle_expand_qname_escapes(unsigned char *name, size_t len, raptor_simple_message_handler error_handler, void *error_data);
 
+/* turtle_common.c */
+RAPTOR_INTERNAL_API unsigned char* turtle_parser_scratch_buffer(raptor_turtle_parser* turtle_parser, size_t size);
+RAPTOR_INTERNAL_API raptor_uri* turtle_qname_cache_get(raptor_turtle_parser* turtle_parser, const unsigned char *name, size_t name_len);
+RAPTOR_INTERNAL_API int turtle_qname_cache_add(raptor_turtle_parser* turtle_parser, const unsigned char *name, size_t name_len, raptor_uri* uri);
+RAPTOR_INTERNAL_API void turtle_qname_cache_clear(raptor_turtle_parser* turtle_parser);
+
 /* turtle_lexer.l */
 extern void turtle_token_free(raptor_world* world, int token, YYSTYPE *lval);
 
 
+/* size of the prefixed name cache; must be a power of 2 */
+#define TURTLE_QNAME_CACHE_SIZE 256
+
+/*
+ * Turtle prefixed name cache entry
+ */
+typedef struct {
+  /* prefixed name as it appeared in the input, before escapes */
+  unsigned char *name;
+  size_t name_len;
+
+  /* shared URI it expands to */
+  raptor_uri* uri;
+} turtle_qname_cache_entry;
+
+
 /*
  * Turtle parser object
  */
@@ -70,12 +92,24 @@ struct raptor_turtle_parser_s {
   size_t consumable;
   /* real end-of-buffer indicator, as we kill the last line */
   size_t end_of_buffer;
+  /* after a run that completed no statement, do not run again until
+   * the buffer holds this much */
+  size_t parse_length;
 
   /* a sequence holding deferred statements */
   raptor_sequence *deferred;
 
-  /* for creating long literals */
-  raptor_stringbuffer* sb;
+  /* scratch buffer for decoding escaped tokens and creating long
+   * literals; kept for the life of the parser */
+  unsigned char* scratch;
+  size_t scratch_size;
+
+  /* length of the long literal in scratch so far */
+  size_t scratch_length;
+
+  /* prefixed name to URI cache of TURTLE_QNAME_CACHE_SIZE entries
+   * or NULL; emptied whenever a prefix is (re)declared */
+  turtle_qname_cache_entry* qname_cache;
 
   /* count of errors in current parse */
   int error_count;
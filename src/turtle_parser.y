@@ -752,6 +752,7 @@ prefix: PREFIX IDENTIFIER URI_LITERAL DOT
 
   ns = raptor_new_namespace_from_uri(&turtle_parser->namespaces, prefix, $3, 0);
   if(ns) {
+    turtle_qname_cache_clear(turtle_parser);
     raptor_namespaces_start_namespace(&turtle_parser->namespaces, ns);
     raptor_parser_start_namespace(rdf_parser, ns);
   }
@@ -786,6 +787,7 @@ prefix: PREFIX IDENTIFIER URI_LITERAL DOT
 
   ns = raptor_new_namespace_from_uri(&turtle_parser->namespaces, prefix, $3, 0);
   if(ns) {
+    turtle_qname_cache_clear(turtle_parser);
     raptor_namespaces_start_namespace(&turtle_parser->namespaces, ns);
     raptor_parser_start_namespace(rdf_parser, ns);
   }
@@ -1339,6 +1341,8 @@ raptor_uri*
 turtle_qname_to_uri(raptor_parser *rdf_parser, unsigned char *name, size_t name_len) 
 {
   raptor_turtle_parser* turtle_parser = (raptor_turtle_parser*)rdf_parser->context;
+  raptor_uri* uri;
+  int cacheable;
 
   if(!turtle_parser)
     return NULL;
@@ -1348,12 +1352,25 @@ turtle_qname_to_uri(raptor_parser *rdf_parser, unsigned char *name, size_t name_
   rdf_parser->locator.column = turtle_lexer_get_column(yyscanner);
 #endif
 
+  /* Names with escapes are expanded in place below and are rare so
+   * only cache the plain ones whose bytes are the cache key as-is */
+  cacheable = !memchr(name, '\\', name_len);
+  if(cacheable) {
+    uri = turtle_qname_cache_get(turtle_parser, name, name_len);
+    if(uri)
+      return raptor_uri_copy(uri);
+  }
+
   name_len = raptor_turtle_expand_qname_escapes(name, name_len,
                                                 (raptor_simple_message_handler)turtle_parser_error, rdf_parser);
   if(!name_len)
     return NULL;
   
-  return raptor_qname_string_to_uri(&turtle_parser->namespaces, name, name_len);
+  uri = raptor_qname_string_to_uri(&turtle_parser->namespaces, name, name_len);
+  if(uri && cacheable)
+    turtle_qname_cache_add(turtle_parser, name, name_len, uri);
+
+  return uri;
 }
 
 
@@ -1495,6 +1512,14 @@ raptor_turtle_parse_terminate(raptor_parser *rdf_parser) {
   if(turtle_parser->buffer)
     RAPTOR_FREE(cdata, turtle_parser->buffer);
 
+  if(turtle_parser->scratch) {
+    RAPTOR_FREE(char*, turtle_parser->scratch);
+    turtle_parser->scratch = NULL;
+    turtle_parser->scratch_size = 0;
+  }
+
+  turtle_qname_cache_clear(turtle_parser);
+
   if(turtle_parser->graph_name) {
     raptor_free_term(turtle_parser->graph_name);
     turtle_parser->graph_name = NULL;
@@ -1643,8 +1668,11 @@ raptor_turtle_parse_chunk(raptor_parser* rdf_parser,
    * the last run plus the chunk passed here */
   turtle_parser->end_of_buffer = turtle_parser->consumed + len;
   if(turtle_parser->end_of_buffer > turtle_parser->buffer_length) {
-    /* resize */
-    size_t new_buffer_length = turtle_parser->end_of_buffer;
+    /* resize, at least doubling so that appending is linear overall */
+    size_t new_buffer_length = turtle_parser->buffer_length * 2;
+
+    if(new_buffer_length < turtle_parser->end_of_buffer)
+      new_buffer_length = turtle_parser->end_of_buffer;
 
     turtle_parser->buffer = RAPTOR_REALLOC(char*, turtle_parser->buffer,
                                            new_buffer_length + 1);
@@ -1670,6 +1698,15 @@ raptor_turtle_parse_chunk(raptor_parser* rdf_parser,
   ptr += len;
   *ptr = '\0';
 
+  /* A statement left incomplete by the last run, such as one with a
+   * very long literal, is lexed again from its start on every run.
+   * Wait until the buffer has doubled before trying it again so that
+   * the total lexing work stays proportional to the input size. */
+  if(!is_end && turtle_parser->end_of_buffer < turtle_parser->parse_length) {
+    turtle_parser->consumed = turtle_parser->end_of_buffer;
+    return 0;
+  }
+
   /* reset processed counter */
   turtle_parser->processed = 0U;
   /* unconsume */
@@ -1708,6 +1745,8 @@ raptor_turtle_parse_chunk(raptor_parser* rdf_parser,
   } else if(!is_end) {
     /* move stuff to the beginning of the buffer */
     turtle_parser->consumed = turtle_parser->end_of_buffer - turtle_parser->processed;
+    turtle_parser->parse_length = turtle_parser->processed ? 0 :
+                                  2 * turtle_parser->end_of_buffer;
     if(turtle_parser->consumed && turtle_parser->processed) {
       memmove(turtle_parser->buffer,
               turtle_parser->buffer + turtle_parser->processed,
@@ -1746,6 +1785,7 @@ raptor_turtle_parse_start(raptor_parser *rdf_parser)
     turtle_parser->buffer = NULL;
     turtle_parser->buffer_length = 0;
   }
+  turtle_parser->parse_length = 0;
   
   turtle_parser->lineno = 1;
 
@@ -77,9 +77,13 @@ static int quiet = 0;
 static int count = 0;
 
 static int triple_count = 0;
+static int duplicate_count = 0;
 
 static raptor_serializer* serializer = NULL;
 
+/* non-0 if the parser writes to the serializer without print_triples() */
+static int direct_serialize = 0;
+
 static int guess = 0;
 
 static int reported_guess = 0;
@@ -467,7 +471,10 @@ main(int argc, char *argv[])
               }
 
               name_len = od->name_len;
-              if(!strncmp(optarg, od->name, name_len)) {
+              /* match the whole name so that checkRdfID does not
+               * match checkRdfIDFilterSize */
+              if(!strncmp(optarg, od->name, name_len) &&
+                 (name_len == arg_len || optarg[name_len] == '=')) {
                 fv = (option_value*)raptor_calloc_memory(sizeof(option_value),
                                                          1);
 
@@ -485,7 +492,16 @@ main(int argc, char *argv[])
                     fv->s_value = (const char*)"";
                 }
 
-                if(domain == RAPTOR_DOMAIN_PARSER) {
+                if(fv->option == RAPTOR_OPTION_PARSE_THREADS_UNORDERED &&
+                   fv->i_value) {
+                  /* print_triples() and the serializer are not thread
+                   * safe so statements must come from one thread */
+                  fprintf(stderr,
+                          "%s: option `%s' is not supported, statements are serialized from one thread\n",
+                          program, od->name);
+                  raptor_free_memory(fv);
+                  usage = 1;
+                } else if(domain == RAPTOR_DOMAIN_PARSER) {
                   if(!parser_options)
                     parser_options = raptor_new_sequence(raptor_free_memory,
                                                          NULL);
@@ -903,6 +919,12 @@ main(int argc, char *argv[])
     raptor_serializer_start_to_file_handle(serializer, 
                                           output_base_uri, stdout);
 
+    /* line-based conversions such as N-Quads to N-Triples are written
+     * by the parser itself without making terms */
+    if(!replace_newlines)
+      direct_serialize = !raptor_parser_set_serializer(rdf_parser,
+                                                       serializer);
+
     if(!report_namespace)
       raptor_parser_set_namespace_handler(rdf_parser, serializer,
                                           relay_namespaces);
@@ -927,12 +949,17 @@ main(int argc, char *argv[])
     }
   }
 
-  raptor_free_parser(rdf_parser);
+  if(direct_serialize)
+    triple_count = raptor_parser_get_serialized_count(rdf_parser);
+  duplicate_count = raptor_parser_get_duplicate_count(rdf_parser);
 
+  /* end serializing first: the log handler still uses the parser */
   if(serializer) {
     raptor_serializer_serialize_end(serializer);
     raptor_free_serializer(serializer);
   }
+
+  raptor_free_parser(rdf_parser);
   
 
   if(!quiet) {
@@ -942,6 +969,12 @@ main(int argc, char *argv[])
     else
       fprintf(stderr, "%s: Parsing returned %d triples\n",
               program, triple_count);
+
+    if(duplicate_count == 1)
+      fprintf(stderr, "%s: Dropped 1 duplicate triple\n", program);
+    else if(duplicate_count)
+      fprintf(stderr, "%s: Dropped %d duplicate triples\n",
+              program, duplicate_count);
   }
   
   if(output_base_uri)
@@ -30,6 +30,10 @@
 
 #include <stdio.h>
 #include <string.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#include <time.h>
 
 /* Raptor includes */
 #include <raptor2.h>
@@ -61,6 +65,7 @@
 #ifndef RAPTOR_INTERNAL
 #define RAPTOR_MALLOC(type, size)		(type)malloc(size)
 #define RAPTOR_CALLOC(type, nmemb, size)	(type)calloc(nmemb, size)
+#define RAPTOR_REALLOC(type, ptr, size)		(type)realloc(ptr, size)
 #define RAPTOR_FREE(type, ptr)			free((void*)ptr)
 #endif
 
@@ -73,7 +78,7 @@ extern char *optarg;
 #define RDF_NAMESPACE_URI_LEN 43
 #define ORDINAL_STRING_LEN (RDF_NAMESPACE_URI_LEN + MAX_ASCII_INT_SIZE + 1)
 
-#define GETOPT_STRING "bhf:t:u:"
+#define GETOPT_STRING "bhf:st:u:"
 
 #ifdef HAVE_GETOPT_LONG
 static const struct option long_options[] =
@@ -82,6 +87,7 @@ static const struct option long_options[] =
   {"brief"       , 0, 0, 'b'},
   {"help"        , 0, 0, 'h'},
   {"from-format" , 1, 0, 'f'},
+  {"stats"       , 0, 0, 's'},
   {"to-format"   , 1, 0, 't'},
   {"base-uri"    , 1, 0, 'u'},
   {NULL          , 0, 0, 0}
@@ -98,36 +104,131 @@ static const struct option long_options[] =
 #define HELP_PAD "\n      "
 #endif
 
-typedef struct rdfdiff_link_s {
-  struct rdfdiff_link_s *next;
+typedef struct {
+  /* the triple, without any graph */
   raptor_statement *statement;
-} rdfdiff_link;
-
-typedef struct rdfdiff_blank_s {
-  struct rdfdiff_blank_s *next;
-  raptor_world *world;
-  char *blank_id;
-  raptor_statement *owner;
-  rdfdiff_link *first;
-  rdfdiff_link *last;
+  /* hashes of the predicate and of the subject or object that is not
+   * a blank node (0 if both are) */
+  unsigned long predicate_hash;
+  unsigned long ground_hash;
+  /* blank node indexes of the subject and object or -1 */
+  int subject_blank;
+  int object_blank;
+  /* non-0 when a statement in the other file is the same */
   int matched;
+} rdfdiff_statement;
+
+typedef struct {
+  /* the statements using this blank node are at arcs[arcs_offset] */
+  int arcs_offset;
+  int arcs_count;
+  /* non-0 if a statement links this blank node to a blank node */
+  int linked;
 } rdfdiff_blank;
 
+/* blank node label, owned by the statement that first used it, and
+ * the index of the blank node */
+typedef struct {
+  const unsigned char *blank_id;
+  int index;
+} rdfdiff_blank_label;
+
+typedef struct {
+  /* blank nodes of the component are component_blanks[offset] onwards */
+  int offset;
+  int count;
+  /* order independent hash of the blank node colours */
+  unsigned long signature;
+  /* non-0 when paired with a component in the other file */
+  int matched;
+} rdfdiff_component;
+
 typedef struct {
   raptor_world *world;
   char *name;
   raptor_parser *parser;
-  rdfdiff_link *first;
-  rdfdiff_link *last;
-  rdfdiff_blank *first_blank;
-  rdfdiff_blank *last_blank;
+
+  /* statements without duplicates in parse order */
+  rdfdiff_statement *statements;
+  int statements_size;
+  /* the same statements to find them by value */
+  raptor_statement_set *statement_set;
+
+  /* blank nodes in order of first use */
+  rdfdiff_blank *blanks;
+  int blanks_count;
+  int blanks_size;
+  /* rdfdiff_blank_label of each blank node by label */
+  raptor_avltree *blank_labels;
+
+  /* statement indexes grouped by blank node */
+  int *arcs;
+
+  /* blank node colours and scratch space used while matching */
+  unsigned long *colours;
+  unsigned long *sorted_colours;
+  int colours_count;
+  /* number of each blank node while refining */
+  int *scope;
+
+  /* components of blank nodes that need searching to match, with the
+   * colours they had before searching */
+  rdfdiff_component *components;
+  int components_count;
+  int *component_blanks;
+  unsigned long *saved_colours;
+
   int statement_count;
+  int blank_statement_count;
   int error_count;
   int warning_count;
   int difference_count;
 } rdfdiff_file;
 
+typedef struct {
+  unsigned long signature;
+  int statement;
+} rdfdiff_signature;
+
+/* a class of blank nodes with the same colour while refining */
+typedef struct {
+  /* nodes of the class are members[start] to members[end - 1] */
+  int start;
+  int end;
+  unsigned long colour;
+  /* hash of the statements of each node, the same for all of them */
+  unsigned long sum;
+} rdfdiff_class;
+
+typedef struct {
+  int class_index;
+  unsigned long sum;
+  int node;
+} rdfdiff_dirty;
+
+/* Colour refinement of blank nodes of two files.  Nodes are numbered
+ * from 0 with those of the first file before those of the second. */
+typedef struct {
+  rdfdiff_file *files[2];
+  const int *nodes[2];
+  int counts[2];
+
+  /* nodes grouped by class, the position of each and its class */
+  int *members;
+  int *positions;
+  int *class_of;
+  rdfdiff_class *classes;
+  int classes_count;
+
+  /* nodes to look at again in the next round */
+  int *dirty;
+  int dirty_count;
+  char *is_dirty;
+  rdfdiff_dirty *entries;
+} rdfdiff_refiner;
+
 static int brief = 0;
+static int stats = 0;
 static char *program = NULL;
 static const char * const title_string="Raptor RDF diff utility";
 static int ignore_errors = 0;
@@ -138,15 +239,25 @@ static int emit_to_header = 1;
 static rdfdiff_file* from_file = NULL;
 static rdfdiff_file*to_file = NULL;
 
-static rdfdiff_file* rdfdiff_new_file(raptor_world* world, const unsigned char *name, const char *syntax);
-static void rdfdiff_free_file(rdfdiff_file* file);
+/* work done matching blank nodes, for --stats */
+static int refine_rounds = 0;
+static int search_steps = 0;
+static int search_limit = 0;
 
-static rdfdiff_blank *rdfdiff_find_blank(rdfdiff_blank *first, char *blank_id);
-static rdfdiff_blank *rdfdiff_new_blank(raptor_world *world, char *blank_id);
-static void rdfdiff_free_blank(rdfdiff_blank *blank);
+/* Maximum number of blank node pairings tried for each component
+ * when colour refinement alone cannot tell blank nodes apart */
+#define RDFDIFF_SEARCH_BUDGET 10000
 
-static int  rdfdiff_blank_equals(const rdfdiff_blank *b1, const rdfdiff_blank *b2,
-                                 rdfdiff_file*b1_file, rdfdiff_file*b2_file);
+#define RDFDIFF_SEARCH_GAVE_UP -1
+#define RDFDIFF_SEARCH_FAILED -2
+
+/* flags for the root blank node of a component */
+#define RDFDIFF_COMPONENT_CYCLIC 1
+#define RDFDIFF_COMPONENT_SHARED 2
+
+static rdfdiff_file* rdfdiff_new_file(raptor_world* world, const unsigned char *name, const char *syntax);
+static void rdfdiff_free_file(rdfdiff_file* file);
+static int rdfdiff_compare_blank_label(const void *a, const void *b);
 
 static void rdfdiff_log_handler(void *data, raptor_log_message *message);
 
@@ -155,22 +266,17 @@ static void rdfdiff_collect_statements(void *user_data, raptor_statement *statem
 int main(int argc, char *argv[]);
 
 
-/* Version of strcmp that can take NULL parameters. Assume that
- * Non-NULL strings are lexically greater than NULL strings 
- */
-static int
-safe_strcmp(const char *s1, const char *s2)
+static double
+rdfdiff_now(void)
 {
-  if(s1 == NULL && s2 == NULL) {
-    return 0;
-  } else if(s1 == NULL && s2 != NULL) {
-    return -1;
-  } else if(s1 != NULL && s2 == NULL) {
-    return 1;
-  } else {
-    return strcmp(s1, s2);
-  }
-  
+#ifdef HAVE_GETTIMEOFDAY
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
 }
 
 
@@ -185,6 +291,14 @@ rdfdiff_new_file(raptor_world *world, const unsigned char *name, const char *syn
     if(!file->name)
       return(0);
     memcpy(file->name, name, name_len + 1);
+
+    file->statement_set = raptor_new_statement_set(world);
+    file->blank_labels = raptor_new_avltree(rdfdiff_compare_blank_label,
+                                            raptor_free_memory, 0);
+    if(!file->statement_set || !file->blank_labels) {
+      rdfdiff_free_file(file);
+      return(0);
+    }
     
     file->parser = raptor_new_parser(world, syntax);
     if(file->parser) {
@@ -206,246 +320,122 @@ rdfdiff_new_file(raptor_world *world, const unsigned char *name, const char *syn
 static void
 rdfdiff_free_file(rdfdiff_file* file) 
 {
-  rdfdiff_link *cur, *next;
-  rdfdiff_blank *cur1, *next1;
-  
+  int i;
+
   if(file->name)
     RAPTOR_FREE(char*, file->name);
 
   if(file->parser)
     raptor_free_parser(file->parser);
   
-  for(cur = file->first; cur; cur = next) {
-    next = cur->next;
-
-    raptor_free_statement(cur->statement);
-    RAPTOR_FREE(rdfdiff_link, cur);
-  }
-
-  for(cur1 = file->first_blank; cur1; cur1 = next1) {
-    next1 = cur1->next;
+  for(i = 0; i < file->statement_count; i++)
+    raptor_free_statement(file->statements[i].statement);
+
+  if(file->statements)
+    RAPTOR_FREE(rdfdiff_statement*, file->statements);
+  if(file->statement_set)
+    raptor_free_statement_set(file->statement_set);
+  if(file->blanks)
+    RAPTOR_FREE(rdfdiff_blank*, file->blanks);
+  if(file->blank_labels)
+    raptor_free_avltree(file->blank_labels);
+  if(file->arcs)
+    RAPTOR_FREE(int*, file->arcs);
+  if(file->colours)
+    RAPTOR_FREE(unsigned long*, file->colours);
+  if(file->scope)
+    RAPTOR_FREE(int*, file->scope);
+  if(file->sorted_colours)
+    RAPTOR_FREE(unsigned long*, file->sorted_colours);
+  if(file->components)
+    RAPTOR_FREE(rdfdiff_component*, file->components);
+  if(file->component_blanks)
+    RAPTOR_FREE(int*, file->component_blanks);
+  if(file->saved_colours)
+    RAPTOR_FREE(unsigned long*, file->saved_colours);
 
-    rdfdiff_free_blank(cur1);
-  }
-  
   RAPTOR_FREE(rdfdiff_file, file);  
-  
 }
 
 
-static rdfdiff_blank *
-rdfdiff_new_blank(raptor_world* world, char *blank_id) 
+static unsigned long
+rdfdiff_mix(unsigned long h, unsigned long v)
 {
-  rdfdiff_blank *blank = RAPTOR_CALLOC(rdfdiff_blank*, 1, sizeof(*blank));
-
-  if(blank) {
-    size_t blank_id_len = strlen(blank_id);
-    blank->world = world;
-    blank->blank_id = RAPTOR_MALLOC(char*, blank_id_len + 1);
-    if(!blank->blank_id)
-      return NULL;
-
-    memcpy(blank->blank_id, blank_id, blank_id_len + 1);
-  }
-  
-  return blank;
+  h ^= v + 0x9e3779b9UL + (h << 6) + (h >> 2);
+  return h;
 }
 
 
-static void
-rdfdiff_free_blank(rdfdiff_blank *blank) 
+static unsigned long
+rdfdiff_scramble(unsigned long h)
 {
-  rdfdiff_link *cur, *next;
-
-  if(blank->blank_id)
-    RAPTOR_FREE(char*, blank->blank_id);
-
-  if(blank->owner)
-    raptor_free_statement(blank->owner);
-  
-  for(cur = blank->first; cur; cur = next) {
-    next = cur->next;
+  h ^= h >> 16;
+  h *= 0x85ebca6bUL;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35UL;
+  h ^= h >> 16;
+  return h;
+}
 
-    raptor_free_statement(cur->statement);
-    RAPTOR_FREE(rdfdiff_link, cur);
-  }
 
-  RAPTOR_FREE(rdfdiff_blank, blank);
-  
+static unsigned long
+rdfdiff_triple_hash(unsigned long subject_hash, unsigned long predicate_hash,
+                    unsigned long object_hash)
+{
+  return rdfdiff_mix(rdfdiff_mix(rdfdiff_scramble(subject_hash),
+                                 predicate_hash), object_hash);
 }
 
 
 static int
-rdfdiff_statement_equals(raptor_world *world, const raptor_statement *s1, const raptor_statement *s2)
+rdfdiff_compare_blank_label(const void *a, const void *b)
 {
-  int rv = 0;
-  
-  if(!s1 || !s2)
-    return 0;
-
-#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-  fprintf(stderr, "(rdfdiff_statement_equals) Comparing ");
-  raptor_statement_print_as_ntriples(s1, stderr);
-  fprintf(stderr, " to ");
-  raptor_statement_print_as_ntriples(s2, stderr);
-#endif
-
-  /* normal comparison */
-  if(s1->subject->type != s2->subject->type) {
-    rv = 0;
-    goto done;
-  }
-
-  if(s1->subject->type == RAPTOR_TERM_TYPE_BLANK) {
-    /* Here for completeness. Anonymous nodes are taken care of
-     * elsewhere */
-    /*if(strcmp((const char *)s1->subject, (const char *)s2->subject->value) != 0)
-      return 0;*/
-  } else {
-    if(!raptor_uri_equals(s1->subject->value.uri,
-                          s2->subject->value.uri)) {
-      rv = 0;
-      goto done;
-    }
-  }
-
-  if(s1->predicate->type != s2->predicate->type) {
-    rv = 0;
-    goto done;
-  }
-  
-  if(!raptor_uri_equals(s1->predicate->value.uri,
-                        s2->predicate->value.uri)) {
-    rv = 0;
-    goto done;
-  }
-  
-  if(s1->object->type != s2->object->type) {
-    rv = 0;
-    goto done;
-  }
-  
-  if(s1->object->type == RAPTOR_TERM_TYPE_LITERAL) {
-    int equal;
-    
-    equal= !safe_strcmp((char *)s1->object->value.literal.string,
-                        (char *)s2->object->value.literal.string);
-
-    if(equal) {
-      if(s1->object->value.literal.language && s2->object->value.literal.language)
-        equal = !strcmp((char *)s1->object->value.literal.language,
-                        (char *)s2->object->value.literal.language);
-      else if(s1->object->value.literal.language || s2->object->value.literal.language)
-        equal = 0;
-      else
-        equal = 1;
-
-      if(equal)
-        equal = raptor_uri_equals(s1->object->value.literal.datatype, 
-                                  s2->object->value.literal.datatype);
-    }
+  const rdfdiff_blank_label *l1 = (const rdfdiff_blank_label*)a;
+  const rdfdiff_blank_label *l2 = (const rdfdiff_blank_label*)b;
 
-    rv = equal;
-    goto done;
-  } else if(s1->object->type == RAPTOR_TERM_TYPE_BLANK) {
-    /* Here for completeness. Anonymous nodes are taken care of
-     * elsewhere */
-    /* if(strcmp((const char *)s1->object, (const char *)s2->object->value) != 0)
-       return 0; */
-  } else {
-    if(!raptor_uri_equals(s1->object->value.uri,
-                          s2->object->value.uri)) {
-      rv = 0;
-      goto done;
-    }
-  }
-
-  rv = 1;
-  done:
-
-#if defined(RAPTOR_DEBUG) && RAPTOR_DEBUG > 1
-  fprintf(stderr, " : %s\n", (rv ? "equal" : "not equal"));
-#endif
-  return rv;
+  return strcmp((const char*)l1->blank_id, (const char*)l2->blank_id);
 }
 
 
+/*
+ * rdfdiff_lookup_blank - Get the index of the blank node for a term,
+ * adding it to the file if it is new.  Returns -1 on failure.
+ */
 static int
-rdfdiff_blank_equals(const rdfdiff_blank *b1, const rdfdiff_blank *b2,
-                     rdfdiff_file *b1_file, rdfdiff_file *b2_file) 
+rdfdiff_lookup_blank(rdfdiff_file *file, raptor_term *term)
 {
-  /* first compare "owners". Owners are subject/predicate or arcs
-   * in. */
-  int equal = 0;
-
-  if(b1->owner == NULL && b2->owner == NULL) {
-    /* Both are "top-level" anonymous objects. I.E. Neither is the
-     * object of a statement. Fall through and compare based on their
-     * contents. */
-    equal = 1;
-  } else if(b1->owner == NULL || b2->owner == NULL) {
-    equal = 0;
-  } else if(b1->owner->subject->type != RAPTOR_TERM_TYPE_BLANK &&
-            b2->owner->subject->type != RAPTOR_TERM_TYPE_BLANK) {
-    /* Neither are anonymous. Normal comparison. This will return
-     * false if both the subject and the predicates don't match. We
-     * know the objects are blank nodes. */
-    equal = rdfdiff_statement_equals(b1->world, b1->owner, b2->owner);
-    
-  } else if(b1->owner->subject->type == RAPTOR_TERM_TYPE_BLANK &&
-            b2->owner->subject->type == RAPTOR_TERM_TYPE_BLANK) {
-    rdfdiff_blank *p1;
-    rdfdiff_blank *p2;
-
-    /* Both are anonymous.  Need further testing. Check that the
-     * containing anononymous nodes are eaual. */
-#if 0
-    fprintf(stderr, "b1->owner: ");    
-    raptor_statement_print_as_ntriples(b1->owner, stderr);
-    fprintf(stderr, "\n");
-
-    fprintf(stderr, "b2->owner: ");    
-    raptor_statement_print_as_ntriples(b2->owner, stderr);
-    fprintf(stderr, "\n");
-#endif    
-    p1 = rdfdiff_find_blank(b1_file->first_blank, 
-                            (char *)b1->owner->subject->value.blank.string);
-    p2 = rdfdiff_find_blank(b2_file->first_blank,
-                            (char *)b2->owner->subject->value.blank.string);
-    equal = rdfdiff_blank_equals(p1, p2, b1_file, b2_file);
-  } else {
-    equal = 0;
+  rdfdiff_blank_label key;
+  rdfdiff_blank_label *label;
+
+  key.blank_id = term->value.blank.string;
+  label = (rdfdiff_blank_label*)raptor_avltree_search(file->blank_labels,
+                                                      &key);
+  if(label)
+    return label->index;
+
+  if(file->blanks_count == file->blanks_size) {
+    int size = file->blanks_size ? file->blanks_size * 2 : 256;
+    rdfdiff_blank *blanks;
+
+    blanks = RAPTOR_REALLOC(rdfdiff_blank*, file->blanks,
+                            (size_t)size * sizeof(*blanks));
+    if(!blanks)
+      return -1;
+    file->blanks = blanks;
+    file->blanks_size = size;
   }
 
-  /* Now compare the contents. This accounts for the case where a
-   * subject has several properties (of the same predicate value) with
-   * different blank nodes as values. */
-  if(equal) {
-    rdfdiff_link *s1 = b1->first;
-    while(s1) {
-
-      rdfdiff_link *s2 = b2->first;
-      while(s2) {
-
-        if(rdfdiff_statement_equals(b1->world, s1->statement, s2->statement))
-          break;
-          
-        s2 = s2->next;
-
-      }
-
-      if(s2 == 0) {
-        equal = 0;
-        break;
-      }
+  label = (rdfdiff_blank_label*)raptor_alloc_memory(sizeof(*label));
+  if(!label)
+    return -1;
+  label->blank_id = key.blank_id;
+  label->index = file->blanks_count;
+  if(raptor_avltree_add(file->blank_labels, label))
+    return -1;
 
-      s1 = s1->next;
+  memset(&file->blanks[file->blanks_count], 0, sizeof(rdfdiff_blank));
 
-    }
-    
-  }
-  
-  return equal;
+  return file->blanks_count++;
 }
 
 
@@ -494,222 +484,1129 @@ rdfdiff_log_handler(void *data, raptor_log_message *message)
 
 
 
-static rdfdiff_blank *
-rdfdiff_find_blank(rdfdiff_blank *first, char *blank_id) 
+/*
+ * rdfdiff_collect_statements - Called when parsing a file to add each
+ * new statement to its statement set for comparison with the other file.
+ */
+static void
+rdfdiff_collect_statements(void *user_data, raptor_statement *statement)
 {
-  rdfdiff_blank *rv_blank = 0;
-  rdfdiff_blank *cur = first;
+  rdfdiff_file* file = (rdfdiff_file*)user_data;
+  rdfdiff_statement *ds;
+  raptor_statement *triple;
+  unsigned long subject_hash;
+  unsigned long object_hash;
+  int rc;
+
+  /* statements are compared as triples */
+  triple = raptor_new_statement_from_nodes(file->world,
+                                           raptor_term_copy(statement->subject),
+                                           raptor_term_copy(statement->predicate),
+                                           raptor_term_copy(statement->object),
+                                           NULL);
+  if(!triple)
+    goto failed;
 
-  while(cur) {
+  rc = raptor_statement_set_add(file->statement_set, triple);
+  if(rc) {
+    raptor_free_statement(triple);
+    if(rc > 0)
+      return;
+    goto failed;
+  }
 
-    if(strcmp(cur->blank_id, blank_id) == 0) {
-      rv_blank = cur;
-      break;
+  if(file->statement_count == file->statements_size) {
+    int size = file->statements_size ? file->statements_size * 2 : 1024;
+    rdfdiff_statement *statements;
+
+    statements = RAPTOR_REALLOC(rdfdiff_statement*, file->statements,
+                                (size_t)size * sizeof(*statements));
+    if(!statements) {
+      raptor_free_statement(triple);
+      goto failed;
     }
+    file->statements = statements;
+    file->statements_size = size;
+  }
 
-    cur = cur->next;
-    
+  subject_hash = raptor_term_hash(triple->subject);
+  object_hash = raptor_term_hash(triple->object);
+
+  ds = &file->statements[file->statement_count++];
+  ds->statement = triple;
+  ds->predicate_hash = raptor_term_hash(triple->predicate);
+  ds->ground_hash = 0;
+  ds->subject_blank = -1;
+  ds->object_blank = -1;
+  ds->matched = 0;
+
+  /* labels are taken from the triple which lives as long as the file */
+  if(triple->subject->type == RAPTOR_TERM_TYPE_BLANK) {
+    ds->subject_blank = rdfdiff_lookup_blank(file, triple->subject);
+    if(ds->subject_blank < 0)
+      goto failed;
+  } else
+    ds->ground_hash = subject_hash;
+
+  if(triple->object->type == RAPTOR_TERM_TYPE_BLANK) {
+    ds->object_blank = rdfdiff_lookup_blank(file, triple->object);
+    if(ds->object_blank < 0)
+      goto failed;
+  } else if(ds->subject_blank >= 0)
+    ds->ground_hash = object_hash;
+
+  if(ds->subject_blank >= 0 || ds->object_blank >= 0)
+    file->blank_statement_count++;
+
+  return;
+
+failed:
+  fprintf(stderr, "%s: Internal Error\n", program);
+  raptor_parser_parse_abort(file->parser);
+}
+
+
+/*
+ * rdfdiff_index_blanks - Group the statements of a file by blank node
+ * and allocate the colour arrays
+ */
+static int
+rdfdiff_index_blanks(rdfdiff_file *file)
+{
+  size_t count = (size_t)file->blanks_count + 1;
+  int offset = 0;
+  int i;
+
+  file->arcs = RAPTOR_MALLOC(int*, (2 * (size_t)file->blank_statement_count + 1) * sizeof(int));
+  file->colours = RAPTOR_CALLOC(unsigned long*, count, sizeof(unsigned long));
+  file->sorted_colours = RAPTOR_CALLOC(unsigned long*, count, sizeof(unsigned long));
+  file->scope = RAPTOR_CALLOC(int*, count, sizeof(int));
+  if(!file->arcs || !file->colours || !file->sorted_colours ||
+     !file->scope)
+    return 1;
+
+  for(i = 0; i < file->statement_count; i++) {
+    rdfdiff_statement *ds = &file->statements[i];
+
+    if(ds->subject_blank >= 0)
+      file->blanks[ds->subject_blank].arcs_count++;
+    if(ds->object_blank >= 0 && ds->object_blank != ds->subject_blank)
+      file->blanks[ds->object_blank].arcs_count++;
+    if(ds->subject_blank >= 0 && ds->object_blank >= 0) {
+      file->blanks[ds->subject_blank].linked = 1;
+      file->blanks[ds->object_blank].linked = 1;
+    }
   }
-  
-  return rv_blank;
-  
+
+  for(i = 0; i < file->blanks_count; i++) {
+    file->blanks[i].arcs_offset = offset;
+    offset += file->blanks[i].arcs_count;
+    file->blanks[i].arcs_count = 0;
+  }
+
+  for(i = 0; i < file->statement_count; i++) {
+    rdfdiff_statement *ds = &file->statements[i];
+    rdfdiff_blank *blank;
+
+    if(ds->subject_blank >= 0) {
+      blank = &file->blanks[ds->subject_blank];
+      file->arcs[blank->arcs_offset + blank->arcs_count++] = i;
+    }
+    if(ds->object_blank >= 0 && ds->object_blank != ds->subject_blank) {
+      blank = &file->blanks[ds->object_blank];
+      file->arcs[blank->arcs_offset + blank->arcs_count++] = i;
+    }
+  }
+
+  return 0;
 }
 
 
-static rdfdiff_blank *
-rdfdiff_lookup_blank(rdfdiff_file* file, char *blank_id) 
+/*
+ * rdfdiff_match_ground_statements - Mark the statements without blank
+ * nodes that are in both files
+ */
+static void
+rdfdiff_match_ground_statements(rdfdiff_file *from, rdfdiff_file *to)
 {
-  rdfdiff_blank *rv_blank = rdfdiff_find_blank(file->first_blank, blank_id);
-  
-  if(!rv_blank) {
-    rv_blank = rdfdiff_new_blank(file->world, blank_id);
-    if(rv_blank) {
-
-      if(!file->first_blank) {
-        file->first_blank = rv_blank;
-        file->last_blank = rv_blank;
-      } else {
-        file->last_blank->next = rv_blank;
-        file->last_blank = rv_blank;
-      }
-    }    
+  rdfdiff_file *files[2];
+  int f;
+
+  files[0] = from;
+  files[1] = to;
+
+  for(f = 0; f < 2; f++) {
+    rdfdiff_file *file = files[f];
+    rdfdiff_file *other = files[1 - f];
+    int i;
+
+    for(i = 0; i < file->statement_count; i++) {
+      rdfdiff_statement *ds = &file->statements[i];
+
+      if(ds->subject_blank >= 0 || ds->object_blank >= 0)
+        continue;
+
+      if(raptor_statement_set_contains(other->statement_set, ds->statement))
+        ds->matched = 1;
+    }
   }
+}
 
-  return rv_blank;
-  
+
+static int
+rdfdiff_compare_colour(const void *a, const void *b)
+{
+  unsigned long c1 = *(const unsigned long*)a;
+  unsigned long c2 = *(const unsigned long*)b;
+
+  return (c1 > c2) - (c1 < c2);
 }
 
 
+/*
+ * rdfdiff_sort_colours - Sort the colours of @count blank nodes of a
+ * file, listed in @nodes or all of them if @nodes is NULL, into
+ * sorted_colours and return the number of distinct colours
+ */
 static int
-rdfdiff_add_blank_statement(rdfdiff_file* file,
-                            raptor_statement *statement)
+rdfdiff_sort_colours(rdfdiff_file *file, const int *nodes, int count)
 {
-  rdfdiff_blank *blank;
-  rdfdiff_link *dlink;
+  int distinct = 0;
+  int i;
 
-  blank = rdfdiff_lookup_blank(file, (char *)statement->subject->value.blank.string);
-  if(!blank)
-    goto failed;
+  for(i = 0; i < count; i++)
+    file->sorted_colours[i] = file->colours[nodes ? nodes[i] : i];
+  qsort(file->sorted_colours, (size_t)count, sizeof(unsigned long),
+        rdfdiff_compare_colour);
 
-  dlink = RAPTOR_MALLOC(rdfdiff_link*, sizeof(*dlink));
-  if(!dlink)
-    goto failed;
-  
-  dlink->statement = raptor_statement_copy(statement);
-  if(!dlink->statement) {
-    RAPTOR_FREE(rdfdiff_link, dlink);
-    goto failed;
+  for(i = 0; i < count; i++)
+    if(!i || file->sorted_colours[i] != file->sorted_colours[i - 1])
+      distinct++;
+
+  return distinct;
+}
+
+
+/*
+ * rdfdiff_blank_sum - Hash the multiset of the statements of a blank
+ * node, with neighbouring blank nodes replaced by their colours
+ */
+static unsigned long
+rdfdiff_blank_sum(rdfdiff_file *file, int b)
+{
+  rdfdiff_blank *blank = &file->blanks[b];
+  unsigned long sum = 0;
+  int k;
+
+  for(k = 0; k < blank->arcs_count; k++) {
+    rdfdiff_statement *ds = &file->statements[file->arcs[blank->arcs_offset + k]];
+    unsigned long other;
+
+    /* a statement may use the blank node as subject and object */
+    if(ds->subject_blank == b) {
+      other = (ds->object_blank >= 0) ? file->colours[ds->object_blank] :
+                                        ds->ground_hash;
+      sum += rdfdiff_scramble(rdfdiff_mix(rdfdiff_mix(1, ds->predicate_hash),
+                                          other));
+    }
+    if(ds->object_blank == b) {
+      other = (ds->subject_blank >= 0) ? file->colours[ds->subject_blank] :
+                                         ds->ground_hash;
+      sum += rdfdiff_scramble(rdfdiff_mix(rdfdiff_mix(2, ds->predicate_hash),
+                                          other));
+    }
   }
-  
-  dlink->next = NULL;
-  if(!blank->first) {
-    blank->first = dlink;
-    blank->last = dlink;
-  } else {
-    blank->last->next = dlink;
-    blank->last = dlink;
+
+  return sum;
+}
+
+
+/* Get the file and blank node of node @k being refined */
+static rdfdiff_file*
+rdfdiff_refiner_blank(rdfdiff_refiner *r, int k, int *blank_p)
+{
+  int f = (k >= r->counts[0]);
+  int i = k - (f ? r->counts[0] : 0);
+
+  *blank_p = r->nodes[f] ? r->nodes[f][i] : i;
+  return r->files[f];
+}
+
+
+static void
+rdfdiff_refiner_mark(rdfdiff_refiner *r, int k)
+{
+  if(!r->is_dirty[k]) {
+    r->is_dirty[k] = 1;
+    r->dirty[r->dirty_count++] = k;
   }
-  
-  return 0;
+}
 
-failed:
-  fprintf(stderr, "%s: Internal Error\n", program);
-  return 1;
+
+/* Give the nodes of class @c a new colour and mark their neighbours
+ * for the next round */
+static void
+rdfdiff_refiner_recolour(rdfdiff_refiner *r, int c, unsigned long colour)
+{
+  rdfdiff_class *cls = &r->classes[c];
+  int i;
+
+  cls->colour = colour;
+  for(i = cls->start; i < cls->end; i++) {
+    int b;
+    rdfdiff_file *file = rdfdiff_refiner_blank(r, r->members[i], &b);
+    rdfdiff_blank *blank = &file->blanks[b];
+    int k;
+
+    file->colours[b] = colour;
+    for(k = 0; k < blank->arcs_count; k++) {
+      rdfdiff_statement *ds = &file->statements[file->arcs[blank->arcs_offset + k]];
+
+      if(ds->subject_blank >= 0 && ds->subject_blank != b)
+        rdfdiff_refiner_mark(r, file->scope[ds->subject_blank]);
+      if(ds->object_blank >= 0 && ds->object_blank != b)
+        rdfdiff_refiner_mark(r, file->scope[ds->object_blank]);
+    }
+  }
 }
 
 
 static int
-rdfdiff_add_blank_statement_owner(rdfdiff_file* file,
-                                  raptor_statement *statement)
+rdfdiff_compare_dirty(const void *a, const void *b)
 {
-  rdfdiff_blank *blank;
+  const rdfdiff_dirty *d1 = (const rdfdiff_dirty*)a;
+  const rdfdiff_dirty *d2 = (const rdfdiff_dirty*)b;
+
+  if(d1->class_index != d2->class_index)
+    return d1->class_index - d2->class_index;
+  if(d1->sum != d2->sum)
+    return (d1->sum > d2->sum) ? 1 : -1;
+  return d1->node - d2->node;
+}
 
-  blank = rdfdiff_lookup_blank(file,
-                               (char*)statement->object->value.blank.string);
-  if(!blank)
-    goto failed;
 
-  if(blank->owner)
-    raptor_free_statement(blank->owner);
+/*
+ * rdfdiff_refiner_split - Split class @c by the new sums of its @count
+ * dirty nodes in @entries, sorted by sum.  The other nodes of the class
+ * still have the sum of the class.  The largest part keeps the colour
+ * of the class and the others get new colours.
+ */
+static void
+rdfdiff_refiner_split(rdfdiff_refiner *r, int c, rdfdiff_dirty *entries,
+                      int count)
+{
+  rdfdiff_class *cls = &r->classes[c];
+  unsigned long colour = cls->colour;
+  int first_new = r->classes_count;
+  int keeper = c;
+  int end = cls->end;
+  int i, j;
+
+  if(count == cls->end - cls->start) {
+    /* every node is dirty so the first part stays */
+    cls->sum = entries[0].sum;
+    if(entries[count - 1].sum == cls->sum)
+      return;
+  }
 
-  blank->owner = raptor_statement_copy(statement);
-  if(!blank->owner)
-    goto failed;
+  /* move the nodes with a different sum to the end of the class */
+  for(i = 0; i < count; i++) {
+    int k = entries[i].node;
+    int p = r->positions[k];
+    int other = r->members[--end];
 
-  return 0;
+    if(entries[i].sum == cls->sum) {
+      end++;
+      continue;
+    }
 
-failed:
-  fprintf(stderr, "%s: Internal Error\n", program);
-  return 1;
+    r->members[p] = other;
+    r->positions[other] = p;
+    r->members[end] = k;
+    r->positions[k] = end;
+  }
+  if(end == cls->end)
+    return;
+
+  /* and make a class of each run of them with the same sum */
+  cls->end = end;
+  for(i = 0; i < count; i = j) {
+    rdfdiff_class *part;
+
+    for(j = i + 1; j < count && entries[j].sum == entries[i].sum; j++)
+      ;
+    if(entries[i].sum == cls->sum)
+      continue;
+
+    part = &r->classes[r->classes_count];
+    part->start = end;
+    part->sum = entries[i].sum;
+    part->colour = colour;
+    for(; i < j; i++) {
+      int k = entries[i].node;
+
+      r->members[end] = k;
+      r->positions[k] = end;
+      r->class_of[k] = r->classes_count;
+      end++;
+    }
+    part->end = end;
+    r->classes_count++;
+  }
+
+  /* sizes count both files so the choice is the same for each */
+  for(i = first_new; i < r->classes_count; i++) {
+    rdfdiff_class *part = &r->classes[i];
+    rdfdiff_class *best = &r->classes[keeper];
+    int size = part->end - part->start;
+    int best_size = best->end - best->start;
+
+    if(size > best_size || (size == best_size && part->sum > best->sum))
+      keeper = i;
+  }
+
+  if(keeper != c)
+    rdfdiff_refiner_recolour(r, c, rdfdiff_mix(colour, cls->sum));
+  for(i = first_new; i < r->classes_count; i++) {
+    if(i != keeper)
+      rdfdiff_refiner_recolour(r, i, rdfdiff_mix(colour, r->classes[i].sum));
+  }
+}
+
+
+/*
+ * rdfdiff_refiner_round - Recompute the sums of the dirty nodes and
+ * split their classes
+ */
+static void
+rdfdiff_refiner_round(rdfdiff_refiner *r)
+{
+  int count = r->dirty_count;
+  int i, j;
+
+  for(i = 0; i < count; i++) {
+    int k = r->dirty[i];
+    int b;
+    rdfdiff_file *file = rdfdiff_refiner_blank(r, k, &b);
+
+    r->is_dirty[k] = 0;
+    r->entries[i].class_index = r->class_of[k];
+    r->entries[i].sum = rdfdiff_blank_sum(file, b);
+    r->entries[i].node = k;
+  }
+  r->dirty_count = 0;
+
+  qsort(r->entries, (size_t)count, sizeof(rdfdiff_dirty),
+        rdfdiff_compare_dirty);
+
+  for(i = 0; i < count; i = j) {
+    for(j = i + 1;
+        j < count && r->entries[j].class_index == r->entries[i].class_index;
+        j++)
+      ;
+    rdfdiff_refiner_split(r, r->entries[i].class_index, &r->entries[i], j - i);
+  }
+}
+
+
+/*
+ * rdfdiff_refine - Refine the colours of blank nodes in both files,
+ * either those listed in @from_nodes and @to_nodes or all of them if
+ * they are NULL, until neither partition gets finer.  Returns non-0 if
+ * the two files do not have the same multiset of colours or <0 on
+ * failure.
+ *
+ * The blank nodes of both files are split into classes of the same
+ * colour.  Each round only looks again at blank nodes next to one
+ * whose colour changed, and when a class splits its largest part keeps
+ * the colour, so a blank node changes colour O(log n) times.
+ */
+static int
+rdfdiff_refine(rdfdiff_file *from, const int *from_nodes, int from_count,
+               rdfdiff_file *to, const int *to_nodes, int to_count)
+{
+  rdfdiff_refiner r;
+  size_t count = (size_t)from_count + (size_t)to_count + 1;
+  int from_distinct;
+  int to_distinct;
+  int rc = -1;
+  int i;
+
+  memset(&r, '\0', sizeof(r));
+  r.files[0] = from;
+  r.files[1] = to;
+  r.nodes[0] = from_nodes;
+  r.nodes[1] = to_nodes;
+  r.counts[0] = from_count;
+  r.counts[1] = to_count;
+
+  r.members = RAPTOR_MALLOC(int*, count * sizeof(int));
+  r.positions = RAPTOR_MALLOC(int*, count * sizeof(int));
+  r.class_of = RAPTOR_MALLOC(int*, count * sizeof(int));
+  r.classes = RAPTOR_MALLOC(rdfdiff_class*, count * sizeof(rdfdiff_class));
+  r.dirty = RAPTOR_MALLOC(int*, count * sizeof(int));
+  r.is_dirty = RAPTOR_CALLOC(char*, count, sizeof(char));
+  r.entries = RAPTOR_MALLOC(rdfdiff_dirty*, count * sizeof(rdfdiff_dirty));
+  if(!r.members || !r.positions || !r.class_of || !r.classes ||
+     !r.dirty || !r.is_dirty || !r.entries)
+    goto tidy;
+
+  /* start with the classes of the current colours, all dirty */
+  count = (size_t)from_count + (size_t)to_count;
+  for(i = 0; i < (int)count; i++) {
+    int b;
+    rdfdiff_file *file = rdfdiff_refiner_blank(&r, i, &b);
+
+    file->scope[b] = i;
+    r.entries[i].class_index = 0;
+    r.entries[i].sum = file->colours[b];
+    r.entries[i].node = i;
+  }
+  qsort(r.entries, count, sizeof(rdfdiff_dirty), rdfdiff_compare_dirty);
+
+  for(i = 0; i < (int)count; i++) {
+    int k = r.entries[i].node;
+
+    if(!i || r.entries[i].sum != r.entries[i - 1].sum) {
+      if(i)
+        r.classes[r.classes_count - 1].end = i;
+      r.classes[r.classes_count].start = i;
+      r.classes[r.classes_count].colour = r.entries[i].sum;
+      r.classes[r.classes_count].sum = 0;
+      r.classes_count++;
+    }
+    r.members[i] = k;
+    r.positions[k] = i;
+    r.class_of[k] = r.classes_count - 1;
+    rdfdiff_refiner_mark(&r, k);
+  }
+  if(r.classes_count)
+    r.classes[r.classes_count - 1].end = (int)count;
+
+  while(r.dirty_count) {
+    rdfdiff_refiner_round(&r);
+    refine_rounds++;
+  }
+
+  from_distinct = rdfdiff_sort_colours(from, from_nodes, from_count);
+  to_distinct = rdfdiff_sort_colours(to, to_nodes, to_count);
+  from->colours_count = from_distinct;
+  to->colours_count = to_distinct;
+
+  if(from_count != to_count || from_distinct != to_distinct)
+    rc = 1;
+  else
+    rc = memcmp(from->sorted_colours, to->sorted_colours,
+                (size_t)from_count * sizeof(unsigned long)) != 0;
+
+  tidy:
+  if(r.members)
+    RAPTOR_FREE(int*, r.members);
+  if(r.positions)
+    RAPTOR_FREE(int*, r.positions);
+  if(r.class_of)
+    RAPTOR_FREE(int*, r.class_of);
+  if(r.classes)
+    RAPTOR_FREE(rdfdiff_class*, r.classes);
+  if(r.dirty)
+    RAPTOR_FREE(int*, r.dirty);
+  if(r.is_dirty)
+    RAPTOR_FREE(char*, r.is_dirty);
+  if(r.entries)
+    RAPTOR_FREE(rdfdiff_dirty*, r.entries);
+
+  return rc;
+}
+
+
+/* Hash a statement with its blank nodes replaced by their colours */
+static unsigned long
+rdfdiff_statement_signature(rdfdiff_file *file, rdfdiff_statement *ds)
+{
+  unsigned long subject;
+  unsigned long object;
+
+  subject = (ds->subject_blank >= 0) ? file->colours[ds->subject_blank] :
+                                       ds->ground_hash;
+  object = (ds->object_blank >= 0) ? file->colours[ds->object_blank] :
+                                     ds->ground_hash;
+
+  return rdfdiff_triple_hash(subject, ds->predicate_hash, object);
 }
 
 
 static int
-rdfdiff_add_statement(rdfdiff_file* file, raptor_statement *statement) 
+rdfdiff_compare_signature(const void *a, const void *b)
 {
-  int rv = 0;
-  
-  rdfdiff_link *dlink = RAPTOR_MALLOC(rdfdiff_link*, sizeof(*dlink));
+  const rdfdiff_signature *s1 = (const rdfdiff_signature*)a;
+  const rdfdiff_signature *s2 = (const rdfdiff_signature*)b;
 
-  if(dlink) {
+  if(s1->signature != s2->signature)
+    return (s1->signature > s2->signature) ? 1 : -1;
+  return s1->statement - s2->statement;
+}
 
-    dlink->statement = raptor_statement_copy(statement);
 
-    if(dlink->statement) {
-      
-      dlink->next = NULL;
-
-      if(!file->first) {
-        file->first = dlink;
-        file->last = dlink;
-      } else {
-        file->last->next = dlink;
-        file->last = dlink;
-      }
-      
+static rdfdiff_signature*
+rdfdiff_blank_signatures(rdfdiff_file *file)
+{
+  rdfdiff_signature *signatures;
+  int count = 0;
+  int i;
+
+  signatures = RAPTOR_MALLOC(rdfdiff_signature*,
+                             ((size_t)file->blank_statement_count + 1) * sizeof(*signatures));
+  if(!signatures)
+    return NULL;
+
+  for(i = 0; i < file->statement_count; i++) {
+    rdfdiff_statement *ds = &file->statements[i];
+
+    if(ds->subject_blank < 0 && ds->object_blank < 0)
+      continue;
+
+    signatures[count].signature = rdfdiff_statement_signature(file, ds);
+    signatures[count].statement = i;
+    count++;
+  }
+
+  qsort(signatures, (size_t)count, sizeof(*signatures),
+        rdfdiff_compare_signature);
+
+  return signatures;
+}
+
+
+/*
+ * rdfdiff_match_blank_statements - Mark the statements with blank nodes
+ * that have a statement of the same shape with the same coloured blank
+ * nodes in the other file.  Returns the number of unmatched statements
+ * or <0 on failure.
+ */
+static int
+rdfdiff_match_blank_statements(rdfdiff_file *from, rdfdiff_file *to)
+{
+  rdfdiff_signature *from_signatures;
+  rdfdiff_signature *to_signatures;
+  int i = 0;
+  int j = 0;
+  int unmatched = 0;
+
+  from_signatures = rdfdiff_blank_signatures(from);
+  to_signatures = rdfdiff_blank_signatures(to);
+  if(!from_signatures || !to_signatures) {
+    if(from_signatures)
+      RAPTOR_FREE(rdfdiff_signature*, from_signatures);
+    if(to_signatures)
+      RAPTOR_FREE(rdfdiff_signature*, to_signatures);
+    return -1;
+  }
+
+  while(i < from->blank_statement_count || j < to->blank_statement_count) {
+    rdfdiff_statement *from_ds = NULL;
+    rdfdiff_statement *to_ds = NULL;
+
+    if(i < from->blank_statement_count)
+      from_ds = &from->statements[from_signatures[i].statement];
+    if(j < to->blank_statement_count)
+      to_ds = &to->statements[to_signatures[j].statement];
+
+    if(from_ds && to_ds &&
+       from_signatures[i].signature == to_signatures[j].signature) {
+      from_ds->matched = to_ds->matched = 1;
+      i++;
+      j++;
+    } else if(from_ds &&
+              (!to_ds || from_signatures[i].signature < to_signatures[j].signature)) {
+      from_ds->matched = 0;
+      unmatched++;
+      i++;
     } else {
-      RAPTOR_FREE(rdfdiff_link, dlink);
-      rv = 1;
+      to_ds->matched = 0;
+      unmatched++;
+      j++;
     }
-    
-  } else {
-    rv = 1;
   }
 
-  if(rv != 0)
-    fprintf(stderr, "%s: Internal Error\n", program);
+  RAPTOR_FREE(rdfdiff_signature*, from_signatures);
+  RAPTOR_FREE(rdfdiff_signature*, to_signatures);
 
-  return rv;
+  return unmatched;
+}
 
+
+static int
+rdfdiff_find_root(int *parent, int i)
+{
+  while(parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
 }
 
 
-static rdfdiff_link*
-rdfdiff_statement_find(rdfdiff_file* file, const raptor_statement *statement,
-                       rdfdiff_link** prev_p)
+/* Check if a blank node has the same colour as another one */
+static int
+rdfdiff_colour_is_shared(rdfdiff_file *file, int b)
 {
-  rdfdiff_link* prev = NULL;
-  rdfdiff_link* cur = file->first;
-  
-  while(cur) {
-    if(rdfdiff_statement_equals(file->world, cur->statement, statement)) {
-      if(prev_p)
-        *prev_p=prev;
-      return cur;
+  unsigned long colour = file->colours[b];
+  unsigned long *p;
+
+  p = (unsigned long*)bsearch(&colour, file->sorted_colours,
+                              (size_t)file->blanks_count,
+                              sizeof(unsigned long), rdfdiff_compare_colour);
+  if(!p)
+    return 0;
+
+  return (p > file->sorted_colours && p[-1] == colour) ||
+         (p + 1 < file->sorted_colours + file->blanks_count && p[1] == colour);
+}
+
+
+/*
+ * rdfdiff_find_components - Find the connected groups of linked blank
+ * nodes that contain a cycle and a colour shared with another blank
+ * node.  Colour refinement tells trees apart so only these need to be
+ * searched.  Returns non-0 on failure.
+ */
+static int
+rdfdiff_find_components(rdfdiff_file *file)
+{
+  size_t count = (size_t)file->blanks_count + 1;
+  int *parent;
+  int *flags;
+  int *component_of;
+  int offset = 0;
+  int rc = 1;
+  int i;
+
+  parent = RAPTOR_MALLOC(int*, count * sizeof(int));
+  flags = RAPTOR_CALLOC(int*, count, sizeof(int));
+  component_of = RAPTOR_MALLOC(int*, count * sizeof(int));
+  file->components = RAPTOR_CALLOC(rdfdiff_component*, count,
+                                   sizeof(rdfdiff_component));
+  file->component_blanks = RAPTOR_MALLOC(int*, count * sizeof(int));
+  file->saved_colours = RAPTOR_MALLOC(unsigned long*,
+                                      count * sizeof(unsigned long));
+  if(!parent || !flags || !component_of || !file->components ||
+     !file->component_blanks || !file->saved_colours)
+    goto tidy;
+
+  memcpy(file->saved_colours, file->colours,
+         (size_t)file->blanks_count * sizeof(unsigned long));
+
+  for(i = 0; i < file->blanks_count; i++)
+    parent[i] = i;
+
+  for(i = 0; i < file->statement_count; i++) {
+    rdfdiff_statement *ds = &file->statements[i];
+    int a, b;
+
+    if(ds->subject_blank < 0 || ds->object_blank < 0)
+      continue;
+
+    a = rdfdiff_find_root(parent, ds->subject_blank);
+    b = rdfdiff_find_root(parent, ds->object_blank);
+    if(a == b)
+      flags[a] |= RDFDIFF_COMPONENT_CYCLIC;
+    else {
+      parent[a] = b;
+      flags[b] |= flags[a];
     }
-    prev = cur;
-    cur = cur->next;
   }
 
-  return NULL;
+  for(i = 0; i < file->blanks_count; i++) {
+    if(file->blanks[i].linked && rdfdiff_colour_is_shared(file, i))
+      flags[rdfdiff_find_root(parent, i)] |= RDFDIFF_COMPONENT_SHARED;
+  }
+
+  /* component_of maps a root blank node to its component */
+  for(i = 0; i < file->blanks_count; i++)
+    component_of[i] = -1;
+
+  file->components_count = 0;
+  for(i = 0; i < file->blanks_count; i++) {
+    int root = rdfdiff_find_root(parent, i);
+
+    if(flags[root] != (RDFDIFF_COMPONENT_CYCLIC | RDFDIFF_COMPONENT_SHARED))
+      continue;
+
+    if(component_of[root] < 0)
+      component_of[root] = file->components_count++;
+    file->components[component_of[root]].count++;
+  }
+
+  for(i = 0; i < file->components_count; i++) {
+    file->components[i].offset = offset;
+    offset += file->components[i].count;
+    file->components[i].count = 0;
+  }
+
+  for(i = 0; i < file->blanks_count; i++) {
+    int root = rdfdiff_find_root(parent, i);
+    rdfdiff_component *component;
+
+    if(flags[root] != (RDFDIFF_COMPONENT_CYCLIC | RDFDIFF_COMPONENT_SHARED))
+      continue;
+
+    component = &file->components[component_of[root]];
+    file->component_blanks[component->offset + component->count++] = i;
+    component->signature += rdfdiff_scramble(file->colours[i]);
+  }
+
+  rc = 0;
+
+  tidy:
+  if(parent)
+    RAPTOR_FREE(int*, parent);
+  if(flags)
+    RAPTOR_FREE(int*, flags);
+  if(component_of)
+    RAPTOR_FREE(int*, component_of);
+
+  return rc;
 }
 
 
 static int
-rdfdiff_statement_exists(rdfdiff_file* file, const raptor_statement *statement)
+rdfdiff_compare_component(const void *a, const void *b)
 {
-  rdfdiff_link* node;
-  rdfdiff_link* prev = NULL;
-  node = rdfdiff_statement_find(file, statement, &prev);
-  return (node != NULL);
+  const rdfdiff_component *c1 = (const rdfdiff_component*)a;
+  const rdfdiff_component *c2 = (const rdfdiff_component*)b;
+
+  if(c1->signature != c2->signature)
+    return (c1->signature > c2->signature) ? 1 : -1;
+  return c1->count - c2->count;
 }
 
 
 /*
- * rdfdiff_collect_statements - Called when parsing "from" file to build a
- * list of statements for comparison with those in the "to" file.
+ * rdfdiff_node_signatures - Get the sorted signatures of the statements
+ * using @count blank nodes that only link to each other.  Returns the
+ * number of signatures stored in *@signatures_p or <0 on failure.
  */
-static void
-rdfdiff_collect_statements(void *user_data, raptor_statement *statement)
+static int
+rdfdiff_node_signatures(rdfdiff_file *file, const int *nodes, int count,
+                        unsigned long **signatures_p)
 {
-  int rv = 0;
-  rdfdiff_file* file = (rdfdiff_file*)user_data;
+  unsigned long *signatures;
+  size_t size = 1;
+  int n = 0;
+  int i;
 
-  if(rdfdiff_statement_exists(file, statement))
-    return;
-  
-  file->statement_count++;
+  for(i = 0; i < count; i++)
+    size += (size_t)file->blanks[nodes[i]].arcs_count;
 
-  if(statement->subject->type == RAPTOR_TERM_TYPE_BLANK ||
-     statement->object->type  == RAPTOR_TERM_TYPE_BLANK) {
+  signatures = RAPTOR_MALLOC(unsigned long*, size * sizeof(unsigned long));
+  if(!signatures)
+    return -1;
 
-    if(statement->subject->type == RAPTOR_TERM_TYPE_BLANK)
-      rv = rdfdiff_add_blank_statement(file, statement);
+  for(i = 0; i < count; i++) {
+    int b = nodes[i];
+    rdfdiff_blank *blank = &file->blanks[b];
+    int k;
 
-    if(rv == 0 && statement->object->type == RAPTOR_TERM_TYPE_BLANK)
-      rv = rdfdiff_add_blank_statement_owner(file, statement);
+    for(k = 0; k < blank->arcs_count; k++) {
+      rdfdiff_statement *ds = &file->statements[file->arcs[blank->arcs_offset + k]];
 
-  } else {
-    rv = rdfdiff_add_statement(file, statement);
+      /* count each statement once, from its subject if that is blank */
+      if(ds->subject_blank == b || ds->subject_blank < 0)
+        signatures[n++] = rdfdiff_statement_signature(file, ds);
+    }
   }
 
-  if(rv != 0) {
-    raptor_parser_parse_abort(file->parser);
+  qsort(signatures, (size_t)n, sizeof(unsigned long),
+        rdfdiff_compare_colour);
+
+  *signatures_p = signatures;
+  return n;
+}
+
+
+static int
+rdfdiff_nodes_match(rdfdiff_file *from, const int *from_nodes,
+                    rdfdiff_file *to, const int *to_nodes, int count)
+{
+  unsigned long *from_signatures = NULL;
+  unsigned long *to_signatures = NULL;
+  int from_n;
+  int to_n;
+  int rc;
+
+  from_n = rdfdiff_node_signatures(from, from_nodes, count, &from_signatures);
+  to_n = rdfdiff_node_signatures(to, to_nodes, count, &to_signatures);
+  if(from_n < 0 || to_n < 0)
+    rc = RDFDIFF_SEARCH_FAILED;
+  else
+    rc = (from_n == to_n &&
+          !memcmp(from_signatures, to_signatures,
+                  (size_t)from_n * sizeof(unsigned long)));
+
+  if(from_signatures)
+    RAPTOR_FREE(unsigned long*, from_signatures);
+  if(to_signatures)
+    RAPTOR_FREE(unsigned long*, to_signatures);
+
+  return rc;
+}
+
+
+/*
+ * rdfdiff_search - Find a pairing of the @count blank nodes in
+ * @from_nodes with those in @to_nodes that makes their statements the
+ * same.  Refines their colours then, while some blank nodes cannot be
+ * told apart, gives a blank node of the smallest such class a new
+ * colour along with each candidate in the other file in turn.
+ *
+ * Returns 1 if the blank nodes match, 0 if not,
+ * RDFDIFF_SEARCH_GAVE_UP if the budget ran out or
+ * RDFDIFF_SEARCH_FAILED on failure.
+ */
+static int
+rdfdiff_search(rdfdiff_file *from, const int *from_nodes,
+               rdfdiff_file *to, const int *to_nodes, int count, int depth)
+{
+  size_t colours_size = (size_t)count * sizeof(unsigned long);
+  unsigned long *from_saved = NULL;
+  unsigned long *to_saved = NULL;
+  unsigned long class_colour = 0;
+  unsigned long new_colour;
+  int class_size = 0;
+  int x = -1;
+  int y;
+  int rc = 0;
+  int i;
+
+  rc = rdfdiff_refine(from, from_nodes, count, to, to_nodes, count);
+  if(rc)
+    return (rc < 0) ? RDFDIFF_SEARCH_FAILED : 0;
+
+  /* find the smallest class with more than one blank node */
+  for(i = 0; i < count; ) {
+    int size = 1;
+
+    while(i + size < count &&
+          from->sorted_colours[i + size] == from->sorted_colours[i])
+      size++;
+    if(size > 1 && (!class_size || size < class_size)) {
+      class_size = size;
+      class_colour = from->sorted_colours[i];
+    }
+    i += size;
   }
-  
+
+  if(!class_size)
+    return rdfdiff_nodes_match(from, from_nodes, to, to_nodes, count);
+
+  for(i = 0; i < count; i++) {
+    if(from->colours[from_nodes[i]] == class_colour) {
+      x = from_nodes[i];
+      break;
+    }
+  }
+
+  from_saved = RAPTOR_MALLOC(unsigned long*, colours_size);
+  to_saved = RAPTOR_MALLOC(unsigned long*, colours_size);
+  if(!from_saved || !to_saved) {
+    rc = RDFDIFF_SEARCH_FAILED;
+    goto tidy;
+  }
+  for(i = 0; i < count; i++) {
+    from_saved[i] = from->colours[from_nodes[i]];
+    to_saved[i] = to->colours[to_nodes[i]];
+  }
+
+  new_colour = rdfdiff_scramble(rdfdiff_mix(class_colour,
+                                            (unsigned long)depth + 1));
+
+  for(y = 0; y < count; y++) {
+    if(to_saved[y] != class_colour)
+      continue;
+
+    if(++search_steps > search_limit) {
+      rc = RDFDIFF_SEARCH_GAVE_UP;
+      break;
+    }
+
+    from->colours[x] = new_colour;
+    to->colours[to_nodes[y]] = new_colour;
+
+    rc = rdfdiff_search(from, from_nodes, to, to_nodes, count, depth + 1);
+    if(rc)
+      break;
+
+    for(i = 0; i < count; i++) {
+      from->colours[from_nodes[i]] = from_saved[i];
+      to->colours[to_nodes[i]] = to_saved[i];
+    }
+  }
+
+  tidy:
+  if(from_saved)
+    RAPTOR_FREE(unsigned long*, from_saved);
+  if(to_saved)
+    RAPTOR_FREE(unsigned long*, to_saved);
+
+  return rc;
+}
+
+
+/*
+ * rdfdiff_match_components - Pair each component found by
+ * rdfdiff_find_components() with one in the other file that has the
+ * same shape.  Returns as rdfdiff_search().
+ */
+static int
+rdfdiff_match_components(rdfdiff_file *from, rdfdiff_file *to)
+{
+  int i = 0;
+
+  if(from->components_count != to->components_count)
+    return 0;
+
+  qsort(from->components, (size_t)from->components_count,
+        sizeof(rdfdiff_component), rdfdiff_compare_component);
+  qsort(to->components, (size_t)to->components_count,
+        sizeof(rdfdiff_component), rdfdiff_compare_component);
+
+  while(i < from->components_count) {
+    int end = i + 1;
+    int f;
+
+    while(end < from->components_count &&
+          !rdfdiff_compare_component(&from->components[end],
+                                     &from->components[i]))
+      end++;
+
+    /* the other file must have the same run of components */
+    if(rdfdiff_compare_component(&to->components[i], &from->components[i]) ||
+       rdfdiff_compare_component(&to->components[end - 1],
+                                 &from->components[i]) ||
+       (end < to->components_count &&
+        !rdfdiff_compare_component(&to->components[end],
+                                   &from->components[i])))
+      return 0;
+
+    for(f = i; f < end; f++) {
+      rdfdiff_component *fc = &from->components[f];
+      const int *from_nodes = &from->component_blanks[fc->offset];
+      int t;
+      int rc = 0;
+
+      for(t = i; t < end; t++) {
+        rdfdiff_component *tc = &to->components[t];
+        const int *to_nodes = &to->component_blanks[tc->offset];
+        int k;
+
+        if(tc->matched)
+          continue;
+
+        search_limit = search_steps + RDFDIFF_SEARCH_BUDGET;
+        rc = rdfdiff_search(from, from_nodes, to, to_nodes, fc->count, 0);
+
+        /* restore the colours for the next pairing */
+        for(k = 0; k < fc->count; k++) {
+          from->colours[from_nodes[k]] = from->saved_colours[from_nodes[k]];
+          to->colours[to_nodes[k]] = to->saved_colours[to_nodes[k]];
+        }
+
+        if(rc < 0)
+          return rc;
+        if(rc) {
+          tc->matched = 1;
+          break;
+        }
+      }
+
+      if(!rc)
+        return 0;
+    }
+
+    i = end;
+  }
+
+  return 1;
 }
 
 
+/*
+ * rdfdiff_match_blanks - Match the statements with blank nodes in the
+ * two files by colour refinement, searching when that leaves cycles of
+ * blank nodes that cannot be told apart.  Returns <0 on failure, 1 if
+ * the search found no match for statements that all have the same
+ * shape, 2 if the search gave up, otherwise 0.
+ */
+static int
+rdfdiff_match_blanks(rdfdiff_file *from, rdfdiff_file *to)
+{
+  int colours_differ;
+  int unmatched;
+  int rc;
+
+  if(rdfdiff_index_blanks(from) || rdfdiff_index_blanks(to))
+    return -1;
+
+  colours_differ = rdfdiff_refine(from, NULL, from->blanks_count,
+                                  to, NULL, to->blanks_count);
+  if(colours_differ < 0)
+    return -1;
+
+  unmatched = rdfdiff_match_blank_statements(from, to);
+  if(unmatched)
+    return (unmatched < 0) ? -1 : 0;
+
+  if(colours_differ || from->colours_count == from->blanks_count)
+    return 0;
+
+  if(rdfdiff_find_components(from) || rdfdiff_find_components(to))
+    return -1;
+
+  rc = rdfdiff_match_components(from, to);
+  if(rc == RDFDIFF_SEARCH_FAILED)
+    return -1;
+  if(rc == RDFDIFF_SEARCH_GAVE_UP)
+    return 2;
+
+  return !rc;
+}
+
+
+static void
+rdfdiff_report_statements(rdfdiff_file *file, rdfdiff_file *other,
+                          const char *prefix, int *emit_header_p)
+{
+  int i;
+
+  for(i = 0; i < file->statement_count; i++) {
+    rdfdiff_statement *ds = &file->statements[i];
+
+    if(ds->matched)
+      continue;
+
+    if(!brief) {
+      if(*emit_header_p) {
+        fprintf(stderr, "Statements in %s but not in %s\n",
+                file->name, other->name);
+        *emit_header_p = 0;
+      }
+
+      fprintf(stderr, "%s    ", prefix);
+      raptor_statement_print_as_ntriples(ds->statement, stderr);
+      fprintf(stderr, "\n");
+    }
+
+    file->difference_count++;
+  }
+}
+
+
+static void
+rdfdiff_print_time(const char *label, double seconds)
+{
+  fprintf(stderr, "%s: %-24s %8.3fs\n", program, label, seconds);
+}
+
 
 int
 main(int argc, char *argv[]) 
@@ -728,8 +1625,13 @@ main(int argc, char *argv[])
   int help = 0;
   char *p;
   int rv = 0;
-  rdfdiff_blank *b1;
-  rdfdiff_link *cur;
+  int blanks_rc = 0;
+  double start_time = 0.0;
+  double parse_from_time = 0.0;
+  double parse_to_time = 0.0;
+  double ground_time = 0.0;
+  double blanks_time = 0.0;
+  double report_time = 0.0;
   
   program = argv[0];
   if((p = strrchr(program, '/')))
@@ -772,6 +1674,10 @@ main(int argc, char *argv[])
         help = 1;
         break;
 
+      case 's':
+        stats = 1;
+        break;
+
       case 'f':
         if(optarg)
           from_syntax = optarg;
@@ -815,9 +1721,14 @@ main(int argc, char *argv[])
     puts("\nOPTIONS:");
     puts(HELP_TEXT("h", "help                      ", "Print this help, then exit"));
     puts(HELP_TEXT("b", "brief                     ", "Report only whether files differ"));
+    puts(HELP_TEXT("s", "stats                     ", "Report sizes and the time taken by each phase"));
     puts(HELP_TEXT("u BASE-URI", "base-uri BASE-URI  ", "Set the base URI for the files"));
     puts(HELP_TEXT("f FORMAT",   "from-format FORMAT ", "Format of <from URI> (default is rdfxml)"));
     puts(HELP_TEXT("t FORMAT",   "to-format FORMAT   ", "Format of <to URI> (default is rdfxml)"));
+    puts("\nExit status is 0 if the files are the same, 1 if they differ or");
+    puts("cannot be read, 2 on an internal error and 3 if the search for");
+    printf("matching blank nodes gave up after %d tries per group of them.\n",
+           RDFDIFF_SEARCH_BUDGET);
     rv = 1;
     goto exit;
   }
@@ -879,152 +1790,78 @@ main(int argc, char *argv[])
   raptor_parser_set_statement_handler(from_file->parser, from_file,
                                rdfdiff_collect_statements);
   
+  start_time = rdfdiff_now();
   if(raptor_parser_parse_uri(from_file->parser, from_uri, base_uri)) {
     fprintf(stderr, "%s: Failed to parse URI %s as %s content\n", program, 
             from_string, from_syntax);
     rv = 1;
     goto exit;
   } else {
+    parse_from_time = rdfdiff_now() - start_time;
 
     /* Note intentional from_uri as base_uri */
     raptor_parser_set_statement_handler(to_file->parser, to_file,
                                  rdfdiff_collect_statements);
+    start_time = rdfdiff_now();
     if(raptor_parser_parse_uri(to_file->parser, to_uri, base_uri ? base_uri: from_uri)) {
       fprintf(stderr, "%s: Failed to parse URI %s as %s content\n", program, 
               to_string, to_syntax);
       rv = 1;
       goto exit;
     }
+    parse_to_time = rdfdiff_now() - start_time;
   }
 
 
-  /* Compare triples with no blank nodes */
-  cur = to_file->first;
-  while(cur) {
-    rdfdiff_link* node;
-    rdfdiff_link* prev;
-    node = rdfdiff_statement_find(from_file, cur->statement, &prev);
-    if(node) {
-      /* exists in from file - remove it from the list */
-      if(from_file->first == node) {
-        from_file->first = node->next;
-      } else {
-        prev->next = node->next;
-      }
-      raptor_free_statement(node->statement);
-      RAPTOR_FREE(rdfdiff_link, node);
-    } else {
-      if(!brief) {
-        if(emit_from_header) {
-          fprintf(stderr, "Statements in %s but not in %s\n",
-                  to_file->name, from_file->name);
-          emit_from_header = 0;
-        }
-        
-        fprintf(stderr, "<    ");
-        raptor_statement_print_as_ntriples(cur->statement, stderr);
-        fprintf(stderr, "\n");
-      }
-      
-      to_file->difference_count++;
-    }
-    cur = cur->next;
-  }
-
-  
-  /* Now compare the blank nodes */
-  b1 = to_file->first_blank;
-  while(b1) {
-
-    rdfdiff_blank *b2 = from_file->first_blank;
-
-    while(b2) {
+  /* Compare statements with no blank nodes */
+  start_time = rdfdiff_now();
+  rdfdiff_match_ground_statements(from_file, to_file);
+  ground_time = rdfdiff_now() - start_time;
 
-      if(!b2->matched && rdfdiff_blank_equals(b1, b2, to_file, from_file)) {
-        b1->matched = 1;
-        b2->matched = 1;
-        break;
-      }
-      
-      b2 = b2->next;
-      
-    }
-
-    if(b2 == 0) {
-      if(!brief) {        
-#if 0
-        fprintf(stderr, "<    ");
-        raptor_statement_print_as_ntriples(b1->owner, stderr);
-        fprintf(stderr, "\n");
-#else
-        if(emit_from_header) {
-          fprintf(stderr, "Statements in %s but not in %s\n",  to_file->name, from_file->name);
-          emit_from_header = 0;
-        }
-
-        fprintf(stderr, "<    anonymous node %s\n", b1->blank_id);
-#endif        
-      }
-      
-      to_file->difference_count++;
+  /* Now compare the statements with blank nodes */
+  start_time = rdfdiff_now();
+  if(from_file->blank_statement_count || to_file->blank_statement_count) {
+    blanks_rc = rdfdiff_match_blanks(from_file, to_file);
+    if(blanks_rc < 0) {
+      fprintf(stderr, "%s: Internal Error\n", program);
+      rv = 2;
+      goto exit;
     }
-    
-    b1 = b1->next;
-
   }
-  
-  if(from_file->first) {
-    /* The entrys left in from_file have not been found in to_file. */
-    if(!brief) {
-
-      if(emit_to_header) {
-        fprintf(stderr, "Statements in %s but not in %s\n",  from_file->name,
-                to_file->name);
-        emit_to_header = 0;
-      }
-      
-      cur = from_file->first;
-      while(cur) {
-        if(!brief) {
-          fprintf(stderr, ">    ");
-          raptor_statement_print_as_ntriples(cur->statement, stderr);
-          fprintf(stderr, "\n");
-        }
-      
-        cur = cur->next;
-        from_file->difference_count++;
-      }
-    }
-
+  blanks_time = rdfdiff_now() - start_time;
+
+  start_time = rdfdiff_now();
+  rdfdiff_report_statements(to_file, from_file, "<", &emit_from_header);
+  rdfdiff_report_statements(from_file, to_file, ">", &emit_to_header);
+
+  if(blanks_rc == 1) {
+    /* every statement has a counterpart but the graphs differ */
+    if(!brief)
+      fprintf(stderr, "Blank nodes in %s cannot be matched to those in %s\n",
+              to_file->name, from_file->name);
+    to_file->difference_count++;
+    from_file->difference_count++;
+  } else if(blanks_rc == 2 && !brief)
+    fprintf(stderr, "%s: Gave up matching blank nodes after %d tries; cannot tell if the files differ\n",
+            program, search_steps);
+  report_time = rdfdiff_now() - start_time;
+
+  if(stats) {
+    fprintf(stderr, "%s: %s: %d statements, %d with blank nodes, %d blank nodes\n",
+            program, from_file->name, from_file->statement_count,
+            from_file->blank_statement_count, from_file->blanks_count);
+    fprintf(stderr, "%s: %s: %d statements, %d with blank nodes, %d blank nodes\n",
+            program, to_file->name, to_file->statement_count,
+            to_file->blank_statement_count, to_file->blanks_count);
+    rdfdiff_print_time("parsing from file", parse_from_time);
+    rdfdiff_print_time("parsing to file", parse_to_time);
+    rdfdiff_print_time("matching statements", ground_time);
+    rdfdiff_print_time("matching blank nodes", blanks_time);
+    fprintf(stderr, "%s: %d colour refinement rounds, %d search steps\n",
+            program, refine_rounds, search_steps);
+    rdfdiff_print_time("reporting", report_time);
   }
 
-  if(from_file->first_blank) {
-    rdfdiff_blank *blank = from_file->first_blank;
-    while(blank) {
-
-      if(!blank->matched) {
-        if(!brief) {
-#if 0          
-          fprintf(stderr, ">    ");
-          raptor_statement_print_as_ntriples(blank->owner, stderr);
-          fprintf(stderr, "\n");
-#else
-          if(emit_to_header) {
-            fprintf(stderr, "Statements in %s but not in %s\n",  from_file->name, to_file->name);
-            emit_to_header = 0;
-          }
-          fprintf(stderr, ">    anonymous node %s\n", blank->blank_id);
-#endif          
-        }
-        from_file->difference_count++;
-      }
-    
-      blank = blank->next;
-      
-    }
-
-  }
-  
   if(!(from_file->difference_count == 0 &&
         to_file->difference_count == 0)) {
 
@@ -1032,6 +1869,11 @@ main(int argc, char *argv[])
       fprintf(stderr, "Files differ\n");
 
     rv = 1;
+  } else if(blanks_rc == 2) {
+    if(brief)
+      fprintf(stderr, "Files may differ\n");
+
+    rv = 3;
   }
 
 exit: